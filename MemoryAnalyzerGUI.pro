@@ -8,15 +8,71 @@ CONFIG += c++17
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+# Count heap allocations per tick for the diagnostics page (qmake
+# CONFIG+=alloc_counter). Replaces malloc for the whole process, so leave it
+# off for sanitizer, valgrind or jemalloc/tcmalloc builds.
+alloc_counter: DEFINES += MEMANALYZER_COUNT_ALLOCS
+
 SOURCES += \
     main.cpp \
     mainwindow.cpp \
-    processworker.cpp
+    processworker.cpp \
+    hardwareprobe.cpp \
+    datasource.cpp \
+    procscanner.cpp \
+    procevents.cpp \
+    samplescheduler.cpp \
+    pressuremonitor.cpp \
+    cgroupmonitor.cpp \
+    metricsexporter.cpp \
+    alertengine.cpp \
+    smapssampler.cpp \
+    growthdetector.cpp \
+    scanprofile.cpp \
+    allocationcounter.cpp \
+    meminfo.cpp \
+    procfdcache.cpp \
+    processtablemodel.cpp \
+    processfilter.cpp \
+    processtree.cpp \
+    processtreemodel.cpp \
+    cgroupmodel.cpp \
+    historystore.cpp \
+    memoryrecorder.cpp \
+    snapshotformat.cpp \
+    snapshotreplayer.cpp \
+    headlesscollector.cpp
 
 HEADERS += \
     datatypes.h \
     mainwindow.h \
-    processworker.h
+    processworker.h \
+    hardwareprobe.h \
+    datasource.h \
+    procscanner.h \
+    procevents.h \
+    samplescheduler.h \
+    pressuremonitor.h \
+    cgroupmonitor.h \
+    metricsexporter.h \
+    alertengine.h \
+    smapssampler.h \
+    growthdetector.h \
+    scanprofile.h \
+    allocationcounter.h \
+    meminfo.h \
+    procfdcache.h \
+    processtablemodel.h \
+    processfilter.h \
+    processtree.h \
+    processtreemodel.h \
+    cgroupmodel.h \
+    topk.h \
+    historystore.h \
+    memoryrecorder.h \
+    snapshotformat.h \
+    snapshotreplayer.h \
+    headlesscollector.h
 
 
 # Default rules for deployment.
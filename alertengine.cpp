@@ -0,0 +1,508 @@
+#include "alertengine.h"
+
+#include <fnmatch.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+namespace {
+
+// Names cached for classify() before the cache starts over; process names
+// are few, but some programs put a counter or an id in theirs.
+const size_t kMaxCachedNames = 16384;
+
+bool isGlob(const std::string &pattern)
+{
+    return pattern.find_first_of("*?[") != std::string::npos;
+}
+
+bool startsWith(const std::string &text, const char *prefix)
+{
+    return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+// "2GB", "512 kb"... to KB. Sizes are binary, as everywhere else here.
+bool parseSize(const std::string &token, bool allowNegative, double &kb)
+{
+    char *end = nullptr;
+    double value = strtod(token.c_str(), &end);
+    if (end == token.c_str() || !std::isfinite(value) || (value < 0 && !allowNegative)) return false;
+    std::string unit(end);
+    for (char &c : unit) c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+    double scale;
+    if (unit == "K" || unit == "KB") scale = 1;
+    else if (unit == "M" || unit == "MB") scale = 1024;
+    else if (unit == "G" || unit == "GB") scale = 1024.0 * 1024;
+    else if (unit == "T" || unit == "TB") scale = 1024.0 * 1024 * 1024;
+    else return false;
+    kb = value * scale;
+    return true;
+}
+
+bool parsePercent(const std::string &token, double &percent)
+{
+    char *end = nullptr;
+    percent = strtod(token.c_str(), &end);
+    if (end == token.c_str() || !std::isfinite(percent) || percent < 0) return false;
+    return *end == '\0' || (end[0] == '%' && end[1] == '\0');
+}
+
+bool parseDuration(const std::string &token, int64_t &ms)
+{
+    char *end = nullptr;
+    double value = strtod(token.c_str(), &end);
+    if (end == token.c_str() || !std::isfinite(value) || value < 0) return false;
+    std::string unit(end);
+    double scale;
+    if (unit == "ms") scale = 1;
+    else if (unit == "s") scale = 1000;
+    else if (unit == "m" || unit == "min") scale = 60 * 1000;
+    else if (unit == "h") scale = 3600 * 1000;
+    else return false;
+    ms = static_cast<int64_t>(value * scale);
+    return true;
+}
+
+std::string formatSize(double kb)
+{
+    char buf[32];
+    double magnitude = std::fabs(kb);
+    if (magnitude >= 1024.0 * 1024) snprintf(buf, sizeof(buf), "%.2f GB", kb / (1024.0 * 1024));
+    else if (magnitude >= 1024) snprintf(buf, sizeof(buf), "%.1f MB", kb / 1024);
+    else snprintf(buf, sizeof(buf), "%.0f KB", kb);
+    return buf;
+}
+
+bool fail(std::string *error, const std::string &message)
+{
+    if (error) *error = message;
+    return false;
+}
+
+} // namespace
+
+bool AlertQueue::push(Alert &&alert)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (Alert &waiting : m_pending) {
+        if (waiting.key == alert.key) {
+            waiting.message = std::move(alert.message);
+            waiting.timeMs = alert.timeMs;
+            waiting.repeats += alert.repeats;
+            return false;
+        }
+    }
+    bool wasEmpty = m_pending.empty();
+    if (m_pending.size() >= m_capacity) {
+        m_pending.pop_front();
+        ++m_dropped;
+    }
+    m_pending.push_back(std::move(alert));
+    return wasEmpty;
+}
+
+std::vector<Alert> AlertQueue::drain()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<Alert> alerts(std::make_move_iterator(m_pending.begin()), std::make_move_iterator(m_pending.end()));
+    m_pending.clear();
+    return alerts;
+}
+
+uint64_t AlertQueue::dropped() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_dropped;
+}
+
+bool AlertEngine::parseRule(const std::string &line, Rule &rule, std::string *error)
+{
+    std::istringstream in(line);
+    std::vector<std::string> tokens;
+    for (std::string token; in >> token;) tokens.push_back(token);
+    if (tokens.size() < 4) return fail(error, "expected <scope> <metric> <op> <threshold>");
+
+    rule = Rule();
+    rule.text = line.substr(line.find_first_not_of(" \t"));
+    rule.text.erase(rule.text.find_last_not_of(" \t\r") + 1);
+
+    const std::string &scope = tokens[0];
+    if (scope == "system") {
+        rule.scope = System;
+    } else if (startsWith(scope, "pid=")) {
+        char *end = nullptr;
+        long pid = strtol(scope.c_str() + 4, &end, 10);
+        if (pid <= 0 || *end != '\0') return fail(error, "bad pid in \"" + scope + "\"");
+        rule.scope = Pid;
+        rule.pid = static_cast<pid_t>(pid);
+    } else if (startsWith(scope, "name=") && scope.size() > 5) {
+        rule.scope = Name;
+        rule.pattern = scope.substr(5);
+    } else if (startsWith(scope, "cgroup=") && scope.size() > 7) {
+        rule.scope = Cgroup;
+        rule.pattern = scope.substr(7);
+        if (rule.pattern[0] != '/') return fail(error, "cgroup paths start with /, e.g. cgroup=/system.slice/*");
+    } else {
+        return fail(error, "unknown scope \"" + scope + "\"; use system, pid=, name= or cgroup=");
+    }
+
+    std::string metric = tokens[1];
+    if (metric.size() > 1 && metric.back() == '%') {
+        rule.mode = Percent;
+        metric.pop_back();
+    } else if (metric.size() > 4 && metric.compare(metric.size() - 4, 4, "/min") == 0) {
+        rule.mode = Rate;
+        metric.resize(metric.size() - 4);
+    }
+    if (metric == "memory") rule.metric = Memory;
+    else if (metric == "swap") rule.metric = Swap;
+    else if (metric == "available") rule.metric = Available;
+    else return fail(error, "unknown metric \"" + tokens[1] + "\"; use memory, swap or available");
+    if (rule.metric == Available && rule.scope != System) return fail(error, "available is only known for the system");
+    if (rule.mode == Rate && rule.metric == Swap && rule.scope != System) {
+        return fail(error, "swap/min is only known for the system");
+    }
+
+    const std::string &op = tokens[2];
+    if (op == ">" || op == ">=") rule.above = true;
+    else if (op == "<" || op == "<=") rule.above = false;
+    else return fail(error, "unknown comparison \"" + op + "\"; use >, >=, < or <=");
+    rule.inclusive = op.size() == 2;
+
+    auto parseLevel = [&rule, error](const std::string &token, double &level) {
+        if (rule.mode == Percent) {
+            if (!parsePercent(token, level)) return fail(error, "bad percentage \"" + token + "\"");
+        } else if (!parseSize(token, rule.mode == Rate, level)) {
+            return fail(error, "bad size \"" + token + "\"; sizes need a unit, e.g. 512MB or 2GB");
+        }
+        return true;
+    };
+    if (!parseLevel(tokens[3], rule.threshold)) return false;
+    rule.clear = rule.threshold;
+
+    for (size_t i = 4; i < tokens.size(); i += 2) {
+        if (i + 1 >= tokens.size()) return fail(error, "\"" + tokens[i] + "\" needs a value");
+        if (tokens[i] == "for") {
+            if (!parseDuration(tokens[i + 1], rule.forMs)) {
+                return fail(error, "bad duration \"" + tokens[i + 1] + "\"; e.g. 500ms, 30s, 5m or 1h");
+            }
+        } else if (tokens[i] == "clear") {
+            if (!parseLevel(tokens[i + 1], rule.clear)) return false;
+            if (rule.above ? rule.clear > rule.threshold : rule.clear < rule.threshold) {
+                return fail(error, "the clear level has to be on the near side of the threshold");
+            }
+        } else {
+            return fail(error, "unexpected \"" + tokens[i] + "\"; rules end with for <duration> or clear <level>");
+        }
+    }
+    return true;
+}
+
+bool AlertEngine::compile(const std::string &rules, std::string *error)
+{
+    std::vector<Rule> parsed;
+    std::istringstream in(rules);
+    int number = 0;
+    for (std::string line; std::getline(in, line);) {
+        ++number;
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') continue;
+        Rule rule;
+        std::string reason;
+        if (!parseRule(line, rule, &reason)) {
+            return fail(error, "line " + std::to_string(number) + ": " + reason);
+        }
+        parsed.push_back(std::move(rule));
+    }
+
+    m_rules = std::move(parsed);
+    m_predicates.clear();
+    m_systemRules.clear();
+    m_cgroupRules.clear();
+    m_globNameRules.clear();
+    m_exactNameRules.clear();
+    m_pidRules.clear();
+    for (size_t i = 0; i < m_rules.size(); ++i) {
+        const Rule &rule = m_rules[i];
+        m_predicates.push_back({rule.metric, rule.mode, rule.above, rule.inclusive, rule.threshold, rule.clear,
+                                rule.forMs});
+        int index = static_cast<int>(i);
+        switch (rule.scope) {
+        case System: m_systemRules.push_back(index); break;
+        case Cgroup: m_cgroupRules.push_back(index); break;
+        case Pid: m_pidRules[rule.pid].push_back(index); break;
+        case Name:
+            if (isGlob(rule.pattern)) m_globNameRules.push_back(index);
+            else m_exactNameRules[rule.pattern].push_back(index);
+            break;
+        }
+    }
+    m_hasProcessRules = !m_globNameRules.empty() || !m_exactNameRules.empty() || !m_pidRules.empty();
+
+    m_classes.clear();
+    m_classRules.clear();
+    m_classOfRules.clear();
+    m_classOfName.clear();
+    m_classOfPid.clear();
+    m_cgroupEntries.clear();
+    m_states.clear();
+    m_lastSystemTimeMs = -1;
+    m_firing = 0;
+    ++m_generation;
+    return true;
+}
+
+int AlertEngine::addClass(std::vector<int> &rules)
+{
+    if (rules.empty()) return -1;
+    std::sort(rules.begin(), rules.end());
+    rules.erase(std::unique(rules.begin(), rules.end()), rules.end());
+    std::string key(reinterpret_cast<const char *>(rules.data()), rules.size() * sizeof(int));
+    auto it = m_classOfRules.find(key);
+    if (it != m_classOfRules.end()) return it->second;
+
+    int cls = static_cast<int>(m_classes.size());
+    m_classes.emplace_back(static_cast<uint32_t>(m_classRules.size()), static_cast<uint32_t>(rules.size()));
+    m_classRules.insert(m_classRules.end(), rules.begin(), rules.end());
+    m_classOfRules.emplace(std::move(key), cls);
+    return cls;
+}
+
+int AlertEngine::classify(pid_t pid, const char *name, size_t len)
+{
+    if (!m_hasProcessRules) return -1;
+
+    std::string key(name, len);
+    int nameClass;
+    auto it = m_classOfName.find(key);
+    if (it != m_classOfName.end()) {
+        nameClass = it->second;
+    } else {
+        std::vector<int> matched;
+        auto exact = m_exactNameRules.find(key);
+        if (exact != m_exactNameRules.end()) matched = exact->second;
+        for (int rule : m_globNameRules) {
+            if (fnmatch(m_rules[rule].pattern.c_str(), key.c_str(), 0) == 0) matched.push_back(rule);
+        }
+        nameClass = addClass(matched);
+        if (m_classOfName.size() >= kMaxCachedNames) m_classOfName.clear();
+        m_classOfName.emplace(std::move(key), nameClass);
+    }
+
+    auto pidRules = m_pidRules.find(pid);
+    if (pidRules == m_pidRules.end()) return nameClass;
+    uint64_t pidKey = static_cast<uint64_t>(static_cast<uint32_t>(pid)) << 32 | static_cast<uint32_t>(nameClass + 1);
+    auto known = m_classOfPid.find(pidKey);
+    if (known != m_classOfPid.end()) return known->second;
+    std::vector<int> combined = pidRules->second;
+    if (nameClass >= 0) {
+        const auto &span = m_classes[nameClass];
+        combined.insert(combined.end(), m_classRules.begin() + span.first,
+                        m_classRules.begin() + span.first + span.second);
+    }
+    int cls = addClass(combined);
+    m_classOfPid.emplace(pidKey, cls);
+    return cls;
+}
+
+void AlertEngine::beginScan(int64_t timeMs, const MemInfo &memInfo)
+{
+    ++m_scan;
+    m_timeMs = timeMs;
+    m_memInfo = memInfo;
+    m_raised.clear();
+    m_evaluations = 0;
+
+    long total = memInfo[MemInfo::MemTotal];
+    long available = memInfo[MemInfo::MemAvailable];
+    long swapTotal = memInfo[MemInfo::SwapTotal];
+    long swapFree = memInfo[MemInfo::SwapFree];
+    double values[3] = {
+        total >= 0 && available >= 0 ? static_cast<double>(total - available) : -1.0,
+        swapTotal >= 0 && swapFree >= 0 ? static_cast<double>(swapTotal - swapFree) : -1.0,
+        static_cast<double>(available),
+    };
+    double totals[3] = {static_cast<double>(total), static_cast<double>(swapTotal), static_cast<double>(total)};
+    double minutes = m_lastSystemTimeMs >= 0 ? (timeMs - m_lastSystemTimeMs) / 60000.0 : 0;
+
+    Subject system = {0, "system", 6};
+    for (int rule : m_systemRules) {
+        const Predicate &p = m_predicates[rule];
+        double value = values[p.metric];
+        if (value < 0) continue;
+        if (p.mode == Percent) {
+            if (totals[p.metric] <= 0) continue;
+            value = value * 100 / totals[p.metric];
+        } else if (p.mode == Rate) {
+            if (minutes <= 0) continue;
+            value = (value - m_lastSystemValues[p.metric]) / minutes;
+        }
+        check(rule, system, value);
+    }
+    std::copy(values, values + 3, m_lastSystemValues);
+    m_lastSystemTimeMs = timeMs;
+}
+
+void AlertEngine::evaluateProcess(int processClass, pid_t pid, const char *name, size_t len, long rssKb,
+                                  long swapKb, double growthKbPerSec)
+{
+    if (processClass < 0 || static_cast<size_t>(processClass) >= m_classes.size()) return;
+    const auto &span = m_classes[processClass];
+    Subject subject = {static_cast<uint32_t>(pid), name, len};
+    long total = m_memInfo[MemInfo::MemTotal];
+    long swapTotal = m_memInfo[MemInfo::SwapTotal];
+    for (uint32_t i = span.first; i < span.first + span.second; ++i) {
+        int rule = m_classRules[i];
+        const Predicate &p = m_predicates[rule];
+        double value;
+        if (p.metric == Memory) {
+            if (p.mode == Rate) value = growthKbPerSec * 60;
+            else if (p.mode == Percent) value = total > 0 ? rssKb * 100.0 / total : -1;
+            else value = rssKb;
+        } else {
+            if (swapKb < 0) continue;
+            if (p.mode == Percent) value = swapTotal > 0 ? swapKb * 100.0 / swapTotal : -1;
+            else value = swapKb;
+        }
+        if (value < 0 && p.mode != Rate) continue;
+        check(rule, subject, value);
+    }
+}
+
+void AlertEngine::evaluateCgroups(const std::vector<CgroupStats> &cgroups)
+{
+    if (m_cgroupRules.empty()) return;
+    if (m_cgroupEntries.size() > 4 * cgroups.size() + 1024) m_cgroupEntries.clear();
+
+    long total = m_memInfo[MemInfo::MemTotal];
+    long swapTotal = m_memInfo[MemInfo::SwapTotal];
+    for (const CgroupStats &cgroup : cgroups) {
+        auto it = m_cgroupEntries.find(cgroup.path);
+        if (it == m_cgroupEntries.end()) {
+            std::vector<int> matched;
+            for (int rule : m_cgroupRules) {
+                if (fnmatch(m_rules[rule].pattern.c_str(), cgroup.path.c_str(), 0) == 0) matched.push_back(rule);
+            }
+            CgroupEntry entry;
+            entry.cls = addClass(matched);
+            entry.id = ++m_nextCgroupId;
+            it = m_cgroupEntries.emplace(cgroup.path, entry).first;
+        }
+        CgroupEntry &entry = it->second;
+        if (entry.cls < 0) continue;
+
+        Subject subject = {entry.id, cgroup.path.data(), cgroup.path.size()};
+        double minutes = entry.lastTimeMs >= 0 ? (m_timeMs - entry.lastTimeMs) / 60000.0 : 0;
+        const auto &span = m_classes[entry.cls];
+        for (uint32_t i = span.first; i < span.first + span.second; ++i) {
+            int rule = m_classRules[i];
+            const Predicate &p = m_predicates[rule];
+            double value = p.metric == Memory ? cgroup.currentKb : cgroup.swapKb;
+            if (value < 0) continue;
+            if (p.mode == Percent) {
+                double base = p.metric == Memory ? (cgroup.limitKb > 0 ? cgroup.limitKb : total) : swapTotal;
+                if (base <= 0) continue;
+                value = value * 100 / base;
+            } else if (p.mode == Rate) {
+                if (minutes <= 0 || entry.lastKb < 0) continue;
+                value = (value - entry.lastKb) / minutes;
+            }
+            check(rule, subject, value);
+        }
+        entry.lastTimeMs = m_timeMs;
+        entry.lastKb = cgroup.currentKb;
+    }
+}
+
+void AlertEngine::check(int rule, const Subject &subject, double value)
+{
+    ++m_evaluations;
+    const Predicate &p = m_predicates[rule];
+    auto past = [&p, value](double level) {
+        if (p.above) return p.inclusive ? value >= level : value > level;
+        return p.inclusive ? value <= level : value < level;
+    };
+    // Short of the clear level nothing is kept: a state left untouched
+    // is dropped in endScan(), which re-arms the rule for this subject.
+    if (!past(p.clear)) return;
+
+    State &state = m_states[static_cast<uint64_t>(rule) << 32 | subject.id];
+    state.scan = m_scan;
+    if (!past(p.threshold)) {
+        state.since = -1;
+        return;
+    }
+    if (state.since < 0) state.since = m_timeMs;
+    if (state.firing || m_timeMs - state.since < p.forMs) return;
+
+    state.firing = true;
+    ++m_fired;
+    Alert alert;
+    alert.key = m_rules[rule].text + '\x1f' + std::to_string(subject.id);
+    alert.message = describe(m_rules[rule], subject, value);
+    alert.timeMs = m_timeMs;
+    m_raised.push_back(std::move(alert));
+}
+
+const std::vector<Alert> &AlertEngine::endScan()
+{
+    m_firing = 0;
+    for (auto it = m_states.begin(); it != m_states.end();) {
+        if (it->second.scan != m_scan) {
+            it = m_states.erase(it);
+        } else {
+            if (it->second.firing) ++m_firing;
+            ++it;
+        }
+    }
+    return m_raised;
+}
+
+std::string AlertEngine::describe(const Rule &rule, const Subject &subject, double value) const
+{
+    std::string text;
+    const char *what;
+    switch (rule.scope) {
+    case System:
+        text = "System";
+        what = rule.metric == Memory ? "used memory" : rule.metric == Swap ? "used swap" : "available memory";
+        break;
+    case Cgroup:
+        text = "Cgroup " + std::string(subject.name, subject.len);
+        what = rule.metric == Memory ? "memory" : "swap";
+        break;
+    default:
+        text = std::string(subject.name, subject.len) + " (PID " + std::to_string(subject.id) + ")";
+        what = rule.metric == Memory ? "RSS" : "swap";
+        break;
+    }
+
+    char buf[32];
+    std::string shown;
+    if (rule.mode == Percent) {
+        snprintf(buf, sizeof(buf), "%.1f%%", value);
+        shown = buf;
+    } else if (rule.mode == Rate) {
+        shown = (value >= 0 ? "+" : "") + formatSize(value) + "/min";
+    } else {
+        shown = formatSize(value);
+    }
+    text += ": " + std::string(what) + (rule.mode == Rate ? " changing by " : " at ") + shown;
+    return text + " (rule: " + rule.text + ")";
+}
+
+AlertEngine::Stats AlertEngine::stats() const
+{
+    Stats stats;
+    stats.rules = m_rules.size();
+    stats.classes = m_classes.size();
+    stats.tracked = m_states.size();
+    stats.firing = m_firing;
+    stats.evaluations = m_evaluations;
+    stats.fired = m_fired;
+    return stats;
+}
@@ -0,0 +1,198 @@
+#ifndef ALERTENGINE_H
+#define ALERTENGINE_H
+
+#include <sys/types.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "cgroupmonitor.h"
+#include "meminfo.h"
+
+// One alert on its way to the user
+struct Alert {
+    std::string key;          // alerts with the same key are the same condition
+    std::string message;
+    int64_t timeMs = 0;       // wall clock when it was raised
+    unsigned repeats = 1;     // raised this many times while waiting in the queue
+};
+
+// Alerts from the threads that raise them (the worker, the pressure monitor)
+// to the one that shows them. push() never waits on the consumer: an alert
+// whose key is already waiting only updates that entry, and beyond the
+// capacity the oldest waiting alert is dropped. Thread-safe.
+class AlertQueue
+{
+public:
+    explicit AlertQueue(size_t capacity = 256) : m_capacity(capacity) {}
+
+    // Returns true if the queue was empty before, i.e. the consumer needs a
+    // nudge; it will find everything pushed until it drains.
+    bool push(Alert &&alert);
+    // Everything waiting, oldest first
+    std::vector<Alert> drain();
+    uint64_t dropped() const;
+
+private:
+    mutable std::mutex m_mutex;
+    std::deque<Alert> m_pending;
+    size_t m_capacity;
+    uint64_t m_dropped = 0;
+};
+
+// Memory alert rules, one per line:
+//
+//   <scope> <metric> <op> <threshold> [for <duration>] [clear <level>]
+//
+//   scope      system, pid=<pid>, name=<glob> (the process name as in
+//              /proc/<pid>/comm) or cgroup=<glob> (a cgroup v2 path)
+//   metric     memory (RSS; for the system, used memory; for a cgroup,
+//              memory.current), swap, or available (system only); with %
+//              appended, as a share of the total (a cgroup's limit, or
+//              all memory if it has none); with /min, its change per minute
+//   op         >, >=, < or <=
+//   threshold  a size such as 512KB, 300MB or 2GB, or a number for %
+//   for        how long the condition has to hold before it fires, e.g.
+//              500ms, 30s, 5m or 1h
+//   clear      once fired, the rule only fires again for that subject after
+//              the value went back past this level (default: the threshold)
+//
+// e.g. "system memory% > 90 for 30s clear 85", "name=chrome* memory > 2GB",
+// "pid=1234 memory/min > 50MB", "cgroup=/system.slice/* memory% >= 95".
+// Blank lines and lines starting with # are skipped.
+//
+// compile() builds flat tables: the rules that apply to a process are
+// resolved once per process name (and pid, for pid rules) into a class
+// that the caller keeps with the process, so a scan is one pass over the
+// processes in which one that no rule mentions costs a comparison. State is
+// kept only for (rule, subject) pairs whose value is past the clear level.
+//
+// Not thread-safe; all calls belong to one thread.
+class AlertEngine
+{
+public:
+    enum Scope { System, Pid, Name, Cgroup };
+    enum Metric { Memory, Swap, Available };
+    enum Mode { Absolute, Percent, Rate };
+
+    struct Rule {
+        Scope scope = System;
+        Metric metric = Memory;
+        Mode mode = Absolute;
+        bool above = true;      // > or >=
+        bool inclusive = false; // >= or <=
+        double threshold = 0;   // KB, percent or KB per minute
+        double clear = 0;
+        int64_t forMs = 0;
+        pid_t pid = 0;
+        std::string pattern;    // name or cgroup glob
+        std::string text;       // the line it came from
+    };
+
+    struct Stats {
+        size_t rules = 0;
+        size_t classes = 0;           // distinct sets of rules matched by processes
+        size_t tracked = 0;           // (rule, subject) pairs past their clear level
+        size_t firing = 0;
+        uint64_t evaluations = 0;     // rule checks in the last scan
+        uint64_t fired = 0;
+    };
+
+    // Replaces the rules. On a syntax error, keeps the old ones and returns
+    // false with the line and what is wrong.
+    bool compile(const std::string &rules, std::string *error = nullptr);
+    const std::vector<Rule> &rules() const { return m_rules; }
+    // Changes with every compile(); classes from earlier ones are invalid.
+    unsigned generation() const { return m_generation; }
+    bool hasProcessRules() const { return m_hasProcessRules; }
+    bool hasCgroupRules() const { return !m_cgroupRules.empty(); }
+
+    // The rules that apply to a process, or -1 if none do. Only changes
+    // with its name or generation().
+    int classify(pid_t pid, const char *name, size_t len);
+
+    void beginScan(int64_t timeMs, const MemInfo &memInfo);
+    // swapKb -1 if not known; growthKbPerSec is the change of rssKb since
+    // the last scan.
+    void evaluateProcess(int processClass, pid_t pid, const char *name, size_t len, long rssKb, long swapKb,
+                         double growthKbPerSec);
+    void evaluateCgroups(const std::vector<CgroupStats> &cgroups);
+    // Forgets subjects that were not past their clear level this scan and
+    // returns the alerts raised by it.
+    const std::vector<Alert> &endScan();
+
+    Stats stats() const;
+
+    static bool parseRule(const std::string &line, Rule &rule, std::string *error);
+
+private:
+    // The part of a rule looked at on every check, kept apart from the text
+    struct Predicate {
+        Metric metric;
+        Mode mode;
+        bool above;
+        bool inclusive;
+        double threshold;
+        double clear;
+        int64_t forMs;
+    };
+
+    struct State {
+        int64_t since = -1;   // when the threshold was first passed, -1 if it is not now
+        bool firing = false;
+        uint64_t scan = 0;    // last scan the value was past the clear level in
+    };
+
+    struct Subject {
+        uint32_t id;          // pid, cgroup id, or 0 for the system
+        const char *name;     // process name or cgroup path
+        size_t len;
+    };
+
+    struct CgroupEntry {
+        int cls = -1;
+        uint32_t id = 0;
+        int64_t lastTimeMs = -1;
+        long lastKb = -1;
+    };
+
+    int addClass(std::vector<int> &rules);
+    void check(int rule, const Subject &subject, double value);
+    std::string describe(const Rule &rule, const Subject &subject, double value) const;
+
+    std::vector<Rule> m_rules;
+    std::vector<Predicate> m_predicates;
+    unsigned m_generation = 0;
+    bool m_hasProcessRules = false;
+    std::vector<int> m_systemRules;
+    std::vector<int> m_cgroupRules;
+    std::vector<int> m_globNameRules;
+    std::unordered_map<std::string, std::vector<int>> m_exactNameRules;
+    std::unordered_map<pid_t, std::vector<int>> m_pidRules;
+
+    // A class is a span of m_classRules; equal sets of rules share one.
+    std::vector<std::pair<uint32_t, uint32_t>> m_classes;
+    std::vector<int> m_classRules;
+    std::unordered_map<std::string, int> m_classOfRules;
+    std::unordered_map<std::string, int> m_classOfName;
+    std::unordered_map<uint64_t, int> m_classOfPid;  // pid << 32 | name class + 1
+    std::unordered_map<std::string, CgroupEntry> m_cgroupEntries;
+    uint32_t m_nextCgroupId = 0;
+
+    std::unordered_map<uint64_t, State> m_states;  // rule << 32 | subject id
+    uint64_t m_scan = 0;
+    int64_t m_timeMs = 0;
+    MemInfo m_memInfo;
+    int64_t m_lastSystemTimeMs = -1;
+    double m_lastSystemValues[3] = {0, 0, 0};      // per Metric, for rates
+    std::vector<Alert> m_raised;
+    size_t m_firing = 0;
+    uint64_t m_evaluations = 0;
+    uint64_t m_fired = 0;
+};
+
+#endif // ALERTENGINE_H
@@ -0,0 +1,71 @@
+#include "allocationcounter.h"
+
+#include <cstddef>
+#include <cstdlib>
+
+#if defined(MEMANALYZER_COUNT_ALLOCS) && defined(__GLIBC__)
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+}
+
+namespace {
+
+// Plain thread_local data in the executable needs no allocation itself, so
+// it is safe to touch from inside malloc.
+thread_local uint64_t t_allocations = 0;
+thread_local uint64_t t_bytes = 0;
+
+} // namespace
+
+// These replace glibc's definitions for the whole process; free() and the
+// aligned variants stay glibc's and work on the same heap.
+extern "C" void *malloc(size_t size)
+{
+    ++t_allocations;
+    t_bytes += size;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    ++t_allocations;
+    t_bytes += count * size;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    ++t_allocations;
+    t_bytes += size;
+    return __libc_realloc(ptr, size);
+}
+
+AllocationCount threadAllocations()
+{
+    AllocationCount count;
+    count.allocations = t_allocations;
+    count.bytes = t_bytes;
+    return count;
+}
+
+bool allocationsCounted()
+{
+    return true;
+}
+
+#else
+
+AllocationCount threadAllocations()
+{
+    return AllocationCount();
+}
+
+bool allocationsCounted()
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <cstdint>
+
+// Heap allocations made by the calling thread since it started. Counting
+// replaces malloc, calloc and realloc for the whole process (which also
+// covers operator new and Qt's containers), and that gets in the way of
+// sanitizers, valgrind and other allocators, so it is only built in on
+// request: with MEMANALYZER_COUNT_ALLOCS defined (CONFIG += alloc_counter
+// for qmake; procbench always has it) and glibc, whose __libc_* entry
+// points the wrappers forward to. Otherwise the counts stay zero.
+struct AllocationCount {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+};
+
+AllocationCount threadAllocations();
+// Whether threadAllocations() counts anything in this build
+bool allocationsCounted();
+
+#endif // ALLOCATIONCOUNTER_H
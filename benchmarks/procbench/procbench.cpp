@@ -0,0 +1,564 @@
+// Scanner and tick-to-table benchmark against a generated proc tree, so a
+// 20k-process host can be reproduced on any Linux box. Three stages:
+//
+//   scanner    ProcScanner alone on the tree: throughput, syscalls and heap
+//              allocations per scan in steady state.
+//   tick       a ProcessWorker on its own thread feeding a ProcessTableModel
+//              behind a sorted ProcessFilterProxy, as the process page does:
+//              the worker's phases and the latency from emitting a scan until
+//              the table holds it.
+//   synthetic  the same pipeline on a SyntheticSource instead of the tree,
+//              each tick started as soon as the last one reached the table:
+//              everything after /proc, at full speed and without the host.
+//
+// With --view, the ticks also go to a ProcessTreeModel behind a sorting
+// proxy, as the tree and grouped views do, and count towards the table
+// update. The generated tree has every process below init; the synthetic
+// source builds a deeper tree. With --metrics-top, the worker also builds
+// the metrics exposition every tick, timed as its Export phase; with
+// --alert-rules, it checks the rules in that file, within its Build phase.
+//
+// Between scans a share of the processes exits and is replaced, and a share
+// changes RSS. Results go to stdout as JSON. Thresholds given on the command
+// line are checked afterwards; any breach is listed under "failures" and
+// makes the exit status 1.
+//
+// Usage: procbench [--pids N] [--name-length N] [--churn PERCENT] ...
+//        (see --help)
+
+#include "processworker.h"
+#include "datasource.h"
+#include "processtablemodel.h"
+#include "processfilter.h"
+#include "processtreemodel.h"
+#include "procscanner.h"
+#include "scanprofile.h"
+#include "allocationcounter.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSortFilterProxyModel>
+#include <QThread>
+#include <QTimer>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Warm-up scans open every descriptor and send the full snapshot; they are
+// not counted.
+const int kWarmupScans = 2;
+
+// A tick that does not arrive within this is a hang, not a slow scan.
+const int kTickTimeoutMs = 60000;
+
+bool writeFile(const std::string &path, const char *data, size_t len)
+{
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    bool ok = ::write(fd, data, len) == static_cast<ssize_t>(len);
+    ::close(fd);
+    return ok;
+}
+
+// /proc/<pid>/{stat,statm,comm} and /proc/meminfo, laid out as the kernel
+// does. statm is fixed width and rewritten in place, so a scanner holding
+// its descriptor sees the new value, as it would for a live process.
+class FakeProcTree
+{
+public:
+    FakeProcTree(std::string root, int nameLength, unsigned seed)
+        : m_root(std::move(root)), m_nameLength(std::clamp(nameLength, 1, 15)), m_rng(seed)
+    {
+    }
+
+    ~FakeProcTree()
+    {
+        if (m_keep) return;
+        for (pid_t pid : m_pids) removeProcess(pid);
+        ::unlink((m_root + "/meminfo").c_str());
+        ::rmdir(m_root.c_str());
+    }
+
+    void setKeep(bool keep) { m_keep = keep; }
+    const std::string &root() const { return m_root; }
+
+    bool create(int count)
+    {
+        static const char kMeminfo[] =
+            "MemTotal:       32768000 kB\nMemFree:         8192000 kB\nMemAvailable:   16384000 kB\n"
+            "Buffers:          512000 kB\nCached:          8192000 kB\nSwapCached:            0 kB\n"
+            "SwapTotal:       8192000 kB\nSwapFree:        8192000 kB\nShmem:            256000 kB\n";
+        if (!writeFile(m_root + "/meminfo", kMeminfo, sizeof(kMeminfo) - 1)) return false;
+        for (int i = 0; i < count; ++i) {
+            if (!addProcess()) return false;
+        }
+        return true;
+    }
+
+    // exitPercent of the processes exit and as many new ones start;
+    // rssPercent of the rest change their RSS.
+    bool churn(double exitPercent, double rssPercent)
+    {
+        size_t exits = static_cast<size_t>(m_pids.size() * exitPercent / 100);
+        for (size_t i = 0; i < exits && !m_pids.empty(); ++i) {
+            size_t victim = m_rng() % m_pids.size();
+            removeProcess(m_pids[victim]);
+            m_pids[victim] = m_pids.back();
+            m_pids.pop_back();
+            m_resident[victim] = m_resident.back();
+            m_resident.pop_back();
+        }
+        for (size_t i = 0; i < exits; ++i) {
+            if (!addProcess()) return false;
+        }
+        size_t changes = static_cast<size_t>(m_pids.size() * rssPercent / 100);
+        for (size_t i = 0; i < changes && !m_pids.empty(); ++i) {
+            size_t index = m_rng() % m_pids.size();
+            m_resident[index] = std::max(1L, m_resident[index] + static_cast<long>(m_rng() % 512) - 200);
+            if (!writeStatm(m_pids[index], m_resident[index])) return false;
+        }
+        return true;
+    }
+
+private:
+    std::string pidDir(pid_t pid) const { return m_root + "/" + std::to_string(pid); }
+
+    bool writeStatm(pid_t pid, long resident)
+    {
+        char buf[96];
+        int len = snprintf(buf, sizeof(buf), "%10ld %10ld %10ld 10 0 %10ld 0\n", resident * 4, resident, resident / 8,
+                           resident);
+        int fd = ::open((pidDir(pid) + "/statm").c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+        bool ok = ::pwrite(fd, buf, len, 0) == len;
+        ::close(fd);
+        return ok;
+    }
+
+    bool addProcess()
+    {
+        pid_t pid = m_nextPid++;
+        std::string dir = pidDir(pid);
+        if (::mkdir(dir.c_str(), 0755) != 0) return false;
+        // Distinct names that share prefixes, like real worker pools
+        std::string name = "w" + std::to_string(pid % 997);
+        while (static_cast<int>(name.size()) < m_nameLength) name += static_cast<char>('a' + name.size() % 26);
+        name.resize(m_nameLength);
+
+        char stat[512];
+        int len = snprintf(stat, sizeof(stat),
+                           "%d (%s) S 1 %d %d 0 -1 4194560 0 0 0 0 0 0 0 0 20 0 1 0 %llu 100000000 %ld "
+                           "18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 17 0 0 0 0 0 0\n",
+                           static_cast<int>(pid), name.c_str(), static_cast<int>(pid), static_cast<int>(pid),
+                           ++m_startTime, 0L);
+        name += '\n';
+        std::lognormal_distribution<double> rssPages(8.0, 1.5);
+        long resident = std::max(1L, static_cast<long>(rssPages(m_rng)));
+        if (!writeFile(dir + "/stat", stat, static_cast<size_t>(len)) || !writeFile(dir + "/comm", name.data(), name.size())
+            || !writeStatm(pid, resident)) {
+            return false;
+        }
+        m_pids.push_back(pid);
+        m_resident.push_back(resident);
+        return true;
+    }
+
+    void removeProcess(pid_t pid)
+    {
+        std::string dir = pidDir(pid);
+        for (const char *file : {"/stat", "/statm", "/comm"}) ::unlink((dir + file).c_str());
+        ::rmdir(dir.c_str());
+    }
+
+    std::string m_root;
+    int m_nameLength;
+    std::mt19937 m_rng;
+    std::vector<pid_t> m_pids;
+    std::vector<long> m_resident; // parallel to m_pids, in pages
+    pid_t m_nextPid = 1000;
+    unsigned long long m_startTime = 100;
+    bool m_keep = false;
+};
+
+QJsonObject distribution(const LatencyHistogram &histogram)
+{
+    QJsonObject out;
+    out["mean"] = histogram.mean() / 1e6;
+    out["p50"] = histogram.percentile(0.5) / 1e6;
+    out["p99"] = histogram.percentile(0.99) / 1e6;
+    out["max"] = histogram.max() / 1e6;
+    return out;
+}
+
+struct Settings {
+    int pids = 20000;
+    double churnPercent = 1;
+    double rssPercent = 10;
+    int scans = 50;
+    int ticks = 30;
+    int threads = 1;
+    int intervalMs = 100;
+    int nameLength = 15;
+    unsigned seed = 1;
+    int view = -1; // a ProcessTreeModel::Mode to feed as well, or -1
+    int metricsTop = -1; // processes exported per tick, or -1 for no metrics endpoint
+    QString alertRules;
+};
+
+QJsonObject runScanner(FakeProcTree &tree, const Settings &settings, QStringList &errors)
+{
+    ProcScanner scanner(tree.root().c_str());
+    scanner.setThreadCount(settings.threads);
+    LatencyHistogram scanTime;
+    LatencyHistogram listTime;
+    uint64_t allocations = 0;
+    uint64_t maxAllocations = 0;
+    uint64_t syscalls = 0;
+    size_t processes = 0;
+    for (int i = 0; i < kWarmupScans + settings.scans; ++i) {
+        if (!tree.churn(settings.churnPercent, settings.rssPercent)) {
+            errors << "could not update the proc tree";
+            break;
+        }
+        AllocationCount before = threadAllocations();
+        QElapsedTimer timer;
+        timer.start();
+        processes = scanner.scan().size();
+        qint64 ns = timer.nsecsElapsed();
+        AllocationCount after = threadAllocations();
+        if (i < kWarmupScans) continue;
+        scanTime.record(static_cast<uint64_t>(ns));
+        listTime.record(static_cast<uint64_t>(scanner.lastProfile().listMs * 1e6));
+        allocations += after.allocations - before.allocations;
+        maxAllocations = std::max<uint64_t>(maxAllocations, after.allocations - before.allocations);
+        syscalls += scanner.lastProfile().syscalls;
+    }
+    int scans = qMax<int>(1, static_cast<int>(scanTime.count()));
+    QJsonObject out;
+    out["scans"] = static_cast<int>(scanTime.count());
+    out["processes"] = static_cast<int>(processes);
+    out["scan_ms"] = distribution(scanTime);
+    out["list_ms"] = distribution(listTime);
+    out["pids_per_second"] = scanTime.mean() ? processes * 1e9 / scanTime.mean() : 0.0;
+    out["us_per_pid"] = processes ? scanTime.mean() / 1e3 / processes : 0.0;
+    out["syscalls_per_scan"] = static_cast<double>(syscalls) / scans;
+    out["allocations_per_scan"] = static_cast<double>(allocations) / scans;
+    out["max_allocations_per_scan"] = static_cast<double>(maxAllocations);
+    return out;
+}
+
+// Runs worker on its own thread until settings.ticks ticks (after warm-up)
+// reached the table. start is invoked on the worker's thread once; advance
+// after every tick, returning false on failure.
+QJsonObject measureTicks(ProcessWorker *worker, void (ProcessWorker::*start)(), const Settings &settings,
+                         const std::function<bool()> &advance, QStringList &errors)
+{
+    QThread thread;
+    worker->moveToThread(&thread);
+    // No history, and only the path the process page takes is measured.
+    worker->setHistoryBudget(0);
+    worker->setCpuBudget(100);
+    worker->setInterval(0);
+    worker->setConsumerInterval(SampleScheduler::Tracker, settings.intervalMs);
+    // On an ephemeral loopback port; nothing scrapes it, building the
+    // exposition is what each tick pays.
+    if (settings.metricsTop >= 0) worker->setMetricsEndpoint("127.0.0.1:0", settings.metricsTop);
+    if (!settings.alertRules.isEmpty()) worker->setAlertRules(settings.alertRules);
+
+    ProcessTableModel model;
+    ProcessFilterProxy proxy;
+    proxy.setProcessModel(&model);
+    proxy.setSortRole(ProcessTableModel::SortRole);
+    proxy.setDynamicSortFilter(true);
+    proxy.sort(ProcessTableModel::MemoryColumn, Qt::DescendingOrder);
+    ProcessTreeModel treeModel;
+    QSortFilterProxyModel treeProxy;
+    if (settings.view >= 0) treeModel.setMode(static_cast<ProcessTreeModel::Mode>(settings.view), QVector<ProcessInfo>());
+    treeProxy.setSourceModel(&treeModel);
+    treeProxy.setSortRole(ProcessTreeModel::SortRole);
+    treeProxy.setDynamicSortFilter(true);
+    treeProxy.sort(ProcessTreeModel::MemoryColumn, Qt::DescendingOrder);
+
+    ScanProfile profile;
+    LatencyHistogram tickToTable;
+    LatencyHistogram scanToTable;
+    quint64 generation = 0;
+    int received = 0;
+    QEventLoop loop;
+    QTimer watchdog;
+    watchdog.setSingleShot(true);
+    QObject::connect(&watchdog, &QTimer::timeout, &loop, [&] {
+        errors << QString("no tick for %1 ms").arg(kTickTimeoutMs);
+        loop.quit();
+    });
+    QObject::connect(worker, &ProcessWorker::scanDelta, &loop, [&](const ScanDelta &delta) {
+        ScanProfile::Tick tick = delta.scanStats.profile;
+        tick.phaseMs[ScanProfile::Deliver] = (ScanProfile::nowNs() - tick.emittedNs) / 1e6;
+        if (delta.baseGeneration != 0 && delta.baseGeneration != generation) {
+            worker->requestFullSnapshot();
+            return;
+        }
+        AllocationCount before = threadAllocations();
+        QElapsedTimer timer;
+        timer.start();
+        model.applyDelta(delta);
+        if (settings.view >= 0) treeModel.applyDelta(delta);
+        tick.phaseMs[ScanProfile::Apply] = timer.nsecsElapsed() / 1e6;
+        AllocationCount after = threadAllocations();
+        tick.receiver.allocations = after.allocations - before.allocations;
+        tick.receiver.allocatedBytes = after.bytes - before.bytes;
+        generation = delta.generation;
+        if (received++ >= kWarmupScans) {
+            profile.record(tick);
+            double toTable = tick.phaseMs[ScanProfile::Deliver] + tick.phaseMs[ScanProfile::Apply];
+            tickToTable.record(static_cast<uint64_t>(toTable * 1e6));
+            scanToTable.record(static_cast<uint64_t>((toTable + tick.phaseMs[ScanProfile::Scan]) * 1e6));
+        }
+        if (received >= kWarmupScans + settings.ticks) {
+            loop.quit();
+            return;
+        }
+        if (!advance()) {
+            loop.quit();
+            return;
+        }
+        watchdog.start(kTickTimeoutMs);
+    });
+    QObject::connect(&thread, &QThread::started, worker, start);
+    QElapsedTimer wallTimer;
+    wallTimer.start();
+    thread.start();
+    watchdog.start(kTickTimeoutMs);
+    loop.exec();
+    qint64 wallNs = wallTimer.nsecsElapsed();
+    QObject::disconnect(worker, &ProcessWorker::scanDelta, &loop, nullptr);
+    thread.quit();
+    thread.wait();
+    delete worker;
+
+    int ticks = qMax<int>(1, static_cast<int>(profile.ticks()));
+    QJsonObject phases;
+    for (int phase = 0; phase < ScanProfile::PhaseCount; ++phase) {
+        const LatencyHistogram &histogram = profile.histogram(static_cast<ScanProfile::Phase>(phase));
+        if (histogram.count()) phases[ScanProfile::phaseName(static_cast<ScanProfile::Phase>(phase))] = distribution(histogram);
+    }
+    QJsonObject out;
+    out["ticks"] = static_cast<int>(profile.ticks());
+    out["ticks_per_second"] = wallNs ? received * 1e9 / wallNs : 0.0;
+    out["rows"] = model.rowCount();
+    if (settings.view >= 0) {
+        out["tree_top_level_rows"] = treeModel.rowCount();
+        out["tree_propagations_per_tick"] = static_cast<double>(treeModel.tree().propagations()) / qMax(1, received);
+    }
+    out["phases_ms"] = phases;
+    out["tick_to_table_ms"] = distribution(tickToTable);
+    out["scan_to_table_ms"] = distribution(scanToTable);
+    out["worker_syscalls_per_tick"] = static_cast<double>(profile.workerTotal().syscalls) / ticks;
+    out["worker_allocations_per_tick"] = static_cast<double>(profile.workerTotal().allocations) / ticks;
+    out["table_allocations_per_tick"] = static_cast<double>(profile.receiverTotal().allocations) / ticks;
+    return out;
+}
+
+QJsonObject runTicks(FakeProcTree &tree, const Settings &settings, QStringList &errors)
+{
+    ProcessWorker *worker = new ProcessWorker(nullptr, tree.root().c_str());
+    // The fake tree has no process connector.
+    worker->setProcessEvents(false);
+    worker->setScanThreadCount(settings.threads);
+    return measureTicks(worker, &ProcessWorker::startSampling, settings, [&] {
+        if (tree.churn(settings.churnPercent, settings.rssPercent)) return true;
+        errors << "could not update the proc tree";
+        return false;
+    }, errors);
+}
+
+QJsonObject runSynthetic(const Settings &settings, QStringList &errors)
+{
+    SyntheticSource::Options options;
+    options.processes = settings.pids;
+    options.churn = settings.churnPercent / 100;
+    options.changes = settings.rssPercent / 100;
+    options.nameLength = settings.nameLength;
+    options.stepMs = settings.intervalMs;
+    options.seed = settings.seed;
+    ProcessWorker *worker = new ProcessWorker(std::unique_ptr<DataSource>(new SyntheticSource(options)));
+    // Queued, so the next tick starts once this one has been applied.
+    return measureTicks(worker, &ProcessWorker::scanNow, settings, [worker] {
+        QMetaObject::invokeMethod(worker, &ProcessWorker::scanNow, Qt::QueuedConnection);
+        return true;
+    }, errors);
+}
+
+// Adds a failure if the threshold option is set and value exceeds it.
+void checkMax(const QCommandLineParser &parser, const QString &option, double value, QJsonArray &failures)
+{
+    if (!parser.isSet(option)) return;
+    double limit = parser.value(option).toDouble();
+    if (value <= limit) return;
+    failures.append(QString("%1: %2 > %3").arg(option).arg(value).arg(limit));
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks the scanner and the tick-to-table path on a generated proc tree.");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"pids", "Processes in the tree (default 20000).", "count", "20000"},
+        {"name-length", "Length of process names, 1 to 15 (default 15).", "chars", "15"},
+        {"churn", "Percent of processes replaced between scans (default 1).", "percent", "1"},
+        {"rss-changes", "Percent of processes whose RSS changes between scans (default 10).", "percent", "10"},
+        {"scans", "Measured scanner-only scans (default 50).", "count", "50"},
+        {"ticks", "Measured worker ticks (default 30).", "count", "30"},
+        {"interval", "Milliseconds between worker ticks (default 100).", "ms", "100"},
+        {"threads", "Scan threads (default 1).", "count", "1"},
+        {"stage", "scanner, tick, synthetic or all (default all).", "stage", "all"},
+        {"view", "Also feed the tree or grouped view: tree, name, user or command.", "view"},
+        {"metrics-top", "Also build the metrics exposition every tick, with this many processes (see the Export phase).",
+         "count"},
+        {"alert-rules", "Also check the alert rules in this file every tick (see the Build phase).", "file"},
+        {"root", "Directory for the tree (default: a new one under $TMPDIR).", "dir"},
+        {"keep", "Leave the tree in place afterwards."},
+        {"seed", "Random seed (default 1).", "number", "1"},
+        {"max-us-per-pid", "Fail if a scanner scan takes longer per process on average.", "us"},
+        {"max-scan-allocations", "Fail if a steady-state scanner scan allocates more often.", "count"},
+        {"max-tick-p99-ms", "Fail if the p99 from emitting a tick to the table holding it is longer.", "ms"},
+        {"max-scan-p99-ms", "Fail if the worker's p99 scan time is longer.", "ms"},
+    });
+    parser.process(app);
+    qRegisterMetaType<ScanDelta>("ScanDelta");
+
+    Settings settings;
+    settings.pids = qMax(1, parser.value("pids").toInt());
+    settings.churnPercent = qBound(0.0, parser.value("churn").toDouble(), 100.0);
+    settings.rssPercent = qBound(0.0, parser.value("rss-changes").toDouble(), 100.0);
+    settings.scans = qMax(1, parser.value("scans").toInt());
+    settings.ticks = qMax(1, parser.value("ticks").toInt());
+    settings.threads = qMax(1, parser.value("threads").toInt());
+    settings.intervalMs = qMax(100, parser.value("interval").toInt());
+    settings.nameLength = parser.value("name-length").toInt();
+    settings.seed = parser.value("seed").toUInt();
+    QString stage = parser.value("stage");
+    if (stage != "scanner" && stage != "tick" && stage != "synthetic" && stage != "all") {
+        fprintf(stderr, "Unknown stage: %s\n", qPrintable(stage));
+        return 2;
+    }
+    if (parser.isSet("view")) {
+        const QStringList views = {"tree", "name", "user", "command"};
+        settings.view = views.indexOf(parser.value("view"));
+        if (settings.view < 0) {
+            fprintf(stderr, "Unknown view: %s\n", qPrintable(parser.value("view")));
+            return 2;
+        }
+    }
+    if (parser.isSet("metrics-top")) settings.metricsTop = qMax(0, parser.value("metrics-top").toInt());
+    if (parser.isSet("alert-rules")) {
+        QFile file(parser.value("alert-rules"));
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            fprintf(stderr, "Cannot read %s\n", qPrintable(file.fileName()));
+            return 2;
+        }
+        settings.alertRules = QString::fromUtf8(file.readAll());
+        std::string error;
+        if (!AlertEngine().compile(settings.alertRules.toStdString(), &error)) {
+            fprintf(stderr, "Alert rules: %s\n", error.c_str());
+            return 2;
+        }
+    }
+    bool useTree = stage != "synthetic";
+
+    std::string root;
+    if (!useTree) {
+        // The synthetic stage needs no tree.
+    } else if (parser.isSet("root")) {
+        root = QFile::encodeName(parser.value("root")).toStdString();
+        if (::mkdir(root.c_str(), 0755) != 0) {
+            fprintf(stderr, "Could not create %s: %s\n", root.c_str(), strerror(errno));
+            return 2;
+        }
+    } else {
+        const char *tmp = getenv("TMPDIR");
+        std::string pattern = std::string(tmp && *tmp ? tmp : "/tmp") + "/procbench-XXXXXX";
+        std::vector<char> path(pattern.begin(), pattern.end());
+        path.push_back('\0');
+        if (!mkdtemp(path.data())) {
+            fprintf(stderr, "Could not create a temporary directory: %s\n", strerror(errno));
+            return 2;
+        }
+        root = path.data();
+    }
+
+    std::unique_ptr<FakeProcTree> tree;
+    QElapsedTimer setupTimer;
+    setupTimer.start();
+    if (useTree) {
+        tree.reset(new FakeProcTree(root, settings.nameLength, settings.seed));
+        tree->setKeep(parser.isSet("keep"));
+        if (!tree->create(settings.pids)) {
+            fprintf(stderr, "Could not create the proc tree under %s: %s\n", root.c_str(), strerror(errno));
+            return 2;
+        }
+    }
+
+    QJsonObject result;
+    QJsonObject config;
+    config["pids"] = settings.pids;
+    config["name_length"] = settings.nameLength;
+    config["churn_percent"] = settings.churnPercent;
+    config["rss_change_percent"] = settings.rssPercent;
+    config["threads"] = settings.threads;
+    config["interval_ms"] = settings.intervalMs;
+    if (settings.view >= 0) config["view"] = parser.value("view");
+    config["setup_ms"] = static_cast<double>(setupTimer.elapsed());
+    result["config"] = config;
+
+    QStringList errors;
+    QJsonArray failures;
+    if (stage == "scanner" || stage == "all") {
+        QJsonObject scanner = runScanner(*tree, settings, errors);
+        checkMax(parser, "max-us-per-pid", scanner["us_per_pid"].toDouble(), failures);
+        checkMax(parser, "max-scan-allocations", scanner["max_allocations_per_scan"].toDouble(), failures);
+        result["scanner"] = scanner;
+    }
+    if ((stage == "tick" || stage == "all") && errors.isEmpty()) {
+        QJsonObject ticks = runTicks(*tree, settings, errors);
+        checkMax(parser, "max-tick-p99-ms", ticks["tick_to_table_ms"].toObject()["p99"].toDouble(), failures);
+        checkMax(parser, "max-scan-p99-ms",
+                 ticks["phases_ms"].toObject()[ScanProfile::phaseName(ScanProfile::Scan)].toObject()["p99"].toDouble(),
+                 failures);
+        result["tick"] = ticks;
+    }
+    if ((stage == "synthetic" || stage == "all") && errors.isEmpty()) {
+        QJsonObject synthetic = runSynthetic(settings, errors);
+        checkMax(parser, "max-tick-p99-ms", synthetic["tick_to_table_ms"].toObject()["p99"].toDouble(), failures);
+        result["synthetic"] = synthetic;
+    }
+    for (const QString &error : errors) failures.append(error);
+    result["failures"] = failures;
+
+    fputs(QJsonDocument(result).toJson(QJsonDocument::Indented).constData(), stdout);
+    for (const QJsonValue &failure : failures) fprintf(stderr, "FAIL %s\n", qPrintable(failure.toString()));
+    return errors.isEmpty() ? (failures.isEmpty() ? 0 : 1) : 2;
+}
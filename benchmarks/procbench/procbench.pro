@@ -0,0 +1,60 @@
+TEMPLATE = app
+QT = core
+CONFIG += console c++17
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+# The allocation thresholds need the counting malloc wrappers.
+DEFINES += MEMANALYZER_COUNT_ALLOCS
+
+SOURCES += \
+    procbench.cpp \
+    ../../processworker.cpp \
+    ../../hardwareprobe.cpp \
+    ../../datasource.cpp \
+    ../../snapshotformat.cpp \
+    ../../procscanner.cpp \
+    ../../procevents.cpp \
+    ../../procfdcache.cpp \
+    ../../samplescheduler.cpp \
+    ../../pressuremonitor.cpp \
+    ../../cgroupmonitor.cpp \
+    ../../metricsexporter.cpp \
+    ../../alertengine.cpp \
+    ../../smapssampler.cpp \
+    ../../growthdetector.cpp \
+    ../../meminfo.cpp \
+    ../../historystore.cpp \
+    ../../scanprofile.cpp \
+    ../../allocationcounter.cpp \
+    ../../processtablemodel.cpp \
+    ../../processfilter.cpp \
+    ../../processtree.cpp \
+    ../../processtreemodel.cpp
+
+HEADERS += \
+    ../../datatypes.h \
+    ../../processworker.h \
+    ../../hardwareprobe.h \
+    ../../datasource.h \
+    ../../snapshotformat.h \
+    ../../memoryrecorder.h \
+    ../../procscanner.h \
+    ../../procevents.h \
+    ../../procfdcache.h \
+    ../../samplescheduler.h \
+    ../../pressuremonitor.h \
+    ../../cgroupmonitor.h \
+    ../../metricsexporter.h \
+    ../../alertengine.h \
+    ../../smapssampler.h \
+    ../../growthdetector.h \
+    ../../meminfo.h \
+    ../../historystore.h \
+    ../../scanprofile.h \
+    ../../allocationcounter.h \
+    ../../processtablemodel.h \
+    ../../processfilter.h \
+    ../../processtree.h \
+    ../../processtreemodel.h \
+    ../../topk.h
@@ -0,0 +1,111 @@
+// Compares ranking the largest K processes with a full std::sort (what the
+// worker used to do every scan) against partial_sort, nth_element and the
+// bounded heap in topk.h.
+//
+// Usage: rankbench [k] [iterations]
+
+#include "topk.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sys/types.h>
+#include <vector>
+
+namespace {
+
+struct Item {
+    long memory;
+    pid_t pid;
+};
+
+bool byMemoryDesc(const Item &a, const Item &b)
+{
+    return a.memory > b.memory;
+}
+
+// RSS on real hosts is roughly log-normal: many small processes, a few big.
+std::vector<Item> makeItems(size_t count, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::lognormal_distribution<double> rss(9.0, 2.0);
+    std::vector<Item> items(count);
+    for (size_t i = 0; i < count; ++i) {
+        items[i].memory = static_cast<long>(rss(rng));
+        items[i].pid = static_cast<pid_t>(i + 1);
+    }
+    return items;
+}
+
+// setup() runs before every run, outside the timed part, so the variants
+// that rank in place can start from a fresh copy without paying for it.
+template <typename Setup, typename Fn>
+double timeNsPerRun(int iterations, Setup setup, Fn fn)
+{
+    long checksum = 0;
+    std::chrono::steady_clock::duration total{};
+    for (int i = 0; i < iterations; ++i) {
+        setup();
+        auto start = std::chrono::steady_clock::now();
+        checksum += fn();
+        total += std::chrono::steady_clock::now() - start;
+    }
+    if (checksum == 42) std::printf(" ");
+    return std::chrono::duration<double, std::nano>(total).count() / iterations;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    long k = 200;
+    long baseIterations = 200;
+    char *end = nullptr;
+    if (argc > 1) k = std::strtol(argv[1], &end, 10);
+    bool valid = argc <= 1 || (*end == '\0' && k >= 1);
+    if (valid && argc > 2) {
+        baseIterations = std::strtol(argv[2], &end, 10);
+        valid = *end == '\0' && baseIterations >= 1 && baseIterations <= 1000000;
+    }
+    if (!valid || argc > 3) {
+        std::fprintf(stderr, "Usage: %s [k >= 1] [iterations >= 1]\n", argv[0]);
+        return 2;
+    }
+
+    std::printf("%-8s %14s %14s %14s %14s %9s\n", "n", "sort (us)", "partial (us)", "nth (us)", "heap (us)", "speedup");
+    for (size_t n : {size_t(1000), size_t(10000), size_t(100000)}) {
+        const std::vector<Item> items = makeItems(n, 12345);
+        const size_t top = std::min(static_cast<size_t>(k), n);
+        const int iterations = std::max(1, static_cast<int>(baseIterations * 10000 / n));
+        std::vector<Item> work;
+        auto copy = [&] { work = items; };
+        auto none = [] {};
+
+        double sortNs = timeNsPerRun(iterations, copy, [&] {
+            std::sort(work.begin(), work.end(), byMemoryDesc);
+            return work[top - 1].memory;
+        });
+        double partialNs = timeNsPerRun(iterations, copy, [&] {
+            std::partial_sort(work.begin(), work.begin() + top, work.end(), byMemoryDesc);
+            return work[top - 1].memory;
+        });
+        double nthNs = timeNsPerRun(iterations, copy, [&] {
+            std::nth_element(work.begin(), work.begin() + (top - 1), work.end(), byMemoryDesc);
+            std::sort(work.begin(), work.begin() + top, byMemoryDesc);
+            return work[top - 1].memory;
+        });
+        TopK<long, pid_t> heap;
+        double heapNs = timeNsPerRun(iterations, none, [&] {
+            heap.reset(top);
+            for (const Item &item : items) heap.push(item.memory, item.pid);
+            return heap.takeSorted()[top - 1].key;
+        });
+
+        std::printf("%-8zu %14.1f %14.1f %14.1f %14.1f %8.1fx\n", n, sortNs / 1000, partialNs / 1000,
+                    nthNs / 1000, heapNs / 1000, sortNs / heapNs);
+    }
+    return 0;
+}
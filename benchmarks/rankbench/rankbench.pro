@@ -0,0 +1,11 @@
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle qt
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    rankbench.cpp
+
+HEADERS += \
+    ../../topk.h
@@ -0,0 +1,260 @@
+#include "cgroupmodel.h"
+
+#include <QBrush>
+#include <QColor>
+#include <limits>
+#include "processtablemodel.h"
+
+namespace {
+
+// Headroom below this share of the limit is shown in red
+const double kLowHeadroom = 0.1;
+
+QString formatLimit(long kilobytes)
+{
+    return kilobytes < 0 ? QString("none") : ProcessTableModel::formatMemory(kilobytes);
+}
+
+} // namespace
+
+CgroupModel::CgroupModel(QObject *parent) : QAbstractItemModel(parent)
+{
+    clear();
+}
+
+QModelIndex CgroupModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (column < 0 || column >= ColumnCount || row < 0) return QModelIndex();
+    int node = parent.isValid() ? static_cast<int>(parent.internalId()) : 0;
+    const QVector<int> &children = m_nodes.at(node).children;
+    if (row >= children.size()) return QModelIndex();
+    return createIndex(row, column, static_cast<quintptr>(children.at(row)));
+}
+
+QModelIndex CgroupModel::parent(const QModelIndex &child) const
+{
+    if (!child.isValid()) return QModelIndex();
+    return indexOf(m_nodes.at(static_cast<int>(child.internalId())).parent);
+}
+
+int CgroupModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid() && parent.column() != 0) return 0;
+    int node = parent.isValid() ? static_cast<int>(parent.internalId()) : 0;
+    return m_nodes.at(node).children.size();
+}
+
+int CgroupModel::columnCount(const QModelIndex &) const
+{
+    return ColumnCount;
+}
+
+QVariant CgroupModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid()) return QVariant();
+    const Node &node = m_nodes.at(static_cast<int>(index.internalId()));
+    const CgroupInfo &info = node.info;
+    long headroom = info.limit >= 0 && info.current >= 0 ? info.limit - info.current : -1;
+
+    if (role == Qt::DisplayRole) {
+        switch (index.column()) {
+        case NameColumn: return info.path == "/" ? info.path : info.path.section('/', -1);
+        case MemoryColumn: return ProcessTableModel::formatMemory(info.current);
+        case LimitColumn: return formatLimit(info.limit);
+        case HeadroomColumn:
+            if (headroom < 0) return info.limit < 0 ? QString("unlimited") : QString();
+            return QString("%1 (%2%)").arg(ProcessTableModel::formatMemory(headroom))
+                .arg(info.limit > 0 ? 100.0 * headroom / info.limit : 0.0, 0, 'f', 0);
+        case SwapColumn: return ProcessTableModel::formatMemory(info.swap);
+        case AnonColumn: return ProcessTableModel::formatMemory(info.anon);
+        case FileColumn: return ProcessTableModel::formatMemory(info.file);
+        case KernelColumn: return ProcessTableModel::formatMemory(info.kernel);
+        case LimitHitsColumn: return static_cast<qulonglong>(info.maxEvents);
+        case OomKillsColumn: return static_cast<qulonglong>(info.oomKills);
+        case PressureColumn:
+            return info.pressureSome < 0 ? QString("N/A") : QString::asprintf("%.1f%%", info.pressureSome * 100);
+        case ProcessesColumn: return node.processes;
+        }
+    } else if (role == SortRole) {
+        switch (index.column()) {
+        case NameColumn: return info.path;
+        case MemoryColumn: return static_cast<qlonglong>(info.current);
+        case LimitColumn:
+            return info.limit < 0 ? std::numeric_limits<qlonglong>::max() : static_cast<qlonglong>(info.limit);
+        case HeadroomColumn:
+            // Unlimited sorts as the most headroom, unknown as the least.
+            if (info.limit < 0) return std::numeric_limits<qlonglong>::max();
+            return static_cast<qlonglong>(headroom < 0 ? std::numeric_limits<qlonglong>::min() : headroom);
+        case SwapColumn: return static_cast<qlonglong>(info.swap);
+        case AnonColumn: return static_cast<qlonglong>(info.anon);
+        case FileColumn: return static_cast<qlonglong>(info.file);
+        case KernelColumn: return static_cast<qlonglong>(info.kernel);
+        case LimitHitsColumn: return static_cast<qulonglong>(info.maxEvents);
+        case OomKillsColumn: return static_cast<qulonglong>(info.oomKills);
+        case PressureColumn: return info.pressureSome;
+        case ProcessesColumn: return node.processes;
+        }
+    } else if (role == Qt::ForegroundRole) {
+        bool low = index.column() == HeadroomColumn && headroom >= 0 && headroom < kLowHeadroom * info.limit;
+        if (low || (index.column() == OomKillsColumn && info.oomKills > 0)) return QBrush(QColor(200, 0, 0));
+    } else if (role == Qt::ToolTipRole) {
+        if (index.column() == NameColumn) return info.path;
+        if (index.column() == LimitColumn) {
+            return QString("memory.max: %1\nmemory.high: %2\nThe limit shown is the lowest memory.max up to the root.")
+                .arg(formatLimit(info.max), formatLimit(info.high));
+        }
+        if (index.column() == OomKillsColumn) {
+            return QString("%1 OOM events, %2 processes killed").arg(info.oomEvents).arg(info.oomKills);
+        }
+    }
+    return QVariant();
+}
+
+QVariant CgroupModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::ToolTipRole) {
+        switch (section) {
+        case MemoryColumn: return QString("memory.current: everything charged to the cgroup, page cache included");
+        case LimitColumn: return QString("The lowest memory.max of the cgroup and its ancestors");
+        case HeadroomColumn: return QString("How much more the cgroup can be charged before it hits the limit");
+        case KernelColumn: return QString("Kernel memory: stacks, slab, page tables and the like");
+        case LimitHitsColumn: return QString("Times usage reached memory.max (the \"max\" count in memory.events)");
+        case OomKillsColumn: return QString("Processes killed by the OOM killer in the cgroup");
+        case PressureColumn: return QString("Share of time some tasks stalled on memory over the last 10 seconds");
+        case ProcessesColumn: return QString("Processes in the cgroup and below it");
+        }
+    }
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractItemModel::headerData(section, orientation, role);
+    }
+    switch (section) {
+    case NameColumn: return QString("Cgroup");
+    case MemoryColumn: return QString("Memory");
+    case LimitColumn: return QString("Limit");
+    case HeadroomColumn: return QString("Headroom");
+    case SwapColumn: return QString("Swap");
+    case AnonColumn: return QString("Anonymous");
+    case FileColumn: return QString("File");
+    case KernelColumn: return QString("Kernel");
+    case LimitHitsColumn: return QString("Limit Hits");
+    case OomKillsColumn: return QString("OOM Kills");
+    case PressureColumn: return QString("Pressure");
+    case ProcessesColumn: return QString("Processes");
+    }
+    return QVariant();
+}
+
+void CgroupModel::setCgroups(const QVector<CgroupInfo> &cgroups, const QVector<ProcessInfo> &processes)
+{
+    ++m_pass;
+    m_nodes[0].seen = m_pass;
+
+    // Processes per cgroup, then summed upwards; parents come first, so
+    // going backwards every child is done before its parent.
+    QHash<QString, int> direct;
+    for (const ProcessInfo &process : processes) {
+        if (!process.cgroup.isEmpty()) ++direct[process.cgroup];
+    }
+    QVector<int> counts(cgroups.size(), 0);
+    for (int i = cgroups.size() - 1; i >= 0; --i) {
+        counts[i] += direct.value(cgroups.at(i).path);
+        if (cgroups.at(i).parent >= 0) counts[cgroups.at(i).parent] += counts[i];
+    }
+
+    QVector<int> nodeOf(cgroups.size(), 0);
+    QVector<int> changed;
+    for (int i = 0; i < cgroups.size(); ++i) {
+        const CgroupInfo &info = cgroups.at(i);
+        int parent = info.parent >= 0 && info.parent < i ? nodeOf[info.parent] : 0;
+        auto it = m_nodeOfPath.constFind(info.path);
+        int node;
+        if (it == m_nodeOfPath.constEnd()) {
+            int row = m_nodes.at(parent).children.size();
+            beginInsertRows(indexOf(parent), row, row);
+            node = addNode(parent, info);
+            m_nodes[node].processes = counts[i];
+            endInsertRows();
+        } else {
+            node = it.value();
+            Node &existing = m_nodes[node];
+            if (!sameValues(existing.info, info) || existing.processes != counts[i]) changed.append(node);
+            existing.info = info;
+            existing.processes = counts[i];
+        }
+        m_nodes[node].seen = m_pass;
+        nodeOf[i] = node;
+    }
+
+    // Cgroups that are gone, removed with their subtree from the top down
+    QVector<int> gone;
+    for (auto it = m_nodeOfPath.constBegin(); it != m_nodeOfPath.constEnd(); ++it) {
+        const Node &node = m_nodes.at(it.value());
+        if (node.seen != m_pass && m_nodes.at(node.parent).seen == m_pass) gone.append(it.value());
+    }
+    for (int node : gone) removeSubtree(node);
+
+    const QVector<int> roles = {Qt::DisplayRole, SortRole, Qt::ForegroundRole};
+    for (int node : changed) emit dataChanged(indexOf(node, MemoryColumn), indexOf(node, ColumnCount - 1), roles);
+}
+
+void CgroupModel::clear()
+{
+    beginResetModel();
+    m_nodes.clear();
+    m_nodes.append(Node());
+    m_free.clear();
+    m_nodeOfPath.clear();
+    endResetModel();
+}
+
+QModelIndex CgroupModel::indexOf(int node, int column) const
+{
+    if (node <= 0) return QModelIndex();
+    return createIndex(m_nodes.at(node).row, column, static_cast<quintptr>(node));
+}
+
+int CgroupModel::addNode(int parent, const CgroupInfo &info)
+{
+    int node;
+    if (!m_free.isEmpty()) {
+        node = m_free.takeLast();
+        m_nodes[node] = Node();
+    } else {
+        node = m_nodes.size();
+        m_nodes.append(Node());
+    }
+    Node &slot = m_nodes[node];
+    slot.info = info;
+    slot.parent = parent;
+    slot.row = m_nodes.at(parent).children.size();
+    m_nodes[parent].children.append(node);
+    m_nodeOfPath.insert(info.path, node);
+    return node;
+}
+
+void CgroupModel::removeSubtree(int node)
+{
+    int parent = m_nodes.at(node).parent;
+    int row = m_nodes.at(node).row;
+    beginRemoveRows(indexOf(parent), row, row);
+    QVector<int> &siblings = m_nodes[parent].children;
+    siblings.remove(row);
+    for (int i = row; i < siblings.size(); ++i) m_nodes[siblings.at(i)].row = i;
+    freeSubtree(node);
+    endRemoveRows();
+}
+
+void CgroupModel::freeSubtree(int node)
+{
+    for (int child : m_nodes.at(node).children) freeSubtree(child);
+    m_nodeOfPath.remove(m_nodes.at(node).info.path);
+    m_nodes[node] = Node();
+    m_free.append(node);
+}
+
+bool CgroupModel::sameValues(const CgroupInfo &a, const CgroupInfo &b)
+{
+    return a.current == b.current && a.max == b.max && a.high == b.high && a.limit == b.limit && a.swap == b.swap
+        && a.anon == b.anon && a.file == b.file && a.kernel == b.kernel && a.maxEvents == b.maxEvents
+        && a.oomEvents == b.oomEvents && a.oomKills == b.oomKills && a.pressureSome == b.pressureSome;
+}
@@ -0,0 +1,63 @@
+#ifndef CGROUPMODEL_H
+#define CGROUPMODEL_H
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QVector>
+#include "datatypes.h"
+
+// The cgroup hierarchy with each cgroup's memory accounting, headroom to
+// its effective limit and OOM counts. Each update is matched to the rows
+// by path: new cgroups are inserted, vanished ones removed with their
+// subtree, and dataChanged is emitted only for cgroups whose values moved,
+// so an expanded view keeps its state across thousands of cgroups.
+class CgroupModel : public QAbstractItemModel
+{
+    Q_OBJECT
+public:
+    enum Column {
+        NameColumn, MemoryColumn, LimitColumn, HeadroomColumn, SwapColumn, AnonColumn, FileColumn, KernelColumn,
+        LimitHitsColumn, OomKillsColumn, PressureColumn, ProcessesColumn, ColumnCount
+    };
+    // Raw value of a cell, for sorting by number instead of by text
+    static const int SortRole = Qt::UserRole + 1;
+
+    explicit CgroupModel(QObject *parent = nullptr);
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    // cgroups as in ScanDelta::cgroups; processes are counted by their
+    // ProcessInfo::cgroup, each towards its cgroup and all above it.
+    void setCgroups(const QVector<CgroupInfo> &cgroups, const QVector<ProcessInfo> &processes);
+    void clear();
+    int cgroupCount() const { return m_nodeOfPath.size(); }
+
+private:
+    // Slot 0 is an invisible root above the root cgroup.
+    struct Node {
+        CgroupInfo info;
+        int parent = -1;
+        QVector<int> children;
+        int row = 0;
+        int processes = 0; // in the subtree
+        quint64 seen = 0;
+    };
+
+    QModelIndex indexOf(int node, int column = 0) const;
+    int addNode(int parent, const CgroupInfo &info);
+    void removeSubtree(int node);
+    void freeSubtree(int node);
+    static bool sameValues(const CgroupInfo &a, const CgroupInfo &b);
+
+    QVector<Node> m_nodes;
+    QVector<int> m_free;
+    QHash<QString, int> m_nodeOfPath;
+    quint64 m_pass = 0;
+};
+
+#endif // CGROUPMODEL_H
@@ -0,0 +1,480 @@
+#include "cgroupmonitor.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_set>
+
+namespace {
+
+// Directory changes and writes to the files read only on change. Deleting
+// the directory itself arrives as IN_IGNORED.
+const uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_ONLYDIR;
+
+const char *const kHotFileNames[] = {"memory.current", "memory.swap.current", "memory.stat", "memory.pressure"};
+
+// Marks a hot file that does not exist in a cgroup (the root has no
+// memory.current, kernels without swap accounting no memory.swap.current)
+const int kMissing = -2;
+
+// Refreshes between two reads of a cgroup's swap, stat and pressure files
+const unsigned kDetailInterval = 4;
+
+long toKb(const char *text)
+{
+    return static_cast<long>(strtoull(text, nullptr, 10) / 1024);
+}
+
+// "max" or a byte count
+long limitToKb(const char *text)
+{
+    return strncmp(text, "max", 3) == 0 ? -1 : toKb(text);
+}
+
+// Value of "key value" lines such as memory.stat and memory.events, or
+// -1 if the key is not there
+long long keyedValue(const char *data, size_t len, const char *key)
+{
+    size_t keyLen = strlen(key);
+    const char *end = data + len;
+    for (const char *line = data; line < end;) {
+        const char *next = static_cast<const char *>(memchr(line, '\n', end - line));
+        if (!next) next = end;
+        if (static_cast<size_t>(next - line) > keyLen && memcmp(line, key, keyLen) == 0 && line[keyLen] == ' ') {
+            return strtoll(line + keyLen + 1, nullptr, 10);
+        }
+        line = next + 1;
+    }
+    return -1;
+}
+
+} // namespace
+
+CgroupMonitor::CgroupMonitor(const char *cgroupRoot, const char *procRoot) : m_root(cgroupRoot)
+{
+    m_procFd = ::open(procRoot, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+CgroupMonitor::~CgroupMonitor()
+{
+    reset();
+    if (m_procFd >= 0) ::close(m_procFd);
+}
+
+bool CgroupMonitor::refresh()
+{
+    if (!m_started && !start()) return false;
+    ++m_refreshes;
+
+    if (m_polling) m_fullWalk = true;
+    else drainNotifications();
+    if (m_fullWalk) {
+        m_stale.clear();
+        walk(0);
+        m_fullWalk = false;
+    } else {
+        std::sort(m_stale.begin(), m_stale.end());
+        m_stale.erase(std::unique(m_stale.begin(), m_stale.end()), m_stale.end());
+        std::vector<int> stale;
+        stale.swap(m_stale);
+        for (int node : stale) {
+            if (m_nodes[node].alive) walk(node);
+        }
+    }
+
+    for (size_t node = 0; node < m_nodes.size(); ++node) {
+        if (m_nodes[node].alive) readValues(static_cast<int>(node));
+    }
+    size_t count = 0;
+    for (const Node &node : m_nodes) count += node.alive;
+    m_cgroups.resize(count);
+    m_stats.cgroups = count;
+    size_t next = 0;
+    std::vector<std::pair<int, int>> stack{{0, -1}};
+    while (!stack.empty()) {
+        int node = stack.back().first;
+        int parentIndex = stack.back().second;
+        stack.pop_back();
+        CgroupStats &out = m_cgroups[next];
+        out = m_nodes[node].stats;
+        out.path = "/" + m_nodes[node].path;
+        out.parent = parentIndex;
+        out.limitKb = out.maxKb;
+        if (parentIndex >= 0) {
+            long parentLimit = m_cgroups[parentIndex].limitKb;
+            if (parentLimit >= 0 && (out.limitKb < 0 || parentLimit < out.limitKb)) out.limitKb = parentLimit;
+        }
+        const std::vector<int> &children = m_nodes[node].children;
+        for (auto it = children.rbegin(); it != children.rend(); ++it) {
+            stack.emplace_back(*it, static_cast<int>(next));
+        }
+        ++next;
+    }
+    return true;
+}
+
+void CgroupMonitor::reset()
+{
+    for (Node &node : m_nodes) closeFds(node);
+    m_nodes.clear();
+    m_freeNodes.clear();
+    m_nodeOfPath.clear();
+    m_nodeOfWatch.clear();
+    m_stale.clear();
+    m_cgroups.clear();
+    if (m_inotifyFd >= 0) ::close(m_inotifyFd);
+    if (m_rootFd >= 0) ::close(m_rootFd);
+    m_inotifyFd = -1;
+    m_rootFd = -1;
+    m_started = false;
+    m_polling = false;
+    m_fullWalk = true;
+    m_stats.available = false;
+    m_stats.inotify = false;
+}
+
+bool CgroupMonitor::membership(pid_t pid, std::string &path)
+{
+    if (m_procFd < 0) return false;
+    char name[32];
+    snprintf(name, sizeof(name), "%d/cgroup", static_cast<int>(pid));
+    m_stats.syscalls += 3;
+    int fd = ::openat(m_procFd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    ssize_t n = ::read(fd, m_buf, sizeof(m_buf));
+    ::close(fd);
+    return n > 0 && parseMembership(m_buf, static_cast<size_t>(n), path);
+}
+
+CgroupMonitor::Stats CgroupMonitor::stats() const
+{
+    Stats stats = m_stats;
+    stats.openFds = m_openFds;
+    return stats;
+}
+
+// The v2 entry is the one with hierarchy ID 0: "0::/user.slice/...".
+bool CgroupMonitor::parseMembership(const char *data, size_t len, std::string &path)
+{
+    const char *end = data + len;
+    for (const char *line = data; line < end;) {
+        const char *next = static_cast<const char *>(memchr(line, '\n', end - line));
+        if (!next) next = end;
+        if (next - line >= 3 && memcmp(line, "0::", 3) == 0) {
+            path.assign(line + 3, next);
+            return !path.empty();
+        }
+        line = next + 1;
+    }
+    return false;
+}
+
+// Kernels before 5.18 have no "kernel" line; kernel_stack plus slab is
+// most of it there.
+void CgroupMonitor::parseStat(const char *data, size_t len, CgroupStats &out)
+{
+    long long anon = keyedValue(data, len, "anon");
+    long long file = keyedValue(data, len, "file");
+    long long shmem = keyedValue(data, len, "shmem");
+    long long kernel = keyedValue(data, len, "kernel");
+    if (kernel < 0) {
+        long long stack = keyedValue(data, len, "kernel_stack");
+        long long slab = keyedValue(data, len, "slab");
+        if (stack >= 0 || slab >= 0) kernel = std::max(0LL, stack) + std::max(0LL, slab);
+    }
+    out.anonKb = anon < 0 ? -1 : static_cast<long>(anon / 1024);
+    out.fileKb = file < 0 ? -1 : static_cast<long>(file / 1024);
+    out.shmemKb = shmem < 0 ? -1 : static_cast<long>(shmem / 1024);
+    out.kernelKb = kernel < 0 ? -1 : static_cast<long>(kernel / 1024);
+}
+
+void CgroupMonitor::parseEvents(const char *data, size_t len, CgroupStats &out)
+{
+    out.highEvents = static_cast<unsigned long long>(std::max(0LL, keyedValue(data, len, "high")));
+    out.maxEvents = static_cast<unsigned long long>(std::max(0LL, keyedValue(data, len, "max")));
+    out.oomEvents = static_cast<unsigned long long>(std::max(0LL, keyedValue(data, len, "oom")));
+    out.oomKills = static_cast<unsigned long long>(std::max(0LL, keyedValue(data, len, "oom_kill")));
+}
+
+// "some avg10=1.23 avg60=... total=...\nfull avg10=0.50 ..."
+void CgroupMonitor::parsePressure(const char *data, size_t len, CgroupStats &out)
+{
+    out.pressureSome = -1;
+    out.pressureFull = -1;
+    const char *end = data + len;
+    for (const char *line = data; line < end;) {
+        const char *next = static_cast<const char *>(memchr(line, '\n', end - line));
+        if (!next) next = end;
+        double *target = nullptr;
+        if (next - line > 11 && memcmp(line, "some avg10=", 11) == 0) target = &out.pressureSome;
+        else if (next - line > 11 && memcmp(line, "full avg10=", 11) == 0) target = &out.pressureFull;
+        if (target) *target = strtod(line + 11, nullptr) / 100;
+        line = next + 1;
+    }
+}
+
+bool CgroupMonitor::start()
+{
+    // Hybrid hierarchies mount cgroup v2 below the v1 controllers.
+    std::string unified = m_root + "/unified";
+    if (::access((m_root + "/cgroup.controllers").c_str(), F_OK) != 0
+        && ::access((unified + "/cgroup.controllers").c_str(), F_OK) == 0) {
+        m_root = unified;
+    }
+    m_rootFd = ::open(m_root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (m_rootFd < 0) {
+        m_stats.error = m_root + ": " + strerror(errno);
+        return false;
+    }
+    // cgroup.controllers only exists in a v2 hierarchy.
+    Node probe;
+    ssize_t n = readOnce(probe, "cgroup.controllers");
+    if (n < 0 || !strstr(std::string(m_buf, static_cast<size_t>(n)).c_str(), "memory")) {
+        m_stats.error = "no cgroup v2 hierarchy with the memory controller at " + m_root;
+        ::close(m_rootFd);
+        m_rootFd = -1;
+        return false;
+    }
+
+    m_inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    m_polling = m_inotifyFd < 0;
+    m_stats.error = m_polling ? std::string("no inotify, polling: ") + strerror(errno) : std::string();
+    m_started = true;
+    m_fullWalk = true;
+    m_stats.available = true;
+    addNode(-1, std::string());
+    m_stats.inotify = !m_polling;
+    return true;
+}
+
+int CgroupMonitor::addNode(int parent, const std::string &path)
+{
+    int node;
+    if (!m_freeNodes.empty()) {
+        node = m_freeNodes.back();
+        m_freeNodes.pop_back();
+    } else {
+        node = static_cast<int>(m_nodes.size());
+        m_nodes.emplace_back();
+    }
+    Node &slot = m_nodes[node];
+    slot = Node();
+    slot.path = path;
+    slot.parent = parent;
+    slot.alive = true;
+    if (parent >= 0) m_nodes[parent].children.push_back(node);
+    m_nodeOfPath[path] = node;
+
+    // Watched before it is listed, so a child created in between is not missed.
+    if (!m_polling) {
+        std::string full = m_root + "/" + path;
+        ++m_stats.syscalls;
+        slot.watch = ::inotify_add_watch(m_inotifyFd, full.c_str(), kWatchMask);
+        if (slot.watch >= 0) {
+            m_nodeOfWatch[slot.watch] = node;
+        } else if (errno == ENOSPC) {
+            m_polling = true;
+            m_stats.inotify = false;
+            m_stats.error = "inotify watch limit reached, polling";
+        }
+    }
+    return node;
+}
+
+void CgroupMonitor::removeNode(int node)
+{
+    while (!m_nodes[node].children.empty()) removeNode(m_nodes[node].children.back());
+    Node &slot = m_nodes[node];
+    if (slot.watch >= 0) {
+        // Usually gone with the directory already
+        ::inotify_rm_watch(m_inotifyFd, slot.watch);
+        m_nodeOfWatch.erase(slot.watch);
+    }
+    closeFds(slot);
+    m_nodeOfPath.erase(slot.path);
+    if (slot.parent >= 0) {
+        std::vector<int> &siblings = m_nodes[slot.parent].children;
+        siblings.erase(std::find(siblings.begin(), siblings.end(), node));
+    }
+    slot = Node();
+    m_freeNodes.push_back(node);
+}
+
+void CgroupMonitor::walk(int node)
+{
+    ++m_stats.walks;
+    const std::string path = m_nodes[node].path;
+    m_stats.syscalls += 3;
+    int fd = ::openat(m_rootFd, path.empty() ? "." : path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR *dir = fd >= 0 ? ::fdopendir(fd) : nullptr;
+    if (!dir) {
+        if (fd >= 0) ::close(fd);
+        // Removed meanwhile; the parent's notification follows.
+        if (node != 0) removeNode(node);
+        return;
+    }
+    std::unordered_set<std::string> names;
+    while (dirent *entry = ::readdir(dir)) {
+        if (entry->d_name[0] == '.') continue;
+        bool isDir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+            isDir = ::fstatat(::dirfd(dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+        }
+        if (isDir) names.emplace(entry->d_name);
+    }
+    ::closedir(dir);
+
+    // Children that are gone
+    std::vector<int> children = m_nodes[node].children;
+    for (int child : children) {
+        const std::string &childPath = m_nodes[child].path;
+        std::string name = childPath.substr(childPath.rfind('/') + 1);
+        if (!names.count(name)) removeNode(child);
+    }
+    // New children, listed in full; known ones only on a full walk
+    for (const std::string &name : names) {
+        std::string childPath = path.empty() ? name : path + "/" + name;
+        auto known = m_nodeOfPath.find(childPath);
+        if (known != m_nodeOfPath.end()) {
+            if (m_fullWalk || m_polling) walk(known->second);
+            continue;
+        }
+        walk(addNode(node, childPath));
+    }
+}
+
+void CgroupMonitor::drainNotifications()
+{
+    alignas(inotify_event) char buffer[16384];
+    for (;;) {
+        ++m_stats.syscalls;
+        ssize_t n = ::read(m_inotifyFd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        for (char *p = buffer; p < buffer + n;) {
+            const inotify_event *event = reinterpret_cast<const inotify_event *>(p);
+            p += sizeof(inotify_event) + event->len;
+            ++m_stats.notifications;
+            if (event->mask & IN_Q_OVERFLOW) {
+                ++m_stats.overflows;
+                m_fullWalk = true;
+                continue;
+            }
+            auto it = m_nodeOfWatch.find(event->wd);
+            if (it == m_nodeOfWatch.end()) continue;
+            int node = it->second;
+            if (event->mask & IN_IGNORED) {
+                // The directory went away; its parent lists it no more.
+                m_nodeOfWatch.erase(it);
+                m_nodes[node].watch = -1;
+                if (m_nodes[node].parent >= 0) m_stale.push_back(m_nodes[node].parent);
+                continue;
+            }
+            if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO))) {
+                m_stale.push_back(node);
+            } else if ((event->mask & IN_MODIFY) && event->len > 0) {
+                if (strcmp(event->name, "memory.events") == 0) m_nodes[node].eventsStale = true;
+                else if (strcmp(event->name, "memory.max") == 0 || strcmp(event->name, "memory.high") == 0) {
+                    m_nodes[node].limitsStale = true;
+                }
+            }
+        }
+    }
+}
+
+void CgroupMonitor::readValues(int index)
+{
+    Node &node = m_nodes[index];
+    CgroupStats &stats = node.stats;
+    ssize_t n = readHot(node, Current);
+    stats.currentKb = n > 0 ? toKb(m_buf) : -1;
+    if (node.fresh || m_polling || (m_refreshes + static_cast<unsigned>(index)) % kDetailInterval == 0) {
+        node.fresh = false;
+        n = readHot(node, Swap);
+        stats.swapKb = n > 0 ? toKb(m_buf) : -1;
+        n = readHot(node, Stat);
+        if (n > 0) parseStat(m_buf, static_cast<size_t>(n), stats);
+        n = readHot(node, Pressure);
+        if (n > 0) parsePressure(m_buf, static_cast<size_t>(n), stats);
+    }
+
+    if (node.limitsStale || m_polling) {
+        node.limitsStale = false;
+        n = readOnce(node, "memory.max");
+        stats.maxKb = n > 0 ? limitToKb(m_buf) : -1;
+        n = readOnce(node, "memory.high");
+        stats.highKb = n > 0 ? limitToKb(m_buf) : -1;
+    }
+    if (node.eventsStale || m_polling) {
+        node.eventsStale = false;
+        n = readOnce(node, "memory.events");
+        if (n > 0) parseEvents(m_buf, static_cast<size_t>(n), stats);
+    }
+}
+
+void CgroupMonitor::closeFds(Node &node)
+{
+    for (int &fd : node.fds) {
+        if (fd >= 0) {
+            ::close(fd);
+            --m_openFds;
+        }
+        fd = -1;
+    }
+}
+
+// Reads a per-refresh file into m_buf (NUL-terminated), keeping its
+// descriptor open while under the cap. Returns the length or -1.
+ssize_t CgroupMonitor::readHot(Node &node, HotFile file)
+{
+    int &fd = node.fds[file];
+    if (fd == kMissing) return -1;
+    if (fd < 0) {
+        // memory.current is read four times as often as the others, so
+        // it may use the whole cap and they half of it.
+        if (m_openFds >= (file == Current ? m_fdLimit : m_fdLimit / 2)) return readOnce(node, kHotFileNames[file]);
+        ++m_stats.syscalls;
+        fd = ::openat(m_rootFd, filePath(node, kHotFileNames[file]).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0 && (errno == EMFILE || errno == ENFILE)) {
+            // Out of descriptors: keep what is open, read the rest once.
+            m_fdLimit = m_openFds;
+            fd = -1;
+            return readOnce(node, kHotFileNames[file]);
+        }
+        if (fd < 0) {
+            fd = errno == ENOENT ? kMissing : -1;
+            return -1;
+        }
+        ++m_openFds;
+    }
+    ++m_stats.syscalls;
+    ssize_t n = ::pread(fd, m_buf, sizeof(m_buf) - 1, 0);
+    if (n < 0) return -1;
+    m_buf[n] = '\0';
+    return n;
+}
+
+ssize_t CgroupMonitor::readOnce(const Node &node, const char *name)
+{
+    m_stats.syscalls += 3;
+    int fd = ::openat(m_rootFd, filePath(node, name).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t n = ::read(fd, m_buf, sizeof(m_buf) - 1);
+    ::close(fd);
+    if (n < 0) return -1;
+    m_buf[n] = '\0';
+    return n;
+}
+
+std::string CgroupMonitor::filePath(const Node &node, const char *name) const
+{
+    return node.path.empty() ? std::string(name) : node.path + "/" + name;
+}
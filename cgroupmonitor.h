@@ -0,0 +1,142 @@
+#ifndef CGROUPMONITOR_H
+#define CGROUPMONITOR_H
+
+#include <sys/types.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Memory accounting of one cgroup, in KB. -1 where the kernel does not say:
+// the root has no memory.current or limits, and a limit of "max" is -1.
+struct CgroupStats {
+    std::string path;         // as in /proc/<pid>/cgroup, "/" for the root
+    int parent = -1;          // index in CgroupMonitor::cgroups(), -1 for the root
+    long currentKb = -1;      // memory.current
+    long maxKb = -1;          // memory.max
+    long highKb = -1;         // memory.high
+    long limitKb = -1;        // the lowest memory.max of this cgroup and its ancestors
+    long swapKb = -1;         // memory.swap.current
+    long anonKb = -1;         // from memory.stat
+    long fileKb = -1;
+    long kernelKb = -1;
+    long shmemKb = -1;
+    unsigned long long highEvents = 0; // from memory.events
+    unsigned long long maxEvents = 0;
+    unsigned long long oomEvents = 0;
+    unsigned long long oomKills = 0;
+    double pressureSome = -1; // memory.pressure "avg10" as a fraction
+    double pressureFull = -1;
+};
+
+// Follows the cgroup v2 hierarchy under the unified mount (the given root,
+// or its unified/ directory on hybrid hosts) and the memory files of every
+// cgroup in it.
+//
+// The directory tree is walked once. After that an inotify watch on every
+// cgroup directory reports new and removed child cgroups, so only the
+// subtrees that changed are listed again, and writes to memory.max and
+// memory.high and the kernel's notifications on memory.events, so those
+// are only read when they changed. memory.current changes all the time and
+// is read on every refresh; memory.swap.current, memory.stat and
+// memory.pressure (the longer files) every fourth, a quarter of the
+// cgroups at a time. Both go through descriptors kept open up to a cap.
+// Without inotify (or once the watch limit is reached) the tree is walked
+// and every file read on each refresh instead.
+//
+// Not thread-safe; refresh() and the accessors belong to one thread.
+class CgroupMonitor
+{
+public:
+    struct Stats {
+        bool available = false;      // a cgroup v2 hierarchy with the memory controller
+        bool inotify = false;        // changes are followed, not polled
+        size_t cgroups = 0;
+        unsigned long long walks = 0;        // directories listed, including the first walk
+        unsigned long long notifications = 0;
+        unsigned long long overflows = 0;    // inotify queue overflows, each followed by a full walk
+        unsigned long long syscalls = 0;
+        int openFds = 0;
+        std::string error;
+    };
+
+    explicit CgroupMonitor(const char *cgroupRoot = "/sys/fs/cgroup", const char *procRoot = "/proc");
+    ~CgroupMonitor();
+    CgroupMonitor(const CgroupMonitor &) = delete;
+    CgroupMonitor &operator=(const CgroupMonitor &) = delete;
+
+    // Caps the descriptors kept open for the per-refresh files; beyond it
+    // files are opened and closed each time.
+    void setFdLimit(int maxFds) { m_fdLimit = maxFds; }
+
+    // Applies pending changes to the hierarchy and reads the values.
+    // Returns false if there is no cgroup v2 memory hierarchy.
+    bool refresh();
+    // Every cgroup, parents before their children
+    const std::vector<CgroupStats> &cgroups() const { return m_cgroups; }
+    // Drops all descriptors and watches; the next refresh() starts over.
+    void reset();
+
+    // The cgroup v2 path of a process from /proc/<pid>/cgroup, e.g.
+    // "/system.slice/sshd.service". Returns false if the process is gone
+    // or not in a v2 hierarchy.
+    bool membership(pid_t pid, std::string &path);
+
+    Stats stats() const;
+
+    // Parsers for the files above; values in bytes become KB
+    static bool parseMembership(const char *data, size_t len, std::string &path);
+    static void parseStat(const char *data, size_t len, CgroupStats &out);
+    static void parseEvents(const char *data, size_t len, CgroupStats &out);
+    static void parsePressure(const char *data, size_t len, CgroupStats &out);
+
+private:
+    // Files read on every refresh, through cached descriptors
+    enum HotFile { Current, Swap, Stat, Pressure, HotFileCount };
+
+    struct Node {
+        std::string path;        // relative to the root: "" or "a/b"
+        int parent = -1;
+        std::vector<int> children;
+        int watch = -1;
+        int fds[HotFileCount] = {-1, -1, -1, -1};
+        bool limitsStale = true; // memory.max / memory.high changed
+        bool eventsStale = true; // memory.events changed
+        bool fresh = true;       // not read yet
+        bool alive = false;
+        CgroupStats stats;
+    };
+
+    bool start();
+    int addNode(int parent, const std::string &path);
+    void removeNode(int node);
+    // Lists node's directory, drops the children that are gone and walks
+    // the new ones; the known ones too on a full walk.
+    void walk(int node);
+    void drainNotifications();
+    void readValues(int node);
+    void closeFds(Node &node);
+    ssize_t readHot(Node &node, HotFile file);
+    ssize_t readOnce(const Node &node, const char *name);
+    std::string filePath(const Node &node, const char *name) const;
+
+    std::string m_root;
+    int m_rootFd = -1;
+    int m_procFd = -1;
+    int m_inotifyFd = -1;
+    bool m_started = false;
+    bool m_polling = false;      // no inotify, or a watch could not be added
+    bool m_fullWalk = true;
+    int m_fdLimit = 4096;
+    int m_openFds = 0;
+    unsigned long long m_refreshes = 0;
+    std::vector<Node> m_nodes;   // slot 0 is the root
+    std::vector<int> m_freeNodes;
+    std::unordered_map<std::string, int> m_nodeOfPath;
+    std::unordered_map<int, int> m_nodeOfWatch;
+    std::vector<int> m_stale;    // directories to list again
+    std::vector<CgroupStats> m_cgroups;
+    Stats m_stats;
+    char m_buf[8192];
+};
+
+#endif // CGROUPMONITOR_H
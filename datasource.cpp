@@ -0,0 +1,100 @@
+#include "datasource.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+LiveProcSource::LiveProcSource(const char *procRoot)
+    : m_procRoot(procRoot), m_scanner(procRoot), m_events(procRoot), m_memInfo(procRoot)
+{
+}
+
+bool LiveProcSource::fill(SourceBatch &batch)
+{
+    batch.timeMs = 0;
+    m_memInfo.read(batch.memInfo);
+    m_scanner.scan(batch.samples);
+    return true;
+}
+
+bool LiveProcSource::setProcessEvents(bool enabled, std::string *error)
+{
+    if (!enabled) {
+        m_scanner.setEventSource(nullptr);
+        m_events.stop();
+        return true;
+    }
+    if (m_events.isRunning()) return true;
+    if (!m_events.start(error)) {
+        m_scanner.setEventSource(nullptr);
+        return false;
+    }
+    m_scanner.setEventSource(&m_events);
+    return true;
+}
+
+SyntheticSource::SyntheticSource(const Options &options) : m_options(options), m_random(options.seed)
+{
+    m_options.processes = std::max(0, m_options.processes);
+    m_options.nameLength = std::min(std::max(1, m_options.nameLength), 15);
+    m_processes.reserve(static_cast<size_t>(m_options.processes));
+    for (int i = 0; i < m_options.processes; ++i) m_processes.push_back(makeProcess());
+    if (m_options.memTotalKb <= 0) {
+        long usedKb = 0;
+        for (const ProcSample &sample : m_processes) usedKb += sample.rssKb;
+        m_options.memTotalKb = std::max(2 * usedKb, 1L << 20);
+    }
+}
+
+ProcSample SyntheticSource::makeProcess()
+{
+    ProcSample sample;
+    sample.pid = m_nextPid++;
+    // A few services started by init, each with a tree of workers below
+    // it, spread over a handful of users
+    if (m_processes.size() < 20 || m_random() % 50 == 0) {
+        sample.ppid = 1;
+    } else {
+        sample.ppid = m_processes[m_random() % m_processes.size()].pid;
+    }
+    sample.uid = static_cast<uid_t>(m_random() % 4 == 0 ? 0 : 1000 + m_random() % 4);
+    // Mostly small processes with a few large ones, like a real machine
+    std::uniform_int_distribution<int> size(0, 99);
+    sample.rssKb = size(m_random) < 98 ? 512 + static_cast<long>(m_random() % (16 << 10))
+                                       : (64L << 10) + static_cast<long>(m_random() % (1L << 20));
+    sample.startTime = m_tick + 1;
+    char name[32];
+    int len = snprintf(name, sizeof(name), "synth-%d", sample.pid);
+    while (len < m_options.nameLength) name[len++] = 'x';
+    len = std::min(len, m_options.nameLength);
+    memcpy(sample.name, name, static_cast<size_t>(len));
+    sample.nameLen = static_cast<unsigned char>(len);
+    return sample;
+}
+
+bool SyntheticSource::fill(SourceBatch &batch)
+{
+    // The first tick shows the initial processes as they are.
+    if (m_tick > 0 && !m_processes.empty()) {
+        std::uniform_int_distribution<size_t> pick(0, m_processes.size() - 1);
+        size_t replaced = static_cast<size_t>(m_options.churn * m_processes.size());
+        for (size_t i = 0; i < replaced; ++i) m_processes[pick(m_random)] = makeProcess();
+        size_t changed = static_cast<size_t>(m_options.changes * m_processes.size());
+        std::uniform_int_distribution<long> step(-512, 1024);
+        for (size_t i = 0; i < changed; ++i) {
+            ProcSample &sample = m_processes[pick(m_random)];
+            sample.rssKb = std::max(4L, sample.rssKb + step(m_random));
+        }
+    }
+
+    long usedKb = 0;
+    for (const ProcSample &sample : m_processes) usedKb += sample.rssKb;
+    batch.timeMs = m_options.startMs + static_cast<int64_t>(m_tick) * m_options.stepMs;
+    batch.memInfo.clear();
+    batch.memInfo.values[MemInfo::MemTotal] = m_options.memTotalKb;
+    batch.memInfo.values[MemInfo::MemAvailable] = std::max(0L, m_options.memTotalKb - usedKb);
+    batch.memInfo.values[MemInfo::MemFree] = batch.memInfo.values[MemInfo::MemAvailable];
+    batch.samples.assign(m_processes.begin(), m_processes.end());
+    ++m_tick;
+    return true;
+}
@@ -0,0 +1,94 @@
+#ifndef DATASOURCE_H
+#define DATASOURCE_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "meminfo.h"
+#include "procevents.h"
+#include "procscanner.h"
+
+// One tick of input for ProcessWorker: what a scan of a machine yields.
+// The caller keeps the batch between ticks, so once the vector has grown
+// to the process count a tick does not touch the heap.
+struct SourceBatch {
+    int64_t timeMs = 0; // 0: taken now, on the caller's clock
+    MemInfo memInfo;
+    std::vector<ProcSample> samples;
+};
+
+// Where the worker's samples come from. Everything downstream (deltas,
+// rankings, history, leak and threshold alerts, the views) only sees the
+// batches, so it can be driven by a generator as well as by the live
+// machine. Recordings are replayed by SnapshotReplayer instead, straight
+// into the views.
+class DataSource
+{
+public:
+    virtual ~DataSource() = default;
+
+    // Replaces the contents of batch with the next tick. Returns false if
+    // there is none (end of a recording, nothing pushed yet), leaving the
+    // batch unspecified.
+    virtual bool fill(SourceBatch &batch) = 0;
+};
+
+// This machine, through ProcScanner and MemInfoReader. The worker reaches
+// through to the scanner and the event source for their settings and
+// statistics.
+class LiveProcSource : public DataSource
+{
+public:
+    explicit LiveProcSource(const char *procRoot = "/proc");
+
+    bool fill(SourceBatch &batch) override;
+
+    const char *procRoot() const { return m_procRoot.c_str(); }
+    ProcScanner &scanner() { return m_scanner; }
+    const ProcEvents &events() const { return m_events; }
+    // Follow process starts and exits through ProcEvents instead of listing
+    // /proc every scan. Returns false (and keeps listing) if the kernel
+    // does not allow it.
+    bool setProcessEvents(bool enabled, std::string *error = nullptr);
+
+private:
+    std::string m_procRoot;
+    ProcScanner m_scanner;
+    ProcEvents m_events;
+    MemInfoReader m_memInfo;
+};
+
+// A made-up machine, the same for the same options: a fixed number of
+// processes in a tree below init, some replaced and some changing size
+// every tick, with time advancing by stepMs per tick. A replaced process's
+// children keep their PPID, as if they had been reparented elsewhere.
+class SyntheticSource : public DataSource
+{
+public:
+    struct Options {
+        int processes = 1000;
+        double churn = 0.01;     // share of processes replaced per tick
+        double changes = 0.2;    // share of processes whose RSS moves per tick
+        int nameLength = 15;
+        long memTotalKb = 0;     // 0: twice the processes' RSS on the first tick
+        int64_t startMs = 1000000000000;
+        int64_t stepMs = 1000;
+        uint64_t seed = 1;
+    };
+
+    explicit SyntheticSource(const Options &options);
+
+    bool fill(SourceBatch &batch) override;
+
+private:
+    ProcSample makeProcess();
+
+    Options m_options;
+    std::mt19937_64 m_random;
+    std::vector<ProcSample> m_processes;
+    pid_t m_nextPid = 100;
+    unsigned long long m_tick = 0;
+};
+
+#endif // DATASOURCE_H
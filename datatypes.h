@@ -2,25 +2,127 @@
 #define DATATYPES_H
 
 #include <QList>
+#include <QVector>
 #include <QString>
 #include <QMetaType>
 #include <QStringList>
+#include "meminfo.h"
+#include "growthdetector.h"
+#include "scanprofile.h"
+#include "cgroupmonitor.h"
 
 // Struct for a single process
 struct ProcessInfo {
     pid_t pid;
+    pid_t ppid = 0;
+    int uid = -1;
     long memory; // in Kilobytes
+    long growth = 0; // KB per second since the previous scan
+    // From smaps_rollup, refreshed within a time budget (see SmapsSampler);
+    // -1 until read
+    long pss = -1;
+    long uss = -1;
+    long swap = -1;
     QString name;
+    // The command line up to its first option, e.g. "python3 manage.py";
+    // only filled while ProcessWorker::setCommandLines() is on
+    QString command;
+    // cgroup v2 path, e.g. "/system.slice/sshd.service"; only filled while
+    // ProcessWorker::setCgroupMonitoring() is on
+    QString cgroup;
 };
 
-// Struct to hold all data passed from worker to main thread
-struct AppData {
-    // Dynamic data
-    long memTotal = 0;
-    long memAvailable = 0;
-    QList<ProcessInfo> processes;
+// A cgroup with its memory accounting (see CgroupStats), in KB
+struct CgroupInfo {
+    QString path;
+    int parent = -1;      // index in ScanDelta::cgroups, -1 for the root
+    long current = -1;
+    long max = -1;        // -1: no limit
+    long high = -1;
+    long limit = -1;      // the lowest max on the way to the root
+    long swap = -1;
+    long anon = -1;
+    long file = -1;
+    long kernel = -1;
+    long shmem = -1;
+    quint64 highEvents = 0;
+    quint64 maxEvents = 0;
+    quint64 oomEvents = 0;
+    quint64 oomKills = 0;
+    double pressureSome = -1;
+    double pressureFull = -1;
+
+    static CgroupInfo fromStats(const CgroupStats &stats)
+    {
+        CgroupInfo info;
+        info.path = QString::fromStdString(stats.path);
+        info.parent = stats.parent;
+        info.current = stats.currentKb;
+        info.max = stats.maxKb;
+        info.high = stats.highKb;
+        info.limit = stats.limitKb;
+        info.swap = stats.swapKb;
+        info.anon = stats.anonKb;
+        info.file = stats.fileKb;
+        info.kernel = stats.kernelKb;
+        info.shmem = stats.shmemKb;
+        info.highEvents = stats.highEvents;
+        info.maxEvents = stats.maxEvents;
+        info.oomEvents = stats.oomEvents;
+        info.oomKills = stats.oomKills;
+        info.pressureSome = stats.pressureSome;
+        info.pressureFull = stats.pressureFull;
+        return info;
+    }
+};
 
-    // Static hardware data
+// Counters describing the cost of the last scan
+struct ScanStats {
+    double scanMs = 0;
+    int scanThreads = 1;
+    quint64 fdCacheHits = 0;
+    quint64 fdCacheMisses = 0;
+    quint64 fdCacheReuses = 0;
+    int fdCacheOpen = 0;
+    int fdCacheLimit = 0;
+    bool processEvents = false;     // PIDs followed through the proc connector
+    quint64 procListings = 0;       // full listings of /proc so far
+    quint64 transientProcesses = 0; // seen only through their exec sample
+    int historySeries = 0;
+    quint64 historyBytes = 0;
+    quint64 historyBudget = 0;
+    qint64 displayIntervalMs = 0;   // after adapting to load and CPU budget
+    bool cpuBudgetLimited = false;
+    int pressureMode = 0;           // PressureMonitor::Mode
+    int pressureTriggers = 0;
+    quint64 pressureAlerts = 0;
+    double pressureWorstLatencyMs = 0;
+    double memoryPressure = 0;      // PSI "some avg10" as a fraction
+    double smapsBudgetMs = 0;       // deep (PSS/USS/swap) accounting, 0 when off
+    double smapsUsedMs = 0;
+    int smapsRead = 0;
+    int smapsDeferred = 0;          // due for a refresh but left for a later scan
+    int smapsOverBudget = 0;        // too big to read within the budget
+    int smapsCovered = 0;           // processes with PSS/USS/swap values
+    int smapsDenied = 0;
+    int growthTracked = 0;          // processes followed by the leak detector
+    quint64 growthAlerts = 0;
+    int alertRules = 0;             // compiled, the usage threshold's included
+    quint64 alertChecks = 0;        // rule checks in this scan
+    int alertsFiring = 0;           // rule and subject pairs that fired and have not cleared
+    bool cgroupsAvailable = false;  // cgroup monitoring is on and found a v2 hierarchy
+    bool cgroupInotify = false;
+    quint64 cgroupWalks = 0;        // cgroup directories listed so far
+    int cgroupOpenFds = 0;
+    QString cgroupError;
+    QString metricsAddress;         // where the metrics are served, empty when not
+    quint64 metricsScrapes = 0;
+    QString metricsError;
+    ScanProfile::Tick profile;      // phase timings and counters of this tick
+};
+
+// Hardware details, fetched once when the worker starts
+struct StaticInfo {
     QString cpuModel;
     QString cpuCores;
     QString cpuThreads;
@@ -33,7 +135,56 @@ struct AppData {
     QString memorySlots;
 };
 
+// New memory value for a process the receiver already has
+struct ProcessUpdate {
+    pid_t pid;
+    long memory; // in Kilobytes
+    long growth; // KB per second since the previous scan
+    long pss = -1;
+    long uss = -1;
+    long swap = -1;
+};
+
+// What changed between two scans. Apply removed, then added (which replaces
+// an existing entry with the same PID, e.g. after a rename, a change of
+// parent or a newly read command line), then changed.
+// A delta with baseGeneration 0 is a full snapshot and replaces everything.
+struct ScanDelta {
+    quint64 generation = 0;
+    quint64 baseGeneration = 0;
+    qint64 timeMs = 0;      // wall clock at the start of the scan
+    quint32 consumers = 0;  // 1 << SampleScheduler::Consumer for each consumer served
+    long memTotal = 0;
+    long memAvailable = 0;
+    MemInfo memInfo;        // all fields -1 when replayed from a recording
+    QList<ProcessInfo> added;
+    QList<pid_t> removed;
+    QList<ProcessUpdate> changed;
+    // Largest processes by memory and by growth, biggest first, up to
+    // rankingSize entries (see ProcessWorker::setRankingSize())
+    int rankingSize = 0;
+    QVector<pid_t> topByMemory;
+    QVector<pid_t> topByGrowth;
+    // Steadiest growers according to the leak detector, up to rankingSize
+    QVector<GrowthDetector::Trend> growthTrends;
+    // Every cgroup, parents first, on display scans while cgroup monitoring
+    // is on; empty otherwise
+    QVector<CgroupInfo> cgroups;
+    ScanStats scanStats;
+};
+
+// Latest system-wide values as materialized by the main thread. The process
+// list itself lives in the process table model.
+struct AppData {
+    qint64 timeMs = 0;
+    long memTotal = 0;
+    long memAvailable = 0;
+    MemInfo memInfo;
+    ScanStats scanStats;
+};
+
 // Required for using these custom structs in Qt's signal/slot system
-Q_DECLARE_METATYPE(AppData)
+Q_DECLARE_METATYPE(StaticInfo)
+Q_DECLARE_METATYPE(ScanDelta)
 
 #endif // DATATYPES_H
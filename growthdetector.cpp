@@ -0,0 +1,221 @@
+#include "growthdetector.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// A page a second; keeps the CUSUM of a process that never changed from
+// firing on its first small allocation.
+const double kMinRateDeviation = 4;
+
+// Largest step of the CUSUM per sample, in mean deviations
+const double kCusumClip = 3;
+
+// RSS this far below the recent trend (in residual standard deviations,
+// and at least kMinReleaseKb) means the process gave memory back.
+const double kReleaseDeviations = 4;
+const double kMinReleaseKb = 1024;
+
+// Re-arm an alert once the projection is this many horizons away.
+const double kRearmFactor = 2;
+
+} // namespace
+
+void GrowthDetector::Fit::restart(double t, double x)
+{
+    *this = Fit();
+    startSec = t;
+    samples = 1;
+    weight = 1;
+    meanT = t;
+    meanX = x;
+}
+
+// Weighted Welford update; older samples lose weight by decay per step.
+void GrowthDetector::Fit::add(double t, double x, double decay)
+{
+    weight = decay * weight + 1;
+    double dT = t - meanT;
+    double dX = x - meanX;
+    meanT += dT / weight;
+    meanX += dX / weight;
+    ctt = decay * ctt + dT * (t - meanT);
+    ctx = decay * ctx + dT * (x - meanX);
+    cxx = decay * cxx + dX * (x - meanX);
+    ++samples;
+}
+
+GrowthDetector::GrowthDetector()
+{
+}
+
+void GrowthDetector::beginScan(double timeSec, long memAvailableKb)
+{
+    ++m_scan;
+    m_nowSec = timeSec;
+    m_memAvailableKb = memAvailableKb;
+    m_rank.reset(m_rankingSize);
+    m_alerts.clear();
+    m_untracked = 0;
+}
+
+const GrowthDetector::Fit *GrowthDetector::trendFit(const State &state, bool *recent) const
+{
+    double now = state.lastSec - state.firstSec;
+    auto credible = [&](const Fit &fit) {
+        return fit.samples >= m_options.minFitSamples && now - fit.startSec >= m_options.minFitSpanSec
+            && fit.fit() >= m_options.minFit;
+    };
+    // The recent fit only counts if the process had not given memory back
+    // for a fit window before growth picked up.
+    bool useRecent = state.changePoint && state.recentFit.startSec - state.lastReleaseSec > m_options.fitWindowSec;
+    if (recent) *recent = useRecent;
+    const Fit &fit = useRecent ? state.recentFit : state.longFit;
+    return credible(fit) ? &fit : nullptr;
+}
+
+void GrowthDetector::add(pid_t pid, unsigned long long startTime, long rssKb)
+{
+    auto it = m_states.find(pid);
+    if (it == m_states.end()) {
+        if (m_states.size() >= m_options.maxTracked) {
+            ++m_untracked;
+            return;
+        }
+        it = m_states.emplace(pid, State()).first;
+    }
+    State &state = it->second;
+    double now = m_nowSec;
+    if (state.seen == 0 || state.startTime != startTime) {
+        state = State();
+        state.startTime = startTime;
+        state.firstSec = now;
+        state.lastSec = now;
+        state.lastKb = rssKb;
+        state.longFit.restart(0, rssKb);
+        state.seen = m_scan;
+        return;
+    }
+    state.seen = m_scan;
+    double dt = now - state.lastSec;
+    if (dt <= 0) return;
+    double t = now - state.firstSec;
+
+    // Growth rate, and the CUSUM on its deviation from the baseline: the slow
+    // EWMA, or once growth has picked up, the recent trend (so that a steady
+    // leak does not keep restarting its own fit while the EWMA catches up).
+    double sample = (rssKb - state.lastKb) / dt;
+    bool settling = state.changePoint && state.recentFit.samples < m_options.minFitSamples;
+    if (state.longFit.samples >= 2 && !settling) {
+        double baseline = state.changePoint ? std::max(state.baseline, state.recentFit.slope()) : state.baseline;
+        double z = (sample - baseline) / std::max(state.rateDeviation, kMinRateDeviation);
+        z = std::clamp(z, -kCusumClip, kCusumClip);
+        state.cusumUp = std::max(0.0, state.cusumUp + z - m_options.cusumDrift);
+        if (state.cusumUp > m_options.cusumThreshold) {
+            // Growth picked up here; the recent fit starts from the last sample.
+            state.cusumUp = 0;
+            state.changePoint = true;
+            state.recentFit.restart(state.lastSec - state.firstSec, state.lastKb);
+            ++m_changePoints;
+        }
+    }
+    // A single clipped step cannot show a release, so compare with the
+    // recent trend instead: a GC or cache drop falls far below it.
+    const Fit &recent = state.recentFit;
+    if (state.changePoint && recent.samples >= m_options.minFitSamples) {
+        double expected = recent.meanX + recent.slope() * (t - recent.meanT);
+        double residual = std::sqrt(std::max(0.0, recent.cxx - recent.slope() * recent.ctx) / recent.weight);
+        if (rssKb < expected - std::max(kReleaseDeviations * residual, kMinReleaseKb)) {
+            state.changePoint = false;
+            state.lastReleaseSec = t;
+        }
+    }
+    double alpha = 1 - std::exp(-dt / m_options.rateWindowSec);
+    state.rate += alpha * (sample - state.rate);
+    double decay = std::exp(-dt / m_options.fitWindowSec);
+    state.rateDeviation += (1 - decay) * (std::fabs(sample - state.baseline) - state.rateDeviation);
+    state.baseline += (1 - decay) * (sample - state.baseline);
+
+    state.longFit.add(t, rssKb, decay);
+    if (state.changePoint) state.recentFit.add(t, rssKb, decay);
+    state.lastSec = now;
+    state.lastKb = rssKb;
+
+    const Fit *fit = trendFit(state);
+    double slope = fit ? fit->slope() : 0;
+    if (slope <= 0) {
+        state.alerted = false;
+        return;
+    }
+    m_rank.push(slope * fit->fit(), pid);
+
+    if (m_options.horizonSec <= 0) return;
+    long limit = m_options.limitKb > 0 ? m_options.limitKb : rssKb + std::max(m_memAvailableKb, 0L);
+    double secondsToLimit = rssKb >= limit ? 0 : (limit - rssKb) / slope;
+    if (secondsToLimit <= m_options.horizonSec) {
+        if (!state.alerted) {
+            state.alerted = true;
+            ++m_alertCount;
+            Trend trend;
+            fill(pid, state, trend);
+            m_alerts.push_back(trend);
+        }
+    } else if (secondsToLimit > kRearmFactor * m_options.horizonSec) {
+        state.alerted = false;
+    }
+}
+
+void GrowthDetector::endScan()
+{
+    for (auto it = m_states.begin(); it != m_states.end();) {
+        if (it->second.seen != m_scan) {
+            it = m_states.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_ranking.clear();
+    for (const auto &entry : m_rank.takeSorted()) {
+        Trend trend;
+        fill(entry.id, m_states.at(entry.id), trend);
+        m_ranking.push_back(trend);
+    }
+}
+
+void GrowthDetector::fill(pid_t pid, const State &state, Trend &out) const
+{
+    bool recent = false;
+    const Fit *fit = trendFit(state, &recent);
+    const Fit &shown = fit ? *fit : recent ? state.recentFit : state.longFit;
+    out.pid = pid;
+    out.rssKb = state.lastKb;
+    out.rateKbPerSec = state.rate;
+    out.slopeKbPerSec = shown.slope();
+    out.fit = shown.fit();
+    out.trendAgeSec = state.lastSec - state.firstSec - shown.startSec;
+    out.changePoint = recent;
+    out.limitKb = m_options.limitKb > 0 ? m_options.limitKb : state.lastKb + std::max(m_memAvailableKb, 0L);
+    out.secondsToLimit = -1;
+    if (fit && out.slopeKbPerSec > 0) {
+        out.secondsToLimit = state.lastKb >= out.limitKb ? 0 : (out.limitKb - state.lastKb) / out.slopeKbPerSec;
+    }
+}
+
+bool GrowthDetector::trend(pid_t pid, Trend &out) const
+{
+    auto it = m_states.find(pid);
+    if (it == m_states.end()) return false;
+    fill(pid, it->second, out);
+    return true;
+}
+
+GrowthDetector::Stats GrowthDetector::stats() const
+{
+    Stats stats;
+    stats.tracked = m_states.size();
+    stats.untracked = m_untracked;
+    stats.changePoints = m_changePoints;
+    stats.alerts = m_alertCount;
+    return stats;
+}
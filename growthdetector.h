@@ -0,0 +1,132 @@
+#ifndef GROWTHDETECTOR_H
+#define GROWTHDETECTOR_H
+
+#include <sys/types.h>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+#include "topk.h"
+
+// Streaming leak detection over per-process RSS. Every sample updates a
+// constant amount of state per PID, whatever the sampling rate:
+//  - EWMAs of the growth rate: a quick one for display, and a slow one
+//    over the fit window with its mean deviation as the CUSUM baseline;
+//  - linear regressions of RSS over time with exponential forgetting,
+//    updated in the centred (Welford) form so they stay precise over days.
+//    Slope and r^2 tell a steady leak from a process that merely breathes;
+//  - a CUSUM on the growth rate against its EWMA baseline, with each step
+//    clipped so a single spike cannot trip it. When growth picks up, a
+//    second, recent regression starts at that point, so a long flat history
+//    does not dilute a leak that just began. If RSS then falls far below the
+//    recent trend, the process gave memory back; for a fit window after that
+//    only the long regression is trusted, which keeps GC sawtooths out.
+// A process whose trend reaches the limit within the horizon raises one
+// alert, re-armed once it is no longer heading there.
+class GrowthDetector
+{
+public:
+    struct Options {
+        double rateWindowSec = 300;        // EWMA time constant
+        double fitWindowSec = 1800;        // regression forgetting time constant
+        double minFitSpanSec = 120;        // history a trend needs before it counts
+        int minFitSamples = 8;
+        double minFit = 0.6;               // r^2 below this is noise, not a trend
+        double cusumDrift = 0.25;          // in units of the rate's mean deviation
+        double cusumThreshold = 8;
+        long limitKb = 0;                  // 0: the process's RSS plus MemAvailable
+        double horizonSec = 0;             // alert if the limit is reached within this; 0 for no alerts
+        size_t maxTracked = 65536;
+    };
+
+    struct Trend {
+        pid_t pid = 0;
+        long rssKb = 0;
+        double slopeKbPerSec = 0;      // from the regression it is judged by
+        double rateKbPerSec = 0;       // EWMA
+        double fit = 0;                // r^2 of that regression
+        double trendAgeSec = 0;        // span of that regression
+        bool changePoint = false;      // judged since an upward change in growth rate
+        double secondsToLimit = -1;    // < 0 when not heading for the limit
+        long limitKb = 0;
+    };
+
+    struct Stats {
+        size_t tracked = 0;
+        size_t untracked = 0;     // not followed because maxTracked was reached
+        unsigned long long changePoints = 0;
+        unsigned long long alerts = 0;
+    };
+
+    GrowthDetector();
+
+    void setOptions(const Options &options) { m_options = options; }
+    const Options &options() const { return m_options; }
+    void setRankingSize(size_t count) { m_rankingSize = count; }
+
+    // One scan: beginScan(), add() for every process, endScan().
+    void beginScan(double timeSec, long memAvailableKb);
+    void add(pid_t pid, unsigned long long startTime, long rssKb);
+    // Forgets processes that were not added since beginScan().
+    void endScan();
+
+    // Steepest credible trends of the last scan, steepest first
+    const std::vector<Trend> &ranking() const { return m_ranking; }
+    // Processes that became projected to reach their limit in the last scan
+    const std::vector<Trend> &alerts() const { return m_alerts; }
+    bool trend(pid_t pid, Trend &out) const;
+    Stats stats() const;
+
+private:
+    // Regression of RSS over time with exponential forgetting
+    struct Fit {
+        double startSec = 0;
+        int samples = 0;
+        double weight = 0;
+        double meanT = 0;
+        double meanX = 0;
+        double ctt = 0;
+        double ctx = 0;
+        double cxx = 0;
+
+        void restart(double t, double x);
+        void add(double t, double x, double decay);
+        double slope() const { return ctt > 0 ? ctx / ctt : 0; }
+        double fit() const { return ctt > 0 && cxx > 0 ? ctx * ctx / (ctt * cxx) : 0; }
+    };
+
+    struct State {
+        unsigned long long startTime = 0;
+        unsigned long long seen = 0;
+        double firstSec = 0;       // fit times are relative to this
+        double lastSec = 0;
+        long lastKb = 0;
+        double rate = 0;           // EWMA of growth over rateWindowSec, KB/s
+        double baseline = 0;       // EWMA of growth over fitWindowSec
+        double rateDeviation = 0;  // EWMA of |growth - baseline|
+        double cusumUp = 0;
+        double lastReleaseSec = -1e300;
+        Fit longFit;
+        Fit recentFit;             // since the last upward change point
+        bool changePoint = false;
+        bool alerted = false;
+    };
+
+    // The fit to judge the process by, or nullptr if none is credible yet
+    const Fit *trendFit(const State &state, bool *recent = nullptr) const;
+    void fill(pid_t pid, const State &state, Trend &out) const;
+
+    Options m_options;
+    size_t m_rankingSize = 10;
+    double m_nowSec = 0;
+    long m_memAvailableKb = 0;
+    unsigned long long m_scan = 0;
+    std::unordered_map<pid_t, State> m_states;
+    TopK<double, pid_t> m_rank;
+    std::vector<Trend> m_ranking;
+    std::vector<Trend> m_alerts;
+    size_t m_untracked = 0;
+    unsigned long long m_changePoints = 0;
+    unsigned long long m_alertCount = 0;
+};
+
+#endif // GROWTHDETECTOR_H
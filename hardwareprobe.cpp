@@ -0,0 +1,467 @@
+#include "hardwareprobe.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <utility>
+
+namespace {
+
+const char *const kCacheMagic = "MemoryAnalyzerGUI hardware 1";
+
+// Vendors seen on display controllers, and the virtual adapters that
+// hypervisors expose, for machines without pci.ids. Real GPUs are named
+// by vendor and device ID unless pci.ids knows them.
+struct PciName {
+    unsigned vendor;
+    unsigned device; // 0: the vendor itself
+    const char *name;
+};
+
+const PciName kPciNames[] = {
+    {0x1002, 0, "Advanced Micro Devices, Inc. [AMD/ATI]"},
+    {0x1013, 0, "Cirrus Logic"},
+    {0x1013, 0x00b8, "GD 5446"},
+    {0x102b, 0, "Matrox Electronics Systems Ltd."},
+    {0x102b, 0x0522, "MGA G200e [Pilot] ServerEngines (SEP1)"},
+    {0x102b, 0x0532, "MGA G200eW WPCM450"},
+    {0x102b, 0x0536, "Integrated Matrox G200eW3 Graphics Controller"},
+    {0x102b, 0x0538, "G200eH"},
+    {0x10de, 0, "NVIDIA Corporation"},
+    {0x1234, 0, "QEMU"},
+    {0x1234, 0x1111, "Standard VGA"},
+    {0x13b5, 0, "ARM"},
+    {0x14e4, 0, "Broadcom Inc. and subsidiaries"},
+    {0x15ad, 0, "VMware"},
+    {0x15ad, 0x0405, "SVGA II Adapter"},
+    {0x1414, 0, "Microsoft Corporation"},
+    {0x1414, 0x5353, "Hyper-V virtual VGA"},
+    {0x1a03, 0, "ASPEED Technology, Inc."},
+    {0x1a03, 0x2000, "ASPEED Graphics Family"},
+    {0x1af4, 0, "Red Hat, Inc."},
+    {0x1af4, 0x1050, "Virtio 1.0 GPU"},
+    {0x1b36, 0, "Red Hat, Inc."},
+    {0x1b36, 0x0100, "QXL paravirtual graphic card"},
+    {0x1d17, 0, "Zhaoxin"},
+    {0x5143, 0, "Qualcomm Inc"},
+    {0x8086, 0, "Intel Corporation"},
+    {0x80ee, 0, "InnoTek Systemberatung GmbH"},
+    {0x80ee, 0xbeef, "VirtualBox Graphics Adapter"},
+};
+
+const char *const kPciIdsPaths[] = {
+    "/usr/share/hwdata/pci.ids",
+    "/usr/share/misc/pci.ids",
+    "/usr/share/pci.ids",
+};
+
+// SMBIOS memory device types (DMTF DSP0134, 7.18.2), from 0x01
+const char *const kMemoryTypes[] = {
+    "Other", "Unknown", "DRAM", "EDRAM", "VRAM", "SRAM", "RAM", "ROM", "Flash", "EEPROM", "FEPROM",
+    "EPROM", "CDRAM", "3DRAM", "SDRAM", "SGRAM", "RDRAM", "DDR", "DDR2", "DDR2 FB-DIMM", "Reserved",
+    "Reserved", "Reserved", "DDR3", "FBD2", "DDR4", "LPDDR", "LPDDR2", "LPDDR3", "LPDDR4",
+    "Logical non-volatile device", "HBM", "HBM2", "DDR5", "LPDDR5", "HBM3",
+};
+
+// Small sysfs and procfs files, whole; false if missing or empty.
+bool readFile(const std::string &path, std::string &out)
+{
+    out.clear();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    char buf[4096];
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof(buf))) > 0) out.append(buf, static_cast<size_t>(n));
+    ::close(fd);
+    while (!out.empty() && (out.back() == '\n' || out.back() == ' ')) out.pop_back();
+    return !out.empty();
+}
+
+// CPUs in a kernel cpulist such as "0-3,8,10-11"
+std::vector<int> parseCpuList(const std::string &list)
+{
+    std::vector<int> cpus;
+    const char *p = list.c_str();
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p) break;
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for (long cpu = first; cpu <= last && cpu - first < 65536; ++cpu) cpus.push_back(static_cast<int>(cpu));
+        if (*p != ',') break;
+        ++p;
+    }
+    return cpus;
+}
+
+// "48K" or "8M" in KiB
+long parseSizeKb(const std::string &size)
+{
+    char *end;
+    long value = strtol(size.c_str(), &end, 10);
+    if (*end == 'M') value *= 1024;
+    else if (*end == 'G') value *= 1024 * 1024;
+    return value;
+}
+
+unsigned parseHex(const std::string &text)
+{
+    return static_cast<unsigned>(strtoul(text.c_str(), nullptr, 16));
+}
+
+const char *builtinPciName(unsigned vendor, unsigned device)
+{
+    for (const PciName &entry : kPciNames) {
+        if (entry.vendor == vendor && entry.device == device) return entry.name;
+    }
+    return nullptr;
+}
+
+// Looks up vendor and device names in a pci.ids file: vendors start a line
+// with four hex digits, their devices follow indented by one tab.
+bool lookupPciIds(const std::string &ids, unsigned vendor, unsigned device, std::string &vendorName,
+                  std::string &deviceName)
+{
+    char key[8];
+    snprintf(key, sizeof(key), "%04x ", vendor);
+    size_t pos = 0;
+    while ((pos = ids.find(key, pos)) != std::string::npos) {
+        if (pos == 0 || ids[pos - 1] == '\n') break;
+        ++pos;
+    }
+    if (pos == std::string::npos) return false;
+    size_t lineEnd = ids.find('\n', pos);
+    vendorName = ids.substr(pos + 6, lineEnd - pos - 6);
+    snprintf(key, sizeof(key), "\t%04x ", device);
+    while (lineEnd != std::string::npos && lineEnd + 1 < ids.size()) {
+        size_t line = lineEnd + 1;
+        lineEnd = ids.find('\n', line);
+        if (ids[line] != '\t' && ids[line] != '#') break; // next vendor
+        if (ids.compare(line, 6, key) == 0) {
+            deviceName = ids.substr(line + 7, lineEnd == std::string::npos ? std::string::npos : lineEnd - line - 7);
+            break;
+        }
+    }
+    return true;
+}
+
+void put(std::string &out, const char *key, const std::string &value)
+{
+    out += key;
+    out += ' ';
+    out += value;
+    out += '\n';
+}
+
+} // namespace
+
+HardwareProbe::HardwareProbe(const char *sysRoot, const char *procRoot)
+    : m_sysRoot(sysRoot), m_procRoot(procRoot)
+{
+}
+
+HardwareInfo HardwareProbe::probe() const
+{
+    HardwareInfo info;
+    probeCpu(info);
+    probeGpus(info);
+    probeMemory(info);
+    return info;
+}
+
+HardwareInfo HardwareProbe::cachedProbe(const std::string &cachePath, bool *fromCache) const
+{
+    HardwareInfo info;
+    bool cached = !cachePath.empty() && loadCache(cachePath, info)
+                  && (info.memoryKnown || ::access((m_sysRoot + "/firmware/dmi/tables/DMI").c_str(), R_OK) != 0);
+    if (fromCache) *fromCache = cached;
+    if (cached) return info;
+    info = probe();
+    if (!cachePath.empty()) saveCache(cachePath, info);
+    return info;
+}
+
+std::string HardwareProbe::bootId() const
+{
+    std::string id;
+    readFile(m_procRoot + "/sys/kernel/random/boot_id", id);
+    return id;
+}
+
+bool HardwareProbe::loadCache(const std::string &path, HardwareInfo &out) const
+{
+    std::string text;
+    std::string boot = bootId();
+    if (boot.empty() || !readFile(path, text)) return false;
+    HardwareInfo info;
+    bool magicSeen = false;
+    bool bootMatches = false;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos) end = text.size();
+        std::string line = text.substr(pos, end - pos);
+        pos = end + 1;
+        if (!magicSeen) {
+            if (line != kCacheMagic) return false;
+            magicSeen = true;
+            continue;
+        }
+        size_t space = line.find(' ');
+        std::string key = line.substr(0, space);
+        std::string value = space == std::string::npos ? std::string() : line.substr(space + 1);
+        if (key == "boot_id") bootMatches = value == boot;
+        else if (key == "cpu_model") info.cpuModel = value;
+        else if (key == "cpu_cores") info.cpuCores = atoi(value.c_str());
+        else if (key == "cpu_threads") info.cpuThreads = atoi(value.c_str());
+        else if (key == "l1") info.l1Cache = value;
+        else if (key == "l2") info.l2Cache = value;
+        else if (key == "l3") info.l3Cache = value;
+        else if (key == "gpu") info.gpus.push_back(value);
+        else if (key == "memory_known") info.memoryKnown = value == "1";
+        else if (key == "memory_type") info.memoryType = value;
+        else if (key == "memory_speed") info.memorySpeed = value;
+        else if (key == "memory_slots") info.memorySlots = atoi(value.c_str());
+        else if (key == "memory_populated") info.memoryPopulated = atoi(value.c_str());
+    }
+    if (!bootMatches) return false;
+    out = info;
+    return true;
+}
+
+bool HardwareProbe::saveCache(const std::string &path, const HardwareInfo &info) const
+{
+    std::string boot = bootId();
+    if (boot.empty()) return false;
+    std::string text = kCacheMagic;
+    text += '\n';
+    put(text, "boot_id", boot);
+    put(text, "cpu_model", info.cpuModel);
+    put(text, "cpu_cores", std::to_string(info.cpuCores));
+    put(text, "cpu_threads", std::to_string(info.cpuThreads));
+    put(text, "l1", info.l1Cache);
+    put(text, "l2", info.l2Cache);
+    put(text, "l3", info.l3Cache);
+    for (const std::string &gpu : info.gpus) put(text, "gpu", gpu);
+    put(text, "memory_known", info.memoryKnown ? "1" : "0");
+    put(text, "memory_type", info.memoryType);
+    put(text, "memory_speed", info.memorySpeed);
+    put(text, "memory_slots", std::to_string(info.memorySlots));
+    put(text, "memory_populated", std::to_string(info.memoryPopulated));
+
+    // Written aside and renamed, so a reader never sees half a file.
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    bool ok = ::write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size());
+    ok = ::close(fd) == 0 && ok;
+    if (!ok || ::rename(tmp.c_str(), path.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+void HardwareProbe::probeCpu(HardwareInfo &out) const
+{
+    std::string cpuinfo;
+    if (readFile(m_procRoot + "/cpuinfo", cpuinfo)) {
+        // x86 says "model name"; other architectures use other keys, if any.
+        const char *const keys[] = {"model name", "Processor", "cpu model", "cpu"};
+        for (const char *key : keys) {
+            size_t keyLen = strlen(key);
+            size_t pos = 0;
+            while (pos < cpuinfo.size() && out.cpuModel.empty()) {
+                size_t end = cpuinfo.find('\n', pos);
+                if (end == std::string::npos) end = cpuinfo.size();
+                if (cpuinfo.compare(pos, keyLen, key) == 0) {
+                    size_t colon = cpuinfo.find(':', pos);
+                    size_t afterKey = cpuinfo.find_first_not_of(" \t", pos + keyLen);
+                    if (colon < end && afterKey == colon) {
+                        size_t value = cpuinfo.find_first_not_of(" \t", colon + 1);
+                        if (value < end) out.cpuModel = cpuinfo.substr(value, end - value);
+                    }
+                }
+                pos = end + 1;
+            }
+            if (!out.cpuModel.empty()) break;
+        }
+    }
+    if (out.cpuModel.empty()) {
+        struct utsname name;
+        if (uname(&name) == 0) out.cpuModel = name.machine;
+    }
+
+    const std::string cpuDir = m_sysRoot + "/devices/system/cpu/";
+    std::string text;
+    std::vector<int> online = readFile(cpuDir + "online", text) ? parseCpuList(text) : std::vector<int>();
+    if (online.empty()) online.push_back(0);
+    out.cpuThreads = static_cast<int>(online.size());
+
+    // Cores are the distinct sets of hardware threads; cache instances the
+    // distinct sets of CPUs sharing one cache.
+    std::set<std::string> cores;
+    struct CacheLevel {
+        long sizeKb = 0;
+        std::set<std::string> instances;
+    };
+    std::map<std::pair<int, std::string>, CacheLevel> caches;
+    for (int cpu : online) {
+        std::string dir = cpuDir + "cpu" + std::to_string(cpu) + "/";
+        if (readFile(dir + "topology/core_cpus_list", text) || readFile(dir + "topology/thread_siblings_list", text)) {
+            cores.insert(text);
+        }
+        for (int index = 0;; ++index) {
+            std::string cacheDir = dir + "cache/index" + std::to_string(index) + "/";
+            std::string level, type, size, shared;
+            if (!readFile(cacheDir + "level", level)) break;
+            if (!readFile(cacheDir + "type", type) || type == "Instruction" || !readFile(cacheDir + "size", size)) continue;
+            if (!readFile(cacheDir + "shared_cpu_list", shared)) shared = std::to_string(cpu);
+            CacheLevel &cache = caches[std::make_pair(atoi(level.c_str()), type)];
+            cache.sizeKb = parseSizeKb(size);
+            cache.instances.insert(shared);
+        }
+    }
+    out.cpuCores = cores.empty() ? out.cpuThreads : static_cast<int>(cores.size());
+    for (const auto &entry : caches) {
+        const CacheLevel &cache = entry.second;
+        int instances = static_cast<int>(cache.instances.size());
+        std::string formatted = formatCacheSize(cache.sizeKb * instances, instances);
+        switch (entry.first.first) {
+        case 1: if (out.l1Cache.empty() || entry.first.second == "Data") out.l1Cache = formatted; break;
+        case 2: out.l2Cache = formatted; break;
+        case 3: out.l3Cache = formatted; break;
+        default: break;
+        }
+    }
+}
+
+void HardwareProbe::probeGpus(HardwareInfo &out) const
+{
+    const std::string pciDir = m_sysRoot + "/bus/pci/devices/";
+    DIR *dir = opendir(pciDir.c_str());
+    if (!dir) return;
+    std::vector<std::string> addresses;
+    while (dirent *entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') addresses.push_back(entry->d_name);
+    }
+    closedir(dir);
+    std::sort(addresses.begin(), addresses.end());
+
+    std::string ids;
+    bool idsLoaded = false;
+    std::string text;
+    for (const std::string &address : addresses) {
+        std::string device = pciDir + address + "/";
+        // Base class 0x03: VGA, XGA, 3D and other display controllers
+        if (!readFile(device + "class", text) || (parseHex(text) >> 16) != 0x03) continue;
+        unsigned vendorId = readFile(device + "vendor", text) ? parseHex(text) : 0;
+        unsigned deviceId = readFile(device + "device", text) ? parseHex(text) : 0;
+
+        if (!idsLoaded) {
+            for (const char *path : kPciIdsPaths) {
+                if (readFile(path, ids)) break;
+            }
+            idsLoaded = true;
+        }
+        std::string vendorName, deviceName;
+        if (ids.empty() || !lookupPciIds(ids, vendorId, deviceId, vendorName, deviceName)) {
+            const char *name = builtinPciName(vendorId, 0);
+            if (name) vendorName = name;
+        }
+        if (deviceName.empty()) {
+            const char *name = builtinPciName(vendorId, deviceId);
+            if (name) deviceName = name;
+        }
+        char fallback[32];
+        if (vendorName.empty()) {
+            snprintf(fallback, sizeof(fallback), "Vendor %04x", vendorId);
+            vendorName = fallback;
+        }
+        if (deviceName.empty()) {
+            snprintf(fallback, sizeof(fallback), "Device %04x", deviceId);
+            deviceName = fallback;
+        }
+        out.gpus.push_back(vendorName + " " + deviceName);
+    }
+}
+
+void HardwareProbe::probeMemory(HardwareInfo &out) const
+{
+    std::string table;
+    if (!readFile(m_sysRoot + "/firmware/dmi/tables/DMI", table)) return;
+    parseSmbiosMemory(reinterpret_cast<const unsigned char *>(table.data()), table.size(), out);
+}
+
+bool HardwareProbe::parseSmbiosMemory(const unsigned char *data, size_t len, HardwareInfo &out)
+{
+    out.memoryKnown = false;
+    out.memorySlots = 0;
+    out.memoryPopulated = 0;
+    size_t pos = 0;
+    // Each structure: type, length of the formatted part, handle, the
+    // formatted part, then its strings, ended by two NULs.
+    while (pos + 4 <= len) {
+        unsigned type = data[pos];
+        size_t formatted = data[pos + 1];
+        if (formatted < 4 || pos + formatted > len) break;
+        const unsigned char *f = data + pos;
+        size_t next = pos + formatted;
+        while (next + 1 < len && (data[next] != 0 || data[next + 1] != 0)) ++next;
+        next += 2;
+
+        if (type == 17 && formatted >= 0x15) {
+            ++out.memorySlots;
+            unsigned size = f[0x0C] | (f[0x0D] << 8);
+            if (size != 0 && size != 0xFFFF) {
+                ++out.memoryPopulated;
+                unsigned memoryType = f[0x12];
+                if (out.memoryType.empty() && memoryType >= 1
+                    && memoryType <= sizeof(kMemoryTypes) / sizeof(kMemoryTypes[0])) {
+                    out.memoryType = kMemoryTypes[memoryType - 1];
+                }
+                // Configured speed if given (SMBIOS 2.7), else the rated one
+                unsigned speed = formatted >= 0x17 ? f[0x15] | (f[0x16] << 8) : 0;
+                if (formatted >= 0x22) {
+                    unsigned configured = f[0x20] | (f[0x21] << 8);
+                    if (configured != 0 && configured != 0xFFFF) speed = configured;
+                }
+                if (out.memorySpeed.empty() && speed != 0 && speed != 0xFFFF) {
+                    out.memorySpeed = std::to_string(speed) + " MT/s";
+                }
+            }
+        }
+        if (type == 127) break; // end of table
+        pos = next;
+    }
+    // A table without memory devices (a VM, or cut short) tells us nothing.
+    out.memoryKnown = out.memorySlots > 0;
+    return out.memoryKnown;
+}
+
+std::string HardwareProbe::formatCacheSize(long totalKb, int instances)
+{
+    char buf[64];
+    int n;
+    if (totalKb < 1024) {
+        n = snprintf(buf, sizeof(buf), "%ld KiB", totalKb);
+    } else if (totalKb % 1024 == 0) {
+        n = snprintf(buf, sizeof(buf), "%ld MiB", totalKb / 1024);
+    } else {
+        n = snprintf(buf, sizeof(buf), "%.1f MiB", totalKb / 1024.0);
+    }
+    if (instances > 1) snprintf(buf + n, sizeof(buf) - n, " (%d instances)", instances);
+    return buf;
+}
@@ -0,0 +1,69 @@
+#ifndef HARDWAREPROBE_H
+#define HARDWAREPROBE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// What the overview page shows about the machine, as plain strings so it
+// can be cached. Cache sizes are formatted like lscpu's ("192 KiB (4
+// instances)"); empty when the kernel does not say.
+struct HardwareInfo {
+    std::string cpuModel;
+    int cpuCores = 0;   // physical cores, all sockets
+    int cpuThreads = 0; // online logical CPUs
+    std::string l1Cache; // data (or unified) L1
+    std::string l2Cache;
+    std::string l3Cache;
+    std::vector<std::string> gpus;
+    bool memoryKnown = false; // the SMBIOS table could be read
+    std::string memoryType;
+    std::string memorySpeed;
+    int memorySlots = 0;
+    int memoryPopulated = 0;
+};
+
+// Reads the hardware description straight from the kernel instead of
+// running lscpu, lspci and dmidecode:
+//   CPU       /proc/cpuinfo for the model name; /sys/devices/system/cpu
+//             for online CPUs, core siblings and the cache index dirs
+//   GPUs      /sys/bus/pci/devices, display controllers (class 0x03),
+//             named from the system's pci.ids if there is one, else from
+//             a small built-in table of vendors and virtual adapters
+//   Memory    SMBIOS type 17 records in /sys/firmware/dmi/tables/DMI,
+//             which only root can read
+// A full probe reads a few files per CPU, so cachedProbe() keeps the result
+// on disk for as long as the machine stays up (keyed by the boot ID).
+class HardwareProbe
+{
+public:
+    explicit HardwareProbe(const char *sysRoot = "/sys", const char *procRoot = "/proc");
+
+    HardwareInfo probe() const;
+    // The cached result from this boot if there is one, else a fresh probe,
+    // which is then written to cachePath. A cache without memory details
+    // is not used once the SMBIOS table has become readable (e.g. when
+    // running as root for the first time).
+    HardwareInfo cachedProbe(const std::string &cachePath, bool *fromCache = nullptr) const;
+
+    // Contents of /proc/sys/kernel/random/boot_id, empty if unknown
+    std::string bootId() const;
+    bool loadCache(const std::string &path, HardwareInfo &out) const;
+    bool saveCache(const std::string &path, const HardwareInfo &info) const;
+
+    void probeCpu(HardwareInfo &out) const;
+    void probeGpus(HardwareInfo &out) const;
+    void probeMemory(HardwareInfo &out) const;
+
+    // Fills the memory fields from a raw SMBIOS structure table. Returns
+    // false if it holds no memory devices.
+    static bool parseSmbiosMemory(const unsigned char *data, size_t len, HardwareInfo &out);
+    // A cache level's total size over its instances, as lscpu prints it
+    static std::string formatCacheSize(long totalKb, int instances);
+
+private:
+    std::string m_sysRoot;
+    std::string m_procRoot;
+};
+
+#endif // HARDWAREPROBE_H
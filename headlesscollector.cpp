@@ -0,0 +1,302 @@
+#include "headlesscollector.h"
+#include "processworker.h"
+#include "allocationcounter.h"
+#include "alertengine.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QLoggingCategory>
+#include <QSocketNotifier>
+#include <QTextStream>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// SIGINT/SIGTERM are forwarded through a socket pair so the actual shutdown
+// runs in the event loop rather than in the signal handler.
+int signalFds[2] = {-1, -1};
+
+void forwardSignal(int)
+{
+    char byte = 1;
+    ssize_t ignored = ::write(signalFds[0], &byte, 1);
+    (void)ignored;
+}
+
+QTextStream &err()
+{
+    static QTextStream stream(stderr);
+    return stream;
+}
+
+} // namespace
+
+HeadlessCollector::HeadlessCollector(QObject *parent) : QObject(parent)
+{
+    m_worker = new ProcessWorker(this);
+    m_worker->setHistoryBudget(0);
+    m_worker->setRankingSize(0);
+    // Recordings carry RSS only.
+    m_worker->setDeepAccountingBudget(0);
+    connect(m_worker, &ProcessWorker::scanDelta, this, &HeadlessCollector::handleScanDelta);
+    connect(m_worker, &ProcessWorker::alertsPending, this, &HeadlessCollector::handleAlerts);
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, signalFds) == 0) {
+        m_signalNotifier = new QSocketNotifier(signalFds[1], QSocketNotifier::Read, this);
+        connect(m_signalNotifier, &QSocketNotifier::activated, this, &HeadlessCollector::handleSignal);
+        struct sigaction action = {};
+        action.sa_handler = forwardSignal;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+    }
+}
+
+HeadlessCollector::~HeadlessCollector()
+{
+    m_recorder.stop();
+}
+
+int HeadlessCollector::run(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("MemoryAnalyzerGUI");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Samples process memory without a GUI.");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"headless", "Run without a GUI."},
+        {"interval", "Milliseconds between scans (default 1000).", "ms", "1000"},
+        {"threshold", "Warn on stderr when system memory use exceeds this percentage.", "percent"},
+        {"rule", "Warn on stderr when this alert rule fires, e.g. \"name=java memory > 4GB for 1m\" "
+                 "(see the README); may be given more than once.", "rule"},
+        {"rules", "Read alert rules from this file, one per line.", "file"},
+        {"stall-ms", "Warn on stderr as soon as tasks stall on memory this long per window (PSI).", "ms", "0"},
+        {"stall-window-ms", "Window for --stall-ms (default 1000).", "ms", "1000"},
+        {"stall-cgroups", "Also watch these comma-separated cgroup v2 paths for --stall-ms.", "list"},
+        {"leak-horizon-min", "Warn on stderr when a process grows steadily enough to reach --leak-limit-mb "
+                             "within this many minutes (default 0: off).", "minutes", "0"},
+        {"leak-limit-mb", "Limit for --leak-horizon-min (default 0: its RSS plus available memory).", "MB", "0"},
+        {"record", "Stream every scan to this file.", "file"},
+        {"format", "Recording format: csv, binary or snapshot (default csv).", "format", "csv"},
+        {"pids", "Record only these comma-separated PIDs.", "list"},
+        {"rotate-mb", "Start a new recording file after this many megabytes.", "MB", "0"},
+        {"rotate-hours", "Start a new recording file after this many hours.", "hours", "0"},
+        {"history-mb", "Keep in-memory history within this budget (default 0: off).", "MB", "0"},
+        {"threads", "Threads used to read /proc.", "count"},
+        {"stat-every", "Re-read process names every this many scans (default 10).", "scans", "10"},
+        {"no-events", "List /proc every scan instead of following process events."},
+        {"diagnostics", "On exit, write per-phase scan timings and counters to this file.", "file"},
+        {"metrics", "Serve every scan as OpenMetrics at /metrics on this loopback host:port or unix:/path.", "address"},
+        {"metrics-top", "Processes exported one by one by --metrics, largest RSS first (default 100).", "count", "100"},
+        {"verbose", "Log every scan."},
+    });
+    parser.process(app);
+
+    if (!parser.isSet("verbose")) QLoggingCategory::setFilterRules("default.debug=false");
+
+    HeadlessCollector collector;
+    ProcessWorker *worker = collector.m_worker;
+    // Nothing to display: scans happen on the exact interval, for the
+    // recording or, without one, for the alerts.
+    worker->setInterval(0);
+    worker->setHistoryBudget(parser.value("history-mb").toInt());
+    if (parser.isSet("threshold")) worker->setThreshold(parser.value("threshold").toInt());
+    QString rules;
+    if (parser.isSet("rules")) {
+        QFile file(parser.value("rules"));
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            err() << "Cannot read " << file.fileName() << ": " << file.errorString() << Qt::endl;
+            return 2;
+        }
+        rules = QString::fromUtf8(file.readAll());
+        if (!rules.isEmpty() && !rules.endsWith('\n')) rules += '\n';
+    }
+    for (const QString &rule : parser.values("rule")) rules += rule + '\n';
+    std::string error;
+    if (!AlertEngine().compile(rules.toStdString(), &error)) {
+        err() << "Alert rules: " << QString::fromStdString(error) << Qt::endl;
+        return 2;
+    }
+    if (!rules.isEmpty()) worker->setAlertRules(rules);
+    worker->setPressureAlert(parser.value("stall-ms").toInt(), parser.value("stall-window-ms").toInt(),
+                             parser.value("stall-cgroups").split(',', Qt::SkipEmptyParts));
+    worker->setLeakAlert(parser.value("leak-limit-mb").toInt(), parser.value("leak-horizon-min").toInt());
+    if (parser.isSet("threads")) worker->setScanThreadCount(parser.value("threads").toInt());
+    worker->setStatRefreshInterval(parser.value("stat-every").toInt());
+    worker->setProcessEvents(!parser.isSet("no-events"));
+    collector.m_diagnosticsPath = parser.value("diagnostics");
+    if (parser.isSet("metrics")) worker->setMetricsEndpoint(parser.value("metrics"), parser.value("metrics-top").toInt());
+
+    for (const QString &pid : parser.value("pids").split(',', Qt::SkipEmptyParts)) {
+        bool ok;
+        pid_t value = pid.trimmed().toInt(&ok);
+        if (!ok) {
+            err() << "Invalid PID: " << pid << Qt::endl;
+            return 2;
+        }
+        collector.m_pids.append(value);
+    }
+
+    if (parser.isSet("record")) {
+        MemoryRecorder::Options options;
+        options.path = QFile::encodeName(parser.value("record")).toStdString();
+        QString format = parser.value("format");
+        if (format == "csv") {
+            options.format = MemoryRecorder::Csv;
+        } else if (format == "binary") {
+            options.format = MemoryRecorder::Binary;
+        } else if (format == "snapshot") {
+            options.format = MemoryRecorder::Snapshot;
+        } else {
+            err() << "Unknown format: " << format << Qt::endl;
+            return 2;
+        }
+        options.maxFileBytes = static_cast<uint64_t>(qMax(0, parser.value("rotate-mb").toInt())) << 20;
+        options.maxFileAgeMs = static_cast<int64_t>(qMax(0, parser.value("rotate-hours").toInt())) * 3600 * 1000;
+        QString error;
+        if (!collector.startRecording(options, &error)) {
+            err() << error << Qt::endl;
+            return 1;
+        }
+    }
+
+    worker->setConsumerInterval(collector.m_recording ? SampleScheduler::Tracker : SampleScheduler::Alerting,
+                                parser.value("interval").toInt());
+    worker->startSampling();
+    return app.exec();
+}
+
+bool HeadlessCollector::startRecording(const MemoryRecorder::Options &options, QString *error)
+{
+    std::string message;
+    if (!m_recorder.start(options, &message)) {
+        if (error) *error = QString::fromStdString(message);
+        return false;
+    }
+    m_recording = true;
+    return true;
+}
+
+void HeadlessCollector::handleScanDelta(const ScanDelta &delta)
+{
+    ++m_scans;
+    ScanProfile::Tick tick = delta.scanStats.profile;
+    tick.phaseMs[ScanProfile::Deliver] = (ScanProfile::nowNs() - tick.emittedNs) / 1e6;
+    AllocationCount allocationsBefore = threadAllocations();
+    QElapsedTimer applyTimer;
+    applyTimer.start();
+    applyDelta(delta);
+    tick.phaseMs[ScanProfile::Apply] = applyTimer.nsecsElapsed() / 1e6;
+    AllocationCount allocations = threadAllocations();
+    tick.receiver.allocations = allocations.allocations - allocationsBefore.allocations;
+    tick.receiver.allocatedBytes = allocations.bytes - allocationsBefore.bytes;
+    m_scanProfile.record(tick);
+}
+
+void HeadlessCollector::applyDelta(const ScanDelta &delta)
+{
+    if (!m_recording) return;
+
+    if (delta.baseGeneration == 0) {
+        m_processes.clear();
+    } else if (delta.baseGeneration != m_generation) {
+        m_worker->requestFullSnapshot();
+        return;
+    }
+    m_generation = delta.generation;
+    for (pid_t pid : delta.removed) m_processes.remove(pid);
+    for (const ProcessInfo &info : delta.added) m_processes.insert(info.pid, info);
+    for (const ProcessUpdate &update : delta.changed) {
+        auto it = m_processes.find(update.pid);
+        if (it == m_processes.end()) continue;
+        it->memory = update.memory;
+        it->growth = update.growth;
+    }
+
+    if (!(delta.consumers & (1u << SampleScheduler::Tracker))) return;
+    RecorderFrame frame;
+    frame.timeMs = delta.timeMs;
+    frame.memTotal = delta.memTotal;
+    frame.memAvailable = delta.memAvailable;
+    auto add = [&frame](const ProcessInfo &process) {
+        QByteArray name = process.name.toUtf8();
+        frame.add(process.pid, process.memory, process.growth, name.constData(), name.size());
+    };
+    if (m_pids.isEmpty()) {
+        frame.samples.reserve(m_processes.size());
+        for (const ProcessInfo &process : m_processes) add(process);
+    } else {
+        for (pid_t pid : m_pids) {
+            auto it = m_processes.constFind(pid);
+            if (it != m_processes.constEnd()) add(*it);
+            else frame.missing.push_back(pid);
+        }
+    }
+    m_recorder.submit(std::move(frame));
+
+    MemoryRecorder::Stats stats = m_recorder.stats();
+    if (!stats.error.empty()) {
+        err() << "Recording failed: " << QString::fromStdString(stats.error) << Qt::endl;
+        QCoreApplication::exit(1);
+    }
+}
+
+void HeadlessCollector::handleAlerts()
+{
+    for (const Alert &alert : m_worker->alerts().drain()) {
+        err() << QDateTime::fromMSecsSinceEpoch(alert.timeMs).toString(Qt::ISODate) << ' '
+              << QString::fromStdString(alert.message);
+        if (alert.repeats > 1) err() << " (" << alert.repeats << " times)";
+        err() << Qt::endl;
+    }
+}
+
+void HeadlessCollector::handleSignal()
+{
+    char byte;
+    ssize_t ignored = ::read(signalFds[1], &byte, 1);
+    (void)ignored;
+    m_recorder.stop();
+    printSummary();
+    writeDiagnostics();
+    QCoreApplication::quit();
+}
+
+void HeadlessCollector::printSummary()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double cpuSec = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+                    + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    err() << m_scans << " scans, " << cpuSec << " s CPU, peak RSS " << usage.ru_maxrss / 1024.0 << " MB";
+    if (m_recording) {
+        MemoryRecorder::Stats stats = m_recorder.stats();
+        err() << ", " << stats.frames << " samples (" << stats.bytesWritten << " bytes) written to "
+              << QString::fromStdString(stats.currentFile);
+        if (stats.droppedFrames) err() << ", " << stats.droppedFrames << " dropped";
+    }
+    err() << Qt::endl;
+}
+
+void HeadlessCollector::writeDiagnostics()
+{
+    if (m_diagnosticsPath.isEmpty()) return;
+    QFile file(m_diagnosticsPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        err() << "Could not write diagnostics to " << m_diagnosticsPath << Qt::endl;
+        return;
+    }
+    QTextStream out(&file);
+    out << "--- Memory Analyzer Diagnostics (headless), " << QDateTime::currentDateTime().toString(Qt::ISODate)
+        << " ---\n";
+    out << QString::fromStdString(m_scanProfile.report());
+}
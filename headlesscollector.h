@@ -0,0 +1,53 @@
+#ifndef HEADLESSCOLLECTOR_H
+#define HEADLESSCOLLECTOR_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include "datatypes.h"
+#include "memoryrecorder.h"
+
+class ProcessWorker;
+class QSocketNotifier;
+
+// The sampling pipeline without any widgets, for servers: a ProcessWorker
+// on the main thread of a QCoreApplication, alerts on stderr
+// and, optionally, every scan streamed to disk by MemoryRecorder. It keeps
+// only the process list the recorder needs (no history or rankings unless
+// asked for).
+class HeadlessCollector : public QObject
+{
+    Q_OBJECT
+public:
+    // Entry point for "--headless"; parses the remaining options and runs
+    // until SIGINT or SIGTERM.
+    static int run(int argc, char *argv[]);
+
+    explicit HeadlessCollector(QObject *parent = nullptr);
+    ~HeadlessCollector();
+
+private slots:
+    void handleScanDelta(const ScanDelta &delta);
+    void handleAlerts();
+    void handleSignal();
+
+private:
+    bool startRecording(const MemoryRecorder::Options &options, QString *error);
+    // Recording's share of a scan, timed by handleScanDelta() as Apply
+    void applyDelta(const ScanDelta &delta);
+    void printSummary();
+    void writeDiagnostics();
+
+    ProcessWorker* m_worker;
+    MemoryRecorder m_recorder;
+    bool m_recording = false;
+    QList<pid_t> m_pids; // empty: record all processes
+    QHash<pid_t, ProcessInfo> m_processes;
+    quint64 m_generation = 0;
+    quint64 m_scans = 0;
+    QSocketNotifier* m_signalNotifier = nullptr;
+    ScanProfile m_scanProfile;
+    QString m_diagnosticsPath;
+};
+
+#endif // HEADLESSCOLLECTOR_H
@@ -0,0 +1,487 @@
+#include "historystore.h"
+#include "topk.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+struct TierConfig {
+    int64_t bucketMs;    // 0 for the raw tier, which keeps every scan
+    int64_t retentionMs;
+    uint32_t blockPoints;
+};
+
+const TierConfig kTiers[HistoryStore::TierCount] = {
+    {0, 60LL * 60 * 1000, 256},
+    {60 * 1000, 24LL * 60 * 60 * 1000, 120},
+    {15 * 60 * 1000, 7LL * 24 * 60 * 60 * 1000, 96},
+};
+
+// Rough cost of a hash node and its unique_ptr, on top of sizeof(Series)
+const size_t kSeriesOverhead = 48;
+
+inline int leadingZeros(uint64_t x) { return __builtin_clzll(x); }
+inline int trailingZeros(uint64_t x) { return __builtin_ctzll(x); }
+
+inline uint64_t lowBits(uint64_t value, int bits)
+{
+    return bits >= 64 ? value : value & ((uint64_t(1) << bits) - 1);
+}
+
+} // namespace
+
+void HistoryBlock::writeBits(uint64_t value, int bits)
+{
+    if (bits == 0) return;
+    value = lowBits(value, bits);
+    int offset = static_cast<int>(m_bits & 63);
+    if (offset == 0) m_words.push_back(0);
+    m_words.back() |= value << offset;
+    if (offset + bits > 64) m_words.push_back(value >> (64 - offset));
+    m_bits += bits;
+}
+
+void HistoryBlock::append(int64_t tick, long value)
+{
+    uint64_t bits = static_cast<uint64_t>(static_cast<int64_t>(value));
+    if (m_count == 0) {
+        writeBits(static_cast<uint64_t>(tick), 64);
+        writeBits(bits, 64);
+        m_firstTick = m_lastTick = tick;
+        m_lastDelta = 0;
+        m_lastValue = bits;
+        m_count = 1;
+        return;
+    }
+
+    // Tick: delta-of-delta in the smallest of five buckets
+    int64_t delta = tick - m_lastTick;
+    int64_t dod = delta - m_lastDelta;
+    if (dod == 0) {
+        writeBits(0, 1);
+    } else if (dod >= -63 && dod <= 64) {
+        writeBits(0b01, 2);
+        writeBits(static_cast<uint64_t>(dod + 63), 7);
+    } else if (dod >= -255 && dod <= 256) {
+        writeBits(0b011, 3);
+        writeBits(static_cast<uint64_t>(dod + 255), 9);
+    } else if (dod >= -2047 && dod <= 2048) {
+        writeBits(0b0111, 4);
+        writeBits(static_cast<uint64_t>(dod + 2047), 12);
+    } else {
+        writeBits(0b1111, 4);
+        writeBits(static_cast<uint64_t>(dod), 64);
+    }
+    m_lastTick = tick;
+    m_lastDelta = delta;
+
+    // Value: XOR with the previous one, reusing its window when it fits
+    uint64_t x = bits ^ m_lastValue;
+    if (x == 0) {
+        writeBits(0, 1);
+    } else {
+        int lead = leadingZeros(x);
+        int trail = trailingZeros(x);
+        if (m_lead >= 0 && lead >= m_lead && trail >= m_trail) {
+            writeBits(0b01, 2);
+            writeBits(x >> m_trail, 64 - m_lead - m_trail);
+        } else {
+            int significant = 64 - lead - trail;
+            writeBits(0b11, 2);
+            writeBits(static_cast<uint64_t>(lead), 6);
+            writeBits(static_cast<uint64_t>(significant - 1), 6);
+            writeBits(x >> trail, significant);
+            m_lead = lead;
+            m_trail = trail;
+        }
+    }
+    m_lastValue = bits;
+    ++m_count;
+}
+
+uint64_t HistoryBlock::Cursor::readBits(int bits)
+{
+    if (bits == 0) return 0;
+    const std::vector<uint64_t> &words = m_block.m_words;
+    size_t word = m_pos >> 6;
+    int offset = static_cast<int>(m_pos & 63);
+    uint64_t value = words[word] >> offset;
+    if (offset + bits > 64) value |= words[word + 1] << (64 - offset);
+    m_pos += bits;
+    return lowBits(value, bits);
+}
+
+bool HistoryBlock::Cursor::next(int64_t &tick, long &value)
+{
+    if (m_index >= m_block.m_count) return false;
+    if (m_index == 0) {
+        m_tick = static_cast<int64_t>(readBits(64));
+        m_value = readBits(64);
+        m_lead = -1;
+    } else {
+        int64_t dod;
+        if (readBits(1) == 0) {
+            dod = 0;
+        } else if (readBits(1) == 0) {
+            dod = static_cast<int64_t>(readBits(7)) - 63;
+        } else if (readBits(1) == 0) {
+            dod = static_cast<int64_t>(readBits(9)) - 255;
+        } else if (readBits(1) == 0) {
+            dod = static_cast<int64_t>(readBits(12)) - 2047;
+        } else {
+            dod = static_cast<int64_t>(readBits(64));
+        }
+        m_delta += dod;
+        m_tick += m_delta;
+
+        if (readBits(1) == 1) {
+            if (readBits(1) == 0) {
+                m_value ^= readBits(64 - m_lead - m_trail) << m_trail;
+            } else {
+                int lead = static_cast<int>(readBits(6));
+                int significant = static_cast<int>(readBits(6)) + 1;
+                m_lead = lead;
+                m_trail = 64 - lead - significant;
+                m_value ^= readBits(significant) << m_trail;
+            }
+        }
+    }
+    ++m_index;
+    tick = m_tick;
+    value = static_cast<long>(static_cast<int64_t>(m_value));
+    return true;
+}
+
+struct HistoryStore::Series {
+    pid_t pid = 0;
+    unsigned long long startTime = 0;
+    bool live = true;
+    int64_t lastSeq = 0;
+    long lastValue = 0;
+    std::vector<HistoryBlock> blocks[TierCount];
+    // Mean being accumulated for the current bucket of each coarse tier
+    int64_t bucket[TierCount] = {-1, -1, -1};
+    long long bucketSum[TierCount] = {};
+    int bucketCount[TierCount] = {};
+
+    bool empty() const
+    {
+        return blocks[RawTier].empty() && blocks[MinuteTier].empty() && blocks[QuarterTier].empty();
+    }
+};
+
+HistoryStore::HistoryStore(size_t budgetBytes) : m_budget(budgetBytes)
+{
+}
+
+HistoryStore::~HistoryStore() = default;
+
+void HistoryStore::setBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_budget = bytes;
+    enforceBudget();
+}
+
+int64_t HistoryStore::tickTime(int tier, int64_t tick) const
+{
+    if (tier != RawTier) return tick * kTiers[tier].bucketMs;
+    int64_t index = tick - m_firstScanSeq;
+    if (index < 0 || index >= static_cast<int64_t>(m_scanTimes.size())) return 0;
+    return m_scanTimes[index];
+}
+
+void HistoryStore::appendPoint(Series &series, int tier, int64_t tick, long value)
+{
+    std::vector<HistoryBlock> &blocks = series.blocks[tier];
+    if (blocks.empty() || blocks.back().count() >= kTiers[tier].blockPoints) {
+        if (!blocks.empty()) {
+            m_bytes -= blocks.back().bytes();
+            blocks.back().seal();
+            m_bytes += blocks.back().bytes();
+        }
+        blocks.emplace_back();
+        m_bytes += blocks.back().bytes();
+    }
+    HistoryBlock &block = blocks.back();
+    m_bytes -= block.bytes();
+    block.append(tick, value);
+    m_bytes += block.bytes();
+}
+
+void HistoryStore::flushBuckets(Series &series)
+{
+    for (int tier = MinuteTier; tier < TierCount; ++tier) {
+        if (series.bucketCount[tier] > 0) {
+            appendPoint(series, tier, series.bucket[tier],
+                        static_cast<long>(series.bucketSum[tier] / series.bucketCount[tier]));
+        }
+        series.bucket[tier] = -1;
+        series.bucketSum[tier] = 0;
+        series.bucketCount[tier] = 0;
+    }
+}
+
+void HistoryStore::append(int64_t timeMs, const std::vector<ProcSample> &samples)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_scanSeq;
+    if (m_scanTimes.empty()) m_firstScanSeq = m_scanSeq;
+    m_scanTimes.push_back(timeMs);
+
+    for (const ProcSample &sample : samples) {
+        std::unique_ptr<Series> &slot = m_series[sample.pid];
+        if (slot && slot->startTime != sample.startTime) {
+            // The PID was reused; the previous process's history goes.
+            for (const auto &blocks : slot->blocks) {
+                for (const HistoryBlock &block : blocks) m_bytes -= block.bytes();
+            }
+            slot.reset();
+            m_bytes -= sizeof(Series) + kSeriesOverhead;
+        }
+        if (!slot) {
+            slot.reset(new Series());
+            slot->pid = sample.pid;
+            slot->startTime = sample.startTime;
+            m_bytes += sizeof(Series) + kSeriesOverhead;
+        }
+
+        Series &series = *slot;
+        series.live = true;
+        series.lastSeq = m_scanSeq;
+        series.lastValue = sample.rssKb;
+        appendPoint(series, RawTier, m_scanSeq, sample.rssKb);
+        for (int tier = MinuteTier; tier < TierCount; ++tier) {
+            int64_t bucket = timeMs / kTiers[tier].bucketMs;
+            if (series.bucket[tier] != bucket) {
+                if (series.bucketCount[tier] > 0) {
+                    appendPoint(series, tier, series.bucket[tier],
+                                static_cast<long>(series.bucketSum[tier] / series.bucketCount[tier]));
+                }
+                series.bucket[tier] = bucket;
+                series.bucketSum[tier] = 0;
+                series.bucketCount[tier] = 0;
+            }
+            series.bucketSum[tier] += sample.rssKb;
+            ++series.bucketCount[tier];
+        }
+    }
+
+    for (auto &entry : m_series) {
+        Series &series = *entry.second;
+        if (series.live && series.lastSeq != m_scanSeq) {
+            series.live = false;
+            flushBuckets(series);
+        }
+    }
+
+    expire(timeMs);
+    enforceBudget();
+}
+
+void HistoryStore::dropFrontBlock(Series &series, int tier)
+{
+    std::vector<HistoryBlock> &blocks = series.blocks[tier];
+    m_bytes -= blocks.front().bytes();
+    blocks.erase(blocks.begin());
+}
+
+void HistoryStore::expire(int64_t nowMs)
+{
+    int64_t oldestRawTick = m_scanSeq;
+    for (auto it = m_series.begin(); it != m_series.end();) {
+        Series &series = *it->second;
+        for (int tier = RawTier; tier < TierCount; ++tier) {
+            const std::vector<HistoryBlock> &blocks = series.blocks[tier];
+            while (!blocks.empty() && tickTime(tier, blocks.front().lastTick()) < nowMs - kTiers[tier].retentionMs) {
+                dropFrontBlock(series, tier);
+            }
+        }
+        if (!series.live && series.empty()) {
+            m_bytes -= sizeof(Series) + kSeriesOverhead;
+            it = m_series.erase(it);
+            continue;
+        }
+        if (!series.blocks[RawTier].empty()) {
+            oldestRawTick = std::min(oldestRawTick, series.blocks[RawTier].front().firstTick());
+        }
+        ++it;
+    }
+
+    // Scan times before the oldest raw block are no longer needed.
+    int64_t unused = oldestRawTick - m_firstScanSeq;
+    if (unused > 0) {
+        m_scanTimes.erase(m_scanTimes.begin(), m_scanTimes.begin() + unused);
+        m_firstScanSeq = oldestRawTick;
+    }
+}
+
+void HistoryStore::enforceBudget()
+{
+    if (m_bytes <= m_budget) return;
+
+    // Oldest front block first, exited processes before live ones
+    struct Candidate {
+        bool live;
+        int64_t lastMs;
+        Series *series;
+        bool operator>(const Candidate &other) const
+        {
+            if (live != other.live) return live;
+            return lastMs > other.lastMs;
+        }
+    };
+    std::vector<Candidate> heap;
+    for (int tier = RawTier; tier < TierCount && m_bytes > m_budget; ++tier) {
+        heap.clear();
+        for (auto &entry : m_series) {
+            Series *series = entry.second.get();
+            const std::vector<HistoryBlock> &blocks = series->blocks[tier];
+            if (!blocks.empty()) heap.push_back({series->live, tickTime(tier, blocks.front().lastTick()), series});
+        }
+        std::make_heap(heap.begin(), heap.end(), std::greater<Candidate>());
+        while (m_bytes > m_budget && !heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<Candidate>());
+            Candidate candidate = heap.back();
+            heap.pop_back();
+            dropFrontBlock(*candidate.series, tier);
+            ++m_evictedBlocks;
+            const std::vector<HistoryBlock> &blocks = candidate.series->blocks[tier];
+            if (!blocks.empty()) {
+                candidate.lastMs = tickTime(tier, blocks.front().lastTick());
+                heap.push_back(candidate);
+                std::push_heap(heap.begin(), heap.end(), std::greater<Candidate>());
+            }
+        }
+    }
+
+    for (auto it = m_series.begin(); it != m_series.end();) {
+        if (!it->second->live && it->second->empty()) {
+            m_bytes -= sizeof(Series) + kSeriesOverhead;
+            it = m_series.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void HistoryStore::collect(const Series &series, int tier, int64_t fromMs, int64_t toMs,
+                           std::vector<HistoryPoint> &out) const
+{
+    for (const HistoryBlock &block : series.blocks[tier]) {
+        if (tickTime(tier, block.lastTick()) < fromMs) continue;
+        if (tickTime(tier, block.firstTick()) > toMs) break;
+        HistoryBlock::Cursor cursor(block);
+        int64_t tick;
+        long value;
+        while (cursor.next(tick, value)) {
+            int64_t timeMs = tickTime(tier, tick);
+            if (timeMs > toMs) break;
+            if (timeMs >= fromMs) out.push_back({timeMs, value});
+        }
+    }
+}
+
+std::vector<HistoryPoint> HistoryStore::query(pid_t pid, int64_t fromMs, int64_t toMs) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_series.find(pid);
+    if (it == m_series.end()) return std::vector<HistoryPoint>();
+    const Series &series = *it->second;
+
+    // Finest tier first; each coarser one only fills in before it.
+    std::vector<HistoryPoint> parts[TierCount];
+    int64_t endMs = toMs;
+    for (int tier = RawTier; tier < TierCount; ++tier) {
+        collect(series, tier, fromMs, endMs, parts[tier]);
+        if (!parts[tier].empty()) endMs = parts[tier].front().timeMs - 1;
+        const std::vector<HistoryBlock> &blocks = series.blocks[tier];
+        if (!blocks.empty() && tickTime(tier, blocks.front().firstTick()) <= fromMs) break;
+    }
+
+    std::vector<HistoryPoint> points;
+    for (int tier = TierCount - 1; tier >= RawTier; --tier) {
+        points.insert(points.end(), parts[tier].begin(), parts[tier].end());
+    }
+    return points;
+}
+
+bool HistoryStore::valueAt(const Series &series, int64_t timeMs, HistoryPoint &point) const
+{
+    int earliestTier = -1;
+    int64_t earliestMs = 0;
+    for (int tier = RawTier; tier < TierCount; ++tier) {
+        const std::vector<HistoryBlock> &blocks = series.blocks[tier];
+        if (blocks.empty()) continue;
+        int64_t firstMs = tickTime(tier, blocks.front().firstTick());
+        if (firstMs <= timeMs) {
+            for (const HistoryBlock &block : blocks) {
+                if (tickTime(tier, block.lastTick()) < timeMs) continue;
+                HistoryBlock::Cursor cursor(block);
+                int64_t tick;
+                long value;
+                while (cursor.next(tick, value)) {
+                    if (tickTime(tier, tick) >= timeMs) {
+                        point = {tickTime(tier, tick), value};
+                        return true;
+                    }
+                }
+            }
+            continue;
+        }
+        if (earliestTier < 0 || firstMs < earliestMs) {
+            earliestTier = tier;
+            earliestMs = firstMs;
+        }
+    }
+    if (earliestTier < 0) return false;
+
+    // Younger than the window: measure from the first sample.
+    HistoryBlock::Cursor cursor(series.blocks[earliestTier].front());
+    int64_t tick;
+    long value;
+    if (!cursor.next(tick, value)) return false;
+    point = {earliestMs, value};
+    return true;
+}
+
+std::vector<HistoryStore::Growth> HistoryStore::topGrowers(int64_t windowMs, size_t count) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<Growth> growth;
+    if (m_scanTimes.empty()) return growth;
+    int64_t fromMs = m_scanTimes.back() - windowMs;
+
+    std::vector<Growth> candidates;
+    TopK<long, size_t> ranking(count);
+    for (const auto &entry : m_series) {
+        const Series &series = *entry.second;
+        HistoryPoint start;
+        if (!series.live || !valueAt(series, fromMs, start)) continue;
+        long grown = series.lastValue - start.value;
+        if (grown <= 0) continue;
+        candidates.push_back({series.pid, start.value, series.lastValue, start.timeMs});
+        ranking.push(grown, candidates.size() - 1);
+    }
+    for (const auto &ranked : ranking.takeSorted()) growth.push_back(candidates[ranked.id]);
+    return growth;
+}
+
+HistoryStore::Stats HistoryStore::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats;
+    stats.series = m_series.size();
+    for (const auto &entry : m_series) {
+        const Series &series = *entry.second;
+        if (series.live) ++stats.liveSeries;
+        for (int tier = RawTier; tier < TierCount; ++tier) {
+            for (const HistoryBlock &block : series.blocks[tier]) stats.points[tier] += block.count();
+        }
+    }
+    stats.bytes = m_bytes;
+    stats.budget = m_budget;
+    stats.evictedBlocks = m_evictedBlocks;
+    return stats;
+}
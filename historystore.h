@@ -0,0 +1,138 @@
+#ifndef HISTORYSTORE_H
+#define HISTORYSTORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+#include "procscanner.h"
+
+struct HistoryPoint {
+    int64_t timeMs;
+    long value;
+};
+
+// A run of (tick, value) pairs compressed as in Facebook's Gorilla: ticks
+// are stored as delta-of-delta (one bit for a regular interval) and values
+// as the XOR with their predecessor (one bit when unchanged, otherwise only
+// the bits that differ).
+class HistoryBlock
+{
+public:
+    void append(int64_t tick, long value);
+    void seal() { m_words.shrink_to_fit(); }
+
+    uint32_t count() const { return m_count; }
+    int64_t firstTick() const { return m_firstTick; }
+    int64_t lastTick() const { return m_lastTick; }
+    size_t bytes() const { return sizeof(HistoryBlock) + m_words.capacity() * sizeof(uint64_t); }
+
+    class Cursor
+    {
+    public:
+        explicit Cursor(const HistoryBlock &block) : m_block(block) {}
+        bool next(int64_t &tick, long &value);
+
+    private:
+        uint64_t readBits(int bits);
+        const HistoryBlock &m_block;
+        size_t m_pos = 0;
+        uint32_t m_index = 0;
+        int64_t m_tick = 0;
+        int64_t m_delta = 0;
+        uint64_t m_value = 0;
+        int m_lead = 0;
+        int m_trail = 0;
+    };
+
+private:
+    void writeBits(uint64_t value, int bits);
+
+    std::vector<uint64_t> m_words;
+    size_t m_bits = 0;
+    uint32_t m_count = 0;
+    int64_t m_firstTick = 0;
+    int64_t m_lastTick = 0;
+    int64_t m_lastDelta = 0;
+    uint64_t m_lastValue = 0;
+    int m_lead = -1; // XOR window of the previous value, -1 until one exists
+    int m_trail = 0;
+};
+
+// Per-process RSS history in three tiers: every scan for the last hour,
+// one-minute means for a day and 15-minute means for a week. Each series
+// is a column of compressed blocks per tier; raw ticks are scan sequence
+// numbers, resolved through one shared table of scan times, so a process
+// sampled every scan pays about a bit per timestamp.
+//
+// Blocks past their tier's retention are dropped after every scan. When the
+// store is still over its byte budget, the oldest blocks go first, those of
+// exited processes before those of live ones.
+//
+// All methods are thread-safe: the worker appends while the GUI queries.
+class HistoryStore
+{
+public:
+    enum Tier { RawTier, MinuteTier, QuarterTier, TierCount };
+
+    struct Growth {
+        pid_t pid;
+        long fromValue;
+        long toValue;
+        int64_t fromMs;
+    };
+
+    struct Stats {
+        size_t series = 0;
+        size_t liveSeries = 0;
+        size_t points[TierCount] = {};
+        size_t bytes = 0;
+        size_t budget = 0;
+        size_t evictedBlocks = 0;
+    };
+
+    explicit HistoryStore(size_t budgetBytes = 64 * 1024 * 1024);
+    ~HistoryStore();
+
+    void setBudget(size_t bytes);
+
+    // Records one scan. Processes missing from it are considered exited.
+    void append(int64_t timeMs, const std::vector<ProcSample> &samples);
+
+    // The latest process with this PID, oldest point first. Older parts of
+    // the window come from coarser tiers once the finer ones have expired.
+    std::vector<HistoryPoint> query(pid_t pid, int64_t fromMs, int64_t toMs) const;
+    // Live processes whose RSS grew the most since windowMs ago (or since
+    // they started, if later), largest growth first.
+    std::vector<Growth> topGrowers(int64_t windowMs, size_t count) const;
+
+    Stats stats() const;
+
+private:
+    struct Series;
+
+    int64_t tickTime(int tier, int64_t tick) const;
+    void appendPoint(Series &series, int tier, int64_t tick, long value);
+    void flushBuckets(Series &series);
+    void collect(const Series &series, int tier, int64_t fromMs, int64_t toMs,
+                 std::vector<HistoryPoint> &out) const;
+    bool valueAt(const Series &series, int64_t timeMs, HistoryPoint &point) const;
+    void dropFrontBlock(Series &series, int tier);
+    void expire(int64_t nowMs);
+    void enforceBudget();
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<pid_t, std::unique_ptr<Series>> m_series;
+    // Time of every scan still referenced by a raw block, by sequence number
+    std::vector<int64_t> m_scanTimes;
+    int64_t m_firstScanSeq = 0;
+    int64_t m_scanSeq = -1;
+    size_t m_bytes = 0;
+    size_t m_budget;
+    size_t m_evictedBlocks = 0;
+};
+
+#endif // HISTORYSTORE_H
@@ -1,9 +1,33 @@
 #include "mainwindow.h"
+#include "headlesscollector.h"
+#include "procfdcache.h"
 
 #include <QApplication>
+#include <QtGlobal>
+#include <cstring>
+
+namespace {
+
+// Room for the default /proc descriptor cache (16384), which takes at most
+// half of the limit.
+const long kWantedFileLimit = 2 * 16384;
+
+} // namespace
 
 int main(int argc, char *argv[])
 {
+    // Once, before anything else holds descriptors, and said out loud since
+    // it applies to the whole process.
+    long before, after;
+    ProcFdCache::raiseFileLimit(kWantedFileLimit, &before, &after);
+    if (after != before) qInfo("Open file limit raised from %ld to %ld for the /proc descriptor cache", before, after);
+
+    // Checked before any application object exists, since QApplication
+    // needs a display.
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--headless") == 0) return HeadlessCollector::run(argc, argv);
+    }
+
     QApplication a(argc, argv);
     MainWindow w;
     w.show();
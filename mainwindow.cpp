@@ -1,6 +1,8 @@
 // mainwindow.cpp
 #include "mainwindow.h"
 #include "processworker.h"
+#include "allocationcounter.h"
+#include "alertengine.h"
 
 #include <QApplication>
 #include <QIcon>
@@ -10,10 +12,101 @@
 #include <QGroupBox>
 #include <QHeaderView>
 #include <QMessageBox>
+#include <QStatusBar>
 #include <QFileDialog>
 #include <QDebug>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+bool byMemoryDesc(const ProcessInfo &a, const ProcessInfo &b)
+{
+    return a.memory > b.memory;
+}
+
+bool byGrowthDesc(const ProcessInfo &a, const ProcessInfo &b)
+{
+    return a.growth > b.growth;
+}
+
+bool byPssDesc(const ProcessInfo &a, const ProcessInfo &b)
+{
+    return a.pss > b.pss;
+}
+
+bool bySwapDesc(const ProcessInfo &a, const ProcessInfo &b)
+{
+    return a.swap > b.swap;
+}
+
+// The model keeps processes in arrival order; reports list the biggest first.
+QVector<ProcessInfo> sortedByMemory(const QVector<ProcessInfo> &processes)
+{
+    QVector<ProcessInfo> sorted = processes;
+    std::sort(sorted.begin(), sorted.end(), byMemoryDesc);
+    return sorted;
+}
+
+// Rows of the memory breakdown: a meminfo field, optionally minus another
+struct BreakdownRow {
+    const char *label;
+    MemInfo::Field field;
+    MemInfo::Field minus;
+};
+
+const BreakdownRow kBreakdownRows[] = {
+    {"Used", MemInfo::MemTotal, MemInfo::MemAvailable},
+    {"Free", MemInfo::MemFree, MemInfo::FieldCount},
+    {"Available", MemInfo::MemAvailable, MemInfo::FieldCount},
+    {"Page cache", MemInfo::Cached, MemInfo::FieldCount},
+    {"Buffers", MemInfo::Buffers, MemInfo::FieldCount},
+    {"Shared (tmpfs, shm)", MemInfo::Shmem, MemInfo::FieldCount},
+    {"Anonymous", MemInfo::AnonPages, MemInfo::FieldCount},
+    {"Mapped files", MemInfo::Mapped, MemInfo::FieldCount},
+    {"Dirty", MemInfo::Dirty, MemInfo::FieldCount},
+    {"Writeback", MemInfo::Writeback, MemInfo::FieldCount},
+    {"Slab (reclaimable)", MemInfo::SReclaimable, MemInfo::FieldCount},
+    {"Slab (unreclaimable)", MemInfo::SUnreclaim, MemInfo::FieldCount},
+    {"Kernel stacks", MemInfo::KernelStack, MemInfo::FieldCount},
+    {"Page tables", MemInfo::PageTables, MemInfo::FieldCount},
+    {"Unevictable", MemInfo::Unevictable, MemInfo::FieldCount},
+    {"Swap used", MemInfo::SwapTotal, MemInfo::SwapFree},
+    {"Swap cached", MemInfo::SwapCached, MemInfo::FieldCount},
+    {"Committed", MemInfo::CommittedAS, MemInfo::FieldCount},
+    {"Commit limit", MemInfo::CommitLimit, MemInfo::FieldCount},
+    {"Huge pages (hugetlbfs)", MemInfo::Hugetlb, MemInfo::FieldCount},
+    {"Transparent huge pages", MemInfo::AnonHugePages, MemInfo::FieldCount},
+};
+
+const int kBreakdownRowCount = static_cast<int>(sizeof(kBreakdownRows) / sizeof(kBreakdownRows[0]));
+
+// Alerts kept in the list on the alert page, newest first
+const int kMaxAlertItems = 500;
+
+// How long the newest alert stays in the status bar
+const int kAlertMessageMs = 15000;
+
+// How far back each change column looks
+const qint64 kBreakdownAgesMs[] = {60 * 1000, 10 * 60 * 1000, 60 * 60 * 1000};
+
+long breakdownValue(const MemInfo &info, const BreakdownRow &row)
+{
+    long value = info[row.field];
+    if (value < 0 || row.minus == MemInfo::FieldCount) return value;
+    long minus = info[row.minus];
+    return minus < 0 ? -1 : value - minus;
+}
+
+QString formatChange(long kilobytes)
+{
+    if (kilobytes == 0) return QString("0");
+    return (kilobytes > 0 ? "+" : "-") + ProcessTableModel::formatMemory(std::labs(kilobytes));
+}
+
+} // namespace
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -44,6 +137,9 @@ MainWindow::MainWindow(QWidget *parent)
     m_sidebar->addItem(new QListWidgetItem(QIcon(":/save.svg"), "Save Report"));
     m_sidebar->addItem(new QListWidgetItem(QIcon(":/search.svg"), "Top N Processes"));
     m_sidebar->addItem(new QListWidgetItem(QIcon(":/save.svg"), "Track Memory Usage"));
+    m_sidebar->addItem(new QListWidgetItem(QIcon(":/monitor.svg"), "Scanner Settings"));
+    m_sidebar->addItem(new QListWidgetItem(QIcon(":/monitor.svg"), "Diagnostics"));
+    m_sidebar->addItem(new QListWidgetItem(QIcon(":/cpu.svg"), "Cgroups"));
     m_sidebar->setCurrentRow(0);
 
     // --- Create and add ALL feature pages to the StackedWidget ---
@@ -54,30 +150,48 @@ MainWindow::MainWindow(QWidget *parent)
     m_mainStack->addWidget(createSaveReportPage());
     m_mainStack->addWidget(createTopNPage());
     m_mainStack->addWidget(createTrackMemoryPage());
+    m_mainStack->addWidget(createScannerSettingsPage());
+    m_mainStack->addWidget(createDiagnosticsPage());
+    m_mainStack->addWidget(createCgroupPage());
 
     // --- Connect Signals and Slots ---
     connect(m_sidebar, &QListWidget::currentRowChanged, m_mainStack, &QStackedWidget::setCurrentIndex);
+    connect(m_mainStack, &QStackedWidget::currentChanged, this, &MainWindow::onPageChanged);
     connect(m_pidGetInfoButton, &QPushButton::clicked, this, &MainWindow::onGetInfoButtonClicked);
     connect(m_pidCompareButton, &QPushButton::clicked, this, &MainWindow::onCompareButtonClicked);
+    connect(m_showHistoryButton, &QPushButton::clicked, this, &MainWindow::onShowHistoryClicked);
+    connect(m_topGrowersButton, &QPushButton::clicked, this, &MainWindow::onTopGrowersClicked);
     connect(m_setAlertButton, &QPushButton::clicked, this, &MainWindow::onSetAlertButtonClicked);
     connect(m_saveReportButton, &QPushButton::clicked, this, &MainWindow::onSaveReportButtonClicked);
+    connect(m_saveSnapshotButton, &QPushButton::clicked, this, &MainWindow::onSaveSnapshotClicked);
+    connect(m_loadRecordingButton, &QPushButton::clicked, this, &MainWindow::onLoadRecordingClicked);
+    connect(m_stopReplayButton, &QPushButton::clicked, this, &MainWindow::onStopReplayClicked);
     connect(m_searchLineEdit, &QLineEdit::textChanged, this, &MainWindow::onSearchTextChanged);
+    connect(m_processViewComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::onProcessViewChanged);
     connect(m_topNButton, &QPushButton::clicked, this, &MainWindow::onGetTopNClicked);
     connect(m_startLoggingButton, &QPushButton::clicked, this, &MainWindow::onStartLoggingClicked);
+    connect(m_stopLoggingButton, &QPushButton::clicked, this, &MainWindow::onStopLoggingClicked);
+    connect(m_applyScannerSettingsButton, &QPushButton::clicked, this, &MainWindow::onApplyScannerSettingsClicked);
+    connect(m_resetDiagnosticsButton, &QPushButton::clicked, this, &MainWindow::onResetDiagnosticsClicked);
+    connect(m_saveDiagnosticsButton, &QPushButton::clicked, this, &MainWindow::onSaveDiagnosticsClicked);
 
     // --- Register Custom Type and Start Worker Thread ---
-    qRegisterMetaType<AppData>("AppData");
+    qRegisterMetaType<StaticInfo>("StaticInfo");
+    qRegisterMetaType<ScanDelta>("ScanDelta");
     workerThread = new QThread();
     worker = new ProcessWorker();
     worker->moveToThread(workerThread);
     connect(workerThread, &QThread::started, worker, &ProcessWorker::startWork);
-    connect(worker, &ProcessWorker::resultReady, this, &MainWindow::handleResults);
-    connect(worker, &ProcessWorker::thresholdExceeded, this, &MainWindow::handleThresholdAlert);
+    connect(worker, &ProcessWorker::staticInfoReady, this, &MainWindow::handleStaticInfo);
+    connect(worker, &ProcessWorker::scanDelta, this, &MainWindow::handleScanDelta);
+    connect(worker, &ProcessWorker::alertsPending, this, &MainWindow::handleAlerts);
+    connect(m_topNSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), worker, &ProcessWorker::setRankingSize);
+    worker->setRankingSize(m_topNSpinBox->value());
     workerThread->start();
 
-    m_loggingTimer = new QTimer(this);
-    connect(m_loggingTimer, &QTimer::timeout, this, &MainWindow::performLog);
-    m_logContent = "";
+    m_replayer = new SnapshotReplayer(this);
+    connect(m_replayer, &SnapshotReplayer::scanDelta, this, &MainWindow::handleReplayDelta);
+    connect(m_replayer, &SnapshotReplayer::finished, this, &MainWindow::handleReplayFinished);
 }
 
 MainWindow::~MainWindow()
@@ -86,7 +200,7 @@ MainWindow::~MainWindow()
     workerThread->wait();
     delete worker;
     delete workerThread;
-    m_loggingTimer->stop();
+    m_recorder.stop();
 }
 
 QWidget* MainWindow::createSystemOverviewPage()
@@ -119,6 +233,23 @@ QWidget* MainWindow::createSystemOverviewPage()
     memLayout->addRow("Type:", m_memoryTypeLabel);
     memLayout->addRow("Speed:", m_memorySpeedLabel);
     memLayout->addRow("Slots:", m_memorySlotsLabel);
+    QGroupBox* breakdownGroup = new QGroupBox("Memory Breakdown");
+    QVBoxLayout* breakdownLayout = new QVBoxLayout(breakdownGroup);
+    m_memoryBreakdownTable = new QTableWidget(kBreakdownRowCount, 4);
+    m_memoryBreakdownTable->setHorizontalHeaderLabels({"Now", "Change (1 min)", "Change (10 min)", "Change (1 h)"});
+    QStringList rowLabels;
+    for (const BreakdownRow &row : kBreakdownRows) rowLabels << row.label;
+    m_memoryBreakdownTable->setVerticalHeaderLabels(rowLabels);
+    m_memoryBreakdownTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    m_memoryBreakdownTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    for (int row = 0; row < kBreakdownRowCount; ++row) {
+        for (int column = 0; column < 4; ++column) {
+            QTableWidgetItem* item = new QTableWidgetItem();
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            m_memoryBreakdownTable->setItem(row, column, item);
+        }
+    }
+    breakdownLayout->addWidget(m_memoryBreakdownTable);
     QGroupBox* graphicsGroup = new QGroupBox("Graphics Controllers");
     QVBoxLayout* graphicsLayout = new QVBoxLayout(graphicsGroup);
     m_gpuListLabel = new QLabel("retrieving...");
@@ -126,8 +257,8 @@ QWidget* MainWindow::createSystemOverviewPage()
     graphicsLayout->addWidget(m_gpuListLabel);
     pageLayout->addWidget(cpuGroup);
     pageLayout->addWidget(memGroup);
+    pageLayout->addWidget(breakdownGroup, 1);
     pageLayout->addWidget(graphicsGroup);
-    pageLayout->addStretch();
     return page;
 }
 
@@ -135,18 +266,62 @@ QWidget* MainWindow::createRealTimeMonitorPage()
 {
     QWidget* page = new QWidget();
     QVBoxLayout* layout = new QVBoxLayout(page);
+    QHBoxLayout* viewLayout = new QHBoxLayout();
+    viewLayout->addWidget(new QLabel("View:"));
+    m_processViewComboBox = new QComboBox();
+    m_processViewComboBox->addItems({"Flat list", "Process tree", "Group by name", "Group by user", "Group by command"});
+    m_processViewComboBox->setToolTip("The tree and groups show the memory of everything below each row.\n"
+                                      "Grouping by command reads each process's command line once.");
+    viewLayout->addWidget(m_processViewComboBox);
+    viewLayout->addStretch();
+    layout->addLayout(viewLayout);
     m_searchLineEdit = new QLineEdit();
     m_searchLineEdit->setPlaceholderText("Filter by process name...");
+    m_searchLineEdit->setToolTip("Terms are combined: name text, re:<regex> or /regex/, pid:1234 or pid:100-200,\n"
+                                 "mem>500M, mem<=2G (also >=, <, =; K/M/G suffixes, plain numbers in KB)");
     m_searchLineEdit->setClearButtonEnabled(true);
     layout->addWidget(m_searchLineEdit);
-    m_processTableWidget = new QTableWidget();
-    layout->addWidget(m_processTableWidget);
-    m_processTableWidget->setColumnCount(3);
-    m_processTableWidget->setHorizontalHeaderLabels({"Process Name", "PID", "Memory Usage"});
-    m_processTableWidget->horizontalHeader()->setStretchLastSection(true);
-    m_processTableWidget->setEditTriggers(QAbstractItemView::NoEditTriggers);
-    m_processTableWidget->setAlternatingRowColors(true);
-    m_processTableWidget->setSortingEnabled(true);
+    m_searchStatusLabel = new QLabel();
+    m_searchStatusLabel->setVisible(false);
+    layout->addWidget(m_searchStatusLabel);
+    m_searchDebounceTimer = new QTimer(this);
+    m_searchDebounceTimer->setSingleShot(true);
+    m_searchDebounceTimer->setInterval(200);
+    connect(m_searchDebounceTimer, &QTimer::timeout, this, &MainWindow::applySearchFilter);
+    m_processModel = new ProcessTableModel(this);
+    m_processProxy = new ProcessFilterProxy(this);
+    m_processProxy->setProcessModel(m_processModel);
+    m_processProxy->setSortRole(ProcessTableModel::SortRole);
+    m_processProxy->setSortCaseSensitivity(Qt::CaseInsensitive);
+    m_processProxy->setDynamicSortFilter(true);
+    m_processViewStack = new QStackedWidget();
+    layout->addWidget(m_processViewStack);
+    m_processTableView = new QTableView();
+    m_processViewStack->addWidget(m_processTableView);
+    m_processTableView->setModel(m_processProxy);
+    m_processTableView->horizontalHeader()->setStretchLastSection(true);
+    m_processTableView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_processTableView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_processTableView->setAlternatingRowColors(true);
+    m_processTableView->setSortingEnabled(true);
+    m_processTableView->sortByColumn(ProcessTableModel::MemoryColumn, Qt::DescendingOrder);
+    // The proxy only sorts the children of branches the view has asked
+    // for, i.e. expanded ones, so a large tree costs what is open.
+    m_processTreeModel = new ProcessTreeModel(this);
+    m_processTreeProxy = new QSortFilterProxyModel(this);
+    m_processTreeProxy->setSourceModel(m_processTreeModel);
+    m_processTreeProxy->setSortRole(ProcessTreeModel::SortRole);
+    m_processTreeProxy->setSortCaseSensitivity(Qt::CaseInsensitive);
+    m_processTreeProxy->setDynamicSortFilter(true);
+    m_processTreeView = new QTreeView();
+    m_processViewStack->addWidget(m_processTreeView);
+    m_processTreeView->setModel(m_processTreeProxy);
+    m_processTreeView->setUniformRowHeights(true);
+    m_processTreeView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_processTreeView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_processTreeView->setAlternatingRowColors(true);
+    m_processTreeView->setSortingEnabled(true);
+    m_processTreeView->sortByColumn(ProcessTreeModel::MemoryColumn, Qt::DescendingOrder);
     return page;
 }
 
@@ -174,28 +349,109 @@ QWidget* MainWindow::createProcessInspectorPage()
     compareLayout->addRow("Process 2 PID:", m_pid2LineEdit);
     compareLayout->addWidget(m_pidCompareButton);
     compareLayout->addRow(m_compareResultLabel);
+
+    QGroupBox* historyGroup = new QGroupBox("Memory History");
+    QFormLayout* historyLayout = new QFormLayout(historyGroup);
+    m_historyPidLineEdit = new QLineEdit();
+    m_historyPidLineEdit->setPlaceholderText("Enter PID");
+    m_historyWindowComboBox = new QComboBox();
+    m_historyWindowComboBox->addItem("Last 10 minutes", qlonglong(10) * 60 * 1000);
+    m_historyWindowComboBox->addItem("Last hour", qlonglong(60) * 60 * 1000);
+    m_historyWindowComboBox->addItem("Last 6 hours", qlonglong(6) * 60 * 60 * 1000);
+    m_historyWindowComboBox->addItem("Last 24 hours", qlonglong(24) * 60 * 60 * 1000);
+    m_historyWindowComboBox->addItem("Last 7 days", qlonglong(7) * 24 * 60 * 60 * 1000);
+    m_showHistoryButton = new QPushButton("Show History");
+    m_topGrowersButton = new QPushButton("Top Growers");
+    QHBoxLayout* historyButtons = new QHBoxLayout();
+    historyButtons->addWidget(m_showHistoryButton);
+    historyButtons->addWidget(m_topGrowersButton);
+    m_historyResultLabel = new QLabel("History is kept for every process while the monitor runs.");
+    m_historyResultLabel->setWordWrap(true);
+    m_historyTable = new QTableWidget(0, 2);
+    m_historyTable->setHorizontalHeaderLabels({"Time", "Memory Usage"});
+    m_historyTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    m_historyTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    historyLayout->addRow("PID:", m_historyPidLineEdit);
+    historyLayout->addRow("Window:", m_historyWindowComboBox);
+    historyLayout->addRow(historyButtons);
+    historyLayout->addRow(m_historyResultLabel);
+    historyLayout->addRow(m_historyTable);
     mainVLayout->addWidget(infoGroup);
     mainVLayout->addWidget(compareGroup);
-    mainVLayout->addStretch();
+    mainVLayout->addWidget(historyGroup);
     return page;
 }
 
 QWidget* MainWindow::createThresholdAlertPage()
 {
     QWidget* page = new QWidget();
+    m_alertPage = page;
     QVBoxLayout* layout = new QVBoxLayout(page);
     QFormLayout* form = new QFormLayout();
     m_thresholdSpinBox = new QSpinBox();
     m_thresholdSpinBox->setRange(0, 100);
     m_thresholdSpinBox->setValue(80);
     m_thresholdSpinBox->setSuffix("%");
+    m_thresholdSpinBox->setSpecialValueText("Off");
     form->addRow("Memory Usage Threshold:", m_thresholdSpinBox);
+    m_alertRulesEdit = new QPlainTextEdit();
+    m_alertRulesEdit->setPlaceholderText("One rule per line, e.g.\n"
+                                         "name=chrome* memory > 2GB\n"
+                                         "pid=1234 memory/min > 50MB for 1m\n"
+                                         "cgroup=/system.slice/* memory% >= 95 clear 90\n"
+                                         "system available < 1GB for 30s");
+    m_alertRulesEdit->setToolTip("<scope> <metric> <op> <threshold> [for <duration>] [clear <level>]\n\n"
+                                 "scope: system, pid=<pid>, name=<glob> or cgroup=<glob>\n"
+                                 "metric: memory, swap or available (system only); memory% is a share of "
+                                 "all memory (a cgroup's limit), memory/min the change per minute\n"
+                                 "for: how long the condition has to hold before it alerts\n"
+                                 "clear: how far back the value has to go before it alerts again");
+    m_alertRulesEdit->setMaximumHeight(110);
+    form->addRow("Alert Rules:", m_alertRulesEdit);
+    m_stallSpinBox = new QSpinBox();
+    m_stallSpinBox->setRange(0, 1000);
+    m_stallSpinBox->setValue(150);
+    m_stallSpinBox->setSuffix(" ms per second");
+    m_stallSpinBox->setSpecialValueText("Off");
+    m_stallSpinBox->setToolTip("Alert within milliseconds when processes wait this long for memory "
+                               "(Linux pressure stall information). Without PSI, memory usage is "
+                               "checked against the threshold ten times a second instead.");
+    form->addRow("Memory Stall Alert:", m_stallSpinBox);
+    m_pressureCgroupsLineEdit = new QLineEdit();
+    m_pressureCgroupsLineEdit->setPlaceholderText("e.g. system.slice, user.slice (optional)");
+    form->addRow("Also Watch Cgroups:", m_pressureCgroupsLineEdit);
+    m_leakHorizonSpinBox = new QSpinBox();
+    m_leakHorizonSpinBox->setRange(0, 24 * 60);
+    m_leakHorizonSpinBox->setValue(0);
+    m_leakHorizonSpinBox->setSuffix(" min");
+    m_leakHorizonSpinBox->setSpecialValueText("Off");
+    m_leakHorizonSpinBox->setToolTip("Alert when a process has grown steadily enough that it is projected "
+                                     "to reach the limit below within this many minutes.");
+    form->addRow("Leak Alert Horizon:", m_leakHorizonSpinBox);
+    m_leakLimitSpinBox = new QSpinBox();
+    m_leakLimitSpinBox->setRange(0, 16 * 1024 * 1024);
+    m_leakLimitSpinBox->setValue(0);
+    m_leakLimitSpinBox->setSuffix(" MB");
+    m_leakLimitSpinBox->setSpecialValueText("All available memory");
+    form->addRow("Leak Alert Limit:", m_leakLimitSpinBox);
     layout->addLayout(form);
     m_setAlertButton = new QPushButton("Set Alert");
     layout->addWidget(m_setAlertButton);
     m_alertStatusLabel = new QLabel("No threshold set.");
     layout->addWidget(m_alertStatusLabel);
-    layout->addStretch();
+    m_alertRulesStatusLabel = new QLabel();
+    layout->addWidget(m_alertRulesStatusLabel);
+    m_pressureStatusLabel = new QLabel();
+    layout->addWidget(m_pressureStatusLabel);
+
+    QGroupBox* recentGroup = new QGroupBox("Recent Alerts");
+    QVBoxLayout* recentLayout = new QVBoxLayout(recentGroup);
+    m_alertList = new QListWidget();
+    recentLayout->addWidget(m_alertList);
+    QPushButton* clearAlertsButton = new QPushButton("Clear");
+    connect(clearAlertsButton, &QPushButton::clicked, m_alertList, &QListWidget::clear);
+    recentLayout->addWidget(clearAlertsButton, 0, Qt::AlignRight);
+    layout->addWidget(recentGroup, 1);
 
     return page;
 }
@@ -206,8 +462,28 @@ QWidget* MainWindow::createSaveReportPage()
     QVBoxLayout* layout = new QVBoxLayout(page);
     m_saveReportButton = new QPushButton("Save Current Report");
     layout->addWidget(m_saveReportButton);
+    m_saveSnapshotButton = new QPushButton("Save Snapshot");
+    m_saveSnapshotButton->setToolTip("Save the process list in the binary snapshot format, which can be replayed below.");
+    layout->addWidget(m_saveSnapshotButton);
     m_reportStatusLabel = new QLabel("Click to save a report.");
     layout->addWidget(m_reportStatusLabel);
+
+    QGroupBox* replayGroup = new QGroupBox("Replay a Recording");
+    QFormLayout* replayForm = new QFormLayout(replayGroup);
+    m_replaySpeedComboBox = new QComboBox();
+    m_replaySpeedComboBox->addItems({"1x (as recorded)", "Maximum speed"});
+    replayForm->addRow("Speed:", m_replaySpeedComboBox);
+    QHBoxLayout* replayButtons = new QHBoxLayout();
+    m_loadRecordingButton = new QPushButton("Load Recording...");
+    m_stopReplayButton = new QPushButton("Stop Replay");
+    m_stopReplayButton->setEnabled(false);
+    replayButtons->addWidget(m_loadRecordingButton);
+    replayButtons->addWidget(m_stopReplayButton);
+    replayForm->addRow(replayButtons);
+    m_replayStatusLabel = new QLabel("Snapshots and Track Memory recordings in snapshot format can be replayed into the process views.");
+    m_replayStatusLabel->setWordWrap(true);
+    replayForm->addRow(m_replayStatusLabel);
+    layout->addWidget(replayGroup);
     layout->addStretch();
     return page;
 }
@@ -222,20 +498,36 @@ QWidget* MainWindow::createTopNPage()
     m_topNSpinBox->setRange(1, 200);
     m_topNSpinBox->setValue(10);
     m_topNSpinBox->setPrefix("Show Top ");
+    m_topNKeyComboBox = new QComboBox();
+    m_topNKeyComboBox->addItems({"by Memory Usage", "by Growth Rate", "by PSS", "by Swap"});
     m_topNButton = new QPushButton("Get Processes");
     controlsLayout->addWidget(new QLabel("Show Top N Processes:"));
     controlsLayout->addWidget(m_topNSpinBox);
+    controlsLayout->addWidget(m_topNKeyComboBox);
     controlsLayout->addWidget(m_topNButton);
     controlsLayout->addStretch();
 
     layout->addLayout(controlsLayout);
 
-    m_topNTableWidget = new QTableWidget();
-    layout->addWidget(m_topNTableWidget);
-    m_topNTableWidget->setColumnCount(3);
-    m_topNTableWidget->setHorizontalHeaderLabels({"Process Name", "PID", "Memory Usage"});
-    m_topNTableWidget->horizontalHeader()->setStretchLastSection(true);
-    m_topNTableWidget->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_topNModel = new ProcessTableModel(this);
+    m_topNTableView = new QTableView();
+    layout->addWidget(m_topNTableView);
+    m_topNTableView->setModel(m_topNModel);
+    m_topNTableView->horizontalHeader()->setStretchLastSection(true);
+    m_topNTableView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+    QGroupBox* trendsGroup = new QGroupBox("Steadiest Growth (leak detector)");
+    QVBoxLayout* trendsLayout = new QVBoxLayout(trendsGroup);
+    m_growthTrendsTable = new QTableWidget(0, 7);
+    m_growthTrendsTable->setHorizontalHeaderLabels(
+        {"Process Name", "PID", "Memory Usage", "Trend", "Fit", "Trend Since", "Reaches Limit In"});
+    m_growthTrendsTable->horizontalHeaderItem(4)->setToolTip("How well a straight line explains the memory usage (r²); "
+                                                             "processes below 0.6 are not listed");
+    m_growthTrendsTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    m_growthTrendsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_growthTrendsTable->verticalHeader()->hide();
+    trendsLayout->addWidget(m_growthTrendsTable);
+    layout->addWidget(trendsGroup);
 
     return page;
 }
@@ -280,9 +572,35 @@ QWidget* MainWindow::createTrackMemoryPage()
     groupLayout->addWidget(m_pidsLineEdit);
     form->addRow(group);
 
+    QGroupBox* outputGroup = new QGroupBox("Output");
+    QFormLayout* outputForm = new QFormLayout(outputGroup);
+    m_logFormatComboBox = new QComboBox();
+    m_logFormatComboBox->addItem("CSV", MemoryRecorder::Csv);
+    m_logFormatComboBox->addItem("Binary (compact)", MemoryRecorder::Binary);
+    m_logFormatComboBox->addItem("Snapshot (replayable)", MemoryRecorder::Snapshot);
+    outputForm->addRow("Format:", m_logFormatComboBox);
+    m_logRotateSizeSpinBox = new QSpinBox();
+    m_logRotateSizeSpinBox->setRange(0, 100000);
+    m_logRotateSizeSpinBox->setValue(100);
+    m_logRotateSizeSpinBox->setSuffix(" MB");
+    m_logRotateSizeSpinBox->setSpecialValueText("Never");
+    outputForm->addRow("New File Every:", m_logRotateSizeSpinBox);
+    m_logRotateTimeSpinBox = new QSpinBox();
+    m_logRotateTimeSpinBox->setRange(0, 720);
+    m_logRotateTimeSpinBox->setValue(0);
+    m_logRotateTimeSpinBox->setSuffix(" hours");
+    m_logRotateTimeSpinBox->setSpecialValueText("Never");
+    outputForm->addRow("Or Every:", m_logRotateTimeSpinBox);
+    form->addRow(outputGroup);
+
     layout->addLayout(form);
+    QHBoxLayout* buttonLayout = new QHBoxLayout();
     m_startLoggingButton = new QPushButton("Start Logging");
-    layout->addWidget(m_startLoggingButton);
+    m_stopLoggingButton = new QPushButton("Stop Logging");
+    m_stopLoggingButton->setEnabled(false);
+    buttonLayout->addWidget(m_startLoggingButton);
+    buttonLayout->addWidget(m_stopLoggingButton);
+    layout->addLayout(buttonLayout);
     m_loggingStatusLabel = new QLabel("Status: Idle");
     layout->addWidget(m_loggingStatusLabel);
     layout->addStretch();
@@ -290,69 +608,495 @@ QWidget* MainWindow::createTrackMemoryPage()
     return page;
 }
 
+QWidget* MainWindow::createDiagnosticsPage()
+{
+    m_diagnosticsPage = new QWidget();
+    QVBoxLayout* layout = new QVBoxLayout(m_diagnosticsPage);
+    QLabel* intro = new QLabel("What each tick of the monitor itself costs, from listing /proc to updating the tables. "
+                               "Read and Parse are summed over the scan threads.");
+    intro->setWordWrap(true);
+    layout->addWidget(intro);
+
+    m_diagnosticsTable = new QTableWidget(ScanProfile::PhaseCount, 6);
+    m_diagnosticsTable->setHorizontalHeaderLabels({"Last (ms)", "Mean (ms)", "p50 (ms)", "p99 (ms)", "Max (ms)", "Ticks"});
+    QStringList phaseLabels;
+    for (int phase = 0; phase < ScanProfile::PhaseCount; ++phase) {
+        phaseLabels << ScanProfile::phaseName(static_cast<ScanProfile::Phase>(phase));
+        for (int column = 0; column < m_diagnosticsTable->columnCount(); ++column) {
+            QTableWidgetItem* item = new QTableWidgetItem();
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            m_diagnosticsTable->setItem(phase, column, item);
+        }
+    }
+    m_diagnosticsTable->setVerticalHeaderLabels(phaseLabels);
+    m_diagnosticsTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    m_diagnosticsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    layout->addWidget(m_diagnosticsTable);
+
+    m_diagnosticsCountersLabel = new QLabel("No scans yet.");
+    m_diagnosticsCountersLabel->setWordWrap(true);
+    layout->addWidget(m_diagnosticsCountersLabel);
+
+    QHBoxLayout* buttons = new QHBoxLayout();
+    m_resetDiagnosticsButton = new QPushButton("Reset");
+    m_saveDiagnosticsButton = new QPushButton("Save to File...");
+    buttons->addWidget(m_resetDiagnosticsButton);
+    buttons->addWidget(m_saveDiagnosticsButton);
+    buttons->addStretch();
+    layout->addLayout(buttons);
+    return m_diagnosticsPage;
+}
+
+QWidget* MainWindow::createCgroupPage()
+{
+    m_cgroupPage = new QWidget();
+    QVBoxLayout* layout = new QVBoxLayout(m_cgroupPage);
+    QLabel* intro = new QLabel("Memory charged to each cgroup against the lowest limit above it. Processes count "
+                               "towards their cgroup and every cgroup containing it.");
+    intro->setWordWrap(true);
+    layout->addWidget(intro);
+
+    m_cgroupModel = new CgroupModel(this);
+    m_cgroupProxy = new QSortFilterProxyModel(this);
+    m_cgroupProxy->setSourceModel(m_cgroupModel);
+    m_cgroupProxy->setSortRole(CgroupModel::SortRole);
+    m_cgroupProxy->setDynamicSortFilter(true);
+    m_cgroupTreeView = new QTreeView();
+    m_cgroupTreeView->setModel(m_cgroupProxy);
+    m_cgroupTreeView->setUniformRowHeights(true);
+    m_cgroupTreeView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_cgroupTreeView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_cgroupTreeView->setAlternatingRowColors(true);
+    m_cgroupTreeView->setSortingEnabled(true);
+    m_cgroupTreeView->sortByColumn(CgroupModel::MemoryColumn, Qt::DescendingOrder);
+    layout->addWidget(m_cgroupTreeView);
+
+    m_cgroupStatusLabel = new QLabel("Waiting for the next scan...");
+    m_cgroupStatusLabel->setWordWrap(true);
+    layout->addWidget(m_cgroupStatusLabel);
+    return m_cgroupPage;
+}
+
+QWidget* MainWindow::createScannerSettingsPage()
+{
+    QWidget* page = new QWidget();
+    QVBoxLayout* layout = new QVBoxLayout(page);
+
+    QGroupBox* cacheGroup = new QGroupBox("Descriptor Cache");
+    QFormLayout* form = new QFormLayout(cacheGroup);
+    m_fdCacheSpinBox = new QSpinBox();
+    m_fdCacheSpinBox->setRange(0, 1000000);
+    m_fdCacheSpinBox->setSingleStep(1024);
+    m_fdCacheSpinBox->setValue(16384);
+    m_fdCacheSpinBox->setSpecialValueText("Disabled");
+    m_fdCacheSpinBox->setToolTip("Open /proc files kept between scans. Capped by half the open file limit.");
+    form->addRow("Max Open Descriptors:", m_fdCacheSpinBox);
+    m_fdCacheStatsLabel = new QLabel("retrieving...");
+    form->addRow("Cache Usage:", m_fdCacheStatsLabel);
+    layout->addWidget(cacheGroup);
+
+    QGroupBox* threadsGroup = new QGroupBox("Parallel Scan");
+    QFormLayout* threadsForm = new QFormLayout(threadsGroup);
+    m_scanThreadsSpinBox = new QSpinBox();
+    m_scanThreadsSpinBox->setRange(1, 64);
+    m_scanThreadsSpinBox->setValue(ProcScanner::defaultThreadCount());
+    m_scanThreadsSpinBox->setToolTip("Threads reading /proc during a scan. Keep this low so the monitor does not become the load.");
+    threadsForm->addRow("Scan Threads:", m_scanThreadsSpinBox);
+    m_scanTimeLabel = new QLabel("retrieving...");
+    threadsForm->addRow("Last Scan:", m_scanTimeLabel);
+    layout->addWidget(threadsGroup);
+
+    QGroupBox* samplingGroup = new QGroupBox("Adaptive Sampling");
+    QFormLayout* samplingForm = new QFormLayout(samplingGroup);
+    m_cpuBudgetSpinBox = new QDoubleSpinBox();
+    m_cpuBudgetSpinBox->setRange(0.1, 100);
+    m_cpuBudgetSpinBox->setDecimals(1);
+    m_cpuBudgetSpinBox->setValue(2.0);
+    m_cpuBudgetSpinBox->setSuffix(" % of a core");
+    m_cpuBudgetSpinBox->setToolTip("The display refreshes every 0.5 to 8 seconds depending on memory pressure, "
+                                   "but never so often that scanning would take more than this. "
+                                   "Track Memory always gets the interval it asked for.");
+    samplingForm->addRow("CPU Budget:", m_cpuBudgetSpinBox);
+    m_refreshIntervalLabel = new QLabel("retrieving...");
+    samplingForm->addRow("Display Refresh:", m_refreshIntervalLabel);
+    layout->addWidget(samplingGroup);
+
+    QGroupBox* smapsGroup = new QGroupBox("Deep Accounting (PSS / USS / Swap)");
+    QFormLayout* smapsForm = new QFormLayout(smapsGroup);
+    m_smapsBudgetSpinBox = new QDoubleSpinBox();
+    m_smapsBudgetSpinBox->setRange(0, 1000);
+    m_smapsBudgetSpinBox->setDecimals(1);
+    m_smapsBudgetSpinBox->setValue(10);
+    m_smapsBudgetSpinBox->setSuffix(" ms per scan");
+    m_smapsBudgetSpinBox->setSpecialValueText("Off");
+    m_smapsBudgetSpinBox->setToolTip("Time each scan may spend reading /proc/<pid>/smaps_rollup. The largest processes "
+                                     "and those whose RSS changed are refreshed first, the rest in turn.");
+    smapsForm->addRow("Time Budget:", m_smapsBudgetSpinBox);
+    m_smapsStatusLabel = new QLabel("retrieving...");
+    m_smapsStatusLabel->setWordWrap(true);
+    smapsForm->addRow("Status:", m_smapsStatusLabel);
+    layout->addWidget(smapsGroup);
+
+    QGroupBox* eventsGroup = new QGroupBox("Process Discovery");
+    QFormLayout* eventsForm = new QFormLayout(eventsGroup);
+    m_processEventsCheckBox = new QCheckBox("Follow process start/exit events");
+    m_processEventsCheckBox->setChecked(true);
+    m_processEventsCheckBox->setToolTip("Uses the kernel's netlink process connector instead of listing /proc every scan, "
+                                       "and also catches processes that exit between scans. Falls back to listing "
+                                       "/proc when not permitted.");
+    eventsForm->addRow(m_processEventsCheckBox);
+    m_processEventsStatusLabel = new QLabel("retrieving...");
+    eventsForm->addRow("Status:", m_processEventsStatusLabel);
+    layout->addWidget(eventsGroup);
+
+    QGroupBox* historyGroup = new QGroupBox("Memory History");
+    QFormLayout* historyForm = new QFormLayout(historyGroup);
+    m_historyBudgetSpinBox = new QSpinBox();
+    m_historyBudgetSpinBox->setRange(8, 4096);
+    m_historyBudgetSpinBox->setValue(64);
+    m_historyBudgetSpinBox->setSuffix(" MB");
+    m_historyBudgetSpinBox->setToolTip("Memory for per-process history. The oldest samples are dropped first when it is full.");
+    historyForm->addRow("Memory Budget:", m_historyBudgetSpinBox);
+    m_historyStatsLabel = new QLabel("retrieving...");
+    historyForm->addRow("History Usage:", m_historyStatsLabel);
+    layout->addWidget(historyGroup);
+
+    QGroupBox* metricsGroup = new QGroupBox("Metrics Endpoint");
+    QFormLayout* metricsForm = new QFormLayout(metricsGroup);
+    m_metricsAddressLineEdit = new QLineEdit();
+    m_metricsAddressLineEdit->setPlaceholderText("e.g. 127.0.0.1:9464 or unix:/run/user/1000/memanalyzer.sock (empty: off)");
+    m_metricsAddressLineEdit->setToolTip("Serves every scan as OpenMetrics text at /metrics, for Prometheus and "
+                                         "compatible scrapers. Loopback addresses and Unix sockets only.");
+    metricsForm->addRow("Listen On:", m_metricsAddressLineEdit);
+    m_metricsTopSpinBox = new QSpinBox();
+    m_metricsTopSpinBox->setRange(0, 100000);
+    m_metricsTopSpinBox->setValue(100);
+    m_metricsTopSpinBox->setToolTip("Processes exported one by one, largest RSS first; the rest are summed into one "
+                                    "series, so the number of series stays bounded.");
+    metricsForm->addRow("Processes Exported:", m_metricsTopSpinBox);
+    m_metricsStatusLabel = new QLabel("Off");
+    m_metricsStatusLabel->setWordWrap(true);
+    metricsForm->addRow("Status:", m_metricsStatusLabel);
+    layout->addWidget(metricsGroup);
+
+    m_applyScannerSettingsButton = new QPushButton("Apply");
+    layout->addWidget(m_applyScannerSettingsButton);
+    layout->addStretch();
+
+    return page;
+}
+
 void MainWindow::onSearchTextChanged(const QString &text)
 {
-    m_currentFilter = text;
+    Q_UNUSED(text);
+    m_searchDebounceTimer->start();
+}
+
+void MainWindow::applySearchFilter()
+{
+    QString error;
+    if (m_processProxy->setQuery(m_searchLineEdit->text(), &error)) {
+        m_searchStatusLabel->setVisible(false);
+    } else {
+        m_searchStatusLabel->setText(error);
+        m_searchStatusLabel->setVisible(true);
+    }
+}
+
+void MainWindow::onProcessViewChanged(int index)
+{
+    if (index <= 0) {
+        m_processViewStack->setCurrentWidget(m_processTableView);
+        m_searchLineEdit->setVisible(true);
+        applySearchFilter();
+        worker->setCommandLines(false);
+        m_processTreeModel->setProcesses(QVector<ProcessInfo>());
+        return;
+    }
+
+    const ProcessTreeModel::Mode modes[] = {ProcessTreeModel::TreeMode, ProcessTreeModel::NameMode,
+                                            ProcessTreeModel::UserMode, ProcessTreeModel::CommandMode};
+    ProcessTreeModel::Mode mode = modes[qMin(index, 4) - 1];
+    // Processes whose command line has not been read yet are grouped by
+    // name until the next scan brings it.
+    worker->setCommandLines(mode == ProcessTreeModel::CommandMode);
+    m_processTreeModel->setMode(mode, m_processModel->processes());
+    m_processTreeView->setColumnHidden(ProcessTreeModel::OwnMemoryColumn, mode != ProcessTreeModel::TreeMode);
+    m_processViewStack->setCurrentWidget(m_processTreeView);
+    // The search applies to the flat list only.
+    m_searchLineEdit->setVisible(false);
+    m_searchStatusLabel->setVisible(false);
+}
+
+void MainWindow::handleStaticInfo(const StaticInfo &info)
+{
+    m_staticInfo = info;
+    m_cpuModelLabel->setText(info.cpuModel);
+    m_cpuCoresThreadsLabel->setText(QString("%1 Cores / %2 Threads").arg(info.cpuCores, info.cpuThreads));
+    m_cpuL1CacheLabel->setText(info.cpuL1Cache);
+    m_cpuL2CacheLabel->setText(info.cpuL2Cache);
+    m_cpuL3CacheLabel->setText(info.cpuL3Cache);
+    m_memoryTypeLabel->setText(info.memoryType);
+    m_memorySpeedLabel->setText(info.memorySpeed);
+    m_memorySlotsLabel->setText(info.memorySlots);
+    m_gpuListLabel->setText(info.gpuModels.isEmpty() ? "None found" : info.gpuModels.join("\n"));
+}
+
+void MainWindow::handleScanDelta(const ScanDelta &delta)
+{
+    // A replay owns the views until it ends.
+    if (m_replayer->isActive()) return;
+    if (delta.baseGeneration != 0 && delta.baseGeneration != m_generation) {
+        // Missed a delta; our state is no longer a valid base.
+        worker->requestFullSnapshot();
+        return;
+    }
+    // The worker timed its phases; add delivery (queueing and copying the
+    // delta) and our own work on top.
+    ScanProfile::Tick tick = delta.scanStats.profile;
+    tick.phaseMs[ScanProfile::Deliver] = (ScanProfile::nowNs() - tick.emittedNs) / 1e6;
+    AllocationCount allocationsBefore = threadAllocations();
+    QElapsedTimer phaseTimer;
+    phaseTimer.start();
+    applyDelta(delta);
+    tick.phaseMs[ScanProfile::Apply] = phaseTimer.nsecsElapsed() / 1e6;
+    phaseTimer.restart();
     handleResults(lastData);
+    tick.phaseMs[ScanProfile::Display] = phaseTimer.nsecsElapsed() / 1e6;
+    AllocationCount allocations = threadAllocations();
+    tick.receiver.allocations = allocations.allocations - allocationsBefore.allocations;
+    tick.receiver.allocatedBytes = allocations.bytes - allocationsBefore.bytes;
+    m_scanProfile.record(tick);
+    if (m_mainStack->currentWidget() == m_diagnosticsPage) updateDiagnostics();
+    if (m_mainStack->currentWidget() == m_cgroupPage) updateCgroupStatus(delta.scanStats);
+    if ((delta.consumers & (1u << SampleScheduler::Tracker)) && m_recorder.isRunning()) performLog();
+}
+
+void MainWindow::handleReplayDelta(const ScanDelta &delta)
+{
+    applyDelta(delta);
+    handleResults(lastData);
+    m_replayStatusLabel->setText(QString("Replaying sample %1 of %2, recorded %3")
+                                     .arg(m_replayer->position() + 1).arg(m_replayer->frameCount())
+                                     .arg(QDateTime::fromMSecsSinceEpoch(m_replayer->currentTimeMs()).toString("yyyy-MM-dd hh:mm:ss")));
+}
+
+void MainWindow::applyDelta(const ScanDelta &delta)
+{
+    m_processModel->applyDelta(delta);
+    if (m_processViewStack->currentWidget() == m_processTreeView) m_processTreeModel->applyDelta(delta);
+    if (!delta.cgroups.isEmpty() && m_mainStack->currentWidget() == m_cgroupPage) {
+        bool first = m_cgroupModel->cgroupCount() == 0;
+        m_cgroupModel->setCgroups(delta.cgroups, m_processModel->processes());
+        if (first) m_cgroupTreeView->expandToDepth(0);
+    }
+    m_rankingSize = delta.rankingSize;
+    m_topByMemory = delta.topByMemory;
+    m_topByGrowth = delta.topByGrowth;
+    m_growthTrends = delta.growthTrends;
+    lastData.timeMs = delta.timeMs;
+    lastData.memTotal = delta.memTotal;
+    lastData.memAvailable = delta.memAvailable;
+    lastData.memInfo = delta.memInfo;
+    lastData.scanStats = delta.scanStats;
+    if (delta.memInfo[MemInfo::MemTotal] > 0) m_memInfoHistory.append(delta.timeMs, delta.memInfo);
+    m_generation = delta.generation;
 }
 
 void MainWindow::handleResults(const AppData &data)
 {
-    lastData = data;
     QString memStr;
-    m_cpuModelLabel->setText(data.cpuModel);
-    m_cpuCoresThreadsLabel->setText(QString("%1 Cores / %2 Threads").arg(data.cpuCores, data.cpuThreads));
-    m_cpuL1CacheLabel->setText(data.cpuL1Cache);
-    m_cpuL2CacheLabel->setText(data.cpuL2Cache);
-    m_cpuL3CacheLabel->setText(data.cpuL3Cache);
     formatMemory(memStr, data.memTotal);
     m_totalMemoryLabel->setText(memStr);
     formatMemory(memStr, data.memAvailable);
     m_availableMemoryLabel->setText(memStr);
-    m_memoryTypeLabel->setText(data.memoryType);
-    m_memorySpeedLabel->setText(data.memorySpeed);
-    m_memorySlotsLabel->setText(data.memorySlots);
-    m_gpuListLabel->setText(data.gpuModels.join("\n"));
-    QList<ProcessInfo> filteredList;
-    if (m_currentFilter.isEmpty()) {
-        filteredList = data.processes;
+    updateMemoryBreakdown(data.memInfo);
+    updateGrowthTrends();
+    m_fdCacheStatsLabel->setText(QString("%1 of %2 descriptors open, %3 hits / %4 misses, %5 reused PIDs")
+                                     .arg(data.scanStats.fdCacheOpen).arg(data.scanStats.fdCacheLimit)
+                                     .arg(data.scanStats.fdCacheHits).arg(data.scanStats.fdCacheMisses)
+                                     .arg(data.scanStats.fdCacheReuses));
+    m_scanTimeLabel->setText(QString("%1 ms on %2 thread(s)")
+                                 .arg(data.scanStats.scanMs, 0, 'f', 2).arg(data.scanStats.scanThreads));
+    const ScanStats &stats = data.scanStats;
+    if (stats.pressureMode == PressureMonitor::Psi) {
+        m_pressureStatusLabel->setText(QString("Watching %1 pressure trigger(s), memory stalled %2% of the last 10 s; "
+                                               "%3 alert(s), worst detection latency %4 ms")
+                                           .arg(stats.pressureTriggers).arg(stats.memoryPressure * 100, 0, 'f', 2)
+                                           .arg(stats.pressureAlerts).arg(stats.pressureWorstLatencyMs, 0, 'f', 0));
+    } else if (stats.pressureMode == PressureMonitor::MeminfoPolling) {
+        m_pressureStatusLabel->setText(QString("No PSI on this kernel; checking memory usage every 100 ms, "
+                                               "%1 alert(s), worst detection latency %2 ms")
+                                           .arg(stats.pressureAlerts).arg(stats.pressureWorstLatencyMs, 0, 'f', 0));
+    } else {
+        m_pressureStatusLabel->clear();
+    }
+    if (stats.alertRules > 0) {
+        m_alertRulesStatusLabel->setText(QString("%1 rule(s) compiled, %2 check(s) in the last scan, %3 firing")
+                                             .arg(stats.alertRules).arg(stats.alertChecks).arg(stats.alertsFiring));
     } else {
-        for (const auto& process : data.processes) {
-            if (process.name.contains(m_currentFilter, Qt::CaseInsensitive)) {
-                filteredList.append(process);
+        m_alertRulesStatusLabel->clear();
+    }
+    m_refreshIntervalLabel->setText(QString("every %1 s%2")
+                                        .arg(data.scanStats.displayIntervalMs / 1000.0, 0, 'f', 2)
+                                        .arg(data.scanStats.cpuBudgetLimited ? " (held back by the CPU budget)" : ""));
+    if (data.scanStats.processEvents) {
+        m_processEventsStatusLabel->setText(QString("Following events, %1 /proc listings, %2 short-lived processes caught")
+                                                .arg(data.scanStats.procListings).arg(data.scanStats.transientProcesses));
+    } else {
+        m_processEventsStatusLabel->setText(QString("Listing /proc every scan (%1 listings)").arg(data.scanStats.procListings));
+    }
+    if (!data.scanStats.metricsAddress.isEmpty()) {
+        QString address = data.scanStats.metricsAddress;
+        m_metricsStatusLabel->setText(QString("Serving %1, %2 scrape(s) so far")
+                                          .arg(address.startsWith("unix:") ? address
+                                                                           : QString("http://%1/metrics").arg(address))
+                                          .arg(data.scanStats.metricsScrapes));
+    } else if (!data.scanStats.metricsError.isEmpty() && !m_metricsAddressLineEdit->text().trimmed().isEmpty()) {
+        m_metricsStatusLabel->setText(QString("Not serving: %1").arg(data.scanStats.metricsError));
+    } else {
+        m_metricsStatusLabel->setText("Off");
+    }
+    QString usedStr, budgetStr;
+    formatMemory(usedStr, static_cast<long>(data.scanStats.historyBytes / 1024));
+    formatMemory(budgetStr, static_cast<long>(data.scanStats.historyBudget / 1024));
+    m_historyStatsLabel->setText(QString("%1 processes, %2 of %3")
+                                     .arg(data.scanStats.historySeries).arg(usedStr).arg(budgetStr));
+    if (stats.smapsBudgetMs > 0) {
+        // Summing PSS instead of RSS counts shared pages once.
+        long rssSum = 0, pssSum = 0;
+        for (const ProcessInfo &process : m_processModel->processes()) {
+            if (process.pss < 0) continue;
+            rssSum += process.memory;
+            pssSum += process.pss;
+        }
+        QString rssStr, pssStr;
+        formatMemory(rssStr, rssSum);
+        formatMemory(pssStr, pssSum);
+        m_smapsStatusLabel->setText(QString("Last scan used %1 of %2 ms for %3 rollup(s). Known for %4 of %5 processes "
+                                            "(PSS %6 vs. RSS %7); %8 waiting, %9 too big for the budget, %10 not readable")
+                                        .arg(stats.smapsUsedMs, 0, 'f', 2).arg(stats.smapsBudgetMs, 0, 'f', 1)
+                                        .arg(stats.smapsRead).arg(stats.smapsCovered)
+                                        .arg(m_processModel->rowCount()).arg(pssStr).arg(rssStr)
+                                        .arg(stats.smapsDeferred).arg(stats.smapsOverBudget).arg(stats.smapsDenied));
+    } else {
+        m_smapsStatusLabel->setText("Off (or smaps_rollup not available on this kernel)");
+    }
+}
+
+void MainWindow::updateMemoryBreakdown(const MemInfo &info)
+{
+    const MemInfo* past[3];
+    for (int i = 0; i < 3; ++i) past[i] = m_memInfoHistory.ago(kBreakdownAgesMs[i]);
+    for (int row = 0; row < kBreakdownRowCount; ++row) {
+        long now = breakdownValue(info, kBreakdownRows[row]);
+        m_memoryBreakdownTable->item(row, 0)->setText(ProcessTableModel::formatMemory(now));
+        for (int i = 0; i < 3; ++i) {
+            long then = past[i] ? breakdownValue(*past[i], kBreakdownRows[row]) : -1;
+            m_memoryBreakdownTable->item(row, i + 1)->setText(now < 0 || then < 0 ? QString() : formatChange(now - then));
+        }
+    }
+}
+
+void MainWindow::updateGrowthTrends()
+{
+    m_growthTrendsTable->setRowCount(m_growthTrends.size());
+    for (int row = 0; row < m_growthTrends.size(); ++row) {
+        const GrowthDetector::Trend &trend = m_growthTrends.at(row);
+        const ProcessInfo *process = m_processModel->findPid(trend.pid);
+        QString memStr;
+        formatMemory(memStr, trend.rssKb);
+        QString limitStr;
+        if (trend.secondsToLimit >= 0) {
+            formatMemory(limitStr, trend.limitKb);
+            limitStr = QString("%1 min (%2)").arg(trend.secondsToLimit / 60, 0, 'f', 0).arg(limitStr);
+        }
+        const QStringList cells = {
+            process ? process->name : QString("?"),
+            QString::number(trend.pid),
+            memStr,
+            QString("%1 MB/h").arg(trend.slopeKbPerSec * 3600 / 1024, 0, 'f', 1),
+            QString::number(trend.fit, 'f', 2),
+            QString("%1 min%2").arg(trend.trendAgeSec / 60, 0, 'f', 0).arg(trend.changePoint ? " (speeding up)" : ""),
+            limitStr,
+        };
+        for (int column = 0; column < cells.size(); ++column) {
+            QTableWidgetItem *item = m_growthTrendsTable->item(row, column);
+            if (!item) {
+                item = new QTableWidgetItem();
+                m_growthTrendsTable->setItem(row, column, item);
             }
+            item->setText(cells.at(column));
         }
     }
-    m_processTableWidget->setSortingEnabled(false);
-    m_processTableWidget->setRowCount(filteredList.count());
-    for(int i = 0; i < filteredList.count(); ++i) {
-        const auto& process = filteredList.at(i);
-        formatMemory(memStr, process.memory);
-        QTableWidgetItem *nameItem = new QTableWidgetItem(process.name);
-        QTableWidgetItem *pidItem = new QTableWidgetItem(QString::number(process.pid));
-        QTableWidgetItem *memItem = new QTableWidgetItem(memStr);
-        m_processTableWidget->setItem(i, 0, nameItem);
-        m_processTableWidget->setItem(i, 1, pidItem);
-        m_processTableWidget->setItem(i, 2, memItem);
+}
+
+void MainWindow::updateDiagnostics()
+{
+    for (int phase = 0; phase < ScanProfile::PhaseCount; ++phase) {
+        const LatencyHistogram &histogram = m_scanProfile.histogram(static_cast<ScanProfile::Phase>(phase));
+        const double values[] = {histogram.last() / 1e6, histogram.mean() / 1e6, histogram.percentile(0.5) / 1e6,
+                                 histogram.percentile(0.99) / 1e6, histogram.max() / 1e6};
+        for (int column = 0; column < 5; ++column) {
+            m_diagnosticsTable->item(phase, column)->setText(histogram.count() ? QString::number(values[column], 'f', 3)
+                                                                                 : QString());
+        }
+        m_diagnosticsTable->item(phase, 5)->setText(QString::number(histogram.count()));
     }
-    m_processTableWidget->setSortingEnabled(true);
+    const ScanProfile::Tick &last = m_scanProfile.lastTick();
+    quint64 ticks = qMax<quint64>(m_scanProfile.ticks(), 1);
+    QString workerBytes, receiverBytes;
+    formatMemory(workerBytes, static_cast<long>(last.worker.allocatedBytes / 1024));
+    formatMemory(receiverBytes, static_cast<long>(last.receiver.allocatedBytes / 1024));
+    QString counters = QString("%1 ticks, the last over %2 processes. Per tick (last / mean): %3 / %4 syscalls "
+                               "reading /proc; ")
+                           .arg(m_scanProfile.ticks()).arg(last.processes).arg(last.worker.syscalls)
+                           .arg(static_cast<double>(m_scanProfile.workerTotal().syscalls) / ticks, 0, 'f', 1);
+    if (allocationsCounted()) {
+        counters += QString("%1 / %2 heap allocations (%3) in the worker; %4 / %5 heap allocations (%6) applying "
+                            "and displaying.")
+                        .arg(last.worker.allocations)
+                        .arg(static_cast<double>(m_scanProfile.workerTotal().allocations) / ticks, 0, 'f', 1)
+                        .arg(workerBytes).arg(last.receiver.allocations)
+                        .arg(static_cast<double>(m_scanProfile.receiverTotal().allocations) / ticks, 0, 'f', 1)
+                        .arg(receiverBytes);
+    } else {
+        counters += "heap allocations are not counted in this build (CONFIG+=alloc_counter).";
+    }
+    m_diagnosticsCountersLabel->setText(counters);
 }
 
-void MainWindow::handleThresholdAlert(const QString& message)
+void MainWindow::updateCgroupStatus(const ScanStats &stats)
 {
-    if (!alertActive && currentThreshold != -1) {
-        alertActive = true;
-        QMessageBox msgBox;
-        msgBox.setWindowTitle("Memory Alert");
-        msgBox.setText(message);
-        m_ignoreButton = msgBox.addButton("OK", QMessageBox::ActionRole);
-        msgBox.exec();
+    if (!stats.cgroupsAvailable) {
+        m_cgroupStatusLabel->setText(stats.cgroupError.isEmpty() ? QString("Waiting for the next scan...")
+                                                                 : QString("Cgroups unavailable: %1").arg(stats.cgroupError));
+        return;
     }
+    m_cgroupStatusLabel->setText(QString("%1 cgroups, %2; %3 directories listed so far, %4 files kept open.")
+                                     .arg(m_cgroupModel->cgroupCount())
+                                     .arg(stats.cgroupInotify ? "changes followed with inotify" : "walked on every scan")
+                                     .arg(stats.cgroupWalks).arg(stats.cgroupOpenFds));
 }
 
-void MainWindow::onIgnoreAlert()
+void MainWindow::handleAlerts()
 {
-    alertActive = true;
+    // Never waits for the user: alerts go to the list on the alert page and
+    // the status bar, and the page's entry in the sidebar counts the unseen.
+    std::vector<Alert> alerts = worker->alerts().drain();
+    if (alerts.empty()) return;
+    for (const Alert &alert : alerts) {
+        QString text = QString("%1  %2").arg(QDateTime::fromMSecsSinceEpoch(alert.timeMs).toString("hh:mm:ss"),
+                                             QString::fromStdString(alert.message));
+        if (alert.repeats > 1) text += QString(" (%1 times)").arg(alert.repeats);
+        m_alertList->insertItem(0, text);
+    }
+    while (m_alertList->count() > kMaxAlertItems) delete m_alertList->takeItem(m_alertList->count() - 1);
+    statusBar()->showMessage(QString::fromStdString(alerts.back().message), kAlertMessageMs);
+    if (m_mainStack->currentWidget() != m_alertPage) {
+        m_unseenAlerts += static_cast<int>(alerts.size());
+        m_sidebar->item(m_mainStack->indexOf(m_alertPage))->setText(QString("Threshold Alert (%1)").arg(m_unseenAlerts));
+    }
 }
 
 void MainWindow::onGetInfoButtonClicked()
@@ -397,13 +1141,140 @@ void MainWindow::onCompareButtonClicked()
     m_compareResultLabel->setText(result);
 }
 
+void MainWindow::onShowHistoryClicked()
+{
+    bool ok;
+    pid_t pid = m_historyPidLineEdit->text().toInt(&ok);
+    if (!ok) {
+        m_historyResultLabel->setText("Please enter a valid PID.");
+        return;
+    }
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 window = m_historyWindowComboBox->currentData().toLongLong();
+    std::vector<HistoryPoint> points = worker->history().query(pid, now - window, now);
+
+    m_historyTable->setRowCount(0);
+    if (points.empty()) {
+        m_historyResultLabel->setText(QString("No history recorded for PID %1.").arg(pid));
+        return;
+    }
+
+    long low = points.front().value, high = points.front().value;
+    for (const HistoryPoint &point : points) {
+        low = std::min(low, point.value);
+        high = std::max(high, point.value);
+    }
+    QString lowStr, highStr, changeStr;
+    formatMemory(lowStr, low);
+    formatMemory(highStr, high);
+    long change = points.back().value - points.front().value;
+    formatMemory(changeStr, std::labs(change));
+    m_historyResultLabel->setText(QString("%1 samples since %2: min %3, max %4, %5%6 overall.")
+                                      .arg(points.size())
+                                      .arg(QDateTime::fromMSecsSinceEpoch(points.front().timeMs).toString("yyyy-MM-dd hh:mm:ss"))
+                                      .arg(lowStr).arg(highStr).arg(change < 0 ? "-" : "+").arg(changeStr));
+
+    // Newest first
+    m_historyTable->setRowCount(static_cast<int>(points.size()));
+    for (int row = 0; row < static_cast<int>(points.size()); ++row) {
+        const HistoryPoint &point = points[points.size() - 1 - row];
+        QString memStr;
+        formatMemory(memStr, point.value);
+        m_historyTable->setItem(row, 0, new QTableWidgetItem(QDateTime::fromMSecsSinceEpoch(point.timeMs).toString("yyyy-MM-dd hh:mm:ss")));
+        m_historyTable->setItem(row, 1, new QTableWidgetItem(memStr));
+    }
+}
+
+void MainWindow::onTopGrowersClicked()
+{
+    qint64 window = m_historyWindowComboBox->currentData().toLongLong();
+    std::vector<HistoryStore::Growth> growers = worker->history().topGrowers(window, 10);
+    if (growers.empty()) {
+        m_historyResultLabel->setText(QString("No process grew during the %1.")
+                                          .arg(m_historyWindowComboBox->currentText().toLower()));
+        return;
+    }
+    QString result = QString("Largest growth during the %1:").arg(m_historyWindowComboBox->currentText().toLower());
+    for (const HistoryStore::Growth &growth : growers) {
+        const ProcessInfo *process = m_processModel->findPid(growth.pid);
+        QString fromStr, toStr;
+        formatMemory(fromStr, growth.fromValue);
+        formatMemory(toStr, growth.toValue);
+        result += QString("\n%1 (PID %2): %3 -> %4").arg(process ? process->name : QString("?"))
+                      .arg(growth.pid).arg(fromStr).arg(toStr);
+    }
+    m_historyResultLabel->setText(result);
+}
+
 void MainWindow::onSetAlertButtonClicked()
 {
+    QString rules = m_alertRulesEdit->toPlainText();
+    std::string error;
+    AlertEngine check;
+    if (!check.compile(rules.toStdString(), &error)) {
+        m_alertStatusLabel->setText(QString("Alert rules not set: %1").arg(QString::fromStdString(error)));
+        return;
+    }
     int threshold = m_thresholdSpinBox->value();
     worker->setThreshold(threshold);
-    m_alertStatusLabel->setText(QString("Alert threshold set to %1%").arg(threshold));
-    currentThreshold = threshold; // Update current threshold
-    alertActive = false; // Reset alert status when threshold changes
+    worker->setAlertRules(rules);
+    QStringList cgroups;
+    for (const QString &cgroup : m_pressureCgroupsLineEdit->text().split(',', Qt::SkipEmptyParts)) {
+        cgroups.append(cgroup.trimmed());
+    }
+    worker->setPressureAlert(m_stallSpinBox->value(), 1000, cgroups);
+    worker->setLeakAlert(m_leakLimitSpinBox->value(), m_leakHorizonSpinBox->value());
+    QString thresholdText = threshold > 0 ? QString("Alert threshold set to %1%").arg(threshold)
+                                          : QString("No threshold set");
+    m_alertStatusLabel->setText(QString("%1, %2 rule(s).").arg(thresholdText).arg(check.rules().size()));
+}
+
+void MainWindow::onApplyScannerSettingsClicked()
+{
+    worker->setFdCacheLimit(m_fdCacheSpinBox->value());
+    worker->setScanThreadCount(m_scanThreadsSpinBox->value());
+    worker->setHistoryBudget(m_historyBudgetSpinBox->value());
+    worker->setProcessEvents(m_processEventsCheckBox->isChecked());
+    worker->setCpuBudget(m_cpuBudgetSpinBox->value());
+    worker->setDeepAccountingBudget(m_smapsBudgetSpinBox->value());
+    worker->setMetricsEndpoint(m_metricsAddressLineEdit->text().trimmed(), m_metricsTopSpinBox->value());
+}
+
+void MainWindow::onPageChanged()
+{
+    if (m_mainStack->currentWidget() == m_alertPage && m_unseenAlerts > 0) {
+        m_unseenAlerts = 0;
+        m_sidebar->item(m_mainStack->indexOf(m_alertPage))->setText("Threshold Alert");
+    }
+    // The diagnostics page is only kept up to date while shown.
+    if (m_mainStack->currentWidget() == m_diagnosticsPage) updateDiagnostics();
+    // Following the cgroups costs a descriptor and a watch per cgroup, so
+    // only while their page is open; it starts over when opened again.
+    bool cgroupsShown = m_mainStack->currentWidget() == m_cgroupPage;
+    worker->setCgroupMonitoring(cgroupsShown);
+    if (!cgroupsShown && m_cgroupModel->cgroupCount() > 0) m_cgroupModel->clear();
+}
+
+void MainWindow::onResetDiagnosticsClicked()
+{
+    m_scanProfile.reset();
+    updateDiagnostics();
+}
+
+void MainWindow::onSaveDiagnosticsClicked()
+{
+    QString dateTime = QDateTime::currentDateTime().toString("yyyy-MM-dd_hh-mm-ss");
+    QString fileName = QFileDialog::getSaveFileName(this, "Save Diagnostics", QString("diagnostics_%1.txt").arg(dateTime),
+                                                    "Text Files (*.txt)");
+    if (fileName.isEmpty()) return;
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        QMessageBox::critical(this, "Error", "Could not save file.");
+        return;
+    }
+    QTextStream out(&file);
+    out << "--- Memory Analyzer Diagnostics, " << QDateTime::currentDateTime().toString(Qt::ISODate) << " ---\n";
+    out << QString::fromStdString(m_scanProfile.report());
 }
 
 void MainWindow::onSaveReportButtonClicked()
@@ -422,12 +1293,12 @@ void MainWindow::onSaveReportButtonClicked()
     out << "Total Memory: " << memStr << "\n";
     formatMemory(memStr, lastData.memAvailable);
     out << "Available Memory: " << memStr << "\n";
-    out << "Memory Type: " << lastData.memoryType << "\n";
-    out << "Memory Speed: " << lastData.memorySpeed << "\n";
+    out << "Memory Type: " << m_staticInfo.memoryType << "\n";
+    out << "Memory Speed: " << m_staticInfo.memorySpeed << "\n";
     out << "\n--- All Running Processes ---\n";
     out << QString("%1; %2; %3\n").arg("Name", -30).arg("PID", -10).arg("Memory");
     out << "--------------------------------------------------------------\n";
-    for(const auto& process : lastData.processes) {
+    for(const auto& process : sortedByMemory(m_processModel->processes())) {
         formatMemory(memStr, process.memory);
         out << QString("%1; %2; %3\n").arg(process.name, -30).arg(process.pid, -10).arg(memStr);
     }
@@ -435,32 +1306,100 @@ void MainWindow::onSaveReportButtonClicked()
     m_reportStatusLabel->setText(QString("Report saved to %1").arg(fileName));
 }
 
-void MainWindow::onGetTopNClicked()
+void MainWindow::onSaveSnapshotClicked()
 {
-    int n = m_topNSpinBox->value();
+    QString dateTime = QDateTime::currentDateTime().toString("yyyy-MM-dd_hh-mm-ss");
+    QString fileName = QFileDialog::getSaveFileName(this, "Save Snapshot", QString("memory_snapshot_%1.masnap").arg(dateTime),
+                                                    "Memory Snapshots (*.masnap)");
+    if (fileName.isEmpty()) return;
+    QFile file(fileName);
+    std::string bytes = SnapshotEncoder::encode({captureFrame(QList<pid_t>())});
+    if (!file.open(QIODevice::WriteOnly)
+        || file.write(bytes.data(), static_cast<qint64>(bytes.size())) != static_cast<qint64>(bytes.size())) {
+        QMessageBox::critical(this, "Error", "Could not save file.");
+        return;
+    }
+    file.close();
+    m_reportStatusLabel->setText(QString("Snapshot saved to %1").arg(fileName));
+}
+
+void MainWindow::onLoadRecordingClicked()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, "Load Recording", QString(), "Memory Snapshots (*.masnap)");
+    if (fileName.isEmpty()) return;
+    QString error;
+    if (!m_replayer->open(fileName, &error)) {
+        QMessageBox::critical(this, "Error", error);
+        return;
+    }
+    m_loadRecordingButton->setEnabled(false);
+    m_stopReplayButton->setEnabled(true);
+    m_replayer->start(m_replaySpeedComboBox->currentIndex() == 0);
+}
 
-    int rowCount = qMin(n, lastData.processes.size());
+void MainWindow::onStopReplayClicked()
+{
+    m_replayer->stop();
+    handleReplayFinished(m_replayer->position(), -1);
+}
 
-    m_topNTableWidget->setRowCount(rowCount);
+void MainWindow::handleReplayFinished(int frames, qint64 elapsedMs)
+{
+    m_loadRecordingButton->setEnabled(true);
+    m_stopReplayButton->setEnabled(false);
+    if (elapsedMs >= 0) {
+        m_replayStatusLabel->setText(QString("Replayed %1 samples in %2 ms (%3 per second). Showing live data again.")
+                                         .arg(frames).arg(elapsedMs)
+                                         .arg(elapsedMs > 0 ? frames * 1000.0 / elapsedMs : 0.0, 0, 'f', 1));
+    } else {
+        m_replayStatusLabel->setText("Replay stopped. Showing live data again.");
+    }
+    // Back to the worker's stream, starting from a full snapshot.
+    m_generation = 0;
+    worker->requestFullSnapshot();
+}
 
-    QString memStr;
-    for(int i = 0; i < rowCount; ++i) {
-        const auto& process = lastData.processes.at(i);
-        formatMemory(memStr, process.memory);
+void MainWindow::onGetTopNClicked()
+{
+    int n = m_topNSpinBox->value();
 
-        QTableWidgetItem *nameItem = new QTableWidgetItem(process.name);
-        QTableWidgetItem *pidItem = new QTableWidgetItem(QString::number(process.pid));
-        QTableWidgetItem *memItem = new QTableWidgetItem(memStr);
+    int key = m_topNKeyComboBox->currentIndex();
+    bool byGrowth = key == 1;
 
-        m_topNTableWidget->setItem(i, 0, nameItem);
-        m_topNTableWidget->setItem(i, 1, pidItem);
-        m_topNTableWidget->setItem(i, 2, memItem);
+    QVector<ProcessInfo> top;
+    if (key >= 2) {
+        // PSS and swap are only known for some processes; rank those here.
+        bool byPss = key == 2;
+        for (const ProcessInfo &process : m_processModel->processes()) {
+            if (byPss ? process.pss >= 0 : process.swap > 0) top.append(process);
+        }
+        int rowCount = qMin(n, top.size());
+        std::partial_sort(top.begin(), top.begin() + rowCount, top.end(), byPss ? byPssDesc : bySwapDesc);
+        top.resize(rowCount);
+    } else if (n <= m_rankingSize) {
+        // The worker already ranked this scan.
+        const QVector<pid_t> &ranking = byGrowth ? m_topByGrowth : m_topByMemory;
+        for (pid_t pid : ranking) {
+            if (top.size() == n) break;
+            if (const ProcessInfo *process = m_processModel->findPid(pid)) top.append(*process);
+        }
+    } else {
+        // N changed since the last scan; rank the materialized list here.
+        for (const ProcessInfo &process : m_processModel->processes()) {
+            if (!byGrowth || process.growth > 0) top.append(process);
+        }
+        int rowCount = qMin(n, top.size());
+        std::partial_sort(top.begin(), top.begin() + rowCount, top.end(),
+                          byGrowth ? byGrowthDesc : byMemoryDesc);
+        top.resize(rowCount);
     }
+
+    m_topNModel->setProcesses(top);
 }
 
 void MainWindow::onStartLoggingClicked()
 {
-    if (m_loggingTimer->isActive()) {
+    if (m_recorder.isRunning()) {
         m_loggingStatusLabel->setText("Logging already in progress.");
         return;
     }
@@ -501,88 +1440,102 @@ void MainWindow::onStartLoggingClicked()
         m_specificPids.clear();
     }
 
+    auto format = static_cast<MemoryRecorder::Format>(m_logFormatComboBox->currentData().toInt());
+    QString extension = format == MemoryRecorder::Binary ? "malog" : format == MemoryRecorder::Snapshot ? "masnap" : "csv";
+    QString filter = format == MemoryRecorder::Binary ? "Memory Logs (*.malog)"
+                     : format == MemoryRecorder::Snapshot ? "Memory Snapshots (*.masnap)" : "CSV Files (*.csv)";
     QString dateTime = QDateTime::currentDateTime().toString("yyyy-MM-dd_hh-mm-ss");
-    m_logContent = QString("Memory Usage Log - Started at %1\n").arg(dateTime);
-    m_logContent += QString("Interval: %1 %2\n").arg(intervalValue).arg(intervalUnit);
-    m_logContent += QString("Duration: %1 %2\n").arg(durationValue).arg(durationUnit);
-    if (m_specificPids.isEmpty()) {
-        m_logContent += "Logging: All Processes\n\n";
-    } else {
-        m_logContent += QString("Logging: Specific PIDs - %1\n\n").arg(m_pidsLineEdit->text());
+    QString defaultFileName = QString("memory_log_%1.%2").arg(dateTime).arg(extension);
+    QString fileName = QFileDialog::getSaveFileName(this, "Save Log To", defaultFileName, filter);
+    if (fileName.isEmpty()) return;
+
+    MemoryRecorder::Options options;
+    options.path = QFile::encodeName(fileName).toStdString();
+    options.format = format;
+    options.maxFileBytes = static_cast<uint64_t>(m_logRotateSizeSpinBox->value()) << 20;
+    options.maxFileAgeMs = static_cast<int64_t>(m_logRotateTimeSpinBox->value()) * 3600 * 1000;
+    std::string error;
+    if (!m_recorder.start(options, &error)) {
+        QMessageBox::critical(this, "Error", QString::fromStdString(error));
+        return;
     }
 
-    performLog();
-    m_loggingTimer->start(interval * 1000);
-    m_loggingStatusLabel->setText("Logging in progress...");
+    m_startLoggingButton->setEnabled(false);
+    m_stopLoggingButton->setEnabled(true);
+    // The first sample comes from a scan taken right away, the rest from
+    // scans on an exact interval grid (see handleScanDelta()).
+    worker->setConsumerInterval(SampleScheduler::Tracker, interval * 1000LL);
+}
+
+void MainWindow::onStopLoggingClicked()
+{
+    stopLogging("Logging stopped.");
 }
 
 void MainWindow::performLog()
 {
-    QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
-    m_logContent += QString("--- Log at %1 ---\n").arg(timestamp);
+    m_recorder.submit(captureFrame(m_specificPids));
 
-    QString memStr;
-    formatMemory(memStr, lastData.memTotal);
-    m_logContent += QString("Total Memory: %1\n").arg(memStr);
-    formatMemory(memStr, lastData.memAvailable);
-    m_logContent += QString("Available Memory: %1\n\n").arg(memStr);
+    m_logCount++;
+    MemoryRecorder::Stats stats = m_recorder.stats();
+    if (!stats.error.empty()) {
+        stopLogging(QString("Logging failed: %1").arg(QString::fromStdString(stats.error)));
+    } else if (m_logCount >= m_totalLogs) {
+        stopLogging("Logging completed.");
+    } else {
+        QString sizeStr;
+        formatMemory(sizeStr, static_cast<long>(stats.bytesWritten / 1024));
+        m_loggingStatusLabel->setText(QString("Logging in progress: %1 of %2 samples, %3 written to %4%5")
+                                          .arg(m_logCount).arg(m_totalLogs).arg(sizeStr)
+                                          .arg(QString::fromStdString(stats.currentFile))
+                                          .arg(stats.droppedFrames ? QString(", %1 dropped").arg(stats.droppedFrames) : QString()));
+    }
+}
 
-    m_logContent += "Processes:\n";
-    m_logContent += QString("%1; %2; %3\n").arg("Name", -30).arg("PID", -10).arg("Memory");
+RecorderFrame MainWindow::captureFrame(const QList<pid_t> &pids) const
+{
+    RecorderFrame frame;
+    frame.timeMs = lastData.timeMs ? lastData.timeMs : QDateTime::currentMSecsSinceEpoch();
+    frame.memTotal = lastData.memTotal;
+    frame.memAvailable = lastData.memAvailable;
 
-    if (m_specificPids.isEmpty()) {
-        for (const auto& process : lastData.processes) {
-            formatMemory(memStr, process.memory);
-            m_logContent += QString("%1; %2; %3\n").arg(process.name, -30).arg(process.pid, -10).arg(memStr);
+    const QVector<ProcessInfo> &processes = m_processModel->processes();
+    if (pids.isEmpty()) {
+        frame.samples.reserve(processes.size());
+        for (const ProcessInfo &process : processes) {
+            QByteArray name = process.name.toUtf8();
+            frame.add(process.pid, process.memory, process.growth, name.constData(), name.size());
         }
     } else {
-        for (pid_t pid : m_specificPids) {
-            auto it = std::find_if(lastData.processes.begin(), lastData.processes.end(),
-                                   [pid](const ProcessInfo& p) { return p.pid == pid; });
-            if (it != lastData.processes.end()) {
-                formatMemory(memStr, it->memory);
-                m_logContent += QString("%1; %2; %3\n").arg(it->name, -30).arg(it->pid, -10).arg(memStr);
-            } else {
-                m_logContent += QString("PID %1 not found.\n").arg(pid);
+        for (pid_t pid : pids) {
+            const ProcessInfo *process = m_processModel->findPid(pid);
+            if (!process) {
+                frame.missing.push_back(pid);
+                continue;
             }
+            QByteArray name = process->name.toUtf8();
+            frame.add(process->pid, process->memory, process->growth, name.constData(), name.size());
         }
     }
-    m_logContent += "\n";
+    return frame;
+}
 
-    m_logCount++;
-    if (m_logCount >= m_totalLogs) {
-        m_loggingTimer->stop();
-        m_logContent += "Logging completed.\n";
-
-        QString dateTime = QDateTime::currentDateTime().toString("yyyy-MM-dd_hh-mm-ss");
-        QString defaultFileName = QString("memory_report_%1.txt").arg(dateTime);
-        QString fileName = QFileDialog::getSaveFileName(this, "Save Log Report", defaultFileName, "Text Files (*.txt)");
-        if (!fileName.isEmpty()) {
-            QFile file(fileName);
-            if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-                QTextStream out(&file);
-                out << m_logContent;
-                file.close();
-                m_loggingStatusLabel->setText(QString("Log saved to %1").arg(fileName));
-            } else {
-                m_loggingStatusLabel->setText("Failed to save log.");
-            }
-        } else {
-            m_loggingStatusLabel->setText("Logging completed, but not saved.");
-        }
-        m_logContent = "";
-    }
+// Drains the recorder (bounded by its queue) and reports where the log went.
+void MainWindow::stopLogging(const QString &status)
+{
+    worker->setConsumerInterval(SampleScheduler::Tracker, 0);
+    m_recorder.stop();
+    MemoryRecorder::Stats stats = m_recorder.stats();
+    QString sizeStr;
+    formatMemory(sizeStr, static_cast<long>(stats.bytesWritten / 1024));
+    QString files = stats.files > 1 ? QString("%1 files ending with %2").arg(stats.files).arg(QString::fromStdString(stats.currentFile))
+                                    : QString::fromStdString(stats.currentFile);
+    m_loggingStatusLabel->setText(QString("%1 %2 samples, %3 saved to %4.").arg(status).arg(stats.frames).arg(sizeStr).arg(files));
+    m_startLoggingButton->setEnabled(true);
+    m_stopLoggingButton->setEnabled(false);
 }
 
 void MainWindow::formatMemory(QString& buffer, long kilobytes)
 {
-    if (kilobytes < 0) {
-        buffer = "N/A";
-    } else if (kilobytes < 1024) {
-        buffer = QString("%1 KB").arg(kilobytes);
-    } else if (kilobytes < 1024 * 1024) {
-        buffer = QString::asprintf("%.2f MB", kilobytes / 1024.0);
-    } else {
-        buffer = QString::asprintf("%.2f GB", kilobytes / (1024.0 * 1024.0));
-    }
+    buffer = ProcessTableModel::formatMemory(kilobytes);
 }
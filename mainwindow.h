@@ -7,6 +7,9 @@
 #include <QListWidget>
 #include <QStackedWidget>
 #include <QLabel>
+#include <QTableView>
+#include <QTreeView>
+#include <QSortFilterProxyModel>
 #include <QTableWidget>
 #include <QLineEdit>
 #include <QPushButton>
@@ -16,7 +19,16 @@
 #include <QFile>
 #include <QTextStream>
 #include <QComboBox>
+#include <QCheckBox>
+#include <QDoubleSpinBox>
+#include <QPlainTextEdit>
 #include "datatypes.h"
+#include "processtablemodel.h"
+#include "processfilter.h"
+#include "processtreemodel.h"
+#include "cgroupmodel.h"
+#include "memoryrecorder.h"
+#include "snapshotreplayer.h"
 
 class ProcessWorker;
 
@@ -29,16 +41,30 @@ public:
     ~MainWindow();
 
 private slots:
-    void handleResults(const AppData &data);
-    void handleThresholdAlert(const QString& message);
+    void handleStaticInfo(const StaticInfo &info);
+    void handleScanDelta(const ScanDelta &delta);
+    void handleAlerts();
     void onGetInfoButtonClicked();
     void onCompareButtonClicked();
+    void onShowHistoryClicked();
+    void onTopGrowersClicked();
     void onSetAlertButtonClicked();
     void onSaveReportButtonClicked();
+    void onSaveSnapshotClicked();
+    void onLoadRecordingClicked();
+    void onStopReplayClicked();
+    void handleReplayDelta(const ScanDelta &delta);
+    void handleReplayFinished(int frames, qint64 elapsedMs);
     void onSearchTextChanged(const QString &text);
+    void applySearchFilter();
+    void onProcessViewChanged(int index);
     void onGetTopNClicked();
     void onStartLoggingClicked();
-    void onIgnoreAlert();
+    void onStopLoggingClicked();
+    void onApplyScannerSettingsClicked();
+    void onPageChanged();
+    void onResetDiagnosticsClicked();
+    void onSaveDiagnosticsClicked();
 
 private:
     QWidget* createSystemOverviewPage();
@@ -48,8 +74,20 @@ private:
     QWidget* createSaveReportPage();
     QWidget* createTopNPage();
     QWidget* createTrackMemoryPage();
+    QWidget* createScannerSettingsPage();
+    QWidget* createDiagnosticsPage();
+    QWidget* createCgroupPage();
+    void handleResults(const AppData &data);
+    void applyDelta(const ScanDelta &delta);
+    void updateMemoryBreakdown(const MemInfo &info);
+    void updateGrowthTrends();
+    void updateDiagnostics();
+    void updateCgroupStatus(const ScanStats &stats);
     void formatMemory(QString& buffer, long kilobytes);
     void performLog();
+    void stopLogging(const QString &status);
+    // Current table contents; all processes if pids is empty
+    RecorderFrame captureFrame(const QList<pid_t> &pids) const;
 
     // Main layout
     QListWidget* m_sidebar;
@@ -59,31 +97,65 @@ private:
     QLabel* m_cpuModelLabel, *m_cpuCoresThreadsLabel, *m_cpuL1CacheLabel, *m_cpuL2CacheLabel, *m_cpuL3CacheLabel;
     QLabel* m_totalMemoryLabel, *m_availableMemoryLabel, *m_memoryTypeLabel, *m_memorySpeedLabel, *m_memorySlotsLabel;
     QLabel* m_gpuListLabel;
+    QTableWidget* m_memoryBreakdownTable;
+    MemInfoHistory m_memInfoHistory;
 
     // Page 1: Real-time Process Monitor
-    QTableWidget* m_processTableWidget;
+    QComboBox* m_processViewComboBox;
+    QStackedWidget* m_processViewStack;
+    QTableView* m_processTableView;
+    ProcessTableModel* m_processModel;
+    ProcessFilterProxy* m_processProxy;
     QLineEdit* m_searchLineEdit;
-    QString m_currentFilter;
+    QLabel* m_searchStatusLabel;
+    QTimer* m_searchDebounceTimer;
+    // Tree and grouped views; only fed deltas while shown
+    QTreeView* m_processTreeView;
+    ProcessTreeModel* m_processTreeModel;
+    QSortFilterProxyModel* m_processTreeProxy;
 
     // Page 2: Process Inspector
     QLineEdit* m_pidLineEdit, *m_pid1LineEdit, *m_pid2LineEdit;
     QPushButton* m_pidGetInfoButton, *m_pidCompareButton;
     QLabel* m_pidResultLabel, *m_compareResultLabel;
+    QLineEdit* m_historyPidLineEdit;
+    QComboBox* m_historyWindowComboBox;
+    QPushButton* m_showHistoryButton, *m_topGrowersButton;
+    QLabel* m_historyResultLabel;
+    QTableWidget* m_historyTable;
 
     // Page 3: Threshold Alert
+    QWidget* m_alertPage;
     QSpinBox* m_thresholdSpinBox;
+    QPlainTextEdit* m_alertRulesEdit;
     QPushButton* m_setAlertButton;
     QLabel* m_alertStatusLabel;
-    QPushButton* m_ignoreButton;
+    QSpinBox* m_stallSpinBox;
+    QLineEdit* m_pressureCgroupsLineEdit;
+    QSpinBox* m_leakHorizonSpinBox;
+    QSpinBox* m_leakLimitSpinBox;
+    QLabel* m_pressureStatusLabel;
+    QLabel* m_alertRulesStatusLabel;
+    QListWidget* m_alertList;
+    int m_unseenAlerts = 0;
 
     // Page 4: Save Report
     QPushButton* m_saveReportButton;
+    QPushButton* m_saveSnapshotButton;
     QLabel* m_reportStatusLabel;
+    QComboBox* m_replaySpeedComboBox;
+    QPushButton* m_loadRecordingButton;
+    QPushButton* m_stopReplayButton;
+    QLabel* m_replayStatusLabel;
+    SnapshotReplayer* m_replayer;
 
     // Page 5: Top N Processes
     QSpinBox* m_topNSpinBox;
+    QComboBox* m_topNKeyComboBox;
     QPushButton* m_topNButton;
-    QTableWidget* m_topNTableWidget;
+    QTableView* m_topNTableView;
+    ProcessTableModel* m_topNModel;
+    QTableWidget* m_growthTrendsTable;
 
     // Page 6: Track Memory Usage
     QSpinBox* m_intervalValueSpinBox;
@@ -93,21 +165,61 @@ private:
     QRadioButton* m_allRadio;
     QRadioButton* m_specificRadio;
     QLineEdit* m_pidsLineEdit;
+    QComboBox* m_logFormatComboBox;
+    QSpinBox* m_logRotateSizeSpinBox;
+    QSpinBox* m_logRotateTimeSpinBox;
     QPushButton* m_startLoggingButton;
+    QPushButton* m_stopLoggingButton;
     QLabel* m_loggingStatusLabel;
 
+    // Page 7: Scanner Settings
+    QSpinBox* m_fdCacheSpinBox;
+    QSpinBox* m_scanThreadsSpinBox;
+    QLabel* m_scanTimeLabel;
+    QPushButton* m_applyScannerSettingsButton;
+    QLabel* m_fdCacheStatsLabel;
+    QSpinBox* m_historyBudgetSpinBox;
+    QLabel* m_historyStatsLabel;
+    QDoubleSpinBox* m_smapsBudgetSpinBox;
+    QLabel* m_smapsStatusLabel;
+    QDoubleSpinBox* m_cpuBudgetSpinBox;
+    QLabel* m_refreshIntervalLabel;
+    QCheckBox* m_processEventsCheckBox;
+    QLineEdit* m_metricsAddressLineEdit;
+    QSpinBox* m_metricsTopSpinBox;
+    QLabel* m_metricsStatusLabel;
+    QLabel* m_processEventsStatusLabel;
+
+    // Page 8: Diagnostics
+    QWidget* m_diagnosticsPage;
+    QTableWidget* m_diagnosticsTable;
+    QLabel* m_diagnosticsCountersLabel;
+    QPushButton* m_resetDiagnosticsButton;
+    QPushButton* m_saveDiagnosticsButton;
+    ScanProfile m_scanProfile;
+
+    // Page 9: Cgroups; the worker only follows them while shown
+    QWidget* m_cgroupPage;
+    QLabel* m_cgroupStatusLabel;
+    QTreeView* m_cgroupTreeView;
+    CgroupModel* m_cgroupModel;
+    QSortFilterProxyModel* m_cgroupProxy;
+
     // Logging management
-    QTimer* m_loggingTimer;
     int m_logCount;
     int m_totalLogs;
-    QString m_logContent;
+    MemoryRecorder m_recorder;
     QList<pid_t> m_specificPids;
 
     // Worker thread members
     QThread* workerThread;
     ProcessWorker* worker;
     AppData lastData;
-    bool alertActive = false;
-    int currentThreshold = -1; // To track the current threshold
+    StaticInfo m_staticInfo;
+    quint64 m_generation = 0;
+    int m_rankingSize = 0;
+    QVector<pid_t> m_topByMemory;
+    QVector<pid_t> m_topByGrowth;
+    QVector<GrowthDetector::Trend> m_growthTrends;
 };
 #endif // MAINWINDOW_H
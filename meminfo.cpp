@@ -0,0 +1,156 @@
+#include "meminfo.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+namespace {
+
+const char *const kFieldNames[MemInfo::FieldCount] = {
+    "MemTotal", "MemFree", "MemAvailable", "Buffers", "Cached", "SwapCached",
+    "Active", "Inactive", "Active(anon)", "Inactive(anon)", "Active(file)", "Inactive(file)",
+    "Unevictable", "Mlocked", "SwapTotal", "SwapFree", "Dirty", "Writeback",
+    "AnonPages", "Mapped", "Shmem", "KReclaimable", "Slab", "SReclaimable", "SUnreclaim",
+    "KernelStack", "PageTables", "CommitLimit", "Committed_AS", "VmallocUsed",
+    "AnonHugePages", "HugePages_Total", "HugePages_Free", "HugePages_Rsvd", "HugePages_Surp",
+    "Hugepagesize", "Hugetlb",
+};
+
+// /proc/meminfo is about 1.5 KB on current kernels.
+const size_t kBufferSize = 8192;
+
+// Skips the spaces after "Name:" and parses the number; p is left at the
+// end of the line.
+long parseValue(const char *&p, const char *end)
+{
+    while (p < end && *p == ' ') ++p;
+    long value = 0;
+    while (p < end && *p >= '0' && *p <= '9') value = value * 10 + (*p++ - '0');
+    while (p < end && *p != '\n') ++p;
+    return value;
+}
+
+} // namespace
+
+void MemInfo::clear()
+{
+    for (long &value : values) value = -1;
+}
+
+const char *MemInfo::name(Field field)
+{
+    return field >= 0 && field < FieldCount ? kFieldNames[field] : "";
+}
+
+MemInfoReader::MemInfoReader(const char *procRoot)
+{
+    m_fd = ::open((std::string(procRoot) + "/meminfo").c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+MemInfoReader::~MemInfoReader()
+{
+    if (m_fd >= 0) ::close(m_fd);
+}
+
+bool MemInfoReader::read(MemInfo &out)
+{
+    out.clear();
+    if (m_fd < 0) return false;
+    char buf[kBufferSize];
+    ssize_t n;
+    do {
+        n = ::pread(m_fd, buf, sizeof(buf), 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return false;
+    const char *end = buf + n;
+
+    if (m_layout.empty() || !parseWithLayout(buf, end, out)) {
+        out.clear();
+        learnLayout(buf, end, out);
+    }
+    return out.values[MemInfo::MemTotal] > 0;
+}
+
+bool MemInfoReader::parseWithLayout(const char *buf, const char *end, MemInfo &out) const
+{
+    const char *p = buf;
+    for (const Line &line : m_layout) {
+        // The name is only checked by its length: a line that moved, or one
+        // the kernel added or dropped, puts the colon somewhere else.
+        if (p + line.nameLen >= end || p[line.nameLen] != ':') return false;
+        p += line.nameLen + 1;
+        if (line.field >= 0) {
+            out.values[line.field] = parseValue(p, end);
+        } else {
+            while (p < end && *p != '\n') ++p;
+        }
+        ++p;
+    }
+    return p >= end;
+}
+
+void MemInfoReader::learnLayout(const char *buf, const char *end, MemInfo &out)
+{
+    m_layout.clear();
+    const char *p = buf;
+    while (p < end) {
+        const char *colon = static_cast<const char *>(memchr(p, ':', end - p));
+        const char *newline = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!colon || (newline && newline < colon) || colon - p > 255) {
+            // Not a "Name: value" line; give up on the fast path for this layout.
+            m_layout.clear();
+            return;
+        }
+        Line line = {-1, static_cast<unsigned char>(colon - p)};
+        for (int i = 0; i < MemInfo::FieldCount; ++i) {
+            if (strlen(kFieldNames[i]) == line.nameLen && memcmp(kFieldNames[i], p, line.nameLen) == 0) {
+                line.field = i;
+                break;
+            }
+        }
+        m_layout.push_back(line);
+        p = colon + 1;
+        if (line.field >= 0) {
+            out.values[line.field] = parseValue(p, end);
+        } else {
+            while (p < end && *p != '\n') ++p;
+        }
+        ++p;
+    }
+}
+
+MemInfoHistory::MemInfoHistory(int64_t spacingMs, int64_t spanMs)
+    : m_spacingMs(spacingMs > 0 ? spacingMs : 1)
+{
+    m_ring.resize(static_cast<size_t>(spanMs / m_spacingMs) + 2);
+}
+
+void MemInfoHistory::append(int64_t timeMs, const MemInfo &info)
+{
+    if (m_count > 0) {
+        const Sample &latest = m_ring[(m_next + m_ring.size() - 1) % m_ring.size()];
+        if (timeMs < latest.timeMs) {
+            // The clock went back (a replay was restarted); start over.
+            m_count = 0;
+        } else if (timeMs - latest.timeMs < m_spacingMs) {
+            return;
+        }
+    }
+    m_ring[m_next] = {timeMs, info};
+    m_next = (m_next + 1) % m_ring.size();
+    if (m_count < m_ring.size()) ++m_count;
+}
+
+const MemInfo *MemInfoHistory::ago(int64_t ageMs) const
+{
+    if (m_count == 0) return nullptr;
+    size_t size = m_ring.size();
+    int64_t latest = m_ring[(m_next + size - 1) % size].timeMs;
+    for (size_t i = 1; i <= m_count; ++i) {
+        const Sample &sample = m_ring[(m_next + size - i) % size];
+        if (latest - sample.timeMs >= ageMs) return &sample.info;
+    }
+    return nullptr;
+}
@@ -0,0 +1,84 @@
+#ifndef MEMINFO_H
+#define MEMINFO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Everything from /proc/meminfo that helps explain where memory went. Values
+// are in KB, except the HugePages_* counts; -1 when the kernel does not
+// report a field (older kernels, or a replayed recording).
+struct MemInfo {
+    enum Field {
+        MemTotal, MemFree, MemAvailable, Buffers, Cached, SwapCached,
+        Active, Inactive, ActiveAnon, InactiveAnon, ActiveFile, InactiveFile,
+        Unevictable, Mlocked, SwapTotal, SwapFree, Dirty, Writeback,
+        AnonPages, Mapped, Shmem, KReclaimable, Slab, SReclaimable, SUnreclaim,
+        KernelStack, PageTables, CommitLimit, CommittedAS, VmallocUsed,
+        AnonHugePages, HugePagesTotal, HugePagesFree, HugePagesRsvd, HugePagesSurp,
+        Hugepagesize, Hugetlb,
+        FieldCount
+    };
+
+    long values[FieldCount];
+
+    MemInfo() { clear(); }
+    void clear();
+    long operator[](Field field) const { return values[field]; }
+    // The name as it appears in /proc/meminfo, without the colon
+    static const char *name(Field field);
+};
+
+// Reads /proc/meminfo with one pread() into a stack buffer and one pass over
+// it. The first read maps each line to its field by name; later reads only
+// check that each line still starts with the expected name length and a
+// colon, and take the number. If the layout changes, it is learnt again.
+class MemInfoReader
+{
+public:
+    explicit MemInfoReader(const char *procRoot = "/proc");
+    ~MemInfoReader();
+    MemInfoReader(const MemInfoReader &) = delete;
+    MemInfoReader &operator=(const MemInfoReader &) = delete;
+
+    bool read(MemInfo &out);
+
+private:
+    struct Line {
+        int field;              // -1: not a field we keep
+        unsigned char nameLen;
+    };
+
+    bool parseWithLayout(const char *buf, const char *end, MemInfo &out) const;
+    void learnLayout(const char *buf, const char *end, MemInfo &out);
+
+    int m_fd = -1;
+    std::vector<Line> m_layout;
+};
+
+// Samples of MemInfo at least spacingMs apart, covering the last hour, to
+// show how each part changed over the last minute, ten minutes and hour.
+class MemInfoHistory
+{
+public:
+    explicit MemInfoHistory(int64_t spacingMs = 10000, int64_t spanMs = 3600 * 1000);
+
+    void append(int64_t timeMs, const MemInfo &info);
+    // The newest sample at least ageMs older than the latest one, or nullptr
+    // if the history does not reach back that far.
+    const MemInfo *ago(int64_t ageMs) const;
+    bool isEmpty() const { return m_count == 0; }
+
+private:
+    struct Sample {
+        int64_t timeMs;
+        MemInfo info;
+    };
+
+    int64_t m_spacingMs;
+    std::vector<Sample> m_ring;
+    size_t m_next = 0;
+    size_t m_count = 0;
+};
+
+#endif // MEMINFO_H
@@ -0,0 +1,391 @@
+#include "memoryrecorder.h"
+#include "snapshotformat.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// Buffered output is written once it reaches this size, or when the next
+// fsync is due.
+const size_t kFlushBytes = 64 * 1024;
+
+// PIDs whose last name written to the binary log is remembered, beyond the
+// ones in the current frame; past that, the ones that are gone are forgotten.
+const size_t kNameSlack = 256;
+
+int64_t nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void putVarint(std::string &out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void putZigzag(std::string &out, int64_t value)
+{
+    putVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void putFixed64(std::string &out, int64_t value)
+{
+    uint64_t bits = static_cast<uint64_t>(value);
+    for (int i = 0; i < 8; ++i) out.push_back(static_cast<char>(bits >> (8 * i)));
+}
+
+void putDecimal(std::string &out, long long value)
+{
+    char text[24];
+    int len = snprintf(text, sizeof(text), "%lld", value);
+    out.append(text, len);
+}
+
+void putCsvField(std::string &out, const char *text, size_t len)
+{
+    if (std::find_if(text, text + len, [](char c) { return c == ',' || c == '"' || c == '\n'; }) == text + len) {
+        out.append(text, len);
+        return;
+    }
+    out.push_back('"');
+    for (size_t i = 0; i < len; ++i) {
+        if (text[i] == '"') out.push_back('"');
+        out.push_back(text[i]);
+    }
+    out.push_back('"');
+}
+
+} // namespace
+
+void RecorderFrame::add(pid_t pid, long memory, long growth, const char *name, size_t len)
+{
+    samples.push_back({pid, memory, growth, static_cast<uint32_t>(names.size()), static_cast<uint32_t>(len)});
+    names.append(name, len);
+}
+
+MemoryRecorder::MemoryRecorder()
+{
+}
+
+MemoryRecorder::~MemoryRecorder()
+{
+    stop();
+}
+
+bool MemoryRecorder::start(const Options &options, std::string *error)
+{
+    stop();
+    m_options = options;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats = Stats();
+        m_queue.clear();
+        m_queuedBytes = 0;
+    }
+    m_buffer.clear();
+    m_buffer.reserve(kFlushBytes * 2);
+    if (!openFile(error)) return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_running = true;
+    m_stopping = false;
+    m_stats.running = true;
+    m_thread = std::thread(&MemoryRecorder::writerLoop, this);
+    return true;
+}
+
+void MemoryRecorder::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) return;
+        m_stopping = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_running = false;
+    m_stats.running = false;
+}
+
+bool MemoryRecorder::isRunning() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_running;
+}
+
+bool MemoryRecorder::submit(RecorderFrame &&frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running || m_stopping || !m_stats.error.empty()) return false;
+        size_t bytes = frame.bytes();
+        if (!m_queue.empty() && m_queuedBytes + bytes > m_options.maxQueuedBytes) {
+            ++m_stats.droppedFrames;
+            return false;
+        }
+        m_queuedBytes += bytes;
+        m_queue.push_back(std::move(frame));
+    }
+    m_wake.notify_one();
+    return true;
+}
+
+MemoryRecorder::Stats MemoryRecorder::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void MemoryRecorder::writerLoop()
+{
+    std::deque<RecorderFrame> batch;
+    m_lastSyncMs = nowMs();
+    for (;;) {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            int64_t untilSync = m_lastSyncMs + m_options.fsyncIntervalMs - nowMs();
+            m_wake.wait_for(lock, std::chrono::milliseconds(std::max<int64_t>(untilSync, 1)),
+                            [this] { return m_stopping || !m_queue.empty(); });
+            batch.swap(m_queue);
+            m_queuedBytes = 0;
+            stopping = m_stopping;
+        }
+
+        size_t written = 0;
+        for (RecorderFrame &frame : batch) {
+            if (m_fd < 0) break;
+            int64_t now = nowMs();
+            bool full = m_options.maxFileBytes > 0 && m_fileBytes + m_buffer.size() >= m_options.maxFileBytes;
+            bool old = m_options.maxFileAgeMs > 0 && now - m_fileOpenedMs >= m_options.maxFileAgeMs;
+            if (full || old) {
+                closeFile();
+                std::string error;
+                if (!openFile(&error)) {
+                    fail(error);
+                    break;
+                }
+            }
+            encode(frame);
+            ++written;
+            if (m_buffer.size() >= kFlushBytes && !flushBuffer()) break;
+        }
+        if (!batch.empty()) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.frames += written;
+            m_stats.droppedFrames += batch.size() - written;
+        }
+        batch.clear();
+
+        if (m_fd >= 0 && nowMs() - m_lastSyncMs >= m_options.fsyncIntervalMs) {
+            if (flushBuffer()) fdatasync(m_fd);
+            m_lastSyncMs = nowMs();
+        }
+        if (stopping) break;
+    }
+    closeFile(true);
+}
+
+bool MemoryRecorder::openFile(std::string *error)
+{
+    int index;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        index = m_stats.files + 1;
+    }
+    std::string path = filePath(index);
+    m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        if (error) *error = "Could not open " + path + ": " + strerror(errno);
+        return false;
+    }
+    m_fileBytes = 0;
+    m_fileOpenedMs = nowMs();
+    m_namesInFile.clear();
+    if (m_options.format == Csv) {
+        m_buffer += "time_ms,pid,name,rss_kb\n";
+    } else if (m_options.format == Binary) {
+        m_buffer.append("MALOG\0\0\1", 8);
+    } else {
+        m_snapshot.reset(new SnapshotEncoder());
+        m_snapshot->begin(m_buffer);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.files = index;
+    m_stats.currentFile = path;
+    return true;
+}
+
+void MemoryRecorder::closeFile(bool syncInBackground)
+{
+    if (m_fd < 0) return;
+    if (m_snapshot) {
+        // The header goes in last, so an interrupted file reads as unfinished.
+        SnapshotHeader header = m_snapshot->finish(m_buffer);
+        m_snapshot.reset();
+        if (flushBuffer() && pwrite(m_fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+            fail(std::string("Write failed: ") + strerror(errno));
+        }
+    } else {
+        flushBuffer();
+    }
+    if (m_fd < 0) return;
+    int fd = m_fd;
+    m_fd = -1;
+    if (syncInBackground) {
+        // stop() joins the writer, and an fsync can take seconds
+        std::thread([fd] {
+            fdatasync(fd);
+            ::close(fd);
+        }).detach();
+        return;
+    }
+    fdatasync(fd);
+    ::close(fd);
+}
+
+bool MemoryRecorder::flushBuffer()
+{
+    const char *data = m_buffer.data();
+    size_t left = m_buffer.size();
+    while (left > 0) {
+        ssize_t written = ::write(m_fd, data, left);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            fail(std::string("Write failed: ") + strerror(errno));
+            return false;
+        }
+        data += written;
+        left -= static_cast<size_t>(written);
+    }
+    m_fileBytes += m_buffer.size();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.bytesWritten += m_buffer.size();
+    }
+    m_buffer.clear();
+    return true;
+}
+
+void MemoryRecorder::fail(const std::string &message)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.error = message;
+    }
+    m_buffer.clear();
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+std::string MemoryRecorder::filePath(int index) const
+{
+    if (index == 1) return m_options.path;
+    const std::string &path = m_options.path;
+    size_t slash = path.rfind('/');
+    size_t dot = path.rfind('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash) || dot == slash + 1) dot = path.size();
+    return path.substr(0, dot) + "-" + std::to_string(index) + path.substr(dot);
+}
+
+void MemoryRecorder::encode(RecorderFrame &frame)
+{
+    if (m_options.format == Csv) {
+        encodeCsv(frame);
+    } else if (m_options.format == Binary) {
+        encodeBinary(frame);
+    } else {
+        m_snapshot->addFrame(m_buffer, frame);
+    }
+}
+
+void MemoryRecorder::encodeCsv(const RecorderFrame &frame)
+{
+    putDecimal(m_buffer, frame.timeMs);
+    m_buffer += ",,MemTotal,";
+    putDecimal(m_buffer, frame.memTotal);
+    m_buffer.push_back('\n');
+    putDecimal(m_buffer, frame.timeMs);
+    m_buffer += ",,MemAvailable,";
+    putDecimal(m_buffer, frame.memAvailable);
+    m_buffer.push_back('\n');
+    for (const RecorderFrame::Sample &sample : frame.samples) {
+        putDecimal(m_buffer, frame.timeMs);
+        m_buffer.push_back(',');
+        putDecimal(m_buffer, sample.pid);
+        m_buffer.push_back(',');
+        putCsvField(m_buffer, frame.names.data() + sample.nameOffset, sample.nameLen);
+        m_buffer.push_back(',');
+        putDecimal(m_buffer, sample.memory);
+        m_buffer.push_back('\n');
+    }
+    for (pid_t pid : frame.missing) {
+        putDecimal(m_buffer, frame.timeMs);
+        m_buffer.push_back(',');
+        putDecimal(m_buffer, pid);
+        m_buffer += ",,not found\n";
+    }
+}
+
+void MemoryRecorder::encodeBinary(RecorderFrame &frame)
+{
+    std::sort(frame.samples.begin(), frame.samples.end(),
+              [](const RecorderFrame::Sample &a, const RecorderFrame::Sample &b) { return a.pid < b.pid; });
+
+    for (const RecorderFrame::Sample &sample : frame.samples) {
+        const char *name = frame.names.data() + sample.nameOffset;
+        auto known = m_namesInFile.find(sample.pid);
+        if (known != m_namesInFile.end() && known->second.size() == sample.nameLen
+            && memcmp(known->second.data(), name, sample.nameLen) == 0) {
+            continue;
+        }
+        m_namesInFile[sample.pid].assign(name, sample.nameLen);
+        m_buffer.push_back('N');
+        putVarint(m_buffer, static_cast<uint64_t>(sample.pid));
+        putVarint(m_buffer, sample.nameLen);
+        m_buffer.append(name, sample.nameLen);
+    }
+    // Forget the PIDs that have gone, or the map grows to every PID ever seen
+    if (m_namesInFile.size() > frame.samples.size() + kNameSlack) {
+        for (auto it = m_namesInFile.begin(); it != m_namesInFile.end();) {
+            auto sample = std::lower_bound(frame.samples.begin(), frame.samples.end(), it->first,
+                                           [](const RecorderFrame::Sample &s, pid_t pid) { return s.pid < pid; });
+            bool present = sample != frame.samples.end() && sample->pid == it->first;
+            it = present ? std::next(it) : m_namesInFile.erase(it);
+        }
+    }
+
+    if (!frame.missing.empty()) {
+        m_buffer.push_back('X');
+        putVarint(m_buffer, frame.missing.size());
+        for (pid_t pid : frame.missing) putVarint(m_buffer, static_cast<uint64_t>(pid));
+    }
+    m_buffer.push_back('F');
+    putFixed64(m_buffer, frame.timeMs);
+    putFixed64(m_buffer, frame.memTotal);
+    putFixed64(m_buffer, frame.memAvailable);
+    putVarint(m_buffer, frame.samples.size());
+    pid_t previous = 0;
+    for (const RecorderFrame::Sample &sample : frame.samples) {
+        putZigzag(m_buffer, static_cast<int64_t>(sample.pid) - previous);
+        putZigzag(m_buffer, sample.memory);
+        previous = sample.pid;
+    }
+}
@@ -0,0 +1,137 @@
+#ifndef MEMORYRECORDER_H
+#define MEMORYRECORDER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+
+class SnapshotEncoder;
+
+// One logging tick: system totals plus the processes being tracked. Names
+// are packed into a single buffer so a frame costs two allocations.
+struct RecorderFrame {
+    struct Sample {
+        pid_t pid;
+        long memory;
+        long growth;
+        uint32_t nameOffset;
+        uint32_t nameLen;
+    };
+
+    int64_t timeMs = 0;
+    long memTotal = 0;
+    long memAvailable = 0;
+    std::vector<Sample> samples;
+    std::string names;
+    std::vector<pid_t> missing;  // PIDs asked for that were not found
+
+    void add(pid_t pid, long memory, long growth, const char *name, size_t len);
+    size_t bytes() const
+    {
+        return sizeof(RecorderFrame) + samples.size() * sizeof(Sample) + names.size() + missing.size() * sizeof(pid_t);
+    }
+};
+
+// Streams frames to disk from a writer thread, so tracking for hours costs
+// a bounded queue instead of an ever-growing string. Output is batched into
+// large write() calls, fsync()ed periodically and rotated by size or age:
+// the first file is the chosen path, later ones get "-2", "-3", ... before
+// the extension. Each file is self-contained.
+//
+// CSV: "time_ms,pid,name,rss_kb", with system totals as rows with an empty
+// PID named MemTotal and MemAvailable, and a PID that was asked for but not
+// found as a row with an empty name and "not found" for rss_kb.
+//
+// Binary: the 8-byte magic "MALOG\0\0\1", then records of one type byte:
+//   'N' varint pid, varint length, UTF-8 name -- before a PID's first sample
+//       in the file and whenever its name changes; it may also be sent
+//       again, unchanged, after the PID was absent for a while. Readers
+//       keep the last 'N' per PID.
+//   'X' varint count, then count varint PIDs -- asked for but not found in
+//       the 'F' record that follows
+//   'F' int64 time_ms, int64 mem_total_kb, int64 mem_available_kb (all
+//       little-endian), varint count, then count pairs of zigzag varints:
+//       PID minus the previous PID (samples are sorted by PID) and RSS in KB
+//
+// Snapshot: the mmap()able .masnap format from snapshotformat.h, which the
+// app can replay. It has no place for PIDs that were not found.
+class MemoryRecorder
+{
+public:
+    enum Format { Csv, Binary, Snapshot };
+
+    struct Options {
+        std::string path;
+        Format format = Csv;
+        uint64_t maxFileBytes = 0;  // 0: no size limit
+        int64_t maxFileAgeMs = 0;   // 0: no time limit
+        int64_t fsyncIntervalMs = 5000;
+        size_t maxQueuedBytes = 8 * 1024 * 1024;
+    };
+
+    struct Stats {
+        bool running = false;
+        uint64_t frames = 0;
+        uint64_t bytesWritten = 0;
+        uint64_t droppedFrames = 0;
+        int files = 0;
+        std::string currentFile;
+        std::string error;
+    };
+
+    MemoryRecorder();
+    ~MemoryRecorder();
+
+    // Opens the first file before returning, so a bad path fails here.
+    bool start(const Options &options, std::string *error = nullptr);
+    // Writes everything still queued and closes the file. The final fsync
+    // runs in the background, so this only waits for the writes.
+    void stop();
+    bool isRunning() const;
+
+    // Never blocks on I/O. Returns false if the frame was dropped because the
+    // queue is full or the recorder has failed.
+    bool submit(RecorderFrame &&frame);
+
+    Stats stats() const;
+
+private:
+    void writerLoop();
+    bool openFile(std::string *error);
+    void closeFile(bool syncInBackground = false);
+    bool flushBuffer();
+    void encode(RecorderFrame &frame);
+    void encodeCsv(const RecorderFrame &frame);
+    void encodeBinary(RecorderFrame &frame);
+    std::string filePath(int index) const;
+    void fail(const std::string &message);
+
+    Options m_options;
+    std::thread m_thread;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<RecorderFrame> m_queue;
+    size_t m_queuedBytes = 0;
+    bool m_running = false;
+    bool m_stopping = false;
+    Stats m_stats;
+
+    // Writer thread only
+    int m_fd = -1;
+    std::string m_buffer;
+    uint64_t m_fileBytes = 0;
+    int64_t m_fileOpenedMs = 0;
+    int64_t m_lastSyncMs = 0;
+    std::unordered_map<pid_t, std::string> m_namesInFile;
+    std::unique_ptr<SnapshotEncoder> m_snapshot;
+};
+
+#endif // MEMORYRECORDER_H
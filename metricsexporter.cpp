@@ -0,0 +1,532 @@
+#include "metricsexporter.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+// Requests are a line and a few headers; anything longer is not a scraper.
+const size_t kMaxRequestBytes = 8192;
+
+const char kContentType[] = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+int64_t nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Length of the UTF-8 sequence starting at data, or 0 if it is not one
+size_t utf8Length(const unsigned char *data, size_t len)
+{
+    unsigned char lead = data[0];
+    size_t length;
+    if (lead < 0x80) return 1;
+    if (lead >= 0xc2 && lead <= 0xdf) {
+        length = 2;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+        length = 3;
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+        length = 4;
+    } else {
+        return 0;
+    }
+    if (length > len) return 0;
+    for (size_t i = 1; i < length; ++i) {
+        if ((data[i] & 0xc0) != 0x80) return 0;
+    }
+    // Overlong three- and four-byte forms, surrogates and beyond U+10FFFF
+    if (lead == 0xe0 && data[1] < 0xa0) return 0;
+    if (lead == 0xed && data[1] >= 0xa0) return 0;
+    if (lead == 0xf0 && data[1] < 0x90) return 0;
+    if (lead == 0xf4 && data[1] >= 0x90) return 0;
+    return length;
+}
+
+void appendEscaped(std::string &out, const char *value, size_t len)
+{
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(value);
+    size_t i = 0;
+    while (i < len) {
+        unsigned char c = data[i];
+        if (c == '\\' || c == '"') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (c < 0x20 || c == 0x7f) {
+            out += '?';
+        } else if (c >= 0x80) {
+            size_t length = utf8Length(data + i, len - i);
+            if (length == 0) {
+                out += '?';
+                ++i;
+                continue;
+            }
+            out.append(value + i, length);
+            i += length;
+            continue;
+        } else {
+            out += static_cast<char>(c);
+        }
+        ++i;
+    }
+}
+
+// Case-insensitive search for a header line, e.g. "connection: close"
+bool hasHeader(const char *begin, const char *end, const char *line)
+{
+    size_t len = strlen(line);
+    for (const char *p = begin; p + len <= end; ++p) {
+        if ((p == begin || p[-1] == '\n') && strncasecmp(p, line, len) == 0) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+void MetricsText::clear(size_t reserve)
+{
+    m_text.clear();
+    m_text.reserve(reserve);
+}
+
+void MetricsText::family(const char *name, const char *type, const char *help, const char *unit)
+{
+    m_text += "# TYPE ";
+    m_text += name;
+    m_text += ' ';
+    m_text += type;
+    m_text += '\n';
+    if (unit) {
+        m_text += "# UNIT ";
+        m_text += name;
+        m_text += ' ';
+        m_text += unit;
+        m_text += '\n';
+    }
+    m_text += "# HELP ";
+    m_text += name;
+    m_text += ' ';
+    m_text += help;
+    m_text += '\n';
+}
+
+void MetricsText::beginSample(const char *name, std::initializer_list<Label> labels)
+{
+    m_text += name;
+    if (labels.size()) {
+        char separator = '{';
+        for (const Label &label : labels) {
+            m_text += separator;
+            m_text += label.name;
+            m_text += "=\"";
+            appendEscaped(m_text, label.value, label.len);
+            m_text += '"';
+            separator = ',';
+        }
+        m_text += '}';
+    }
+    m_text += ' ';
+}
+
+void MetricsText::sample(const char *name, std::initializer_list<Label> labels, int64_t value)
+{
+    beginSample(name, labels);
+    char number[24];
+    auto result = std::to_chars(number, number + sizeof(number), value);
+    m_text.append(number, result.ptr);
+    m_text += '\n';
+}
+
+void MetricsText::sample(const char *name, std::initializer_list<Label> labels, double value)
+{
+    beginSample(name, labels);
+    char number[32];
+    int len = snprintf(number, sizeof(number), "%.9g", value);
+    m_text.append(number, static_cast<size_t>(std::max(len, 0)));
+    m_text += '\n';
+}
+
+void MetricsText::finish()
+{
+    m_text += "# EOF\n";
+}
+
+MetricsExporter::MetricsExporter() = default;
+
+MetricsExporter::~MetricsExporter()
+{
+    stop();
+}
+
+bool MetricsExporter::start(const Options &options, std::string *error)
+{
+    stop();
+    m_options = options;
+    std::string message;
+    if (!listenOn(options.address, &message) || ::pipe2(m_wakeFds, O_CLOEXEC) != 0) {
+        if (message.empty()) message = std::string("pipe2: ") + strerror(errno);
+        if (error) *error = message;
+        stop();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.error = message;
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.running = true;
+        m_stats.error.clear();
+    }
+    m_thread = std::thread(&MetricsExporter::run, this);
+    return true;
+}
+
+void MetricsExporter::stop()
+{
+    if (m_thread.joinable()) {
+        if (::write(m_wakeFds[1], "x", 1) < 0) {
+            // Only fails if the pipe is full, which already wakes the thread.
+        }
+        m_thread.join();
+    }
+    for (Client &client : m_clients) ::close(client.fd);
+    m_clients.clear();
+    if (m_listenFd >= 0) ::close(m_listenFd);
+    m_listenFd = -1;
+    if (!m_unixPath.empty()) ::unlink(m_unixPath.c_str());
+    m_unixPath.clear();
+    for (int &fd : m_wakeFds) {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.running = false;
+    m_stats.clients = 0;
+}
+
+void MetricsExporter::publish(std::string &&exposition)
+{
+    auto shared = std::make_shared<const std::string>(std::move(exposition));
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_exposition.swap(shared);
+    // The old buffer is freed here, or by the last scrape still writing it.
+}
+
+MetricsExporter::Stats MetricsExporter::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+bool MetricsExporter::listenOn(const std::string &address, std::string *error)
+{
+    sockaddr_storage storage = {};
+    socklen_t storageLen = 0;
+    if (address.compare(0, 5, "unix:") == 0) {
+        std::string path = address.substr(5);
+        sockaddr_un *un = reinterpret_cast<sockaddr_un *>(&storage);
+        if (path.empty() || path.size() >= sizeof(un->sun_path)) {
+            *error = "Invalid socket path: " + path;
+            return false;
+        }
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path, path.c_str(), path.size() + 1);
+        storageLen = sizeof(sockaddr_un);
+        // A socket left behind by a crash is replaced, one in use is not.
+        struct stat st;
+        if (::lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+            int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            bool inUse = probe >= 0 && ::connect(probe, reinterpret_cast<sockaddr *>(un), storageLen) == 0;
+            if (probe >= 0) ::close(probe);
+            if (inUse) {
+                *error = path + " is in use by another process";
+                return false;
+            }
+            ::unlink(path.c_str());
+        }
+    } else {
+        size_t colon = address.rfind(':');
+        if (colon == std::string::npos) {
+            *error = "Expected host:port or unix:/path, got \"" + address + "\"";
+            return false;
+        }
+        std::string host = address.substr(0, colon);
+        if (host.size() >= 2 && host.front() == '[' && host.back() == ']') host = host.substr(1, host.size() - 2);
+        if (host.empty() || host == "localhost") host = "127.0.0.1";
+        int port = -1;
+        const char *portBegin = address.c_str() + colon + 1;
+        auto parsed = std::from_chars(portBegin, address.c_str() + address.size(), port);
+        if (parsed.ec != std::errc() || *parsed.ptr != '\0' || port < 0 || port > 65535) {
+            *error = "Invalid port in \"" + address + "\"";
+            return false;
+        }
+        sockaddr_in *in4 = reinterpret_cast<sockaddr_in *>(&storage);
+        sockaddr_in6 *in6 = reinterpret_cast<sockaddr_in6 *>(&storage);
+        if (::inet_pton(AF_INET, host.c_str(), &in4->sin_addr) == 1) {
+            if ((ntohl(in4->sin_addr.s_addr) >> 24) != 127) {
+                *error = host + " is not a loopback address; put a proxy in front to serve other hosts";
+                return false;
+            }
+            in4->sin_family = AF_INET;
+            in4->sin_port = htons(static_cast<uint16_t>(port));
+            storageLen = sizeof(sockaddr_in);
+        } else if (::inet_pton(AF_INET6, host.c_str(), &in6->sin6_addr) == 1) {
+            if (!IN6_IS_ADDR_LOOPBACK(&in6->sin6_addr)) {
+                *error = host + " is not a loopback address; put a proxy in front to serve other hosts";
+                return false;
+            }
+            in6->sin6_family = AF_INET6;
+            in6->sin6_port = htons(static_cast<uint16_t>(port));
+            storageLen = sizeof(sockaddr_in6);
+        } else {
+            *error = "Not a numeric loopback address: " + host;
+            return false;
+        }
+    }
+
+    m_listenFd = ::socket(storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_listenFd < 0) {
+        *error = std::string("socket: ") + strerror(errno);
+        return false;
+    }
+    int one = 1;
+    if (storage.ss_family != AF_UNIX) ::setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (::bind(m_listenFd, reinterpret_cast<sockaddr *>(&storage), storageLen) != 0
+        || ::listen(m_listenFd, SOMAXCONN) != 0) {
+        *error = "Could not listen on " + address + ": " + strerror(errno);
+        return false;
+    }
+
+    std::string bound = address;
+    if (storage.ss_family == AF_UNIX) {
+        m_unixPath = address.substr(5);
+        // Only the owner and its group may read which processes run.
+        ::chmod(m_unixPath.c_str(), 0660);
+    } else {
+        socklen_t len = sizeof(storage);
+        char host[INET6_ADDRSTRLEN] = {};
+        if (::getsockname(m_listenFd, reinterpret_cast<sockaddr *>(&storage), &len) == 0) {
+            if (storage.ss_family == AF_INET) {
+                const sockaddr_in *in4 = reinterpret_cast<const sockaddr_in *>(&storage);
+                ::inet_ntop(AF_INET, &in4->sin_addr, host, sizeof(host));
+                bound = std::string(host) + ":" + std::to_string(ntohs(in4->sin_port));
+            } else {
+                const sockaddr_in6 *in6 = reinterpret_cast<const sockaddr_in6 *>(&storage);
+                ::inet_ntop(AF_INET6, &in6->sin6_addr, host, sizeof(host));
+                bound = "[" + std::string(host) + "]:" + std::to_string(ntohs(in6->sin6_port));
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.address = bound;
+    return true;
+}
+
+void MetricsExporter::run()
+{
+    std::vector<pollfd> fds;
+    for (;;) {
+        fds.clear();
+        fds.push_back({m_wakeFds[0], POLLIN, 0});
+        fds.push_back({m_listenFd, POLLIN, 0});
+        for (const Client &client : m_clients) {
+            fds.push_back({client.fd, static_cast<short>(client.header.empty() ? POLLIN : POLLOUT), 0});
+        }
+        // Only idle clients need a timeout.
+        int n = ::poll(fds.data(), fds.size(), m_clients.empty() ? -1 : 1000);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.error = std::string("poll: ") + strerror(errno);
+            return;
+        }
+        if (fds[0].revents) return;
+
+        int64_t now = nowMs();
+        size_t kept = 0;
+        for (size_t i = 0; i < m_clients.size(); ++i) {
+            Client &client = m_clients[i];
+            short revents = fds[i + 2].revents;
+            bool open = true;
+            if (revents & (POLLERR | POLLNVAL)) {
+                open = false;
+            } else if (revents & POLLOUT) {
+                open = writeResponse(client);
+                client.lastActiveMs = now;
+            } else if (revents & (POLLIN | POLLHUP)) {
+                open = readRequest(client);
+                client.lastActiveMs = now;
+            } else if (now - client.lastActiveMs > m_options.idleTimeoutMs) {
+                open = false;
+            }
+            if (open) {
+                if (kept != i) m_clients[kept] = std::move(client);
+                ++kept;
+            } else {
+                ::close(client.fd);
+            }
+        }
+        m_clients.resize(kept);
+        if (fds[1].revents & POLLIN) accept();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.clients = static_cast<int>(m_clients.size());
+    }
+}
+
+void MetricsExporter::accept()
+{
+    for (;;) {
+        int fd = ::accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return; // EAGAIN, or out of descriptors until a client leaves
+        if (static_cast<int>(m_clients.size()) >= m_options.maxClients) {
+            ::close(fd);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_stats.rejected;
+            continue;
+        }
+        Client client;
+        client.fd = fd;
+        client.lastActiveMs = nowMs();
+        m_clients.push_back(std::move(client));
+    }
+}
+
+bool MetricsExporter::readRequest(Client &client)
+{
+    char buf[4096];
+    for (;;) {
+        ssize_t n = ::recv(client.fd, buf, sizeof(buf), 0);
+        if (n == 0) return false;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        client.request.append(buf, static_cast<size_t>(n));
+        if (client.request.size() > kMaxRequestBytes) break;
+    }
+    size_t end = client.request.find("\r\n\r\n");
+    if (end == std::string::npos) {
+        if (client.request.size() <= kMaxRequestBytes) return true;
+        client.header = "HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        client.closeAfter = true;
+        client.request.clear();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_stats.rejected;
+    } else {
+        respond(client, end + 4);
+    }
+    // Most responses fit the socket buffer; try right away.
+    return writeResponse(client);
+}
+
+void MetricsExporter::respond(Client &client, size_t requestLen)
+{
+    const char *begin = client.request.data();
+    const char *end = begin + requestLen;
+    const char *lineEnd = static_cast<const char *>(memchr(begin, '\r', requestLen));
+    std::string line(begin, lineEnd ? lineEnd : end);
+    size_t methodEnd = line.find(' ');
+    size_t targetEnd = methodEnd == std::string::npos ? std::string::npos : line.find(' ', methodEnd + 1);
+    std::string method = line.substr(0, methodEnd);
+    std::string target = targetEnd == std::string::npos ? std::string() : line.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+    std::string path = target.substr(0, target.find('?'));
+    bool http11 = targetEnd != std::string::npos && line.compare(targetEnd + 1, std::string::npos, "HTTP/1.1") == 0;
+    client.closeAfter = http11 ? hasHeader(begin, end, "connection: close")
+                               : !hasHeader(begin, end, "connection: keep-alive");
+    const char *connection = client.closeAfter ? "close" : "keep-alive";
+    client.request.erase(0, requestLen);
+
+    char header[256];
+    if (targetEnd == std::string::npos) {
+        client.closeAfter = true;
+        snprintf(header, sizeof(header), "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    } else if (method != "GET" && method != "HEAD") {
+        snprintf(header, sizeof(header),
+                 "HTTP/1.1 405 Method Not Allowed\r\nAllow: GET, HEAD\r\nContent-Length: 0\r\nConnection: %s\r\n\r\n",
+                 connection);
+    } else if (path != "/metrics" && path != "/") {
+        snprintf(header, sizeof(header), "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: %s\r\n\r\n",
+                 connection);
+    } else {
+        std::shared_ptr<const std::string> exposition;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            exposition = m_exposition;
+        }
+        if (!exposition) {
+            snprintf(header, sizeof(header),
+                     "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 1\r\nContent-Length: 0\r\nConnection: %s\r\n\r\n",
+                     connection);
+        } else {
+            snprintf(header, sizeof(header),
+                     "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: %s\r\n\r\n",
+                     kContentType, exposition->size(), connection);
+            if (method == "GET") client.body = std::move(exposition);
+            client.header = header;
+            if (!client.body) client.body = std::make_shared<const std::string>();
+            return;
+        }
+    }
+    client.header = header;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_stats.rejected;
+}
+
+bool MetricsExporter::writeResponse(Client &client)
+{
+    for (;;) {
+        if (client.header.empty()) return true;
+        size_t headerLen = client.header.size();
+        size_t bodyLen = client.body ? client.body->size() : 0;
+        size_t total = headerLen + bodyLen;
+        while (client.sent < total) {
+            iovec iov[2];
+            int count = 0;
+            if (client.sent < headerLen) {
+                iov[count++] = {const_cast<char *>(client.header.data()) + client.sent, headerLen - client.sent};
+            }
+            if (bodyLen) {
+                size_t offset = client.sent > headerLen ? client.sent - headerLen : 0;
+                iov[count++] = {const_cast<char *>(client.body->data()) + offset, bodyLen - offset};
+            }
+            msghdr message = {};
+            message.msg_iov = iov;
+            message.msg_iovlen = count;
+            ssize_t n = ::sendmsg(client.fd, &message, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            client.sent += static_cast<size_t>(n);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (client.body) ++m_stats.scrapes;
+            m_stats.bytesServed += total;
+        }
+        client.header.clear();
+        client.body.reset();
+        client.sent = 0;
+        if (client.closeAfter) return false;
+        // A pipelined request may already be waiting.
+        size_t end = client.request.find("\r\n\r\n");
+        if (end == std::string::npos) return true;
+        respond(client, end + 4);
+    }
+}
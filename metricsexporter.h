@@ -0,0 +1,126 @@
+#ifndef METRICSEXPORTER_H
+#define METRICSEXPORTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes the OpenMetrics text format. Label values are escaped, and bytes
+// that are not valid UTF-8 (process names can hold anything) are replaced,
+// since a scraper rejects the whole exposition over one bad byte.
+class MetricsText
+{
+public:
+    struct Label {
+        const char *name;
+        const char *value;
+        size_t len;
+    };
+
+    // Starts over with room for the given size, e.g. the last build's
+    void clear(size_t reserve = 0);
+    // Starts a metric family; unit may be null. Counters take their samples
+    // as name + "_total".
+    void family(const char *name, const char *type, const char *help, const char *unit = nullptr);
+    void sample(const char *name, std::initializer_list<Label> labels, int64_t value);
+    void sample(const char *name, std::initializer_list<Label> labels, double value);
+    void sample(const char *name, int64_t value) { sample(name, {}, value); }
+    void sample(const char *name, double value) { sample(name, {}, value); }
+    // Ends the exposition with "# EOF"
+    void finish();
+
+    const std::string &text() const { return m_text; }
+    std::string &text() { return m_text; }
+
+private:
+    void beginSample(const char *name, std::initializer_list<Label> labels);
+
+    std::string m_text;
+};
+
+// Serves the latest OpenMetrics exposition over HTTP from a thread of its
+// own, for Prometheus and compatible scrapers. The exposition is built by
+// the caller once per scan and handed over with publish(); a scrape only
+// writes the current buffer out (with writev, next to a small header), so
+// it costs the same whether it comes once a second or not at all, and never
+// waits for a scan.
+//
+// Listens on a loopback TCP address or a Unix socket only: the data names
+// every process on the machine, so exposing it further is left to a proxy
+// that can authenticate. Keep-alive connections are served; GET and HEAD
+// of /metrics (or /) are the only requests answered with data.
+class MetricsExporter
+{
+public:
+    struct Options {
+        // "127.0.0.1:9464", "localhost:9464", "[::1]:9464", ":9464" (IPv4
+        // loopback) or "unix:/path/to/socket"
+        std::string address;
+        int maxClients = 16;
+        int idleTimeoutMs = 30000;
+    };
+
+    struct Stats {
+        bool running = false;
+        std::string address;           // as bound, e.g. the port picked for ":0"
+        unsigned long long scrapes = 0;
+        unsigned long long bytesServed = 0;
+        unsigned long long rejected = 0; // bad requests, other paths, clients over the limit
+        int clients = 0;
+        std::string error;
+    };
+
+    MetricsExporter();
+    ~MetricsExporter();
+    MetricsExporter(const MetricsExporter &) = delete;
+    MetricsExporter &operator=(const MetricsExporter &) = delete;
+
+    // Binds before returning, so a bad or busy address fails here.
+    bool start(const Options &options, std::string *error = nullptr);
+    void stop();
+    bool isRunning() const { return m_thread.joinable(); }
+
+    // Replaces what scrapes get from now on; scrapes already being written
+    // keep the buffer they started with. Until the first call, scrapes are
+    // answered 503.
+    void publish(std::string &&exposition);
+
+    Stats stats() const;
+
+private:
+    struct Client {
+        int fd = -1;
+        std::string request;
+        std::string header;
+        std::shared_ptr<const std::string> body;
+        size_t sent = 0;            // of header + body
+        bool closeAfter = false;
+        int64_t lastActiveMs = 0;
+    };
+
+    bool listenOn(const std::string &address, std::string *error);
+    void run();
+    void accept();
+    // False once the client is to be closed
+    bool readRequest(Client &client);
+    bool writeResponse(Client &client);
+    void respond(Client &client, size_t requestLen);
+
+    Options m_options;
+    std::thread m_thread;
+    int m_listenFd = -1;
+    int m_wakeFds[2] = {-1, -1};
+    std::string m_unixPath;
+    std::vector<Client> m_clients; // exporter thread only
+
+    mutable std::mutex m_mutex;
+    std::shared_ptr<const std::string> m_exposition;
+    Stats m_stats;
+};
+
+#endif // METRICSEXPORTER_H
@@ -0,0 +1,245 @@
+#include "pressuremonitor.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Trigger window granularity the kernel requires from unprivileged users
+const int kUnprivilegedWindowMs = 2000;
+
+double nowMs()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Reads a small /proc or cgroup file from the start into buf, NUL-terminated.
+ssize_t readAll(int fd, char *buf, size_t size)
+{
+    ssize_t n;
+    do {
+        n = ::pread(fd, buf, size - 1, 0);
+    } while (n < 0 && errno == EINTR);
+    buf[n > 0 ? n : 0] = '\0';
+    return n;
+}
+
+// "some avg10=1.23 ..." -> 0.0123, or -1
+double parseSomeAvg10(const char *text)
+{
+    const char *some = strstr(text, "some avg10=");
+    if (!some) return -1;
+    return strtod(some + 11, nullptr) / 100.0;
+}
+
+} // namespace
+
+PressureMonitor::PressureMonitor(const char *procRoot, const char *cgroupRoot)
+    : m_procRoot(procRoot), m_cgroupRoot(cgroupRoot), m_memInfo(procRoot)
+{
+    // Hybrid hierarchies mount cgroup v2 below the v1 controllers.
+    std::string unified = m_cgroupRoot + "/unified";
+    if (::access((m_cgroupRoot + "/cgroup.controllers").c_str(), F_OK) != 0
+        && ::access((unified + "/cgroup.controllers").c_str(), F_OK) == 0) {
+        m_cgroupRoot = unified;
+    }
+}
+
+PressureMonitor::~PressureMonitor()
+{
+    stop();
+}
+
+bool PressureMonitor::addTrigger(const std::string &path, const std::string &source, std::string *error)
+{
+    int fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        if (error) *error = path + ": " + strerror(errno);
+        return false;
+    }
+    char trigger[64];
+    int len = snprintf(trigger, sizeof(trigger), "some %d %d", m_options.stallMs * 1000, m_options.windowMs * 1000);
+    // The kernel wants the terminating NUL as part of the write.
+    if (::write(fd, trigger, len + 1) < 0) {
+        int writeError = errno;
+        if (error) *error = path + ": " + strerror(writeError);
+        ::close(fd);
+        errno = writeError;
+        return false;
+    }
+    m_triggers.push_back({fd, source});
+    return true;
+}
+
+bool PressureMonitor::start(const Options &options, Callback callback, std::string *error)
+{
+    stop();
+    m_options = options;
+    m_options.stallMs = std::clamp(m_options.stallMs, 1, m_options.windowMs);
+    m_callback = std::move(callback);
+    m_aboveThreshold = false;
+
+    Stats stats;
+    bool registered = addTrigger(m_procRoot + "/pressure/memory", "system", &stats.error);
+    if (!registered && errno == EINVAL && m_options.windowMs % kUnprivilegedWindowMs != 0) {
+        // Without CAP_SYS_RESOURCE the window must be a multiple of 2 s;
+        // keep the same stall ratio.
+        int window = (m_options.windowMs / kUnprivilegedWindowMs + 1) * kUnprivilegedWindowMs;
+        m_options.stallMs = m_options.stallMs * window / m_options.windowMs;
+        m_options.windowMs = window;
+        registered = addTrigger(m_procRoot + "/pressure/memory", "system", &stats.error);
+        if (registered) stats.error = "window raised to " + std::to_string(window) + " ms (no CAP_SYS_RESOURCE)";
+    }
+    if (registered) {
+        stats.mode = Psi;
+        for (const std::string &cgroup : m_options.cgroups) {
+            std::string cgroupError;
+            if (!addTrigger(m_cgroupRoot + "/" + cgroup + "/memory.pressure", cgroup, &cgroupError)) {
+                stats.error += (stats.error.empty() ? "" : "; ") + cgroupError;
+            }
+        }
+    } else {
+        stats.mode = MeminfoPolling;
+    }
+    stats.triggers = static_cast<int>(m_triggers.size());
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats = stats;
+    }
+
+    if (::pipe2(m_wakeFds, O_CLOEXEC) != 0) {
+        if (error) *error = std::string("pipe2: ") + strerror(errno);
+        stop();
+        return false;
+    }
+    m_thread = std::thread(&PressureMonitor::run, this);
+    return true;
+}
+
+void PressureMonitor::stop()
+{
+    if (m_thread.joinable()) {
+        if (::write(m_wakeFds[1], "x", 1) < 0) {
+            // Only fails if the pipe is full, which already wakes the thread.
+        }
+        m_thread.join();
+    }
+    for (const Trigger &trigger : m_triggers) ::close(trigger.fd);
+    m_triggers.clear();
+    for (int &fd : m_wakeFds) {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.mode = Off;
+}
+
+void PressureMonitor::run()
+{
+    std::vector<pollfd> fds;
+    fds.push_back({m_wakeFds[0], POLLIN, 0});
+    for (const Trigger &trigger : m_triggers) fds.push_back({trigger.fd, POLLPRI, 0});
+    bool polling = m_triggers.empty();
+    int timeout = polling ? std::max(m_options.pollIntervalMs, 1) : -1;
+    // The kernel evaluates a trigger every tenth of its window.
+    double kernelLatencyMs = m_options.windowMs / 10.0;
+    double lastPoll = nowMs();
+    char buf[256];
+
+    for (;;) {
+        int n = ::poll(fds.data(), fds.size(), timeout);
+        double woke = nowMs();
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (fds[0].revents) return;
+        if (polling) {
+            pollMeminfo(woke - lastPoll);
+            lastPoll = woke;
+            continue;
+        }
+        for (size_t i = 1; i < fds.size();) {
+            const Trigger &trigger = m_triggers[i - 1];
+            if (fds[i].revents & POLLERR) {
+                // The cgroup was removed.
+                ::close(trigger.fd);
+                m_triggers.erase(m_triggers.begin() + (i - 1));
+                fds.erase(fds.begin() + i);
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stats.triggers = static_cast<int>(m_triggers.size());
+                continue;
+            }
+            if (fds[i].revents & POLLPRI) {
+                readAll(trigger.fd, buf, sizeof(buf));
+                char message[192];
+                snprintf(message, sizeof(message),
+                         "Memory pressure: tasks stalled on memory for over %d ms within %d ms (%s, some avg10=%.2f%%)",
+                         m_options.stallMs, m_options.windowMs, trigger.source.c_str(),
+                         std::max(parseSomeAvg10(buf), 0.0) * 100);
+                report(trigger.source, message, kernelLatencyMs + (nowMs() - woke));
+            }
+            ++i;
+        }
+    }
+}
+
+void PressureMonitor::pollMeminfo(double sinceLastMs)
+{
+    int threshold = m_thresholdPercent;
+    if (threshold <= 0) {
+        m_aboveThreshold = false;
+        return;
+    }
+    double started = nowMs();
+    MemInfo info;
+    if (!m_memInfo.read(info)) return;
+    long total = info[MemInfo::MemTotal];
+    long available = info[MemInfo::MemAvailable];
+    if (available < 0) return;
+
+    int usagePercent = static_cast<int>(100.0 * (total - available) / total);
+    bool above = usagePercent > threshold;
+    // One alert per crossing, not one per poll.
+    if (above && !m_aboveThreshold) {
+        char message[128];
+        snprintf(message, sizeof(message), "Warning: Memory usage is at %d%%, exceeding threshold of %d%%!",
+                 usagePercent, threshold);
+        report("meminfo", message, sinceLastMs + (nowMs() - started));
+    }
+    m_aboveThreshold = above;
+}
+
+void PressureMonitor::report(const std::string &source, const std::string &message, double latencyMs)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_stats.alerts;
+        m_stats.lastLatencyMs = latencyMs;
+        m_stats.worstLatencyMs = std::max(m_stats.worstLatencyMs, latencyMs);
+    }
+    if (m_callback) m_callback({source, message, latencyMs});
+}
+
+double PressureMonitor::systemPressure() const
+{
+    int fd = ::open((m_procRoot + "/pressure/memory").c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    char buf[256];
+    readAll(fd, buf, sizeof(buf));
+    ::close(fd);
+    return parseSomeAvg10(buf);
+}
+
+PressureMonitor::Stats PressureMonitor::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
@@ -0,0 +1,98 @@
+#ifndef PRESSUREMONITOR_H
+#define PRESSUREMONITOR_H
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "meminfo.h"
+
+// Memory pressure alerts that do not wait for the next scan. On kernels with
+// PSI, a trigger ("some <stall> <window>") is registered on
+// /proc/pressure/memory and on the memory.pressure file of each configured
+// cgroup, and a dedicated thread sleeps in poll() until the kernel reports
+// that tasks were stalled on memory for more than stall within window. The
+// kernel checks triggers every window / 10, so an alert arrives at most
+// that long (plus our own wake-up) after the threshold is crossed.
+//
+// Without PSI the thread polls /proc/meminfo every pollIntervalMs instead
+// and alerts when used memory crosses the threshold percentage; the
+// detection latency is then bounded by the polling interval.
+class PressureMonitor
+{
+public:
+    enum Mode { Off, Psi, MeminfoPolling };
+
+    struct Options {
+        int stallMs = 150;
+        int windowMs = 1000;            // the kernel accepts 500 ms to 10 s
+        std::vector<std::string> cgroups; // relative to the cgroup v2 root
+        int pollIntervalMs = 100;
+    };
+
+    struct Alert {
+        std::string source;  // "system", a cgroup path or "meminfo"
+        std::string message;
+        double latencyMs;    // upper bound on time from crossing to this alert
+    };
+
+    struct Stats {
+        Mode mode = Off;
+        int triggers = 0;    // PSI triggers registered
+        unsigned long long alerts = 0;
+        double lastLatencyMs = 0;
+        double worstLatencyMs = 0;
+        std::string error;   // why PSI (or a cgroup) could not be used
+    };
+
+    using Callback = std::function<void(const Alert &)>;
+
+    explicit PressureMonitor(const char *procRoot = "/proc", const char *cgroupRoot = "/sys/fs/cgroup");
+    ~PressureMonitor();
+    PressureMonitor(const PressureMonitor &) = delete;
+    PressureMonitor &operator=(const PressureMonitor &) = delete;
+
+    // The callback runs on the monitor's thread. Falls back to polling
+    // meminfo when the system-wide trigger cannot be registered; returns
+    // false only if the thread could not be started at all.
+    bool start(const Options &options, Callback callback, std::string *error = nullptr);
+    void stop();
+    bool isRunning() const { return m_thread.joinable(); }
+
+    // Used-memory percentage for meminfo polling; <= 0 disables it
+    void setMemoryThreshold(int percent) { m_thresholdPercent = percent; }
+
+    // "some avg10" of /proc/pressure/memory as a fraction, or -1 without PSI
+    double systemPressure() const;
+
+    Stats stats() const;
+
+private:
+    struct Trigger {
+        int fd;
+        std::string source;
+    };
+
+    bool addTrigger(const std::string &path, const std::string &source, std::string *error);
+    void run();
+    void pollMeminfo(double sinceLastMs);
+    void report(const std::string &source, const std::string &message, double latencyMs);
+
+    std::string m_procRoot;
+    std::string m_cgroupRoot;
+    MemInfoReader m_memInfo;  // used by the monitor thread only
+    Options m_options;
+    Callback m_callback;
+    std::thread m_thread;
+    int m_wakeFds[2] = {-1, -1};
+    std::vector<Trigger> m_triggers;
+    std::atomic<int> m_thresholdPercent{-1};
+    bool m_aboveThreshold = false;
+
+    mutable std::mutex m_mutex;
+    Stats m_stats;
+};
+
+#endif // PRESSUREMONITOR_H
@@ -0,0 +1,275 @@
+#include "processfilter.h"
+#include "processtablemodel.h"
+
+#include <algorithm>
+
+int ProcessNameIndex::intern(const QString &name)
+{
+    QString folded = name.toCaseFolded();
+    auto it = m_idOfName.constFind(folded);
+    if (it != m_idOfName.constEnd()) {
+        ++m_names[it.value()].refs;
+        return it.value();
+    }
+
+    int id;
+    if (!m_freeIds.isEmpty()) {
+        id = m_freeIds.takeLast();
+    } else {
+        id = m_names.size();
+        m_names.append(Name());
+    }
+    Name &entry = m_names[id];
+    entry.folded = folded;
+    entry.refs = 1;
+    ++entry.stamp;
+    m_idOfName.insert(folded, id);
+    indexTrigrams(id, true);
+    return id;
+}
+
+void ProcessNameIndex::release(int id)
+{
+    if (id < 0 || id >= m_names.size() || m_names[id].refs == 0) return;
+    if (--m_names[id].refs > 0) return;
+    indexTrigrams(id, false);
+    m_idOfName.remove(m_names[id].folded);
+    m_names[id].folded.clear();
+    m_freeIds.append(id);
+}
+
+quint64 ProcessNameIndex::trigramKey(const QString &s, int pos)
+{
+    return (quint64(s.at(pos).unicode()) << 32) | (quint64(s.at(pos + 1).unicode()) << 16)
+           | quint64(s.at(pos + 2).unicode());
+}
+
+void ProcessNameIndex::indexTrigrams(int id, bool add)
+{
+    const QString &folded = m_names.at(id).folded;
+    for (int pos = 0; pos + 3 <= folded.size(); ++pos) {
+        quint64 key = trigramKey(folded, pos);
+        if (add) {
+            QVector<int> &ids = m_trigrams[key];
+            // A name repeating a trigram ("aaaa") is listed once.
+            if (ids.isEmpty() || ids.last() != id) ids.append(id);
+        } else {
+            auto it = m_trigrams.find(key);
+            if (it == m_trigrams.end()) continue;
+            it->removeAll(id);
+            if (it->isEmpty()) m_trigrams.erase(it);
+        }
+    }
+}
+
+QVector<int> ProcessNameIndex::candidates(const QString &foldedNeedle) const
+{
+    if (foldedNeedle.size() < 3) return liveIds();
+
+    const QVector<int> *best = nullptr;
+    for (int pos = 0; pos + 3 <= foldedNeedle.size(); ++pos) {
+        auto it = m_trigrams.constFind(trigramKey(foldedNeedle, pos));
+        if (it == m_trigrams.constEnd()) return QVector<int>();
+        if (!best || it->size() < best->size()) best = &it.value();
+    }
+    return *best;
+}
+
+QVector<int> ProcessNameIndex::liveIds() const
+{
+    QVector<int> ids;
+    ids.reserve(m_idOfName.size());
+    for (int id = 0; id < m_names.size(); ++id) {
+        if (m_names.at(id).refs > 0) ids.append(id);
+    }
+    return ids;
+}
+
+namespace {
+
+// Parses "500", "500K", "1.5G", "200MB" into kilobytes.
+bool parseKilobytes(QString text, long &kilobytes)
+{
+    text = text.trimmed().toUpper();
+    if (text.endsWith('B')) text.chop(1);
+    double scale = 1;
+    if (text.endsWith('K')) {
+        text.chop(1);
+    } else if (text.endsWith('M')) {
+        scale = 1024;
+        text.chop(1);
+    } else if (text.endsWith('G')) {
+        scale = 1024.0 * 1024.0;
+        text.chop(1);
+    }
+    bool ok;
+    double value = text.toDouble(&ok);
+    if (!ok || value < 0) return false;
+    kilobytes = static_cast<long>(value * scale);
+    return true;
+}
+
+} // namespace
+
+ProcessQuery ProcessQuery::parse(const QString &text)
+{
+    ProcessQuery query;
+    const QStringList terms = text.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
+    for (const QString &term : terms) {
+        QString lower = term.toLower();
+        if (lower.startsWith("pid:")) {
+            QStringList bounds = term.mid(4).split('-');
+            bool okMin = false, okMax = false;
+            long low = bounds.value(0).toLong(&okMin);
+            long high = bounds.size() > 1 ? bounds.value(1).toLong(&okMax) : low;
+            if (!okMin || (bounds.size() > 1 && !okMax) || bounds.size() > 2) {
+                query.error = QString("Invalid PID term \\"%1\\"").arg(term);
+                return query;
+            }
+            query.pidMin = static_cast<pid_t>(low);
+            query.pidMax = static_cast<pid_t>(high);
+        } else if (lower.startsWith("mem") && term.size() > 3 && QString("<>=").contains(term.at(3))) {
+            QString rest = term.mid(3);
+            QString op = rest.left(rest.size() > 1 && rest.at(1) == '=' ? 2 : 1);
+            long value;
+            if (!parseKilobytes(rest.mid(op.size()), value)) {
+                query.error = QString("Invalid memory term \\"%1\\"").arg(term);
+                return query;
+            }
+            if (op == ">") query.memMin = value + 1;
+            else if (op == ">=") query.memMin = value;
+            else if (op == "<") query.memMax = qMax(0L, value - 1);
+            else if (op == "<=") query.memMax = value;
+            else query.memMin = query.memMax = value;
+        } else if (lower.startsWith("re:") || (term.size() >= 2 && term.startsWith('/') && term.endsWith('/'))) {
+            QString pattern = lower.startsWith("re:") ? term.mid(3) : term.mid(1, term.size() - 2);
+            if (query.hasRegex) {
+                query.error = "Only one regular expression is supported";
+                return query;
+            }
+            query.regex = QRegularExpression(pattern, QRegularExpression::CaseInsensitiveOption);
+            if (!query.regex.isValid()) {
+                query.error = QString("Invalid regular expression: %1").arg(query.regex.errorString());
+                return query;
+            }
+            query.hasRegex = true;
+        } else {
+            query.substrings.append(term.toCaseFolded());
+        }
+    }
+    return query;
+}
+
+bool ProcessQuery::isEmpty() const
+{
+    return !hasNameTerms() && pidMin < 0 && memMin < 0 && memMax < 0;
+}
+
+bool ProcessQuery::matchesName(const QString &folded) const
+{
+    for (const QString &needle : substrings) {
+        if (!folded.contains(needle)) return false;
+    }
+    return !hasRegex || regex.match(folded).hasMatch();
+}
+
+bool ProcessQuery::refines(const ProcessQuery &other) const
+{
+    if (!other.hasNameTerms()) return false;
+    if (other.hasRegex && (!hasRegex || regex.pattern() != other.regex.pattern())) return false;
+    for (const QString &needle : other.substrings) {
+        bool covered = std::any_of(substrings.begin(), substrings.end(),
+                                   [&needle](const QString &s) { return s.contains(needle); });
+        if (!covered) return false;
+    }
+    return true;
+}
+
+ProcessFilterProxy::ProcessFilterProxy(QObject *parent) : QSortFilterProxyModel(parent)
+{
+}
+
+void ProcessFilterProxy::setProcessModel(ProcessTableModel *model)
+{
+    m_model = model;
+    setSourceModel(model);
+}
+
+bool ProcessFilterProxy::setQuery(const QString &text, QString *error)
+{
+    ProcessQuery query = ProcessQuery::parse(text);
+    if (!query.error.isEmpty()) {
+        if (error) *error = query.error;
+        return false;
+    }
+
+    const ProcessNameIndex &index = m_model->nameIndex();
+    m_evaluatedStamp.resize(index.capacity());
+    m_accepted.resize(index.capacity());
+
+    if (query.hasNameTerms()) {
+        bool refine = query.refines(m_query);
+        QVector<int> candidates;
+        if (refine) {
+            candidates = m_matchedIds;
+            // Names evaluated under the old query without matching cannot
+            // match a narrower one; the rest stay lazy.
+            for (int id = 0; id < index.capacity(); ++id) {
+                if (index.isLive(id) && m_evaluatedStamp[id] == index.stamp(id)) m_accepted[id] = false;
+            }
+        } else {
+            const QString *longest = nullptr;
+            for (const QString &needle : query.substrings) {
+                if (!longest || needle.size() > longest->size()) longest = &needle;
+            }
+            candidates = longest ? index.candidates(*longest) : index.liveIds();
+            for (int id = 0; id < index.capacity(); ++id) {
+                m_evaluatedStamp[id] = index.stamp(id);
+                m_accepted[id] = false;
+            }
+        }
+
+        m_matchedIds.clear();
+        for (int id : candidates) {
+            if (!index.isLive(id)) continue;
+            bool match = query.matchesName(index.folded(id));
+            m_evaluatedStamp[id] = index.stamp(id);
+            m_accepted[id] = match;
+            if (match) m_matchedIds.append(id);
+        }
+    } else {
+        m_matchedIds.clear();
+    }
+
+    m_query = query;
+    invalidateFilter();
+    return true;
+}
+
+bool ProcessFilterProxy::nameAccepted(int id) const
+{
+    const ProcessNameIndex &index = m_model->nameIndex();
+    if (id >= m_evaluatedStamp.size()) {
+        m_evaluatedStamp.resize(index.capacity());
+        m_accepted.resize(index.capacity());
+    }
+    if (m_evaluatedStamp[id] != index.stamp(id)) {
+        // A name that appeared (or an id that was reused) after the query ran.
+        m_evaluatedStamp[id] = index.stamp(id);
+        m_accepted[id] = m_query.matchesName(index.folded(id));
+        if (m_accepted[id]) m_matchedIds.append(id);
+    }
+    return m_accepted[id];
+}
+
+bool ProcessFilterProxy::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    Q_UNUSED(sourceParent);
+    if (!m_model || m_query.isEmpty()) return true;
+    const ProcessInfo &process = m_model->processes().at(sourceRow);
+    if (m_query.pidMin >= 0 && (process.pid < m_query.pidMin || process.pid > m_query.pidMax)) return false;
+    if (m_query.memMin >= 0 && process.memory < m_query.memMin) return false;
+    if (m_query.memMax >= 0 && process.memory > m_query.memMax) return false;
+    if (m_query.hasNameTerms()) return nameAccepted(m_model->nameIdAt(sourceRow));
+    return true;
+}
@@ -0,0 +1,102 @@
+#ifndef PROCESSFILTER_H
+#define PROCESSFILTER_H
+
+#include <QHash>
+#include <QRegularExpression>
+#include <QSortFilterProxyModel>
+#include <QString>
+#include <QVector>
+#include <sys/types.h>
+
+class ProcessTableModel;
+
+// Case-folded process names, interned once per distinct name (200 "chrome"
+// workers share one entry) with a trigram index over them. Ids are reused
+// after a name's last process exits; stamp() changes whenever that happens.
+class ProcessNameIndex
+{
+public:
+    int intern(const QString &name);
+    void release(int id);
+
+    int capacity() const { return m_names.size(); }
+    bool isLive(int id) const { return m_names.at(id).refs > 0; }
+    const QString &folded(int id) const { return m_names.at(id).folded; }
+    quint32 stamp(int id) const { return m_names.at(id).stamp; }
+
+    // Ids of names that may contain needle (already case-folded): the
+    // shortest trigram posting list, or every live name for needles shorter
+    // than three characters. Callers still have to verify each candidate.
+    QVector<int> candidates(const QString &foldedNeedle) const;
+    QVector<int> liveIds() const;
+
+private:
+    static quint64 trigramKey(const QString &s, int pos);
+    void indexTrigrams(int id, bool add);
+
+    struct Name {
+        QString folded;
+        int refs = 0;
+        quint32 stamp = 0;
+    };
+    QVector<Name> m_names;
+    QVector<int> m_freeIds;
+    QHash<QString, int> m_idOfName;
+    QHash<quint64, QVector<int>> m_trigrams;
+};
+
+// A parsed filter. Whitespace-separated terms must all match:
+//   chrome          name contains "chrome" (case-insensitive)
+//   re:^kworker     name matches the regular expression (also /^kworker/)
+//   pid:1234        PID equals, or pid:100-200 for a range
+//   mem>500M        memory compared with >, >=, <, <= or =; K/M/G suffixes,
+//                   plain numbers are in KB
+struct ProcessQuery {
+    QVector<QString> substrings; // case-folded
+    QRegularExpression regex;
+    bool hasRegex = false;
+    pid_t pidMin = -1;
+    pid_t pidMax = -1;
+    long memMin = -1;
+    long memMax = -1;
+    QString error;
+
+    static ProcessQuery parse(const QString &text);
+    bool isEmpty() const;
+    bool hasNameTerms() const { return !substrings.isEmpty() || hasRegex; }
+    bool matchesName(const QString &folded) const;
+    // True if every row matching this query also matches other.
+    bool refines(const ProcessQuery &other) const;
+};
+
+// Filters the process table through the name index. A new query is resolved
+// to a set of name ids once (only re-checking the previous matches when the
+// query merely got longer), after which each row is accepted by an id lookup
+// and numeric comparisons. Rows the worker adds later are checked as they
+// arrive, since their names may not have existed when the query ran.
+class ProcessFilterProxy : public QSortFilterProxyModel
+{
+    Q_OBJECT
+public:
+    explicit ProcessFilterProxy(QObject *parent = nullptr);
+
+    void setProcessModel(ProcessTableModel *model);
+    // Returns false (and keeps the old filter) if the text does not parse.
+    bool setQuery(const QString &text, QString *error = nullptr);
+    int matchedNameCount() const { return m_matchedIds.size(); }
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+private:
+    bool nameAccepted(int id) const;
+
+    ProcessTableModel *m_model = nullptr;
+    ProcessQuery m_query;
+    mutable QVector<int> m_matchedIds;
+    // Per name id: the stamp it was evaluated under and the result.
+    mutable QVector<quint32> m_evaluatedStamp;
+    mutable QVector<bool> m_accepted;
+};
+
+#endif // PROCESSFILTER_H
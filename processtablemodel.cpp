@@ -0,0 +1,195 @@
+#include "processtablemodel.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+
+ProcessTableModel::ProcessTableModel(QObject *parent) : QAbstractTableModel(parent)
+{
+}
+
+int ProcessTableModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_rows.size();
+}
+
+int ProcessTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant ProcessTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size()) return QVariant();
+    const ProcessInfo &process = m_rows.at(index.row());
+
+    if (role == Qt::DisplayRole) {
+        switch (index.column()) {
+        case NameColumn: return process.name;
+        case PidColumn: return static_cast<int>(process.pid);
+        case MemoryColumn: return formatMemory(process.memory);
+        case GrowthColumn: return formatGrowth(process.growth);
+        case PssColumn: return formatMemory(process.pss);
+        case UssColumn: return formatMemory(process.uss);
+        case SwapColumn: return formatMemory(process.swap);
+        }
+    } else if (role == SortRole) {
+        switch (index.column()) {
+        case NameColumn: return process.name;
+        case PidColumn: return static_cast<int>(process.pid);
+        case MemoryColumn: return static_cast<qlonglong>(process.memory);
+        case GrowthColumn: return static_cast<qlonglong>(process.growth);
+        case PssColumn: return static_cast<qlonglong>(process.pss);
+        case UssColumn: return static_cast<qlonglong>(process.uss);
+        case SwapColumn: return static_cast<qlonglong>(process.swap);
+        }
+    }
+    return QVariant();
+}
+
+QVariant ProcessTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::ToolTipRole) {
+        switch (section) {
+        case MemoryColumn: return QString("Resident set size; counts shared libraries and shared memory in full");
+        case PssColumn: return QString("Proportional set size; shared pages split among the processes using them");
+        case UssColumn: return QString("Unique set size; memory freed if this process exited");
+        case SwapColumn: return QString("Swapped out");
+        }
+    }
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    switch (section) {
+    case NameColumn: return QString("Process Name");
+    case PidColumn: return QString("PID");
+    case MemoryColumn: return QString("Memory Usage");
+    case GrowthColumn: return QString("Growth");
+    case PssColumn: return QString("PSS");
+    case UssColumn: return QString("USS");
+    case SwapColumn: return QString("Swap");
+    }
+    return QVariant();
+}
+
+void ProcessTableModel::setProcesses(const QVector<ProcessInfo> &processes)
+{
+    beginResetModel();
+    for (int id : m_nameIds) m_nameIndex.release(id);
+    m_rows = processes;
+    m_nameIds.resize(m_rows.size());
+    for (int i = 0; i < m_rows.size(); ++i) m_nameIds[i] = m_nameIndex.intern(m_rows.at(i).name);
+    m_rowOfPid.clear();
+    m_rowOfPid.reserve(m_rows.size());
+    reindexFrom(0);
+    endResetModel();
+}
+
+void ProcessTableModel::applyDelta(const ScanDelta &delta)
+{
+    if (delta.baseGeneration == 0) {
+        setProcesses(QVector<ProcessInfo>(delta.added.begin(), delta.added.end()));
+        return;
+    }
+
+    if (!delta.removed.isEmpty()) {
+        QVector<int> doomed;
+        doomed.reserve(delta.removed.size());
+        for (pid_t pid : delta.removed) {
+            auto it = m_rowOfPid.constFind(pid);
+            if (it != m_rowOfPid.constEnd()) doomed.append(it.value());
+        }
+        std::sort(doomed.begin(), doomed.end(), std::greater<int>());
+
+        // Remove contiguous runs bottom-up so the rows still to be removed
+        // keep their numbers.
+        int i = 0;
+        while (i < doomed.size()) {
+            int last = doomed[i];
+            int first = last;
+            for (++i; i < doomed.size() && doomed[i] == first - 1; ++i) first = doomed[i];
+            beginRemoveRows(QModelIndex(), first, last);
+            for (int row = first; row <= last; ++row) {
+                m_rowOfPid.remove(m_rows[row].pid);
+                m_nameIndex.release(m_nameIds[row]);
+            }
+            m_rows.remove(first, last - first + 1);
+            m_nameIds.remove(first, last - first + 1);
+            endRemoveRows();
+        }
+        if (!doomed.isEmpty()) reindexFrom(doomed.last());
+    }
+
+    QVector<ProcessInfo> appended;
+    for (const ProcessInfo &info : delta.added) {
+        auto it = m_rowOfPid.constFind(info.pid);
+        if (it == m_rowOfPid.constEnd()) {
+            appended.append(info);
+            continue;
+        }
+        int row = it.value();
+        if (m_rows[row].name != info.name) {
+            m_nameIndex.release(m_nameIds[row]);
+            m_nameIds[row] = m_nameIndex.intern(info.name);
+        }
+        m_rows[row] = info;
+        emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
+    }
+    if (!appended.isEmpty()) {
+        int first = m_rows.size();
+        beginInsertRows(QModelIndex(), first, first + appended.size() - 1);
+        m_rows += appended;
+        for (const ProcessInfo &info : appended) m_nameIds.append(m_nameIndex.intern(info.name));
+        reindexFrom(first);
+        endInsertRows();
+    }
+
+    const QVector<int> roles = {Qt::DisplayRole, SortRole};
+    for (const ProcessUpdate &update : delta.changed) {
+        auto it = m_rowOfPid.constFind(update.pid);
+        if (it == m_rowOfPid.constEnd()) continue;
+        int row = it.value();
+        ProcessInfo &process = m_rows[row];
+        if (process.memory == update.memory && process.growth == update.growth && process.pss == update.pss
+            && process.uss == update.uss && process.swap == update.swap) {
+            continue;
+        }
+        process.memory = update.memory;
+        process.growth = update.growth;
+        process.pss = update.pss;
+        process.uss = update.uss;
+        process.swap = update.swap;
+        emit dataChanged(index(row, MemoryColumn), index(row, SwapColumn), roles);
+    }
+}
+
+const ProcessInfo *ProcessTableModel::findPid(pid_t pid) const
+{
+    auto it = m_rowOfPid.constFind(pid);
+    return it == m_rowOfPid.constEnd() ? nullptr : &m_rows.at(it.value());
+}
+
+QString ProcessTableModel::formatMemory(long kilobytes)
+{
+    if (kilobytes < 0) {
+        return QString("N/A");
+    } else if (kilobytes < 1024) {
+        return QString("%1 KB").arg(kilobytes);
+    } else if (kilobytes < 1024 * 1024) {
+        return QString::asprintf("%.2f MB", kilobytes / 1024.0);
+    } else {
+        return QString::asprintf("%.2f GB", kilobytes / (1024.0 * 1024.0));
+    }
+}
+
+QString ProcessTableModel::formatGrowth(long kilobytesPerSecond)
+{
+    if (kilobytesPerSecond == 0) return QString("0 KB/s");
+    QString sign = kilobytesPerSecond > 0 ? "+" : "-";
+    return sign + formatMemory(std::labs(kilobytesPerSecond)) + "/s";
+}
+
+void ProcessTableModel::reindexFrom(int row)
+{
+    for (int i = row; i < m_rows.size(); ++i) m_rowOfPid.insert(m_rows.at(i).pid, i);
+}
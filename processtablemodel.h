@@ -0,0 +1,52 @@
+#ifndef PROCESSTABLEMODEL_H
+#define PROCESSTABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QVector>
+#include "datatypes.h"
+#include "processfilter.h"
+
+// Table model over a contiguous array of processes. Deltas from the worker
+// are applied in place: exited PIDs become row removals, new PIDs are
+// appended as row insertions and memory changes only emit dataChanged for
+// the affected cells, so views keep their scroll position and selection.
+// Text is formatted in data(), i.e. only for rows a view actually paints.
+class ProcessTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    enum Column { NameColumn, PidColumn, MemoryColumn, GrowthColumn, PssColumn, UssColumn, SwapColumn, ColumnCount };
+    // Raw value of a cell, for sorting by number instead of by text
+    static const int SortRole = Qt::UserRole + 1;
+
+    explicit ProcessTableModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    // Replaces all rows. Meant for full snapshots and small tables.
+    void setProcesses(const QVector<ProcessInfo> &processes);
+    void applyDelta(const ScanDelta &delta);
+
+    const QVector<ProcessInfo> &processes() const { return m_rows; }
+    const ProcessInfo *findPid(pid_t pid) const;
+    // Interned, case-folded name of each row, for ProcessFilterProxy
+    const ProcessNameIndex &nameIndex() const { return m_nameIndex; }
+    int nameIdAt(int row) const { return m_nameIds.at(row); }
+
+    static QString formatMemory(long kilobytes);
+    static QString formatGrowth(long kilobytesPerSecond);
+
+private:
+    void reindexFrom(int row);
+
+    QVector<ProcessInfo> m_rows;
+    QHash<pid_t, int> m_rowOfPid;
+    QVector<int> m_nameIds; // parallel to m_rows
+    ProcessNameIndex m_nameIndex;
+};
+
+#endif // PROCESSTABLEMODEL_H
@@ -0,0 +1,153 @@
+#include "processtree.h"
+
+Rollup &Rollup::operator+=(const Rollup &other)
+{
+    memory += other.memory;
+    pss += other.pss;
+    uss += other.uss;
+    swap += other.swap;
+    processes += other.processes;
+    deep += other.deep;
+    return *this;
+}
+
+Rollup &Rollup::operator-=(const Rollup &other)
+{
+    memory -= other.memory;
+    pss -= other.pss;
+    uss -= other.uss;
+    swap -= other.swap;
+    processes -= other.processes;
+    deep -= other.deep;
+    return *this;
+}
+
+bool Rollup::operator==(const Rollup &other) const
+{
+    return memory == other.memory && pss == other.pss && uss == other.uss && swap == other.swap
+        && processes == other.processes && deep == other.deep;
+}
+
+ProcessTree::ProcessTree()
+{
+    clear();
+}
+
+void ProcessTree::clear()
+{
+    m_nodes.assign(1, Slot());
+    m_nodes[kRoot].parent = kRoot;
+    m_free.clear();
+    m_dirty.clear();
+    m_live = 0;
+}
+
+ProcessTree::Node ProcessTree::add(Node parent, const Rollup &self)
+{
+    Node node;
+    if (!m_free.empty()) {
+        node = m_free.back();
+        m_free.pop_back();
+    } else {
+        node = static_cast<Node>(m_nodes.size());
+        m_nodes.emplace_back();
+    }
+    Slot &slot = m_nodes[node];
+    slot.parent = parent;
+    slot.row = childCount(parent);
+    slot.dirty = false;
+    slot.self = self;
+    slot.total = self;
+    slot.children.clear();
+    m_nodes[parent].children.push_back(node);
+    ++m_live;
+    propagate(parent, self, false);
+    return node;
+}
+
+void ProcessTree::remove(Node node)
+{
+    if (node == kRoot || m_nodes[node].parent == kNone || !m_nodes[node].children.empty()) return;
+    Rollup total = m_nodes[node].total;
+    Node parent = m_nodes[node].parent;
+    detach(node);
+    propagate(parent, total, true);
+    Slot &slot = m_nodes[node];
+    slot.parent = kNone;
+    slot.self = Rollup();
+    slot.total = Rollup();
+    m_free.push_back(node);
+    --m_live;
+}
+
+bool ProcessTree::move(Node node, Node newParent)
+{
+    if (node == kRoot || isAncestor(node, newParent)) return false;
+    Node oldParent = m_nodes[node].parent;
+    Rollup total = m_nodes[node].total;
+    detach(node);
+    propagate(oldParent, total, true);
+    m_nodes[node].parent = newParent;
+    m_nodes[node].row = childCount(newParent);
+    m_nodes[newParent].children.push_back(node);
+    propagate(newParent, total, false);
+    return true;
+}
+
+void ProcessTree::setSelf(Node node, const Rollup &self)
+{
+    Rollup difference = self;
+    difference -= m_nodes[node].self;
+    if (difference == Rollup()) return;
+    m_nodes[node].self = self;
+    propagate(node, difference, false);
+}
+
+bool ProcessTree::isAncestor(Node ancestor, Node node) const
+{
+    // The root is its own parent, so the walk ends there.
+    for (;;) {
+        if (node == ancestor) return true;
+        if (node == kRoot) return false;
+        node = m_nodes[node].parent;
+    }
+}
+
+void ProcessTree::takeDirty(std::vector<Node> &out)
+{
+    out.clear();
+    for (Node node : m_dirty) {
+        if (!m_nodes[node].dirty) continue;
+        m_nodes[node].dirty = false;
+        if (m_nodes[node].parent != kNone) out.push_back(node);
+    }
+    m_dirty.clear();
+}
+
+void ProcessTree::propagate(Node node, const Rollup &difference, bool subtract)
+{
+    for (;;) {
+        if (subtract) m_nodes[node].total -= difference;
+        else m_nodes[node].total += difference;
+        ++m_propagations;
+        if (node == kRoot) return;
+        markDirty(node);
+        node = m_nodes[node].parent;
+    }
+}
+
+void ProcessTree::markDirty(Node node)
+{
+    if (m_nodes[node].dirty) return;
+    m_nodes[node].dirty = true;
+    m_dirty.push_back(node);
+}
+
+// Takes node out of its parent's children, shifting the rows after it.
+void ProcessTree::detach(Node node)
+{
+    std::vector<Node> &siblings = m_nodes[m_nodes[node].parent].children;
+    int row = m_nodes[node].row;
+    siblings.erase(siblings.begin() + row);
+    for (int i = row; i < static_cast<int>(siblings.size()); ++i) m_nodes[siblings[i]].row = i;
+}
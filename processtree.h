@@ -0,0 +1,90 @@
+#ifndef PROCESSTREE_H
+#define PROCESSTREE_H
+
+#include <cstddef>
+#include <vector>
+
+// Memory of a process, or summed over a subtree. PSS, USS and swap count
+// only the processes that have them (deep is how many do), so a subtree
+// of unknowns stays distinguishable from one of zeros.
+struct Rollup {
+    long memory = 0;
+    long pss = 0;
+    long uss = 0;
+    long swap = 0;
+    long processes = 0;
+    long deep = 0;
+
+    Rollup &operator+=(const Rollup &other);
+    Rollup &operator-=(const Rollup &other);
+    bool operator==(const Rollup &other) const;
+    bool operator!=(const Rollup &other) const { return !(*this == other); }
+};
+
+// A forest of nodes under an invisible root, each with its own value and
+// the total of its subtree. Totals are kept up to date incrementally: a
+// changed value, an insertion, a removal or a move adds the difference to
+// the ancestors of the nodes involved and nothing else, so a tick costs
+// the depth of the changed nodes rather than the size of the tree.
+// Children keep their insertion order, and each node knows its row among
+// its siblings, as an item model needs.
+class ProcessTree
+{
+public:
+    typedef int Node;
+    static const Node kRoot = 0;
+    static const Node kNone = -1;
+
+    ProcessTree();
+
+    void clear();
+    size_t size() const { return m_live; } // nodes, not counting the root
+
+    // Appends a new node to parent's children.
+    Node add(Node parent, const Rollup &self);
+    // Removes a node without children; move them elsewhere first.
+    void remove(Node node);
+    // Makes node the last child of newParent. Returns false, changing
+    // nothing, if newParent is node itself or one of its descendants.
+    bool move(Node node, Node newParent);
+    void setSelf(Node node, const Rollup &self);
+
+    const Rollup &self(Node node) const { return m_nodes[node].self; }
+    const Rollup &total(Node node) const { return m_nodes[node].total; }
+    Node parent(Node node) const { return m_nodes[node].parent; }
+    int row(Node node) const { return m_nodes[node].row; }
+    int childCount(Node node) const { return static_cast<int>(m_nodes[node].children.size()); }
+    Node child(Node node, int row) const { return m_nodes[node].children[row]; }
+    const std::vector<Node> &children(Node node) const { return m_nodes[node].children; }
+    bool isAncestor(Node ancestor, Node node) const;
+
+    // Nodes whose total changed since the last call, each once, without
+    // the root and without nodes removed in the meantime
+    void takeDirty(std::vector<Node> &out);
+    // Ancestor totals updated so far, for diagnostics
+    unsigned long long propagations() const { return m_propagations; }
+
+private:
+    struct Slot {
+        Node parent = kNone; // kNone also marks a free slot
+        int row = 0;
+        bool dirty = false;
+        Rollup self;
+        Rollup total;
+        std::vector<Node> children;
+    };
+
+    // Adds (or with subtract, removes) difference to the totals of node
+    // and its ancestors.
+    void propagate(Node node, const Rollup &difference, bool subtract);
+    void markDirty(Node node);
+    void detach(Node node);
+
+    std::vector<Slot> m_nodes;
+    std::vector<Node> m_free;
+    std::vector<Node> m_dirty;
+    size_t m_live = 0;
+    unsigned long long m_propagations = 0;
+};
+
+#endif // PROCESSTREE_H
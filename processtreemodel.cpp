@@ -0,0 +1,365 @@
+#include "processtreemodel.h"
+
+#include <pwd.h>
+#include <unistd.h>
+#include "processtablemodel.h"
+
+ProcessTreeModel::ProcessTreeModel(QObject *parent) : QAbstractItemModel(parent)
+{
+}
+
+void ProcessTreeModel::setMode(Mode mode, const QVector<ProcessInfo> &processes)
+{
+    m_mode = mode;
+    setProcesses(processes);
+}
+
+QModelIndex ProcessTreeModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (column < 0 || column >= ColumnCount || row < 0) return QModelIndex();
+    Node node = nodeOf(parent);
+    if (row >= m_tree.childCount(node)) return QModelIndex();
+    return createIndex(row, column, static_cast<quintptr>(m_tree.child(node, row)));
+}
+
+QModelIndex ProcessTreeModel::parent(const QModelIndex &child) const
+{
+    if (!child.isValid()) return QModelIndex();
+    return indexOf(m_tree.parent(nodeOf(child)));
+}
+
+int ProcessTreeModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid() && parent.column() != 0) return 0;
+    return m_tree.childCount(nodeOf(parent));
+}
+
+int ProcessTreeModel::columnCount(const QModelIndex &) const
+{
+    return ColumnCount;
+}
+
+QVariant ProcessTreeModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid()) return QVariant();
+    Node node = nodeOf(index);
+    const Item &item = m_items[node];
+    const Rollup &total = m_tree.total(node);
+    bool group = item.pid == 0;
+
+    if (role == Qt::DisplayRole) {
+        switch (index.column()) {
+        case NameColumn: return item.name;
+        case PidColumn: return group ? QVariant() : QVariant(static_cast<int>(item.pid));
+        case ProcessesColumn: return static_cast<qlonglong>(total.processes);
+        case MemoryColumn: return ProcessTableModel::formatMemory(total.memory);
+        case PssColumn: return ProcessTableModel::formatMemory(total.deep > 0 ? total.pss : -1);
+        case UssColumn: return ProcessTableModel::formatMemory(total.deep > 0 ? total.uss : -1);
+        case SwapColumn: return ProcessTableModel::formatMemory(total.deep > 0 ? total.swap : -1);
+        case OwnMemoryColumn:
+            return group ? QVariant() : QVariant(ProcessTableModel::formatMemory(m_tree.self(node).memory));
+        }
+    } else if (role == SortRole) {
+        switch (index.column()) {
+        case NameColumn: return item.name;
+        case PidColumn: return static_cast<int>(item.pid);
+        case ProcessesColumn: return static_cast<qlonglong>(total.processes);
+        case MemoryColumn: return static_cast<qlonglong>(total.memory);
+        case PssColumn: return static_cast<qlonglong>(total.deep > 0 ? total.pss : -1);
+        case UssColumn: return static_cast<qlonglong>(total.deep > 0 ? total.uss : -1);
+        case SwapColumn: return static_cast<qlonglong>(total.deep > 0 ? total.swap : -1);
+        case OwnMemoryColumn: return static_cast<qlonglong>(m_tree.self(node).memory);
+        }
+    } else if (role == Qt::ToolTipRole && index.column() == NameColumn && !item.command.isEmpty()) {
+        return item.command;
+    }
+    return QVariant();
+}
+
+QVariant ProcessTreeModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::ToolTipRole) {
+        switch (section) {
+        case ProcessesColumn: return QString("Processes in this branch or group");
+        case MemoryColumn: return QString("Resident set size of the whole branch or group; shared pages count once per process");
+        case PssColumn: return QString("Proportional set size of the processes that have one");
+        case UssColumn: return QString("Unique set size of the processes that have one");
+        case OwnMemoryColumn: return QString("Resident set size of this process alone");
+        }
+    }
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractItemModel::headerData(section, orientation, role);
+    }
+    switch (section) {
+    case NameColumn:
+        switch (m_mode) {
+        case TreeMode: return QString("Process Name");
+        case NameMode: return QString("Name");
+        case UserMode: return QString("User");
+        case CommandMode: return QString("Command");
+        }
+        break;
+    case PidColumn: return QString("PID");
+    case ProcessesColumn: return QString("Processes");
+    case MemoryColumn: return QString("Memory Usage");
+    case PssColumn: return QString("PSS");
+    case UssColumn: return QString("USS");
+    case SwapColumn: return QString("Swap");
+    case OwnMemoryColumn: return QString("Own Memory");
+    }
+    return QVariant();
+}
+
+void ProcessTreeModel::setProcesses(const QVector<ProcessInfo> &processes)
+{
+    beginResetModel();
+    m_resetting = true;
+    m_tree.clear();
+    m_items.assign(1, Item());
+    m_nodeOfPid.clear();
+    m_nodeOfPid.reserve(processes.size());
+    m_groupOfKey.clear();
+    m_waitingFor.clear();
+    for (const ProcessInfo &process : processes) insertProcess(process);
+    m_tree.takeDirty(m_dirty);
+    m_resetting = false;
+    endResetModel();
+}
+
+void ProcessTreeModel::applyDelta(const ScanDelta &delta)
+{
+    if (delta.baseGeneration == 0) {
+        setProcesses(QVector<ProcessInfo>(delta.added.begin(), delta.added.end()));
+        return;
+    }
+
+    for (pid_t pid : delta.removed) removeProcess(pid);
+    for (const ProcessInfo &process : delta.added) {
+        auto it = m_nodeOfPid.constFind(process.pid);
+        if (it == m_nodeOfPid.constEnd()) insertProcess(process);
+        else updateProcess(it.value(), process);
+    }
+    for (const ProcessUpdate &update : delta.changed) {
+        auto it = m_nodeOfPid.constFind(update.pid);
+        if (it == m_nodeOfPid.constEnd()) continue;
+        ProcessInfo process;
+        process.memory = update.memory;
+        process.pss = update.pss;
+        process.uss = update.uss;
+        process.swap = update.swap;
+        m_tree.setSelf(it.value(), rollupOf(process));
+    }
+
+    // Only the changed processes and their ancestors
+    const QVector<int> roles = {Qt::DisplayRole, SortRole};
+    m_tree.takeDirty(m_dirty);
+    for (Node node : m_dirty) {
+        emit dataChanged(indexOf(node, ProcessesColumn), indexOf(node, OwnMemoryColumn), roles);
+    }
+}
+
+pid_t ProcessTreeModel::pidAt(const QModelIndex &index) const
+{
+    return index.isValid() ? m_items[nodeOf(index)].pid : 0;
+}
+
+ProcessTreeModel::Node ProcessTreeModel::nodeOf(const QModelIndex &index) const
+{
+    return index.isValid() ? static_cast<Node>(index.internalId()) : ProcessTree::kRoot;
+}
+
+QModelIndex ProcessTreeModel::indexOf(Node node, int column) const
+{
+    if (node == ProcessTree::kRoot) return QModelIndex();
+    return createIndex(m_tree.row(node), column, static_cast<quintptr>(node));
+}
+
+Rollup ProcessTreeModel::rollupOf(const ProcessInfo &process)
+{
+    Rollup rollup;
+    rollup.memory = qMax(0L, process.memory);
+    rollup.processes = 1;
+    if (process.pss >= 0) {
+        rollup.pss = process.pss;
+        rollup.uss = qMax(0L, process.uss);
+        rollup.swap = qMax(0L, process.swap);
+        rollup.deep = 1;
+    }
+    return rollup;
+}
+
+QString ProcessTreeModel::groupKey(const Item &item)
+{
+    switch (m_mode) {
+    case NameMode: return item.name;
+    case UserMode: return userName(item.uid);
+    case CommandMode: return item.command.isEmpty() ? item.name : item.command;
+    case TreeMode: break;
+    }
+    return QString();
+}
+
+QString ProcessTreeModel::userName(int uid)
+{
+    if (uid < 0) return QString("(unknown)");
+    auto it = m_userNames.constFind(uid);
+    if (it != m_userNames.constEnd()) return it.value();
+
+    QString name = QString::number(uid);
+    struct passwd entry;
+    struct passwd *result = nullptr;
+    char buffer[4096];
+    if (getpwuid_r(static_cast<uid_t>(uid), &entry, buffer, sizeof(buffer), &result) == 0 && result) {
+        name = QString::fromLocal8Bit(result->pw_name);
+    }
+    m_userNames.insert(uid, name);
+    return name;
+}
+
+ProcessTreeModel::Node ProcessTreeModel::placeFor(const Item &item)
+{
+    if (m_mode != TreeMode) return groupFor(groupKey(item));
+    if (item.ppid <= 0 || item.ppid == item.pid) return ProcessTree::kRoot;
+    auto it = m_nodeOfPid.constFind(item.ppid);
+    if (it != m_nodeOfPid.constEnd()) return it.value();
+    // The parent is listed later in this scan, or not visible at all
+    m_waitingFor[item.ppid].insert(item.pid);
+    return ProcessTree::kRoot;
+}
+
+ProcessTreeModel::Node ProcessTreeModel::groupFor(const QString &key)
+{
+    auto it = m_groupOfKey.constFind(key);
+    if (it != m_groupOfKey.constEnd()) return it.value();
+
+    Item group;
+    group.name = key;
+    int row = m_tree.childCount(ProcessTree::kRoot);
+    if (!m_resetting) beginInsertRows(QModelIndex(), row, row);
+    Node node = m_tree.add(ProcessTree::kRoot, Rollup());
+    setItem(node, group);
+    if (!m_resetting) endInsertRows();
+    m_groupOfKey.insert(key, node);
+    return node;
+}
+
+void ProcessTreeModel::insertProcess(const ProcessInfo &process)
+{
+    Item item;
+    item.pid = process.pid;
+    item.ppid = process.ppid;
+    item.uid = process.uid;
+    item.name = process.name;
+    item.command = process.command;
+
+    Node parent = placeFor(item);
+    int row = m_tree.childCount(parent);
+    if (!m_resetting) beginInsertRows(indexOf(parent), row, row);
+    Node node = m_tree.add(parent, rollupOf(process));
+    setItem(node, item);
+    m_nodeOfPid.insert(process.pid, node);
+    if (!m_resetting) endInsertRows();
+    if (m_mode == TreeMode) adoptChildren(process.pid, node);
+}
+
+// A rename, exec, new parent or new command line
+void ProcessTreeModel::updateProcess(Node node, const ProcessInfo &process)
+{
+    Item &item = m_items[node];
+    bool labelChanged = item.name != process.name || item.command != process.command;
+    QString oldKey = m_mode == TreeMode ? QString() : groupKey(item);
+    pid_t oldPpid = item.ppid;
+    bool parentChanged = oldPpid != process.ppid;
+    item.ppid = process.ppid;
+    item.uid = process.uid;
+    item.name = process.name;
+    item.command = process.command;
+    m_tree.setSelf(node, rollupOf(process));
+
+    if (m_mode == TreeMode) {
+        if (parentChanged) {
+            if (m_tree.parent(node) == ProcessTree::kRoot) forgetWaiting(process.pid, oldPpid);
+            moveNode(node, placeFor(item));
+        }
+    } else if (groupKey(item) != oldKey) {
+        Node oldGroup = m_tree.parent(node);
+        moveNode(node, groupFor(groupKey(item)));
+        dropGroupIfEmpty(oldGroup);
+    }
+    if (labelChanged) emit dataChanged(indexOf(node, NameColumn), indexOf(node, PidColumn));
+}
+
+void ProcessTreeModel::removeProcess(pid_t pid)
+{
+    auto it = m_nodeOfPid.find(pid);
+    if (it == m_nodeOfPid.end()) return;
+    Node node = it.value();
+    m_nodeOfPid.erase(it);
+
+    Node parent = m_tree.parent(node);
+    if (m_mode == TreeMode) {
+        // Orphans stay visible at the top level until a later scan shows
+        // who adopted them.
+        while (m_tree.childCount(node) > 0) moveNode(m_tree.child(node, 0), ProcessTree::kRoot);
+        if (parent == ProcessTree::kRoot) forgetWaiting(pid, m_items[node].ppid);
+    }
+    removeNode(node);
+    if (m_mode != TreeMode) dropGroupIfEmpty(parent);
+}
+
+void ProcessTreeModel::moveNode(Node node, Node newParent)
+{
+    Node oldParent = m_tree.parent(node);
+    // A process cannot become its own ancestor; that only happens when
+    // the PIDs of a scan are out of step, and the next one sorts it out.
+    if (oldParent == newParent || m_tree.isAncestor(node, newParent)) return;
+    int row = m_tree.row(node);
+    int destination = m_tree.childCount(newParent);
+    if (!m_resetting) beginMoveRows(indexOf(oldParent), row, row, indexOf(newParent), destination);
+    m_tree.move(node, newParent);
+    if (!m_resetting) endMoveRows();
+}
+
+void ProcessTreeModel::removeNode(Node node)
+{
+    int row = m_tree.row(node);
+    if (!m_resetting) beginRemoveRows(indexOf(m_tree.parent(node)), row, row);
+    m_tree.remove(node);
+    m_items[node] = Item();
+    if (!m_resetting) endRemoveRows();
+}
+
+void ProcessTreeModel::dropGroupIfEmpty(Node group)
+{
+    if (group == ProcessTree::kRoot || m_tree.childCount(group) > 0) return;
+    m_groupOfKey.remove(m_items[group].name);
+    removeNode(group);
+}
+
+void ProcessTreeModel::adoptChildren(pid_t pid, Node node)
+{
+    auto waiting = m_waitingFor.find(pid);
+    if (waiting == m_waitingFor.end()) return;
+    QSet<pid_t> children = waiting.value();
+    m_waitingFor.erase(waiting);
+    for (pid_t child : children) {
+        auto it = m_nodeOfPid.constFind(child);
+        // It may have exited or been reparented in the meantime.
+        if (it == m_nodeOfPid.constEnd() || m_items[it.value()].ppid != pid) continue;
+        if (m_tree.parent(it.value()) == ProcessTree::kRoot) moveNode(it.value(), node);
+    }
+}
+
+void ProcessTreeModel::forgetWaiting(pid_t pid, pid_t ppid)
+{
+    auto waiting = m_waitingFor.find(ppid);
+    if (waiting == m_waitingFor.end()) return;
+    waiting->remove(pid);
+    if (waiting->isEmpty()) m_waitingFor.erase(waiting);
+}
+
+void ProcessTreeModel::setItem(Node node, const Item &item)
+{
+    if (static_cast<size_t>(node) >= m_items.size()) m_items.resize(node + 1);
+    m_items[node] = item;
+}
@@ -0,0 +1,92 @@
+#ifndef PROCESSTREEMODEL_H
+#define PROCESSTREEMODEL_H
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <vector>
+#include "datatypes.h"
+#include "processtree.h"
+
+// Processes as a parent/child tree, or grouped by name, user or command
+// line, with every row showing the memory of everything below it. Sums
+// live in a ProcessTree, so a delta only touches the ancestors of the
+// processes it changes, and dataChanged is emitted for those rows alone.
+// Rows are created and moved with the model's insert/remove/move signals,
+// which lets a QTreeView (and a sorting proxy in front of it) keep its
+// expansion and only lay out the branches that are open.
+class ProcessTreeModel : public QAbstractItemModel
+{
+    Q_OBJECT
+public:
+    enum Mode { TreeMode, NameMode, UserMode, CommandMode };
+    enum Column { NameColumn, PidColumn, ProcessesColumn, MemoryColumn, PssColumn, UssColumn, SwapColumn, OwnMemoryColumn, ColumnCount };
+    // Raw value of a cell, for sorting by number instead of by text
+    static const int SortRole = Qt::UserRole + 1;
+
+    explicit ProcessTreeModel(QObject *parent = nullptr);
+
+    Mode mode() const { return m_mode; }
+    // Rebuilds the rows for another mode from a full process list.
+    void setMode(Mode mode, const QVector<ProcessInfo> &processes);
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    void setProcesses(const QVector<ProcessInfo> &processes);
+    void applyDelta(const ScanDelta &delta);
+
+    // PID of the process at index, 0 for a group
+    pid_t pidAt(const QModelIndex &index) const;
+    const ProcessTree &tree() const { return m_tree; }
+
+private:
+    typedef ProcessTree::Node Node;
+
+    // A process, or in the grouped modes also a group (pid 0)
+    struct Item {
+        pid_t pid = 0;
+        pid_t ppid = 0;
+        int uid = -1;
+        QString name;    // the group's label for a group
+        QString command;
+    };
+
+    Node nodeOf(const QModelIndex &index) const;
+    QModelIndex indexOf(Node node, int column = 0) const;
+    static Rollup rollupOf(const ProcessInfo &process);
+    QString groupKey(const Item &item);
+    QString userName(int uid);
+
+    // Where a process belongs: its parent's node (or the top level until
+    // the parent shows up), or its group's, creating the group if needed
+    Node placeFor(const Item &item);
+    Node groupFor(const QString &key);
+    void insertProcess(const ProcessInfo &process);
+    void updateProcess(Node node, const ProcessInfo &process);
+    void removeProcess(pid_t pid);
+    void moveNode(Node node, Node newParent);
+    void removeNode(Node node);
+    void dropGroupIfEmpty(Node group);
+    // Moves processes that were waiting for pid to appear below it
+    void adoptChildren(pid_t pid, Node node);
+    void forgetWaiting(pid_t pid, pid_t ppid);
+    void setItem(Node node, const Item &item);
+
+    Mode m_mode = TreeMode;
+    bool m_resetting = false; // rows change inside begin/endResetModel
+    ProcessTree m_tree;
+    std::vector<Item> m_items; // by node
+    QHash<pid_t, Node> m_nodeOfPid;
+    QHash<QString, Node> m_groupOfKey;
+    QHash<pid_t, QSet<pid_t>> m_waitingFor; // parent PID -> children shown at the top level
+    QHash<int, QString> m_userNames;
+    std::vector<Node> m_dirty;
+};
+
+#endif // PROCESSTREEMODEL_H
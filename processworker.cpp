@@ -1,161 +1,769 @@
 #include "processworker.h"
+#include "allocationcounter.h"
+#include "hardwareprobe.h"
 #include <QThread>
 #include <QDebug>
 #include <algorithm>
-#include <QProcess>
-#include <QFile>
-#include <QTextStream>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
 #include <QDir>
+#include <QFile>
+#include <QStandardPaths>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QDateTime>
+
+namespace {
+
+// Bytes of a command line kept for grouping
+const int kCommandLength = 256;
+
+// Processes rarely change cgroups (a service manager or container runtime
+// places them right after fork), so membership is read when a process is
+// first seen and then every this many scans, staggered by PID.
+const quint64 kCgroupRefreshScans = 30;
+
+// Label values for the worker's phases in the metrics, up to Export
+const char *const kMetricsPhaseLabels[] = {
+    "list", "read", "parse", "deep_accounting", "build", "rank", "scan", "export",
+};
+static_assert(sizeof(kMetricsPhaseLabels) / sizeof(kMetricsPhaseLabels[0]) == ScanProfile::Export + 1,
+              "a label for every worker phase");
+
+// One scanner per calling thread for the static one-off helpers, so the GUI
+// thread never shares buffers with the worker's scanner.
+ProcScanner& threadScanner()
+{
+    thread_local ProcScanner scanner;
+    return scanner;
+}
 
-ProcessWorker::ProcessWorker(QObject *parent) : QObject(parent)
+} // namespace
+
+ProcessWorker::ProcessWorker(QObject *parent, const char *procRoot)
+    : ProcessWorker(std::unique_ptr<DataSource>(new LiveProcSource(procRoot)), parent)
+{
+}
+
+ProcessWorker::ProcessWorker(std::unique_ptr<DataSource> source, QObject *parent)
+    : QObject(parent), m_source(std::move(source)), m_live(dynamic_cast<LiveProcSource *>(m_source.get())),
+      m_pressure(m_live ? m_live->procRoot() : "/proc"), m_smaps(m_live ? m_live->procRoot() : "/proc"),
+      m_cgroups("/sys/fs/cgroup", m_live ? m_live->procRoot() : "/proc")
 {
     m_timer = new QTimer(this);
 }
 
-void ProcessWorker::setThreshold(int percent) { this->memoryThreshold = percent; }
+ProcessWorker::~ProcessWorker()
+{
+    // Their threads call back into this object, which is about to go.
+    m_pressure.stop();
+    m_metrics.stop();
+    if (m_probeThread.joinable()) m_probeThread.join();
+}
+
+void ProcessWorker::setThreshold(int percent)
+{
+    m_pressure.setMemoryThreshold(percent);
+    // May be called from another thread; the rules are compiled on ours.
+    QMetaObject::invokeMethod(this, [this, percent] {
+        m_thresholdPercent = qMax(0, percent);
+        compileAlertRules();
+    }, Qt::QueuedConnection);
+}
+
+void ProcessWorker::setAlertRules(const QString &rules)
+{
+    QMetaObject::invokeMethod(this, [this, rules] {
+        m_alertRules = rules;
+        compileAlertRules();
+    }, Qt::QueuedConnection);
+}
+
+void ProcessWorker::compileAlertRules()
+{
+    QString rules = m_alertRules;
+    if (m_thresholdPercent > 0) rules.prepend(QString("system memory% > %1\n").arg(m_thresholdPercent));
+    std::string error;
+    if (!m_alertEngine.compile(rules.toStdString(), &error)) qWarning() << "Alert rules:" << error.c_str();
+    // Cgroup rules keep the monitor running while the page is hidden.
+    if (!m_alertEngine.hasCgroupRules() && !m_appliedCgroupMonitoring) m_cgroups.reset();
+}
+
+void ProcessWorker::raise(Alert &&alert)
+{
+    if (m_alertQueue.push(std::move(alert))) emit alertsPending();
+}
+
+void ProcessWorker::setPressureAlert(int stallMs, int windowMs, const QStringList &cgroups)
+{
+    // May be called from another thread; the monitor is owned by ours.
+    QMetaObject::invokeMethod(this, [this, stallMs, windowMs, cgroups] {
+        m_pressure.stop();
+        if (stallMs <= 0) return;
+        PressureMonitor::Options options;
+        options.stallMs = stallMs;
+        options.windowMs = windowMs;
+        for (const QString &cgroup : cgroups) options.cgroups.push_back(QFile::encodeName(cgroup).toStdString());
+        std::string error;
+        bool started = m_pressure.start(options, [this](const PressureMonitor::Alert &alert) {
+            // Runs on the monitor's thread; the queue takes it from there.
+            Alert pending;
+            pending.key = "pressure:" + alert.source;
+            pending.message = QString("%1 (detected within %2 ms)")
+                                  .arg(QString::fromStdString(alert.message))
+                                  .arg(alert.latencyMs, 0, 'f', 0).toStdString();
+            pending.timeMs = QDateTime::currentMSecsSinceEpoch();
+            raise(std::move(pending));
+        }, &error);
+        PressureMonitor::Stats stats = m_pressure.stats();
+        if (!started || !stats.error.empty()) {
+            qWarning() << "Memory pressure alerts:" << (started ? stats.error.c_str() : error.c_str());
+        }
+    }, Qt::QueuedConnection);
+}
+
+void ProcessWorker::setFdCacheLimit(int maxFds) { m_fdCacheLimit = maxFds; }
+
+void ProcessWorker::setScanThreadCount(int threads) { m_scanThreadCount = threads; }
+
+void ProcessWorker::requestFullSnapshot() { m_fullSnapshotRequested = true; }
+
+void ProcessWorker::setRankingSize(int count) { m_rankingSize = count; }
+
+void ProcessWorker::setHistoryBudget(int megabytes)
+{
+    m_historyBudgetMb = qMax(0, megabytes);
+    m_history.setBudget(static_cast<size_t>(m_historyBudgetMb.load()) << 20);
+}
+
+void ProcessWorker::setInterval(int milliseconds) { setConsumerInterval(SampleScheduler::Display, milliseconds); }
+
+void ProcessWorker::setConsumerInterval(int consumer, qint64 milliseconds)
+{
+    if (consumer < 0 || consumer >= SampleScheduler::ConsumerCount) return;
+    m_requestedIntervals[consumer] = milliseconds > 0 ? qMax<qint64>(100, milliseconds) : 0;
+    // May be called from another thread; the timer is re-armed on ours.
+    QMetaObject::invokeMethod(this, &ProcessWorker::reschedule, Qt::QueuedConnection);
+}
+
+void ProcessWorker::setCpuBudget(double percent) { m_cpuBudget = percent; }
+
+void ProcessWorker::setStatRefreshInterval(int scans) { m_statRefreshInterval = scans; }
+
+void ProcessWorker::setProcessEvents(bool enabled) { m_useProcessEvents = enabled; }
+
+void ProcessWorker::setDeepAccountingBudget(double milliseconds) { m_smapsBudgetMs = qMax(0.0, milliseconds); }
+
+void ProcessWorker::setLeakAlert(int limitMb, int horizonMinutes)
+{
+    m_leakLimitMb = qMax(0, limitMb);
+    m_leakHorizonMinutes = qMax(0, horizonMinutes);
+}
+
+void ProcessWorker::setCommandLines(bool enabled) { m_commandLines = enabled; }
+
+void ProcessWorker::setCgroupMonitoring(bool enabled) { m_cgroupMonitoring = enabled; }
+
+void ProcessWorker::setMetricsEndpoint(const QString &address, int topProcesses)
+{
+    // May be called from another thread; the exporter is owned by ours.
+    QMetaObject::invokeMethod(this, [this, address, topProcesses] {
+        m_metricsTopProcesses = qMax(0, topProcesses);
+        if (address == m_metricsAddress && m_metrics.isRunning()) return;
+        m_metrics.stop();
+        m_metricsAddress = address;
+        if (address.isEmpty()) return;
+        MetricsExporter::Options options;
+        options.address = QFile::encodeName(address).toStdString();
+        std::string error;
+        if (!m_metrics.start(options, &error)) qWarning() << "Metrics endpoint:" << error.c_str();
+    }, Qt::QueuedConnection);
+}
 
 void ProcessWorker::startWork()
 {
-    fetchStaticInfo();
+    if (m_live && !m_probeThread.joinable()) {
+        QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+                           + "/MemoryAnalyzerGUI";
+        std::string cachePath;
+        if (QDir().mkpath(cacheDir)) cachePath = QFile::encodeName(cacheDir + "/hardware").toStdString();
+        m_probeThread = std::thread(&ProcessWorker::fetchStaticInfo, this, cachePath);
+    } else if (!m_live) {
+        // Another machine's (or no machine's) samples next to this one's
+        // hardware would only mislead.
+        emit staticInfoReady(StaticInfo());
+    }
+    startSampling();
+}
+
+void ProcessWorker::startSampling()
+{
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
     connect(m_timer, &QTimer::timeout, this, &ProcessWorker::performScan);
-    m_timer->start(2000);
+    m_clock.start();
     performScan();
 }
 
+void ProcessWorker::reschedule()
+{
+    if (!m_clock.isValid()) return; // not sampling yet
+    applyRequests();
+    armTimer();
+}
+
+void ProcessWorker::applyRequests()
+{
+    qint64 now = m_clock.elapsed();
+    for (int i = 0; i < SampleScheduler::ConsumerCount; ++i) {
+        auto consumer = static_cast<SampleScheduler::Consumer>(i);
+        m_scheduler.setRequest(consumer, m_requestedIntervals[i], consumer == SampleScheduler::Display, now);
+    }
+    m_scheduler.setCpuBudget(m_cpuBudget / 100.0);
+}
+
+void ProcessWorker::armTimer()
+{
+    qint64 delay = m_scheduler.delayUntilNext(m_clock.elapsed());
+    if (delay < 0) {
+        m_timer->stop();
+    } else {
+        m_timer->start(static_cast<int>(qMin<qint64>(delay, std::numeric_limits<int>::max())));
+    }
+}
+
 void ProcessWorker::performScan()
 {
-    appData.memTotal = getMemInfo("MemTotal:");
-    appData.memAvailable = getMemInfo("MemAvailable:");
+    applyRequests();
+    unsigned consumers = m_scheduler.takeDue(m_clock.elapsed());
+    if (consumers == 0) {
+        armTimer(); // woke up early
+        return;
+    }
+    scan(consumers);
+}
 
-    if (memoryThreshold > 0 && appData.memTotal > 0) {
-        long memUsed = appData.memTotal - appData.memAvailable;
-        int usagePercent = static_cast<int>(100.0 * memUsed / appData.memTotal);
-        if (usagePercent > memoryThreshold) {
-            QString message = QString("Warning: Memory usage is at %1%, exceeding threshold of %2%!")
-                                  .arg(usagePercent).arg(memoryThreshold);
-            emit thresholdExceeded(message);
+void ProcessWorker::scanNow()
+{
+    if (!m_clock.isValid()) m_clock.start();
+    applyRequests();
+    unsigned consumers = 0;
+    for (int i = 0; i < SampleScheduler::ConsumerCount; ++i) {
+        if (m_requestedIntervals[i] > 0) consumers |= 1u << i;
+    }
+    scan(consumers ? consumers : 1u << SampleScheduler::Display);
+}
+
+void ProcessWorker::scan(unsigned consumers)
+{
+    QElapsedTimer tickTimer;
+    tickTimer.start();
+    AllocationCount allocationsBefore = threadAllocations();
+
+    if (m_live) {
+        ProcScanner &scanner = m_live->scanner();
+        int fdCacheLimit = m_fdCacheLimit;
+        if (fdCacheLimit != m_appliedFdCacheLimit) {
+            scanner.setFdCacheLimit(fdCacheLimit);
+            m_appliedFdCacheLimit = fdCacheLimit;
+        }
+        scanner.setThreadCount(m_scanThreadCount);
+        scanner.setStatRefreshInterval(m_statRefreshInterval);
+        bool useProcessEvents = m_useProcessEvents;
+        if (useProcessEvents != m_appliedProcessEvents) {
+            // Tried once per change of the setting; without permission we keep
+            // listing /proc.
+            m_appliedProcessEvents = useProcessEvents;
+            std::string error;
+            if (!m_live->setProcessEvents(useProcessEvents, &error)) {
+                qWarning() << "Process events unavailable, listing /proc every scan:" << error.c_str();
+            }
         }
+        bool cgroupMonitoring = m_cgroupMonitoring;
+        if (!cgroupMonitoring && m_appliedCgroupMonitoring) m_cgroups.reset();
+        m_appliedCgroupMonitoring = cgroupMonitoring;
+    }
+
+    QElapsedTimer scanTimer;
+    scanTimer.start();
+    if (!m_source->fill(m_batch)) {
+        // Nothing this time (a recording ran out, nothing was pushed)
+        armTimer();
+        return;
+    }
+    qint64 fillNs = scanTimer.nsecsElapsed();
+    const std::vector<ProcSample>& samples = m_batch.samples;
+
+    ScanDelta delta;
+    delta.consumers = consumers;
+    // A source with its own clock (a recording, a generator) sets the
+    // times, so replaying it gives the same growth rates and alerts.
+    bool sourceTime = m_batch.timeMs > 0;
+    delta.timeMs = sourceTime ? m_batch.timeMs : QDateTime::currentMSecsSinceEpoch();
+    delta.memInfo = m_batch.memInfo;
+    delta.memTotal = delta.memInfo[MemInfo::MemTotal];
+    delta.memAvailable = delta.memInfo[MemInfo::MemAvailable];
+
+    // System rules are checked here, the others along the way below.
+    m_alertEngine.beginScan(delta.timeMs, delta.memInfo);
+    bool processAlerts = m_alertEngine.hasProcessRules();
+    unsigned alertGeneration = m_alertEngine.generation();
+
+    double intervalSec = 0;
+    if (sourceTime) {
+        if (m_lastSourceTimeMs > 0) intervalSec = qMax<qint64>(0, delta.timeMs - m_lastSourceTimeMs) / 1000.0;
+        m_lastSourceTimeMs = delta.timeMs;
+    } else {
+        intervalSec = m_scanClock.isValid() ? m_scanClock.restart() / 1000.0 : 0;
+        if (!m_scanClock.isValid()) m_scanClock.start();
+    }
+    size_t rankingSize = static_cast<size_t>(qMax(0, m_rankingSize.load()));
+    m_rankByMemory.reset(rankingSize);
+    m_rankByGrowth.reset(rankingSize);
+    delta.rankingSize = static_cast<int>(rankingSize);
+
+    if (m_historyBudgetMb > 0) m_history.append(delta.timeMs, samples);
+    // statm for everyone above; smaps_rollup for as many as the budget allows,
+    // the biggest (everything the rankings could show) first.
+    const std::vector<SmapsRollup>* rollups = &m_noRollups;
+    if (m_live) {
+        m_smaps.setBudgetMs(m_smapsBudgetMs);
+        m_smaps.setTopCount(qMax<size_t>(rankingSize, 10));
+        rollups = &m_smaps.update(samples);
+    } else {
+        m_noRollups.resize(samples.size());
     }
+    GrowthDetector::Options growthOptions = m_growth.options();
+    growthOptions.limitKb = static_cast<long>(m_leakLimitMb) * 1024;
+    growthOptions.horizonSec = m_leakHorizonMinutes * 60.0;
+    m_growth.setOptions(growthOptions);
+    m_growth.setRankingSize(rankingSize);
+    m_growth.beginScan(sourceTime ? delta.timeMs / 1000.0 : m_clock.elapsed() / 1000.0, delta.memAvailable);
+    bool full = m_fullSnapshotRequested.exchange(false) || m_generation == 0;
+    ++m_generation;
+    delta.generation = m_generation;
+    delta.baseGeneration = full ? 0 : m_generation - 1;
+    if (full) delta.added.reserve(static_cast<int>(samples.size()));
 
-    appData.processes.clear();
-    QDir procDir("/proc");
-    QStringList entries = procDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
-    for (const QString &entry : entries) {
-        bool isNumber;
-        pid_t pid = entry.toInt(&isNumber);
-        if (isNumber) {
-            long memory_kb = getVmRssFromPid(pid);
-            if (memory_kb >= 0) {
-                ProcessInfo info;
-                info.pid = pid;
-                info.memory = memory_kb;
-                info.name = getNameFromPid(pid);
-                appData.processes.append(info);
+    QElapsedTimer phaseTimer;
+    phaseTimer.start();
+    bool wantCommands = m_live && m_commandLines;
+    m_commandReads = 0;
+    bool wantCgroups = m_live && m_appliedCgroupMonitoring;
+    unsigned long long cgroupSyscalls = m_cgroups.stats().syscalls;
+    bool exporting = m_metrics.isRunning();
+    m_rankForMetrics.reset(exporting ? static_cast<size_t>(m_metricsTopProcesses) : 0);
+    long long totalRssKb = 0;
+
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const ProcSample &sample = samples[i];
+        const SmapsRollup &rollup = (*rollups)[i];
+        auto it = m_known.find(sample.pid);
+        bool isNew = it == m_known.end();
+        if (!isNew && it->startTime != sample.startTime) {
+            // Same PID, different process: retire the old one first.
+            if (!full) delta.removed.append(sample.pid);
+            isNew = true;
+        }
+        if (isNew) {
+            it = m_known.insert(sample.pid, KnownProcess());
+            it->startTime = sample.startTime;
+        }
+        KnownProcess &known = *it;
+        known.seen = m_generation;
+        bool renamed = updateName(known, sample);
+        if (renamed && !isNew) known.commandRead = false; // exec'd
+        // A new parent (the old one exited) or owner is sent like a rename.
+        if (known.ppid != sample.ppid || known.uid != static_cast<int>(sample.uid)) {
+            known.ppid = sample.ppid;
+            known.uid = static_cast<int>(sample.uid);
+            renamed = true;
+        }
+        if (wantCommands && !known.commandRead && updateCommand(known, sample.pid)) renamed = true;
+        if (wantCgroups && (!known.cgroupRead || (m_generation + sample.pid) % kCgroupRefreshScans == 0)
+            && updateCgroup(known, sample.pid)) {
+            renamed = true;
+        }
+        long growth = 0;
+        if (!isNew && known.memory >= 0 && intervalSec > 0) {
+            growth = std::lround((sample.rssKb - known.memory) / intervalSec);
+        }
+        bool valuesChanged = known.memory != sample.rssKb || known.growth != growth
+                             || known.rollup.pssKb != rollup.pssKb || known.rollup.ussKb != rollup.ussKb
+                             || known.rollup.swapKb != rollup.swapKb;
+        known.memory = sample.rssKb;
+        known.growth = growth;
+        known.rollup = rollup;
+        if (processAlerts) {
+            // Classified again only when the name (or the rules) changed
+            if (renamed || known.alertGeneration != alertGeneration) {
+                known.alertClass = m_alertEngine.classify(sample.pid, known.raw, known.len);
+                known.alertGeneration = alertGeneration;
+            }
+            if (known.alertClass >= 0) {
+                m_alertEngine.evaluateProcess(known.alertClass, sample.pid, known.raw, known.len, sample.rssKb,
+                                              rollup.swapKb, growth);
             }
         }
+
+        if (full || isNew || renamed) {
+            ProcessInfo info;
+            info.pid = sample.pid;
+            info.ppid = known.ppid;
+            info.uid = known.uid;
+            info.memory = sample.rssKb;
+            info.growth = growth;
+            info.pss = rollup.pssKb;
+            info.uss = rollup.ussKb;
+            info.swap = rollup.swapKb;
+            info.name = known.name;
+            info.command = known.command;
+            info.cgroup = known.cgroup;
+            delta.added.append(info);
+        } else if (valuesChanged) {
+            delta.changed.append(ProcessUpdate{sample.pid, sample.rssKb, growth, rollup.pssKb, rollup.ussKb, rollup.swapKb});
+        }
+
+        m_rankByMemory.push(sample.rssKb, sample.pid);
+        if (exporting) {
+            m_rankForMetrics.push(sample.rssKb, sample.pid);
+            totalRssKb += qMax(0L, sample.rssKb);
+        }
+        if (growth > 0) m_rankByGrowth.push(growth, sample.pid);
+        m_growth.add(sample.pid, sample.startTime, sample.rssKb);
+    }
+    qint64 buildNs = phaseTimer.nsecsElapsed();
+    phaseTimer.restart();
+    bool displayCgroups = wantCgroups && (consumers & (1u << SampleScheduler::Display));
+    bool cgroupAlerts = m_live && m_alertEngine.hasCgroupRules();
+    if ((displayCgroups || cgroupAlerts) && m_cgroups.refresh()) {
+        const std::vector<CgroupStats> &cgroups = m_cgroups.cgroups();
+        if (displayCgroups) {
+            delta.cgroups.reserve(static_cast<int>(cgroups.size()));
+            for (const CgroupStats &stats : cgroups) delta.cgroups.append(CgroupInfo::fromStats(stats));
+        }
+        m_alertEngine.evaluateCgroups(cgroups);
+    }
+    qint64 cgroupNs = phaseTimer.nsecsElapsed();
+    phaseTimer.restart();
+    m_growth.endScan();
+    for (const GrowthDetector::Trend &trend : m_growth.ranking()) delta.growthTrends.append(trend);
+    for (const GrowthDetector::Trend &trend : m_growth.alerts()) {
+        auto known = m_known.constFind(trend.pid);
+        QString name = known != m_known.constEnd() ? known->name : QString();
+        QString message = QString("Possible leak: %1 (PID %2) grows by %3 MB per hour and is projected to reach %4 MB "
+                                  "in %5 minutes")
+                              .arg(name).arg(trend.pid)
+                              .arg(trend.slopeKbPerSec * 3600 / 1024, 0, 'f', 1)
+                              .arg(trend.limitKb / 1024)
+                              .arg(qMax(0.0, trend.secondsToLimit / 60), 0, 'f', 0);
+        Alert alert;
+        alert.key = "leak:" + std::to_string(trend.pid);
+        alert.message = message.toStdString();
+        alert.timeMs = delta.timeMs;
+        raise(std::move(alert));
     }
+    for (const Alert &alert : m_alertEngine.endScan()) raise(Alert(alert));
+    for (const auto &entry : m_rankByMemory.takeSorted()) delta.topByMemory.append(entry.id);
+    for (const auto &entry : m_rankByGrowth.takeSorted()) delta.topByGrowth.append(entry.id);
+    qint64 rankNs = phaseTimer.nsecsElapsed();
+    phaseTimer.restart();
+    for (auto it = m_known.begin(); it != m_known.end();) {
+        if (it->seen != m_generation) {
+            if (!full) delta.removed.append(it.key());
+            it = m_known.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    buildNs += phaseTimer.nsecsElapsed();
 
-    qDebug() << "Scan complete: Found" << appData.processes.count() << "processes. Total memory:" << appData.memTotal;
+    delta.scanStats.scanMs = scanTimer.nsecsElapsed() / 1e6;
+    ProcFdCache::Stats cacheStats;
+    if (m_live) {
+        ProcScanner &scanner = m_live->scanner();
+        delta.scanStats.scanThreads = scanner.threadCount();
+        cacheStats = scanner.fdCacheStats();
+        delta.scanStats.fdCacheHits = cacheStats.hits;
+        delta.scanStats.fdCacheMisses = cacheStats.misses;
+        delta.scanStats.fdCacheReuses = cacheStats.reuses;
+        delta.scanStats.fdCacheOpen = cacheStats.openFds;
+        delta.scanStats.fdCacheLimit = cacheStats.fdLimit;
+        ProcEvents::Stats eventStats = m_live->events().stats();
+        delta.scanStats.processEvents = m_live->events().isRunning();
+        delta.scanStats.procListings = scanner.listings();
+        delta.scanStats.transientProcesses = eventStats.transient;
+    } else {
+        delta.scanStats.scanThreads = 1;
+    }
+    HistoryStore::Stats historyStats = m_history.stats();
+    delta.scanStats.historySeries = static_cast<int>(historyStats.series);
+    delta.scanStats.historyBytes = historyStats.bytes;
+    delta.scanStats.historyBudget = historyStats.budget;
+    SmapsSampler::Stats smapsStats = m_live ? m_smaps.stats() : SmapsSampler::Stats();
+    delta.scanStats.smapsBudgetMs = smapsStats.supported ? smapsStats.budgetMs : 0;
+    delta.scanStats.smapsUsedMs = smapsStats.usedMs;
+    delta.scanStats.smapsRead = smapsStats.read;
+    delta.scanStats.smapsDeferred = smapsStats.deferred;
+    delta.scanStats.smapsOverBudget = smapsStats.overBudget;
+    delta.scanStats.smapsCovered = smapsStats.covered;
+    delta.scanStats.smapsDenied = smapsStats.denied;
+    GrowthDetector::Stats growthStats = m_growth.stats();
+    delta.scanStats.growthTracked = static_cast<int>(growthStats.tracked);
+    delta.scanStats.growthAlerts = growthStats.alerts;
+    AlertEngine::Stats alertStats = m_alertEngine.stats();
+    delta.scanStats.alertRules = static_cast<int>(alertStats.rules);
+    delta.scanStats.alertChecks = alertStats.evaluations;
+    delta.scanStats.alertsFiring = static_cast<int>(alertStats.firing);
+    CgroupMonitor::Stats cgroupStats = m_cgroups.stats();
+    delta.scanStats.cgroupsAvailable = cgroupStats.available;
+    delta.scanStats.cgroupInotify = cgroupStats.inotify;
+    delta.scanStats.cgroupWalks = cgroupStats.walks;
+    delta.scanStats.cgroupOpenFds = cgroupStats.openFds;
+    delta.scanStats.cgroupError = QString::fromStdString(cgroupStats.error);
+    MetricsExporter::Stats metricsStats = m_metrics.stats();
+    if (metricsStats.running) delta.scanStats.metricsAddress = QString::fromStdString(metricsStats.address);
+    delta.scanStats.metricsScrapes = metricsStats.scrapes;
+    delta.scanStats.metricsError = QString::fromStdString(metricsStats.error);
 
-    std::sort(appData.processes.begin(), appData.processes.end(), [](const ProcessInfo &a, const ProcessInfo &b) {
-        return a.memory > b.memory;
-    });
+    // Scan wall time stands in for its CPU cost (an upper bound with one
+    // scan thread). Only growth of used memory counts as allocation.
+    SampleScheduler::Load load;
+    m_systemPressure = m_pressure.systemPressure();
+    load.pressure = qMax(0.0, m_systemPressure);
+    if (delta.memTotal > 0) {
+        long usedKb = delta.memTotal - delta.memAvailable;
+        load.usedFraction = static_cast<double>(usedKb) / delta.memTotal;
+        if (m_lastUsedKb >= 0 && intervalSec > 0) {
+            load.allocRate = qMax(0L, usedKb - m_lastUsedKb) / intervalSec / delta.memTotal;
+        }
+        m_lastUsedKb = usedKb;
+    }
+    m_scheduler.recordScan(delta.scanStats.scanMs, load);
+    PressureMonitor::Stats pressureStats = m_pressure.stats();
+    delta.scanStats.pressureMode = pressureStats.mode;
+    delta.scanStats.pressureTriggers = pressureStats.triggers;
+    delta.scanStats.pressureAlerts = pressureStats.alerts;
+    delta.scanStats.pressureWorstLatencyMs = pressureStats.worstLatencyMs;
+    delta.scanStats.memoryPressure = load.pressure;
+    delta.scanStats.displayIntervalMs = m_scheduler.effectivePeriod(SampleScheduler::Display);
+    delta.scanStats.cpuBudgetLimited = m_scheduler.budgetLimited();
+    armTimer();
 
-    emit resultReady(appData);
+    ScanProfile::Tick &tick = delta.scanStats.profile;
+    if (m_live) {
+        const ProcScanner::Profile &scanProfile = m_live->scanner().lastProfile();
+        tick.phaseMs[ScanProfile::List] = scanProfile.listMs;
+        // Cgroup files count as reading, like the process files.
+        tick.phaseMs[ScanProfile::Read] = scanProfile.readMs + cgroupNs / 1e6;
+        tick.phaseMs[ScanProfile::Parse] = scanProfile.parseMs;
+        if (smapsStats.budgetMs > 0) tick.phaseMs[ScanProfile::DeepAccounting] = smapsStats.usedMs;
+        // The meminfo pread comes on top of the scanners' own.
+        tick.worker.syscalls = scanProfile.syscalls + smapsStats.syscalls + 1 + 3 * m_commandReads
+                               + (cgroupStats.syscalls - cgroupSyscalls);
+    } else {
+        // Whatever the source does to produce a batch counts as reading it.
+        tick.phaseMs[ScanProfile::Read] = fillNs / 1e6;
+    }
+    tick.phaseMs[ScanProfile::Build] = buildNs / 1e6;
+    tick.phaseMs[ScanProfile::Rank] = rankNs / 1e6;
+    tick.processes = static_cast<int>(m_known.size());
+    AllocationCount allocations = threadAllocations();
+    tick.worker.allocations = allocations.allocations - allocationsBefore.allocations;
+    tick.worker.allocatedBytes = allocations.bytes - allocationsBefore.bytes;
+    tick.phaseMs[ScanProfile::Scan] = tickTimer.nsecsElapsed() / 1e6;
+    if (exporting) {
+        // Built once per scan, whether or not anyone scrapes it before the
+        // next one.
+        phaseTimer.restart();
+        publishMetrics(delta, totalRssKb);
+        m_lastExportMs = phaseTimer.nsecsElapsed() / 1e6;
+        tick.phaseMs[ScanProfile::Export] = m_lastExportMs;
+    }
+    tick.emittedNs = ScanProfile::nowNs();
+    emit scanDelta(delta);
 }
 
-QString ProcessWorker::runCommand(const QString &command)
+// Refreshes the cached QString for a process, only decoding the name again
+// when its comm bytes changed (e.g. after exec). Returns true if it changed.
+bool ProcessWorker::updateName(KnownProcess &known, const ProcSample &sample)
 {
-    QProcess process;
-    process.start("/bin/sh", QStringList() << "-c" << command);
-    process.waitForFinished(5000);
-    return process.readAllStandardOutput().trimmed();
+    if (!known.name.isNull() && known.len == sample.nameLen
+        && memcmp(known.raw, sample.name, sample.nameLen) == 0) {
+        return false;
+    }
+    memcpy(known.raw, sample.name, sample.nameLen);
+    known.len = sample.nameLen;
+    known.name = QString::fromUtf8(sample.name, sample.nameLen);
+    return true;
 }
 
-void ProcessWorker::fetchStaticInfo()
+// Reads the command line of a live process and keeps the part before the
+// first option: "/usr/bin/python3 manage.py runserver" stays whole, while
+// "/opt/google/chrome/chrome --type=renderer ..." becomes its executable,
+// so its workers share one command. Processes that rewrite their argv into
+// one string ("postgres: checkpointer") are kept as they are. Returns true
+// if the command changed.
+bool ProcessWorker::updateCommand(KnownProcess &known, pid_t pid)
 {
-    QString lscpu_out = runCommand("lscpu");
-    for(const QString& line : lscpu_out.split('\n')) {
-        if(line.startsWith("Model name:")) appData.cpuModel = line.section(':', 1).trimmed();
-        if(line.startsWith("Core(s) per socket:")) appData.cpuCores = line.section(':', 1).trimmed();
-        if(line.startsWith("CPU(s):")) appData.cpuThreads = line.section(':', 1).trimmed();
-        if(line.startsWith("L1d cache:") || line.startsWith("L1 cache:")) appData.cpuL1Cache = line.section(':', 1).trimmed();
-        if(line.startsWith("L2 cache:")) appData.cpuL2Cache = line.section(':', 1).trimmed();
-        if(line.startsWith("L3 cache:")) appData.cpuL3Cache = line.section(':', 1).trimmed();
+    known.commandRead = true;
+    ++m_commandReads;
+    int len = m_live->scanner().readCommandLine(pid, m_commandBuf, sizeof(m_commandBuf));
+    int end = 0;
+    while (end < len) {
+        int word = end;
+        if (word > 0) {
+            if (m_commandBuf[word] == '-') break;
+            m_commandBuf[word - 1] = ' ';
+        }
+        while (end < len && m_commandBuf[end] != '\0') ++end;
+        ++end;
     }
+    // Long enough to tell scripts apart, short enough to be a group label
+    QString command = QString::fromUtf8(m_commandBuf, qBound(0, qMin(end, len + 1) - 1, kCommandLength));
+    if (command == known.command) return false;
+    known.command = command;
+    return true;
+}
+
+// Reads which cgroup a process is in. Returns true if that changed.
+bool ProcessWorker::updateCgroup(KnownProcess &known, pid_t pid)
+{
+    known.cgroupRead = true;
+    if (!m_cgroups.membership(pid, m_cgroupPath)) return false;
+    QString cgroup = QString::fromStdString(m_cgroupPath);
+    if (cgroup == known.cgroup) return false;
+    known.cgroup = cgroup;
+    return true;
+}
 
-    QStringList all_gpus_out = runCommand("lspci | grep -Ei 'VGA|3D|Display'").trimmed().split('\n');
-    for (const QString &gpu_line : all_gpus_out) {
-        appData.gpuModels.append(gpu_line.section(':', 2).trimmed());
+// Rebuilds the exposition served by m_metrics from this scan. Process names
+// go out as the kernel's comm bytes, without a QString round trip.
+void ProcessWorker::publishMetrics(const ScanDelta &delta, long long totalRssKb)
+{
+    const ScanProfile::Tick &tick = delta.scanStats.profile;
+    ++m_metricsScans;
+    m_metricsSyscalls += tick.worker.syscalls;
+    for (int phase = 0; phase < ScanProfile::Export; ++phase) {
+        if (tick.phaseMs[phase] > 0) m_metricsPhaseTotalMs[phase] += tick.phaseMs[phase];
     }
+    m_metricsPhaseTotalMs[ScanProfile::Export] += m_lastExportMs;
 
-    QString dmidecode_out = runCommand("sudo -n dmidecode -t memory");
-    if (dmidecode_out.isEmpty() || dmidecode_out.contains("permission denied")) {
-        appData.memoryType = "N/A (run with sudo)";
-        appData.memorySpeed = "N/A (run with sudo)";
-        appData.memorySlots = "N/A (run with sudo)";
-    } else {
-        int deviceCount = 0;
-        for(const QString& line : dmidecode_out.split('\n')) {
-            QString trimmedLine = line.trimmed();
-            if(trimmedLine.startsWith("Locator:") && !trimmedLine.contains("Not Specified")) deviceCount++;
-            if(trimmedLine.startsWith("Type:") && appData.memoryType.isEmpty()) appData.memoryType = trimmedLine.section(':', 1).trimmed();
-            if(trimmedLine.startsWith("Speed:") && !trimmedLine.contains("Unknown") && appData.memorySpeed.isEmpty()) {
-                appData.memorySpeed = trimmedLine.section(':', 1).trimmed();
-            }
-        }
-        appData.memorySlots = QString("%1 populated").arg(deviceCount);
+    MetricsText &out = m_metricsText;
+    out.clear(m_metricsBytes + m_metricsBytes / 8);
+    out.family("memanalyzer_process_resident_memory_bytes", "gauge",
+               "Resident set size of the largest processes by RSS", "bytes");
+    long long listedKb = 0;
+    for (const auto &entry : m_rankForMetrics.takeSorted()) {
+        auto known = m_known.constFind(entry.id);
+        if (known == m_known.constEnd()) continue;
+        char pid[16];
+        int pidLen = snprintf(pid, sizeof(pid), "%d", static_cast<int>(entry.id));
+        out.sample("memanalyzer_process_resident_memory_bytes",
+                   {{"pid", pid, static_cast<size_t>(pidLen)}, {"name", known->raw, known->len}},
+                   static_cast<int64_t>(entry.key) * 1024);
+        listedKb += qMax(0L, entry.key);
     }
-}
+    out.family("memanalyzer_process_resident_memory_other_bytes", "gauge",
+               "Resident set size of all processes not listed individually", "bytes");
+    out.sample("memanalyzer_process_resident_memory_other_bytes", static_cast<int64_t>(totalRssKb - listedKb) * 1024);
+    out.family("memanalyzer_processes", "gauge", "Processes seen by the last scan");
+    out.sample("memanalyzer_processes", static_cast<int64_t>(m_known.size()));
 
+    out.family("memanalyzer_meminfo_bytes", "gauge", "Fields of /proc/meminfo", "bytes");
+    for (int field = 0; field < MemInfo::FieldCount; ++field) {
+        if (field >= MemInfo::HugePagesTotal && field <= MemInfo::HugePagesSurp) continue;
+        long value = delta.memInfo[static_cast<MemInfo::Field>(field)];
+        if (value < 0) continue;
+        const char *name = MemInfo::name(static_cast<MemInfo::Field>(field));
+        out.sample("memanalyzer_meminfo_bytes", {{"field", name, strlen(name)}}, static_cast<int64_t>(value) * 1024);
+    }
+    out.family("memanalyzer_meminfo_hugepages", "gauge", "HugePages_* counts of /proc/meminfo");
+    for (int field = MemInfo::HugePagesTotal; field <= MemInfo::HugePagesSurp; ++field) {
+        long value = delta.memInfo[static_cast<MemInfo::Field>(field)];
+        if (value < 0) continue;
+        const char *name = MemInfo::name(static_cast<MemInfo::Field>(field));
+        out.sample("memanalyzer_meminfo_hugepages", {{"field", name, strlen(name)}}, static_cast<int64_t>(value));
+    }
+    if (m_systemPressure >= 0) {
+        out.family("memanalyzer_memory_pressure_ratio", "gauge",
+                   "Share of the last 10 s in which some tasks stalled on memory (PSI)", "ratio");
+        out.sample("memanalyzer_memory_pressure_ratio", m_systemPressure);
+    }
 
-// --- VVV REWRITTEN HELPER FUNCTIONS USING DIRECT FILE I/O VVV ---
+    out.family("memanalyzer_scans", "counter", "Scans taken by the monitor");
+    out.sample("memanalyzer_scans_total", static_cast<int64_t>(m_metricsScans));
+    out.family("memanalyzer_scan_phase_seconds", "counter",
+               "Time the monitor spent in each phase of its scans; read and parse are summed over the scan threads",
+               "seconds");
+    for (int phase = 0; phase <= ScanProfile::Export; ++phase) {
+        const char *label = kMetricsPhaseLabels[phase];
+        out.sample("memanalyzer_scan_phase_seconds_total", {{"phase", label, strlen(label)}},
+                   m_metricsPhaseTotalMs[phase] / 1000);
+    }
+    out.family("memanalyzer_scan_phase_last_seconds", "gauge",
+               "Time each phase of the last scan took; export is that of the scan before", "seconds");
+    for (int phase = 0; phase <= ScanProfile::Export; ++phase) {
+        double ms = phase == ScanProfile::Export ? m_lastExportMs : tick.phaseMs[phase];
+        if (ms < 0) continue;
+        const char *label = kMetricsPhaseLabels[phase];
+        out.sample("memanalyzer_scan_phase_last_seconds", {{"phase", label, strlen(label)}}, ms / 1000);
+    }
+    out.family("memanalyzer_scan_syscalls", "counter", "System calls the monitor made reading /proc");
+    out.sample("memanalyzer_scan_syscalls_total", static_cast<int64_t>(m_metricsSyscalls));
+    out.family("memanalyzer_display_interval_seconds", "gauge",
+               "Display refresh period after adapting to load and the CPU budget", "seconds");
+    out.sample("memanalyzer_display_interval_seconds", delta.scanStats.displayIntervalMs / 1000.0);
+    out.family("memanalyzer_exporter_scrapes", "counter", "Scrapes of this endpoint");
+    out.sample("memanalyzer_exporter_scrapes_total", static_cast<int64_t>(delta.scanStats.metricsScrapes));
+    out.finish();
 
-long ProcessWorker::getMemInfo(const char *field)
+    m_metricsBytes = out.text().size();
+    m_metrics.publish(std::move(out.text()));
+}
+
+// Runs on m_probeThread; the signal is queued to receivers.
+void ProcessWorker::fetchStaticInfo(const std::string &cachePath)
 {
-    QFile file("/proc/meminfo");
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        return -1;
-    }
-    QTextStream in(&file);
-    while (!in.atEnd()) {
-        QString line = in.readLine();
-        if (line.startsWith(field)) {
-            QStringList parts = line.section(':', 1).simplified().split(' ');
-            if (!parts.isEmpty()) {
-                return parts.first().toLong();
-            }
-        }
+    HardwareProbe probe("/sys", m_live->procRoot());
+    HardwareInfo hardware = probe.cachedProbe(cachePath);
+
+    StaticInfo info;
+    info.cpuModel = QString::fromStdString(hardware.cpuModel);
+    info.cpuCores = QString::number(hardware.cpuCores);
+    info.cpuThreads = QString::number(hardware.cpuThreads);
+    info.cpuL1Cache = QString::fromStdString(hardware.l1Cache);
+    info.cpuL2Cache = QString::fromStdString(hardware.l2Cache);
+    info.cpuL3Cache = QString::fromStdString(hardware.l3Cache);
+    for (const std::string &gpu : hardware.gpus) info.gpuModels.append(QString::fromStdString(gpu));
+    if (!hardware.memoryKnown) {
+        info.memoryType = "N/A (run with sudo)";
+        info.memorySpeed = "N/A (run with sudo)";
+        info.memorySlots = "N/A (run with sudo)";
+    } else {
+        info.memoryType = hardware.memoryType.empty() ? "Unknown" : QString::fromStdString(hardware.memoryType);
+        info.memorySpeed = hardware.memorySpeed.empty() ? "Unknown" : QString::fromStdString(hardware.memorySpeed);
+        info.memorySlots = QString("%1 of %2 populated").arg(hardware.memoryPopulated).arg(hardware.memorySlots);
     }
-    return -1;
+    emit staticInfoReady(info);
 }
 
+
+// --- VVV REWRITTEN HELPER FUNCTIONS USING DIRECT FILE I/O VVV ---
+
 long ProcessWorker::getVmRssFromPid(pid_t pid)
 {
-    QFile file(QString("/proc/%1/status").arg(pid));
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        return -1;
-    }
-    QTextStream in(&file);
-    while (!in.atEnd()) {
-        QString line = in.readLine();
-        if (line.startsWith("VmRSS:")) {
-            QStringList parts = line.section(':', 1).simplified().split(' ');
-            if (!parts.isEmpty()) {
-                return parts.first().toLong();
-            }
-        }
-    }
-    return -1;
+    return threadScanner().readRssKb(pid);
 }
 
 QString ProcessWorker::getNameFromPid(pid_t pid)
 {
-    QFile file(QString("/proc/%1/comm").arg(pid));
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    char name[16];
+    int len = threadScanner().readName(pid, name, sizeof(name));
+    if (len < 0) {
         return "";
     }
-    QTextStream in(&file);
-    return in.readLine().trimmed();
+    return QString::fromUtf8(name, len);
 }
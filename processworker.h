@@ -2,8 +2,24 @@
 #define PROCESSWORKER_H
 
 #include <QObject>
+#include <QHash>
+#include <QElapsedTimer>
 #include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
 #include "datatypes.h"
+#include "datasource.h"
+#include "historystore.h"
+#include "samplescheduler.h"
+#include "pressuremonitor.h"
+#include "cgroupmonitor.h"
+#include "metricsexporter.h"
+#include "alertengine.h"
+#include "meminfo.h"
+#include "smapssampler.h"
+#include "growthdetector.h"
+#include "topk.h"
 
 class QTimer;
 
@@ -11,32 +27,195 @@ class ProcessWorker : public QObject
 {
     Q_OBJECT
 public:
-    explicit ProcessWorker(QObject *parent = nullptr);
+    // procRoot is where /proc is mounted; benchmarks point it at a fake tree.
+    explicit ProcessWorker(QObject *parent = nullptr, const char *procRoot = "/proc");
+    // Samples from source instead of the live machine. Settings that only
+    // make sense for /proc (threads, fd cache, process events, deep
+    // accounting, the hardware probe) are ignored unless it is a
+    // LiveProcSource.
+    explicit ProcessWorker(std::unique_ptr<DataSource> source, QObject *parent = nullptr);
+    ~ProcessWorker();
 
     // Public helper functions for one-off calls from MainWindow
     static long getVmRssFromPid(pid_t pid);
     static QString getNameFromPid(pid_t pid);
 
+    // Per-process memory history, appended after every scan. The store
+    // locks internally, so the GUI thread may query it directly.
+    HistoryStore &history() { return m_history; }
+    // Alerts from the rules, the leak detector and the pressure monitor,
+    // waiting to be shown; see alertsPending.
+    AlertQueue &alerts() { return m_alertQueue; }
+
 public slots:
+    // Starts sampling, and probes the hardware (see HardwareProbe) on a
+    // thread of its own meanwhile; staticInfoReady follows from there.
     void startWork();
+    // Scanning only, without the hardware probe
+    void startSampling();
+    // One scan for every consumer with a request, right away and outside
+    // the schedule; drives a recorded or synthetic source as fast as the
+    // pipeline goes.
+    void scanNow();
+    // Shorthand for the rule "system memory% > percent" next to those of
+    // setAlertRules(), 0 for none. Also the level setPressureAlert polls
+    // /proc/meminfo against without PSI.
     void setThreshold(int percent);
+    // Replaces the alert rules (see AlertEngine for the syntax), checked on
+    // every scan. Rules that do not compile are refused with a warning and
+    // the old ones kept; check them with AlertEngine::compile() first.
+    void setAlertRules(const QString &rules);
+    // Alerts (through alerts()) as soon as tasks stall on memory
+    // for more than stallMs within windowMs, system-wide and in each listed
+    // cgroup v2 path. Without PSI, polls /proc/meminfo against the usage
+    // threshold instead. stallMs 0 turns it off.
+    void setPressureAlert(int stallMs, int windowMs, const QStringList &cgroups);
+    void setFdCacheLimit(int maxFds);
+    void setScanThreadCount(int threads);
+    // Makes the next scan carry the whole process list instead of a delta,
+    // for a receiver that lost track of the generation sequence.
+    void requestFullSnapshot();
+    // How many processes each ranking in ScanDelta carries
+    void setRankingSize(int count);
+    // 0 turns the history off
+    void setHistoryBudget(int megabytes);
+    // Display refresh period; the scheduler stretches or shrinks it with
+    // the load (see SampleScheduler). Same as setConsumerInterval(Display, ...),
+    // so 0 stops display scans.
+    void setInterval(int milliseconds);
+    // Period a consumer wants scans at, 0 to stop asking. Tracker and
+    // Alerting are served on an exact grid; every ScanDelta says which
+    // consumers it was taken for.
+    void setConsumerInterval(int consumer, qint64 milliseconds);
+    // Share of one core that adaptive scanning may use, in percent
+    void setCpuBudget(double percent);
+    // See ProcScanner::setStatRefreshInterval
+    void setStatRefreshInterval(int scans);
+    // Follow process starts and exits through the netlink proc connector
+    // instead of listing /proc every scan, when the kernel allows it
+    void setProcessEvents(bool enabled);
+    // Time per scan for reading PSS/USS/swap from smaps_rollup, 0 for off
+    void setDeepAccountingBudget(double milliseconds);
+    // Alert when the leak detector projects a process to
+    // reach limitMb (0: its RSS plus MemAvailable) within horizonMinutes.
+    // horizonMinutes 0 turns these alerts off; the ranking is kept anyway.
+    void setLeakAlert(int limitMb, int horizonMinutes);
+    // Read /proc/<pid>/cmdline once per process (again after exec) and
+    // send ProcessInfo::command, for grouping by command
+    void setCommandLines(bool enabled);
+    // Follow the cgroup v2 hierarchy (see CgroupMonitor): every display
+    // scan then carries ScanDelta::cgroups, and ProcessInfo::cgroup is
+    // filled in. Off releases its descriptors and watches.
+    void setCgroupMonitoring(bool enabled);
+    // Serve every scan as OpenMetrics text on a loopback address or a Unix
+    // socket (see MetricsExporter): RSS of the topProcesses largest
+    // processes, /proc/meminfo and the worker's own scan timings. An empty
+    // address stops serving.
+    void setMetricsEndpoint(const QString &address, int topProcesses);
 
 private slots:
     void performScan();
+    // Picks up changed requests and re-arms the timer for the next scan.
+    void reschedule();
 
 signals:
-    void resultReady(const AppData &data);
-    void thresholdExceeded(const QString &message);
+    void staticInfoReady(const StaticInfo &info);
+    void scanDelta(const ScanDelta &delta);
+    // Alerts are waiting in alerts(). Emitted when the queue stops being
+    // empty, so a receiver drains it once per burst.
+    void alertsPending();
 
 private:
     // Helpers used internally
-    QString runCommand(const QString& command);
-    void fetchStaticInfo();
-    long getMemInfo(const char* field);
+    void applyRequests();
+    void armTimer();
+    void scan(unsigned consumers);
+    void fetchStaticInfo(const std::string &cachePath);
+
+    // What the receiver already knows about a process, to compute deltas
+    struct KnownProcess {
+        char raw[16];
+        unsigned char len = 0;
+        long memory = -1;
+        long growth = 0;
+        SmapsRollup rollup;
+        quint64 startTime = 0;
+        quint64 seen = 0;
+        pid_t ppid = 0;
+        int uid = -1;
+        bool commandRead = false;
+        bool cgroupRead = false;
+        int alertClass = -1;            // see AlertEngine::classify
+        unsigned alertGeneration = 0;
+        QString name;
+        QString command;
+        QString cgroup;
+    };
+
+    bool updateName(KnownProcess &known, const ProcSample &sample);
+    bool updateCommand(KnownProcess &known, pid_t pid);
+    bool updateCgroup(KnownProcess &known, pid_t pid);
+    void publishMetrics(const ScanDelta &delta, long long totalRssKb);
+    void compileAlertRules();
+    // Any thread
+    void raise(Alert &&alert);
 
-    std::atomic<int> memoryThreshold{-1};
-    AppData appData;
+    std::atomic<int> m_fdCacheLimit{16384};
+    int m_appliedFdCacheLimit = -1;
+    std::atomic<int> m_scanThreadCount{ProcScanner::defaultThreadCount()};
+    std::thread m_probeThread;
     QTimer* m_timer;
+    std::unique_ptr<DataSource> m_source;
+    LiveProcSource* m_live; // m_source, if it is the live machine
+    SourceBatch m_batch;
+    qint64 m_lastSourceTimeMs = 0;
+    // Ahead of the threads that raise alerts, so it outlives them
+    AlertEngine m_alertEngine;
+    AlertQueue m_alertQueue;
+    PressureMonitor m_pressure;
+    SmapsSampler m_smaps;
+    std::vector<SmapsRollup> m_noRollups; // for sources without smaps_rollup
+    std::atomic<double> m_smapsBudgetMs{10};
+    GrowthDetector m_growth;
+    std::atomic<int> m_leakLimitMb{0};
+    std::atomic<int> m_leakHorizonMinutes{0};
+    std::atomic<bool> m_commandLines{false};
+    int m_commandReads = 0; // this scan
+    char m_commandBuf[4096];
+    CgroupMonitor m_cgroups;
+    std::atomic<bool> m_cgroupMonitoring{false};
+    bool m_appliedCgroupMonitoring = false;
+    std::string m_cgroupPath;
+    MetricsExporter m_metrics;
+    QString m_metricsAddress;
+    int m_metricsTopProcesses = 0;
+    TopK<long, pid_t> m_rankForMetrics;
+    MetricsText m_metricsText;
+    size_t m_metricsBytes = 0;      // of the last exposition
+    quint64 m_metricsScans = 0;
+    double m_metricsPhaseTotalMs[ScanProfile::PhaseCount] = {};
+    quint64 m_metricsSyscalls = 0;
+    double m_lastExportMs = 0;
+    QString m_alertRules;
+    int m_thresholdPercent = 0;
+    std::atomic<bool> m_useProcessEvents{true};
+    bool m_appliedProcessEvents = false;
+    QHash<pid_t, KnownProcess> m_known;
+    quint64 m_generation = 0;
+    std::atomic<bool> m_fullSnapshotRequested{false};
+    std::atomic<int> m_rankingSize{10};
+    TopK<long, pid_t> m_rankByMemory;
+    TopK<long, pid_t> m_rankByGrowth;
+    QElapsedTimer m_scanClock;
+    HistoryStore m_history;
+    std::atomic<int> m_historyBudgetMb{64};
+    SampleScheduler m_scheduler;
+    QElapsedTimer m_clock;
+    std::atomic<qint64> m_requestedIntervals[SampleScheduler::ConsumerCount] = {{2000}, {0}, {0}};
+    std::atomic<double> m_cpuBudget{2.0};
+    long m_lastUsedKb = -1;
+    double m_systemPressure = -1;   // of the last scan, -1 without PSI
+    std::atomic<int> m_statRefreshInterval{1};
 };
 
 #endif // PROCESSWORKER_H
@@ -0,0 +1,275 @@
+#include "procevents.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+// Upper bound on processes sampled at exec and not yet handed over, so a
+// fork storm between two scans cannot grow the table without limit.
+const size_t kMaxPending = 4096;
+
+// Milliseconds start() waits for the kernel to acknowledge the subscription
+const int kAckTimeoutMs = 1000;
+
+ssize_t preadAtStart(int fd, char* buf, size_t size)
+{
+    ssize_t n;
+    do {
+        n = ::pread(fd, buf, size, 0);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+} // namespace
+
+ProcEvents::ProcEvents(const char* procRoot)
+{
+    m_rootFd = ::open(procRoot, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    long pageSize = sysconf(_SC_PAGESIZE);
+    m_pageKb = pageSize > 0 ? pageSize / 1024 : 4;
+}
+
+ProcEvents::~ProcEvents()
+{
+    stop();
+    if (m_rootFd >= 0) ::close(m_rootFd);
+}
+
+bool ProcEvents::start(std::string* error)
+{
+    if (isRunning()) return true;
+    stop(); // a listener that failed still holds its socket
+    auto failed = [&](const std::string& message) {
+        if (error) *error = message;
+        if (m_socket >= 0) ::close(m_socket);
+        m_socket = -1;
+        return false;
+    };
+
+    m_socket = ::socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (m_socket < 0) return failed(std::string("No netlink connector: ") + strerror(errno));
+    sockaddr_nl addr = {};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = CN_IDX_PROC;
+    if (::bind(m_socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        return failed(std::string("Cannot listen for process events: ") + strerror(errno));
+    }
+    int bufferSize = 4 * 1024 * 1024;
+    setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+    if (!subscribe(true)) return failed(std::string("Cannot subscribe to process events: ") + strerror(errno));
+
+    // Without CAP_NET_ADMIN the kernel still accepts the request but
+    // answers with an error in the acknowledgement.
+    char buf[4096];
+    for (;;) {
+        pollfd pfd = {m_socket, POLLIN, 0};
+        if (::poll(&pfd, 1, kAckTimeoutMs) <= 0) return failed("No answer from the process event connector");
+        ssize_t n = ::recv(m_socket, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return failed(std::string("Cannot read process events: ") + strerror(errno));
+        const nlmsghdr* header = reinterpret_cast<const nlmsghdr*>(buf);
+        if (!NLMSG_OK(header, static_cast<size_t>(n))
+            || header->nlmsg_len < NLMSG_LENGTH(sizeof(cn_msg) + sizeof(proc_event))) {
+            continue;
+        }
+        const cn_msg* message = static_cast<const cn_msg*>(NLMSG_DATA(header));
+        proc_event event;
+        memcpy(&event, message->data, sizeof(event));
+        if (event.what != proc_event::PROC_EVENT_NONE) continue;
+        if (event.event_data.ack.err != 0) {
+            return failed(std::string("Cannot subscribe to process events: ") + strerror(event.event_data.ack.err));
+        }
+        break;
+    }
+
+    if (::pipe2(m_wakeFds, O_CLOEXEC) != 0) return failed(std::string("pipe2: ") + strerror(errno));
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_events.clear();
+        m_pending.clear();
+        m_overflowed = false;
+        m_stats.failed = false;
+    }
+    m_thread = std::thread(&ProcEvents::listenLoop, this);
+    return true;
+}
+
+void ProcEvents::stop()
+{
+    if (m_socket < 0) return;
+    if (::write(m_wakeFds[1], "x", 1) < 0) {
+        // The listener also wakes up on the next event; nothing else to do.
+    }
+    m_thread.join();
+    subscribe(false);
+    ::close(m_socket);
+    ::close(m_wakeFds[0]);
+    ::close(m_wakeFds[1]);
+    m_socket = m_wakeFds[0] = m_wakeFds[1] = -1;
+}
+
+bool ProcEvents::isRunning() const
+{
+    if (m_socket < 0) return false;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_stats.failed;
+}
+
+bool ProcEvents::subscribe(bool listen)
+{
+    alignas(nlmsghdr) char buf[NLMSG_SPACE(sizeof(cn_msg) + sizeof(proc_cn_mcast_op))] = {};
+    nlmsghdr* header = reinterpret_cast<nlmsghdr*>(buf);
+    header->nlmsg_len = NLMSG_LENGTH(sizeof(cn_msg) + sizeof(proc_cn_mcast_op));
+    header->nlmsg_type = NLMSG_DONE;
+    cn_msg* message = static_cast<cn_msg*>(NLMSG_DATA(header));
+    message->id.idx = CN_IDX_PROC;
+    message->id.val = CN_VAL_PROC;
+    message->len = sizeof(proc_cn_mcast_op);
+    proc_cn_mcast_op op = listen ? PROC_CN_MCAST_LISTEN : PROC_CN_MCAST_IGNORE;
+    memcpy(message->data, &op, sizeof(op));
+    return ::send(m_socket, buf, header->nlmsg_len, 0) == static_cast<ssize_t>(header->nlmsg_len);
+}
+
+void ProcEvents::listenLoop()
+{
+    alignas(nlmsghdr) char buf[8192];
+    pollfd fds[2] = {{m_socket, POLLIN, 0}, {m_wakeFds[0], POLLIN, 0}};
+    for (;;) {
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            listenFailed();
+            return;
+        }
+        if (fds[1].revents) return;
+        ssize_t n = ::recv(m_socket, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == ENOBUFS) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_overflowed = true;
+                ++m_stats.overflows;
+            } else if (errno != EINTR && errno != EAGAIN) {
+                listenFailed();
+                return;
+            }
+            continue;
+        }
+        for (const nlmsghdr* header = reinterpret_cast<const nlmsghdr*>(buf); NLMSG_OK(header, static_cast<size_t>(n));
+             header = NLMSG_NEXT(header, n)) {
+            if (header->nlmsg_type == NLMSG_ERROR || header->nlmsg_type == NLMSG_NOOP) continue;
+            handleMessage(static_cast<const char*>(NLMSG_DATA(header)), header->nlmsg_len - NLMSG_HDRLEN);
+        }
+    }
+}
+
+// Scans go back to listing /proc, since no more events will come.
+void ProcEvents::listenFailed()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.failed = true;
+}
+
+void ProcEvents::handleMessage(const char* data, size_t len)
+{
+    if (len < sizeof(cn_msg) + sizeof(proc_event)) return;
+    const cn_msg* message = reinterpret_cast<const cn_msg*>(data);
+    if (message->id.idx != CN_IDX_PROC || message->id.val != CN_VAL_PROC) return;
+    // The event follows the 20-byte cn_msg, so it is not aligned for reading in place.
+    proc_event event;
+    memcpy(&event, message->data, sizeof(event));
+
+    // Thread events are reported too; only whole processes matter here.
+    switch (event.what) {
+    case proc_event::PROC_EVENT_FORK: {
+        pid_t pid = event.event_data.fork.child_pid;
+        if (pid != event.event_data.fork.child_tgid) return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_events.push_back({pid, false});
+        ++m_stats.events;
+        return;
+    }
+    case proc_event::PROC_EVENT_EXEC: {
+        pid_t pid = event.event_data.exec.process_tgid;
+        ProcSample sample;
+        bool sampled = sampleNow(pid, sample);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_events.push_back({pid, false});
+        ++m_stats.events;
+        if (sampled && (m_pending.size() < kMaxPending || m_pending.count(pid))) m_pending[pid] = {sample, false};
+        return;
+    }
+    case proc_event::PROC_EVENT_EXIT: {
+        pid_t pid = event.event_data.exit.process_pid;
+        if (pid != event.event_data.exit.process_tgid) return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_events.push_back({pid, true});
+        ++m_stats.events;
+        auto it = m_pending.find(pid);
+        if (it != m_pending.end()) it->second.exited = true;
+        return;
+    }
+    default:
+        return;
+    }
+}
+
+// Same files and parsing as ProcScanner, through this thread's buffers.
+bool ProcEvents::sampleNow(pid_t pid, ProcSample& out)
+{
+    char path[32];
+    int len = snprintf(path, sizeof(path), "%d/statm", pid);
+    int fd = ::openat(m_rootFd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    ssize_t n = preadAtStart(fd, m_statmBuf, sizeof(m_statmBuf));
+    ::close(fd);
+    const char* p = m_statmBuf;
+    long size = 0, resident = 0;
+    if (n <= 0 || !ProcScanner::parseLong(p, m_statmBuf + n, size)
+        || !ProcScanner::parseLong(p, m_statmBuf + n, resident) || size == 0) {
+        return false;
+    }
+
+    path[len - 1] = '\0'; // "<pid>/stat"
+    fd = ::openat(m_rootFd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    n = preadAtStart(fd, m_statBuf, sizeof(m_statBuf));
+    struct stat st;
+    out.uid = ::fstat(fd, &st) == 0 ? st.st_uid : static_cast<uid_t>(-1);
+    ::close(fd);
+    if (n <= 0 || !ProcScanner::parseStat(m_statBuf, static_cast<size_t>(n), out)) return false;
+    out.pid = pid;
+    out.rssKb = resident * m_pageKb;
+    return true;
+}
+
+bool ProcEvents::drain(std::vector<ProcEvent>& events, std::vector<ProcSample>& transient)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    events.swap(m_events);
+    m_events.clear();
+    transient.clear();
+    for (const auto& entry : m_pending) {
+        if (entry.second.exited) transient.push_back(entry.second.sample);
+    }
+    // Those still running are picked up by the next scan.
+    m_pending.clear();
+    m_stats.transient += transient.size();
+    bool complete = !m_overflowed && !m_stats.failed;
+    m_overflowed = false;
+    return complete;
+}
+
+ProcEvents::Stats ProcEvents::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
@@ -0,0 +1,83 @@
+#ifndef PROCEVENTS_H
+#define PROCEVENTS_H
+
+#include <sys/types.h>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "procscanner.h"
+
+// Process lifecycle events from the kernel's netlink proc connector
+// (PROC_EVENT_FORK/EXEC/EXIT), so the set of live PIDs can be kept up to
+// date without listing /proc. Listening needs CAP_NET_ADMIN in the initial
+// network namespace; start() fails without it and callers fall back to
+// listing /proc.
+//
+// A listener thread queues the events. It also samples a process right
+// after exec, so one that exits again before the next scan is still seen
+// once (with the RSS it had then).
+class ProcEvents
+{
+public:
+    // overflows counts the times events were lost because the socket buffer
+    // filled up, after which the caller has to list /proc again. failed is
+    // set once the listener gave up on a socket error; from then on nothing
+    // arrives and drain() always returns false.
+    struct Stats {
+        unsigned long long events = 0;
+        unsigned long long overflows = 0;
+        unsigned long long transient = 0; // exited before a scan saw them
+        bool failed = false;
+    };
+
+    explicit ProcEvents(const char* procRoot = "/proc");
+    ~ProcEvents();
+    ProcEvents(const ProcEvents&) = delete;
+    ProcEvents& operator=(const ProcEvents&) = delete;
+
+    bool start(std::string* error = nullptr);
+    void stop();
+    // False again once the listener has failed; start() then sets it up anew.
+    bool isRunning() const;
+
+    // Hands over everything that happened since the last call: processes
+    // that started or exited, in order, and the samples taken at exec of
+    // processes that have exited since. Returns false if events were lost,
+    // in which case the list is incomplete.
+    bool drain(std::vector<ProcEvent>& events, std::vector<ProcSample>& transient);
+
+    Stats stats() const;
+
+private:
+    struct Pending {
+        ProcSample sample;
+        bool exited = false;
+    };
+
+    bool subscribe(bool listen);
+    void listenLoop();
+    void listenFailed();
+    void handleMessage(const char* data, size_t len);
+    bool sampleNow(pid_t pid, ProcSample& out);
+
+    int m_rootFd = -1;
+    int m_socket = -1;
+    int m_wakeFds[2] = {-1, -1};
+    long m_pageKb = 4;
+    std::thread m_thread;
+
+    mutable std::mutex m_mutex;
+    std::vector<ProcEvent> m_events;
+    std::unordered_map<pid_t, Pending> m_pending;
+    bool m_overflowed = false;
+    Stats m_stats;
+
+    // Listener thread only
+    char m_statmBuf[128];
+    char m_statBuf[1024];
+};
+
+#endif // PROCEVENTS_H
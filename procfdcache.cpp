@@ -0,0 +1,159 @@
+#include "procfdcache.h"
+
+#include <sys/resource.h>
+#include <unistd.h>
+#include <algorithm>
+
+namespace {
+
+void closeFd(int& fd)
+{
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
+
+} // namespace
+
+ProcFdCache::ProcFdCache(int maxFds)
+{
+    setLimit(maxFds);
+}
+
+ProcFdCache::~ProcFdCache()
+{
+    trimTo(0);
+}
+
+void ProcFdCache::setLimit(int maxFds)
+{
+    rlim_t wanted = maxFds > 0 ? static_cast<rlim_t>(maxFds) : 0;
+    struct rlimit rl;
+    if (::getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY) {
+        wanted = std::min(wanted, rl.rlim_cur / 2);
+    }
+
+    m_maxEntries = static_cast<int>(wanted / 2);
+    trimTo(m_maxEntries);
+    m_index.reserve(static_cast<size_t>(m_maxEntries));
+}
+
+void ProcFdCache::raiseFileLimit(long wantedFds, long *before, long *after)
+{
+    struct rlimit rl;
+    *before = *after = -1;
+    if (::getrlimit(RLIMIT_NOFILE, &rl) != 0) return;
+    *before = *after = rl.rlim_cur == RLIM_INFINITY ? -1 : static_cast<long>(rl.rlim_cur);
+    rlim_t wanted = static_cast<rlim_t>(std::max(0L, wantedFds));
+    if (rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur >= wanted) return;
+    rl.rlim_cur = rl.rlim_max == RLIM_INFINITY ? wanted : std::min(rl.rlim_max, wanted);
+    if (::setrlimit(RLIMIT_NOFILE, &rl) == 0) *after = static_cast<long>(rl.rlim_cur);
+}
+
+void ProcFdCache::beginTick()
+{
+    ++m_tick;
+}
+
+int ProcFdCache::acquire(pid_t pid)
+{
+    auto it = m_index.find(pid);
+    if (it != m_index.end()) {
+        int slot = it->second;
+        m_entries[slot].lastTick = m_tick;
+        unlink(slot);
+        pushFront(slot);
+        return slot;
+    }
+    if (m_maxEntries == 0) return -1;
+
+    if (static_cast<int>(m_index.size()) >= m_maxEntries) {
+        // Only recycle an entry that this tick does not still need.
+        if (m_tail < 0 || m_entries[m_tail].lastTick == m_tick) return -1;
+        ++m_stats.evictions;
+        release(m_tail);
+    }
+
+    int slot;
+    if (!m_freeSlots.empty()) {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    } else {
+        slot = static_cast<int>(m_entries.size());
+        m_entries.emplace_back();
+    }
+    ProcFdEntry& e = m_entries[slot];
+    e = ProcFdEntry();
+    e.pid = pid;
+    e.lastTick = m_tick;
+    m_index.emplace(pid, slot);
+    pushFront(slot);
+    return slot;
+}
+
+void ProcFdCache::endTick()
+{
+    // Everything touched this tick sits in front of everything that was not,
+    // so untouched PIDs (exited, or no longer listed) collect at the tail.
+    while (m_tail >= 0 && m_entries[m_tail].lastTick != m_tick) {
+        ++m_stats.exits;
+        release(m_tail);
+    }
+    for (int slot = m_head; slot >= 0;) {
+        int next = m_entries[slot].next;
+        if (m_entries[slot].stale) {
+            ++m_stats.exits;
+            release(slot);
+        }
+        slot = next;
+    }
+}
+
+ProcFdCache::Stats ProcFdCache::stats() const
+{
+    Stats s = m_stats;
+    s.fdLimit = m_maxEntries * 2;
+    s.openFds = 0;
+    for (int slot = m_head; slot >= 0; slot = m_entries[slot].next) {
+        s.openFds += (m_entries[slot].statmFd >= 0) + (m_entries[slot].statFd >= 0);
+    }
+    return s;
+}
+
+void ProcFdCache::unlink(int slot)
+{
+    ProcFdEntry& e = m_entries[slot];
+    if (e.prev >= 0) m_entries[e.prev].next = e.next;
+    else if (m_head == slot) m_head = e.next;
+    if (e.next >= 0) m_entries[e.next].prev = e.prev;
+    else if (m_tail == slot) m_tail = e.prev;
+    e.prev = e.next = -1;
+}
+
+void ProcFdCache::pushFront(int slot)
+{
+    ProcFdEntry& e = m_entries[slot];
+    e.prev = -1;
+    e.next = m_head;
+    if (m_head >= 0) m_entries[m_head].prev = slot;
+    m_head = slot;
+    if (m_tail < 0) m_tail = slot;
+}
+
+void ProcFdCache::release(int slot)
+{
+    ProcFdEntry& e = m_entries[slot];
+    unlink(slot);
+    closeFd(e.statmFd);
+    closeFd(e.statFd);
+    m_index.erase(e.pid);
+    e.pid = 0;
+    m_freeSlots.push_back(slot);
+}
+
+void ProcFdCache::trimTo(int maxEntries)
+{
+    while (static_cast<int>(m_index.size()) > maxEntries && m_tail >= 0) {
+        ++m_stats.evictions;
+        release(m_tail);
+    }
+}
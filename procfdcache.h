@@ -0,0 +1,90 @@
+#ifndef PROCFDCACHE_H
+#define PROCFDCACHE_H
+
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+// Open descriptors for one process, kept across scans so each tick costs a
+// pread() instead of a path lookup + open + read + close.
+struct ProcFdEntry {
+    pid_t pid = 0;
+    int statmFd = -1;
+    int statFd = -1;
+    unsigned long long startTime = 0; // field 22 of /proc/<pid>/stat
+    pid_t ppid = 0;                   // field 4, as of the last stat read
+    uid_t uid = static_cast<uid_t>(-1);
+    unsigned long long lastTick = 0;
+    bool stale = false;               // read failed (ESRCH), drop at endTick()
+    bool kernelThread = false;        // nothing to sample, descriptors closed
+    bool statCached = false;          // name below is from an earlier stat read
+    unsigned char nameLen = 0;
+    char name[16];
+    int prev = -1;                    // LRU links, slot indices
+    int next = -1;
+};
+
+// Per-PID descriptor cache with LRU eviction. Lookups and evictions happen
+// between beginTick() and endTick() on the scanning thread; the descriptors
+// of an acquired slot may then be used by whichever thread samples that PID.
+class ProcFdCache
+{
+public:
+    struct Stats {
+        unsigned long long hits = 0;
+        unsigned long long misses = 0;
+        unsigned long long evictions = 0;   // dropped by LRU to stay under the cap
+        unsigned long long exits = 0;       // dropped because the process went away
+        unsigned long long reuses = 0;      // PID came back with a new start time
+        int openFds = 0;
+        int fdLimit = 0;
+    };
+
+    explicit ProcFdCache(int maxFds = 16384);
+    ~ProcFdCache();
+    ProcFdCache(const ProcFdCache&) = delete;
+    ProcFdCache& operator=(const ProcFdCache&) = delete;
+
+    // Caps the number of cached descriptors. The cache never takes more than
+    // half of the soft RLIMIT_NOFILE, leaving the rest to the application.
+    void setLimit(int maxFds);
+    // Raises the soft RLIMIT_NOFILE to wantedFds, or the hard limit if that
+    // is lower, so a cache of wantedFds / 2 descriptors fits. It applies to
+    // the whole process, so it is meant to be called once at startup.
+    // Returns the soft limit before and after.
+    static void raiseFileLimit(long wantedFds, long *before, long *after);
+    int limit() const { return m_maxEntries * 2; }
+
+    void beginTick();
+    // Returns the slot for pid, creating it if there is room, or -1 when the
+    // cache is disabled or full of entries already used this tick.
+    int acquire(pid_t pid);
+    ProcFdEntry& entry(int slot) { return m_entries[slot]; }
+    // Closes descriptors of stale entries and of PIDs not seen this tick.
+    void endTick();
+
+    void addCounts(unsigned long long hits, unsigned long long misses, unsigned long long reuses)
+    {
+        m_stats.hits += hits;
+        m_stats.misses += misses;
+        m_stats.reuses += reuses;
+    }
+    Stats stats() const;
+
+private:
+    void unlink(int slot);
+    void pushFront(int slot);
+    void release(int slot);
+    void trimTo(int maxEntries);
+
+    std::vector<ProcFdEntry> m_entries;
+    std::vector<int> m_freeSlots;
+    std::unordered_map<pid_t, int> m_index;
+    int m_head = -1;
+    int m_tail = -1;
+    int m_maxEntries = 0;
+    unsigned long long m_tick = 0;
+    Stats m_stats;
+};
+
+#endif // PROCFDCACHE_H
@@ -0,0 +1,578 @@
+#include "procscanner.h"
+#include "procevents.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+struct LinuxDirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+// Writes "<pid>/<file>" into buf without going through printf.
+void buildPidPath(char* buf, pid_t pid, const char* file)
+{
+    char digits[16];
+    int n = 0;
+    unsigned int value = static_cast<unsigned int>(pid);
+    do {
+        digits[n++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    char* p = buf;
+    while (n > 0) *p++ = digits[--n];
+    *p++ = '/';
+    while (*file) *p++ = *file++;
+    *p = '\0';
+}
+
+// Returns the PID for an all-digit directory name, or -1.
+pid_t parsePidName(const char* name)
+{
+    if (*name < '0' || *name > '9') return -1;
+    long value = 0;
+    for (; *name; ++name) {
+        if (*name < '0' || *name > '9') return -1;
+        value = value * 10 + (*name - '0');
+    }
+    return static_cast<pid_t>(value);
+}
+
+long long nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ssize_t preadAtStart(int fd, char* buf, size_t size)
+{
+    ssize_t n;
+    do {
+        n = ::pread(fd, buf, size, 0);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+enum { kSampled, kSkipped, kGone };
+
+const unsigned long kPfKthread = 0x00200000; // PF_KTHREAD in the stat flags field
+
+// Cached kernel threads hold no descriptors, so nothing stops their PID from
+// going to a new process; their stat is read again every this many scans.
+const unsigned long long kKernelThreadRecheck = 16;
+
+// Only every n-th syscall of the sampling threads is timed, as reading the
+// clock costs a few percent of a cached pread().
+const unsigned long long kTimedEvery = 8;
+
+// PIDs claimed at a time from a shard; small enough to balance, large enough
+// that threads do not fight over the cursor.
+const size_t kChunk = 16;
+
+} // namespace
+
+ProcScanner::ProcScanner(const char* procRoot)
+{
+    m_rootFd = ::open(procRoot, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    long pageSize = sysconf(_SC_PAGESIZE);
+    m_pageKb = pageSize > 0 ? pageSize / 1024 : 4;
+    setThreadCount(1);
+}
+
+ProcScanner::~ProcScanner()
+{
+    stopThreads();
+    if (m_rootFd >= 0) ::close(m_rootFd);
+}
+
+int ProcScanner::defaultThreadCount()
+{
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    return std::clamp(cores / 8, 1, 4);
+}
+
+void ProcScanner::setThreadCount(int threads)
+{
+    threads = std::max(threads, 1);
+    if (threads == threadCount()) return;
+    stopThreads();
+    m_shards.clear();
+    for (int i = 0; i < threads; ++i) m_shards.push_back(std::make_unique<Shard>());
+    m_stopping = false;
+    for (int i = 1; i < threads; ++i) m_threads.emplace_back(&ProcScanner::workerLoop, this, static_cast<size_t>(i), m_round);
+}
+
+void ProcScanner::stopThreads()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_poolMutex);
+        m_stopping = true;
+    }
+    m_startCv.notify_all();
+    for (std::thread& thread : m_threads) thread.join();
+    m_threads.clear();
+}
+
+void ProcScanner::workerLoop(size_t self, unsigned long long seen)
+{
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_poolMutex);
+            m_startCv.wait(lock, [&] { return m_stopping || m_round != seen; });
+            if (m_stopping) return;
+            seen = m_round;
+        }
+        runShard(self);
+        std::lock_guard<std::mutex> lock(m_poolMutex);
+        if (--m_pending == 0) m_doneCv.notify_one();
+    }
+}
+
+void ProcScanner::runShard(size_t self)
+{
+    Shard& shard = *m_shards[self];
+    ReadContext& ctx = shard.ctx;
+    ctx.hits = ctx.misses = ctx.reuses = 0;
+    ctx.syscalls = 0;
+    ctx.timedSyscalls = 0;
+    ctx.syscallNs = 0;
+    long long started = nowNs();
+    shard.batch.clear();
+
+    // Own shard first, then steal from the others in turn.
+    const size_t shardCount = m_shards.size();
+    for (size_t k = 0; k < shardCount; ++k) {
+        Shard& victim = *m_shards[(self + k) % shardCount];
+        for (;;) {
+            size_t begin = victim.next.fetch_add(kChunk, std::memory_order_relaxed);
+            if (begin >= victim.end) break;
+            size_t end = std::min(begin + kChunk, victim.end);
+            for (size_t i = begin; i < end; ++i) {
+                shard.batch.emplace_back();
+                ProcSample& out = shard.batch.back();
+                bool ok = m_slots[i] >= 0 ? sampleCached(m_fdCache.entry(m_slots[i]), ctx, out)
+                                          : sampleUncached(m_pids[i], ctx, out);
+                if (!ok) shard.batch.pop_back();
+            }
+        }
+    }
+    ctx.busyNs = nowNs() - started;
+}
+
+bool ProcScanner::parseLong(const char*& p, const char* end, long& value)
+{
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    if (p >= end || *p < '0' || *p > '9') return false;
+    long result = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        result = result * 10 + (*p - '0');
+        ++p;
+    }
+    value = result;
+    return true;
+}
+
+const std::vector<pid_t>& ProcScanner::listPids()
+{
+    ++m_listings;
+    m_pids.clear();
+    if (m_rootFd < 0) return m_pids;
+
+    int dirFd = ::openat(m_rootFd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    ++m_listSyscalls;
+    if (dirFd < 0) return m_pids;
+    for (;;) {
+        long n = ::syscall(SYS_getdents64, dirFd, m_dirBuf, sizeof(m_dirBuf));
+        ++m_listSyscalls;
+        if (n <= 0) break;
+        for (long offset = 0; offset < n;) {
+            const auto* entry = reinterpret_cast<const LinuxDirent64*>(m_dirBuf + offset);
+            offset += entry->d_reclen;
+            if (entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN) continue;
+            pid_t pid = parsePidName(entry->d_name);
+            if (pid > 0) m_pids.push_back(pid);
+        }
+    }
+    ::close(dirFd);
+    ++m_listSyscalls;
+    return m_pids;
+}
+
+void ProcScanner::setEventSource(ProcEvents* events, int reconcileScans)
+{
+    m_events = events;
+    m_reconcileScans = reconcileScans < 1 ? 1 : reconcileScans;
+    m_pidsTracked = false;
+    m_pidIndex.clear();
+    m_transient.clear();
+}
+
+// Applies the events since the last scan to m_pids, or falls back to a
+// full listing when the list cannot be trusted.
+const std::vector<pid_t>& ProcScanner::trackPids()
+{
+    bool complete = m_events->drain(m_eventBuf, m_transient);
+    if (!complete || !m_pidsTracked || m_scanCount % m_reconcileScans == 0) {
+        listPids();
+        m_pidIndex.clear();
+        for (size_t i = 0; i < m_pids.size(); ++i) m_pidIndex.emplace(m_pids[i], i);
+        m_pidsTracked = true;
+        return m_pids;
+    }
+    for (const ProcEvent& event : m_eventBuf) {
+        auto it = m_pidIndex.find(event.pid);
+        if (!event.exited) {
+            if (it == m_pidIndex.end()) {
+                m_pidIndex.emplace(event.pid, m_pids.size());
+                m_pids.push_back(event.pid);
+            }
+        } else if (it != m_pidIndex.end()) {
+            size_t index = it->second;
+            m_pidIndex.erase(it);
+            if (index + 1 != m_pids.size()) {
+                m_pids[index] = m_pids.back();
+                m_pidIndex[m_pids[index]] = index;
+            }
+            m_pids.pop_back();
+        }
+    }
+    return m_pids;
+}
+
+int ProcScanner::openPidFile(pid_t pid, const char* file, ReadContext* ctx)
+{
+    if (m_rootFd < 0) return -1;
+    char path[64];
+    buildPidPath(path, pid, file);
+    long long started = ctx ? beginSyscall(*ctx) : 0;
+    int fd = ::openat(m_rootFd, path, O_RDONLY | O_CLOEXEC);
+    if (ctx) endSyscall(*ctx, started);
+    return fd;
+}
+
+ssize_t ProcScanner::readPidFile(pid_t pid, const char* file, char* buf, size_t size, ReadContext* ctx)
+{
+    int fd = openPidFile(pid, file, ctx);
+    if (fd < 0) return -1;
+    if (!ctx) {
+        ssize_t n = preadAtStart(fd, buf, size);
+        ::close(fd);
+        return n;
+    }
+    ssize_t n = readAt(fd, buf, size, *ctx);
+    closeFd(fd, *ctx);
+    return n;
+}
+
+ssize_t ProcScanner::readAt(int fd, char* buf, size_t size, ReadContext& ctx)
+{
+    long long started = beginSyscall(ctx);
+    ssize_t n = preadAtStart(fd, buf, size);
+    endSyscall(ctx, started);
+    return n;
+}
+
+void ProcScanner::closeFd(int& fd, ReadContext& ctx)
+{
+    long long started = beginSyscall(ctx);
+    ::close(fd);
+    endSyscall(ctx, started);
+    fd = -1;
+}
+
+// /proc/<pid> files belong to the process's effective UID (root for
+// non-dumpable processes, like ps shows them).
+uid_t ProcScanner::ownerOf(int fd, ReadContext& ctx)
+{
+    struct stat st;
+    long long started = beginSyscall(ctx);
+    int result = ::fstat(fd, &st);
+    endSyscall(ctx, started);
+    return result == 0 ? st.st_uid : static_cast<uid_t>(-1);
+}
+
+// Syscalls of the sampling threads are counted and a sample of them timed,
+// so that what remains of a shard's time is parsing and bookkeeping.
+// Returns 0 for an untimed call.
+long long ProcScanner::beginSyscall(ReadContext& ctx)
+{
+    return ctx.syscalls % kTimedEvery == 0 ? nowNs() : 0;
+}
+
+void ProcScanner::endSyscall(ReadContext& ctx, long long started)
+{
+    ++ctx.syscalls;
+    if (started == 0) return;
+    ++ctx.timedSyscalls;
+    ctx.syscallNs += nowNs() - started;
+}
+
+bool ProcScanner::parseStatm(const char* buf, ssize_t len, long& rssKb) const
+{
+    // statm: size resident shared text lib data dt, all in pages
+    if (len <= 0) return false;
+    const char* p = buf;
+    const char* end = buf + len;
+    long size = 0, resident = 0;
+    if (!parseLong(p, end, size) || !parseLong(p, end, resident)) return false;
+    if (size == 0) return false;
+    rssKb = resident * m_pageKb;
+    return true;
+}
+
+bool ProcScanner::parseStat(const char* buf, size_t len, ProcSample& out, unsigned long* flags)
+{
+    // "pid (comm) state ppid ..." - comm may itself contain ") ", so the
+    // fields resume after the last closing parenthesis.
+    const char* end = buf + len;
+    const char* open = static_cast<const char*>(memchr(buf, '(', len));
+    const char* close = end;
+    while (close > buf && close[-1] != ')') --close;
+    if (!open || close <= open + 1) return false;
+    size_t nameLen = static_cast<size_t>(close - 1 - (open + 1));
+    if (nameLen > sizeof(out.name)) nameLen = sizeof(out.name);
+    memcpy(out.name, open + 1, nameLen);
+    out.nameLen = static_cast<unsigned char>(nameLen);
+
+    // close points just past ')'; field 3 (state) follows a blank.
+    const char* p = close;
+    out.ppid = 0;
+    for (int field = 3; field < 22; ++field) {
+        while (p < end && *p == ' ') ++p;
+        if (field == 4) {
+            long ppid = 0;
+            parseLong(p, end, ppid);
+            out.ppid = static_cast<pid_t>(ppid);
+        }
+        if (field == 9 && flags) {
+            long value = 0;
+            parseLong(p, end, value);
+            *flags = static_cast<unsigned long>(value);
+        }
+        while (p < end && *p != ' ') ++p;
+    }
+    long long startTime = 0;
+    while (p < end && *p == ' ') ++p;
+    if (p >= end || *p < '0' || *p > '9') return false;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) startTime = startTime * 10 + (*p - '0');
+    out.startTime = static_cast<unsigned long long>(startTime);
+    return true;
+}
+
+long ProcScanner::readRssKb(pid_t pid)
+{
+    long rssKb;
+    ssize_t n = readPidFile(pid, "statm", m_readBuf, sizeof(m_readBuf));
+    return parseStatm(m_readBuf, n, rssKb) ? rssKb : -1;
+}
+
+int ProcScanner::readName(pid_t pid, char* out, size_t outSize)
+{
+    ssize_t n = readPidFile(pid, "comm", m_readBuf, sizeof(m_readBuf));
+    if (n < 0) return -1;
+    while (n > 0 && (m_readBuf[n - 1] == '\n' || m_readBuf[n - 1] == ' ')) --n;
+    size_t len = static_cast<size_t>(n) < outSize ? static_cast<size_t>(n) : outSize;
+    memcpy(out, m_readBuf, len);
+    return static_cast<int>(len);
+}
+
+int ProcScanner::readCommandLine(pid_t pid, char* out, size_t outSize)
+{
+    ssize_t n = readPidFile(pid, "cmdline", out, outSize);
+    if (n < 0) return -1;
+    while (n > 0 && out[n - 1] == '\0') --n;
+    return static_cast<int>(n);
+}
+
+// Reads both files through the entry's descriptors. Returns kSampled, or
+// kSkipped for kernel threads and zombies, or kGone once the process exited.
+int ProcScanner::readEntry(ProcFdEntry& entry, ReadContext& ctx, ProcSample& out)
+{
+    ssize_t n = readAt(entry.statmFd, ctx.statmBuf, sizeof(ctx.statmBuf), ctx);
+    if (n < 0) return kGone;
+    if (!parseStatm(ctx.statmBuf, n, out.rssKb)) return kSkipped;
+    out.pid = entry.pid;
+    if (entry.statCached && (m_scanCount + static_cast<unsigned long long>(entry.pid)) % m_statRefresh != 0) {
+        // The descriptors pin the process, so its start time cannot change;
+        // only the name (after exec) can, and that may wait a few scans.
+        memcpy(out.name, entry.name, entry.nameLen);
+        out.nameLen = entry.nameLen;
+        out.startTime = entry.startTime;
+        out.ppid = entry.ppid;
+        out.uid = entry.uid;
+        return kSampled;
+    }
+    n = readAt(entry.statFd, ctx.statBuf, sizeof(ctx.statBuf), ctx);
+    if (n < 0) return kGone;
+    if (!parseStat(ctx.statBuf, static_cast<size_t>(n), out)) return kSkipped;
+    memcpy(entry.name, out.name, out.nameLen);
+    entry.nameLen = out.nameLen;
+    entry.ppid = out.ppid;
+    entry.statCached = true;
+    out.uid = entry.uid;
+    return kSampled;
+}
+
+bool ProcScanner::isKernelThread(ProcFdEntry& entry, ReadContext& ctx)
+{
+    ssize_t n = readAt(entry.statFd, ctx.statBuf, sizeof(ctx.statBuf), ctx);
+    unsigned long flags = 0;
+    ProcSample scratch;
+    if (n <= 0 || !parseStat(ctx.statBuf, static_cast<size_t>(n), scratch, &flags)) return false;
+    entry.startTime = scratch.startTime;
+    return (flags & kPfKthread) != 0;
+}
+
+// False if the PID now belongs to another process (or none).
+bool ProcScanner::stillKernelThread(ProcFdEntry& entry, ReadContext& ctx)
+{
+    ssize_t n = readPidFile(entry.pid, "stat", ctx.statBuf, sizeof(ctx.statBuf), &ctx);
+    unsigned long flags = 0;
+    ProcSample scratch;
+    if (n <= 0 || !parseStat(ctx.statBuf, static_cast<size_t>(n), scratch, &flags)) return false;
+    return (flags & kPfKthread) != 0 && scratch.startTime == entry.startTime;
+}
+
+bool ProcScanner::sampleCached(ProcFdEntry& entry, ReadContext& ctx, ProcSample& out)
+{
+    if (entry.kernelThread) {
+        if ((m_scanCount + static_cast<unsigned long long>(entry.pid)) % kKernelThreadRecheck != 0
+            || stillKernelThread(entry, ctx)) {
+            ++ctx.hits;
+            return false;
+        }
+        entry.kernelThread = false;
+        entry.statCached = false;
+    }
+    if (entry.statmFd >= 0) {
+        int result = readEntry(entry, ctx, out);
+        if (result != kGone) {
+            ++ctx.hits;
+            return result == kSampled;
+        }
+        // The process behind our descriptors is gone, but the PID is still
+        // listed: it has been reused, so fall through and reopen it.
+        closeFd(entry.statmFd, ctx);
+        closeFd(entry.statFd, ctx);
+        entry.statCached = false;
+    }
+
+    ++ctx.misses;
+    entry.statmFd = openPidFile(entry.pid, "statm", &ctx);
+    entry.statFd = openPidFile(entry.pid, "stat", &ctx);
+    if (entry.statmFd < 0 || entry.statFd < 0) {
+        entry.stale = true;
+        return false;
+    }
+    // The owner only changes through setuid(), which is rare enough to
+    // pick up when the descriptors are next reopened.
+    entry.uid = ownerOf(entry.statFd, ctx);
+    int result = readEntry(entry, ctx, out);
+    if (result == kGone) {
+        entry.stale = true;
+        return false;
+    }
+    if (result == kSkipped && isKernelThread(entry, ctx)) {
+        // Kernel threads never get an address space; remember that without
+        // holding descriptors so later ticks skip them with no syscalls.
+        closeFd(entry.statmFd, ctx);
+        closeFd(entry.statFd, ctx);
+        entry.kernelThread = true;
+        return false;
+    }
+    if (result == kSampled) {
+        if (entry.startTime != 0 && entry.startTime != out.startTime) ++ctx.reuses;
+        entry.startTime = out.startTime;
+    }
+    return result == kSampled;
+}
+
+bool ProcScanner::sampleUncached(pid_t pid, ReadContext& ctx, ProcSample& out)
+{
+    ++ctx.misses;
+    ssize_t n = readPidFile(pid, "statm", ctx.statmBuf, sizeof(ctx.statmBuf), &ctx);
+    if (!parseStatm(ctx.statmBuf, n, out.rssKb)) return false;
+    int fd = openPidFile(pid, "stat", &ctx);
+    if (fd < 0) return false;
+    n = readAt(fd, ctx.statBuf, sizeof(ctx.statBuf), ctx);
+    out.uid = n > 0 ? ownerOf(fd, ctx) : static_cast<uid_t>(-1);
+    closeFd(fd, ctx);
+    if (n <= 0 || !parseStat(ctx.statBuf, static_cast<size_t>(n), out)) return false;
+    out.pid = pid;
+    return true;
+}
+
+const std::vector<ProcSample>& ProcScanner::scan()
+{
+    scan(m_samples);
+    return m_samples;
+}
+
+void ProcScanner::scan(std::vector<ProcSample>& out)
+{
+    ++m_scanCount;
+    long long started = nowNs();
+    m_listSyscalls = 0;
+    const std::vector<pid_t>& pids = m_events ? trackPids() : listPids();
+    long long listed = nowNs();
+    m_fdCache.beginTick();
+    m_slots.resize(pids.size());
+    for (size_t i = 0; i < pids.size(); ++i) m_slots[i] = m_fdCache.acquire(pids[i]);
+
+    const size_t shardCount = m_shards.size();
+    for (size_t s = 0; s < shardCount; ++s) {
+        m_shards[s]->next.store(pids.size() * s / shardCount, std::memory_order_relaxed);
+        m_shards[s]->end = pids.size() * (s + 1) / shardCount;
+        m_shards[s]->batch.reserve(pids.size());
+    }
+
+    if (shardCount > 1) {
+        {
+            std::lock_guard<std::mutex> lock(m_poolMutex);
+            ++m_round;
+            m_pending = shardCount - 1;
+        }
+        m_startCv.notify_all();
+    }
+    runShard(0);
+    if (shardCount > 1) {
+        std::unique_lock<std::mutex> lock(m_poolMutex);
+        m_doneCv.wait(lock, [&] { return m_pending == 0; });
+    }
+
+    // Each thread wrote only to its own batch, so merging is a plain append.
+    out.clear();
+    m_profile = Profile();
+    m_profile.syscalls = m_listSyscalls;
+    for (const std::unique_ptr<Shard>& shard : m_shards) {
+        out.insert(out.end(), shard->batch.begin(), shard->batch.end());
+        m_fdCache.addCounts(shard->ctx.hits, shard->ctx.misses, shard->ctx.reuses);
+        const ReadContext& ctx = shard->ctx;
+        double syscallNs = ctx.timedSyscalls ? static_cast<double>(ctx.syscallNs) * ctx.syscalls / ctx.timedSyscalls : 0;
+        syscallNs = std::min(syscallNs, static_cast<double>(ctx.busyNs));
+        m_profile.syscalls += ctx.syscalls;
+        m_profile.readMs += syscallNs / 1e6;
+        m_profile.parseMs += (ctx.busyNs - syscallNs) / 1e6;
+    }
+    // A transient PID may already belong to a new process that is listed.
+    for (const ProcSample& sample : m_transient) {
+        if (!m_pidIndex.count(sample.pid)) out.push_back(sample);
+    }
+    m_transient.clear();
+
+    m_fdCache.endTick();
+    m_profile.listMs = (listed - started) / 1e6;
+    m_profile.sampleMs = (nowNs() - listed) / 1e6;
+}
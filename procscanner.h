@@ -0,0 +1,183 @@
+#ifndef PROCSCANNER_H
+#define PROCSCANNER_H
+
+#include <sys/types.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "procfdcache.h"
+
+class ProcEvents;
+
+// Raw result for a single process. Fixed-size so a scan can reuse the same
+// storage every tick without touching the heap.
+struct ProcSample {
+    pid_t pid;
+    pid_t ppid;
+    uid_t uid;    // owner of /proc/<pid>, i.e. the effective UID; -1 if unknown
+    long rssKb;
+    unsigned long long startTime; // clock ticks after boot, identifies PID reuse
+    unsigned char nameLen;
+    char name[16]; // TASK_COMM_LEN, not NUL-terminated
+};
+
+// A process that started (fork or exec) or exited, from ProcEvents
+struct ProcEvent {
+    pid_t pid;
+    bool exited;
+};
+
+// Allocation-free reader for /proc. Everything goes through openat()/read()
+// relative to a directory fd on the proc root, into buffers owned by the
+// scanner, and numbers are parsed by hand instead of through QString.
+// Descriptors for statm/stat are kept open across scans in a ProcFdCache and
+// re-read with pread(), so a steady-state tick does no opens or closes.
+// The PID list is split into one shard per thread; a thread that finishes
+// its shard steals chunks from the others, so a PID stuck in D-state only
+// holds up the thread reading it.
+class ProcScanner
+{
+public:
+    // Cost of the last scan(). Read and parse are summed over the sampling
+    // threads, so with several threads they can add up to more than sampleMs.
+    struct Profile {
+        double listMs = 0;        // listing /proc or applying process events
+        double sampleMs = 0;      // wall time reading and parsing every PID
+        double readMs = 0;        // in open/pread/close
+        double parseMs = 0;       // the rest of sampling
+        unsigned long long syscalls = 0;
+    };
+
+    explicit ProcScanner(const char* procRoot = "/proc");
+    ~ProcScanner();
+    ProcScanner(const ProcScanner&) = delete;
+    ProcScanner& operator=(const ProcScanner&) = delete;
+
+    bool isValid() const { return m_rootFd >= 0; }
+
+    // Lists and samples every process under the proc root. The returned
+    // vector belongs to the scanner and is overwritten by the next call.
+    const std::vector<ProcSample>& scan();
+    // Same, into a vector owned by the caller (cleared first), whose
+    // capacity is reused from scan to scan.
+    void scan(std::vector<ProcSample>& out);
+
+    // Resident set size in kB, or -1 if the process is gone or is a kernel
+    // thread (which has no user address space, like a missing VmRSS line).
+    long readRssKb(pid_t pid);
+    // Copies /proc/<pid>/comm without the trailing newline. Returns the
+    // length, or -1 if the process is gone.
+    int readName(pid_t pid, char* out, size_t outSize);
+    // Copies /proc/<pid>/cmdline (arguments separated by NULs), truncated to
+    // outSize. Returns the length, 0 for kernel threads and zombies, or -1
+    // if the process is gone.
+    int readCommandLine(pid_t pid, char* out, size_t outSize);
+
+    // Number of threads sampling PIDs, including the one calling scan().
+    void setThreadCount(int threads);
+    int threadCount() const { return static_cast<int>(m_shards.size()); }
+    // A small fraction of the cores, so the monitor does not become the load.
+    static int defaultThreadCount();
+
+    // Maximum number of descriptors kept open between scans (0 disables).
+    void setFdCacheLimit(int maxFds) { m_fdCache.setLimit(maxFds); }
+    ProcFdCache::Stats fdCacheStats() const { return m_fdCache.stats(); }
+
+    // Reads /proc/<pid>/stat (name, start time) of PIDs with cached
+    // descriptors only every n-th scan, staggered by PID; statm is still
+    // read every scan. A rename then shows up within n scans.
+    void setStatRefreshInterval(int scans) { m_statRefresh = scans < 1 ? 1 : scans; }
+
+    // Keeps the PID list up to date from a running ProcEvents instead of
+    // listing /proc every scan. /proc is still listed on the first scan,
+    // every reconcileScans scans and whenever events were lost. Processes
+    // that started and exited between two scans are included in the scan
+    // with their sample from exec. nullptr goes back to listing.
+    void setEventSource(ProcEvents* events, int reconcileScans = 30);
+    // Number of times /proc was listed since the scanner was created
+    unsigned long long listings() const { return m_listings; }
+    const Profile& lastProfile() const { return m_profile; }
+
+    // Parses an unsigned decimal at p, skipping leading blanks. Advances p.
+    static bool parseLong(const char*& p, const char* end, long& value);
+    // Extracts comm, parent PID and start time (and optionally the task
+    // flags) from the contents of /proc/<pid>/stat.
+    static bool parseStat(const char* buf, size_t len, ProcSample& out, unsigned long* flags = nullptr);
+
+private:
+    // Scratch space and counters for one sampling thread.
+    struct ReadContext {
+        char statmBuf[128];
+        char statBuf[1024];
+        unsigned long long hits = 0;
+        unsigned long long misses = 0;
+        unsigned long long reuses = 0;
+        unsigned long long syscalls = 0;
+        unsigned long long timedSyscalls = 0; // every kTimedEvery-th
+        long long syscallNs = 0;              // of the timed ones
+        long long busyNs = 0;
+    };
+
+    // One thread's share of a scan: its PID range, claimed in chunks through
+    // next, and the samples it produced.
+    struct Shard {
+        alignas(64) std::atomic<size_t> next{0};
+        size_t end = 0;
+        ReadContext ctx;
+        std::vector<ProcSample> batch;
+    };
+
+    void runShard(size_t self);
+    void workerLoop(size_t self, unsigned long long seen);
+    void stopThreads();
+    const std::vector<pid_t>& listPids();
+    const std::vector<pid_t>& trackPids();
+    int openPidFile(pid_t pid, const char* file, ReadContext* ctx = nullptr);
+    ssize_t readPidFile(pid_t pid, const char* file, char* buf, size_t size, ReadContext* ctx = nullptr);
+    static ssize_t readAt(int fd, char* buf, size_t size, ReadContext& ctx);
+    static void closeFd(int& fd, ReadContext& ctx);
+    static uid_t ownerOf(int fd, ReadContext& ctx);
+    static long long beginSyscall(ReadContext& ctx);
+    static void endSyscall(ReadContext& ctx, long long started);
+    bool parseStatm(const char* buf, ssize_t len, long& rssKb) const;
+    int readEntry(ProcFdEntry& entry, ReadContext& ctx, ProcSample& out);
+    bool isKernelThread(ProcFdEntry& entry, ReadContext& ctx);
+    bool stillKernelThread(ProcFdEntry& entry, ReadContext& ctx);
+    bool sampleCached(ProcFdEntry& entry, ReadContext& ctx, ProcSample& out);
+    bool sampleUncached(pid_t pid, ReadContext& ctx, ProcSample& out);
+
+    int m_rootFd = -1;
+    long m_pageKb;
+    ProcFdCache m_fdCache;
+    std::vector<pid_t> m_pids;
+    ProcEvents* m_events = nullptr;
+    int m_reconcileScans = 30;
+    bool m_pidsTracked = false;
+    unsigned long long m_listings = 0;
+    unsigned long long m_listSyscalls = 0;
+    Profile m_profile;
+    std::unordered_map<pid_t, size_t> m_pidIndex; // position in m_pids while tracking
+    std::vector<ProcEvent> m_eventBuf;
+    std::vector<ProcSample> m_transient;
+    std::vector<int> m_slots;
+    std::vector<ProcSample> m_samples;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    std::vector<std::thread> m_threads;
+    std::mutex m_poolMutex;
+    std::condition_variable m_startCv;
+    std::condition_variable m_doneCv;
+    unsigned long long m_round = 0;
+    int m_statRefresh = 1;
+    unsigned long long m_scanCount = 0;
+    size_t m_pending = 0;
+    bool m_stopping = false;
+    char m_dirBuf[16384];
+    char m_readBuf[256];
+};
+
+#endif // PROCSCANNER_H
@@ -0,0 +1,135 @@
+#include "samplescheduler.h"
+
+#include <algorithm>
+
+namespace {
+
+// Adaptive periods range from a quarter to four times the requested one.
+const double kMinFactor = 0.25;
+const double kMaxFactor = 4;
+// Step for each scan that keeps looking calm (or for drifting back to 1)
+const double kFactorStep = 1.25;
+
+// Busy: tighten at once. Calm: back off slowly.
+const double kBusyUsed = 0.90;
+const double kBusyAllocRate = 0.01;
+const double kBusyPressure = 0.10;
+const double kCalmUsed = 0.75;
+const double kCalmAllocRate = 0.001;
+const double kCalmPressure = 0.01;
+
+// Timers fire a little late (or early); exact consumers due within this
+// are served now rather than by a scan of their own a moment later.
+const int64_t kExactSlackMs = 5;
+
+// Weight of the latest scan in the scan cost average
+const double kCostWeight = 0.2;
+
+} // namespace
+
+SampleScheduler::SampleScheduler()
+{
+}
+
+void SampleScheduler::setRequest(Consumer consumer, int64_t periodMs, bool adaptive, int64_t nowMs)
+{
+    Request &request = m_consumers[consumer];
+    if (periodMs == request.period && adaptive == request.adaptive) return;
+    request.period = std::max<int64_t>(periodMs, 0);
+    request.adaptive = adaptive;
+    request.due = nowMs;
+    request.served = false;
+}
+
+void SampleScheduler::setLimits(int64_t minMs, int64_t maxMs)
+{
+    m_minMs = std::max<int64_t>(minMs, 1);
+    m_maxMs = std::max(maxMs, m_minMs);
+}
+
+void SampleScheduler::setCpuBudget(double fraction)
+{
+    m_cpuBudget = fraction;
+}
+
+int64_t SampleScheduler::budgetFloor() const
+{
+    if (m_cpuBudget <= 0) return 0;
+    return static_cast<int64_t>(m_scanCostMs / m_cpuBudget);
+}
+
+bool SampleScheduler::budgetLimited() const
+{
+    const Request &display = m_consumers[Display];
+    if (display.period <= 0) return false;
+    int64_t period = static_cast<int64_t>(display.period * m_factor);
+    return budgetFloor() > std::clamp(period, m_minMs, m_maxMs);
+}
+
+int64_t SampleScheduler::effectivePeriod(Consumer consumer) const
+{
+    const Request &request = m_consumers[consumer];
+    if (request.period <= 0 || !request.adaptive) return request.period;
+    int64_t period = std::clamp(static_cast<int64_t>(request.period * m_factor), m_minMs, m_maxMs);
+    return std::max(period, budgetFloor());
+}
+
+// Adaptive consumers are due relative to their last scan, so a period that
+// shrinks under load takes effect right away instead of after the old one.
+int64_t SampleScheduler::dueAt(int consumer) const
+{
+    const Request &request = m_consumers[consumer];
+    if (!request.adaptive || !request.served) return request.due;
+    return request.lastMs + effectivePeriod(static_cast<Consumer>(consumer));
+}
+
+unsigned SampleScheduler::takeDue(int64_t nowMs)
+{
+    unsigned due = 0;
+    for (int i = 0; i < ConsumerCount; ++i) {
+        Request &request = m_consumers[i];
+        if (request.period <= 0) continue;
+        int64_t period = effectivePeriod(static_cast<Consumer>(i));
+        // An adaptive consumer due within a quarter period rides along.
+        int64_t slack = request.adaptive ? period / 4 : kExactSlackMs;
+        if (dueAt(i) > nowMs + slack) continue;
+        due |= 1u << i;
+        if (request.adaptive) {
+            request.lastMs = nowMs;
+            request.served = true;
+        } else {
+            // Stay on the grid; slots missed (e.g. while suspended) are skipped.
+            request.due += period;
+            if (request.due <= nowMs) request.due += ((nowMs - request.due) / period + 1) * period;
+        }
+    }
+    return due;
+}
+
+void SampleScheduler::recordScan(double scanMs, const Load &load)
+{
+    m_scanCostMs = m_scanCostMs == 0 ? scanMs : m_scanCostMs + kCostWeight * (scanMs - m_scanCostMs);
+
+    bool busy = load.usedFraction >= kBusyUsed || load.allocRate >= kBusyAllocRate || load.pressure >= kBusyPressure;
+    bool calm = load.usedFraction < kCalmUsed && load.allocRate < kCalmAllocRate && load.pressure < kCalmPressure;
+    if (busy) {
+        m_factor = kMinFactor;
+    } else if (calm) {
+        m_factor = std::min(m_factor * kFactorStep, kMaxFactor);
+    } else if (m_factor > 1) {
+        m_factor = std::max(m_factor / kFactorStep, 1.0);
+    } else {
+        m_factor = std::min(m_factor * kFactorStep, 1.0);
+    }
+}
+
+int64_t SampleScheduler::delayUntilNext(int64_t nowMs) const
+{
+    int64_t next = -1;
+    for (int i = 0; i < ConsumerCount; ++i) {
+        if (m_consumers[i].period <= 0) continue;
+        int64_t due = dueAt(i);
+        if (next < 0 || due < next) next = due;
+    }
+    return next < 0 ? -1 : std::max<int64_t>(next - nowMs, 0);
+}
@@ -0,0 +1,75 @@
+#ifndef SAMPLESCHEDULER_H
+#define SAMPLESCHEDULER_H
+
+#include <cstdint>
+
+// Decides when the worker scans next, for several consumers at once. Each
+// consumer asks for a period; one scan serves every consumer that is due
+// (or nearly due) at that moment, so they never cause separate scans.
+//
+// Exact consumers (the Track Memory log) are served on a fixed grid of
+// start + k * period, so a log asked to sample every 5 s gets one sample
+// every 5 s without drift. Adaptive consumers (the display) have their
+// period scaled by the load: down to a quarter when memory is short or
+// being allocated fast, up to four times when the system has been calm
+// for a while. Adaptive periods also stay above the monitor's CPU budget,
+// i.e. the recent cost of a scan divided by the budgeted share of a core.
+// Exact periods are honoured even when that exceeds the budget, since the
+// user asked for them.
+class SampleScheduler
+{
+public:
+    enum Consumer { Display, Tracker, Alerting, ConsumerCount };
+
+    // What the last scan saw of the system
+    struct Load {
+        double usedFraction = 0;  // 1 - MemAvailable / MemTotal
+        double allocRate = 0;     // change of used memory per second, as a fraction of MemTotal
+        double pressure = 0;      // share of time stalled on memory, 0 when unknown
+    };
+
+    SampleScheduler();
+
+    // periodMs 0 removes the consumer. A new or changed request is due at nowMs.
+    void setRequest(Consumer consumer, int64_t periodMs, bool adaptive, int64_t nowMs);
+    int64_t requestedPeriod(Consumer consumer) const { return m_consumers[consumer].period; }
+    // Period the consumer is currently served at, after load and budget
+    int64_t effectivePeriod(Consumer consumer) const;
+
+    // Bounds for adaptive periods
+    void setLimits(int64_t minMs, int64_t maxMs);
+    // Share of one core the monitor may spend scanning, e.g. 0.02
+    void setCpuBudget(double fraction);
+    bool budgetLimited() const;
+    double loadFactor() const { return m_factor; }
+
+    // Consumers (as 1 << Consumer bits) that a scan starting at nowMs
+    // serves. Advances their schedules.
+    unsigned takeDue(int64_t nowMs);
+    // Feeds back how long the scan took and what it saw.
+    void recordScan(double scanMs, const Load &load);
+    // Milliseconds from nowMs until the next scan is due, or -1 if nothing
+    // is requested.
+    int64_t delayUntilNext(int64_t nowMs) const;
+
+private:
+    struct Request {
+        int64_t period = 0;
+        int64_t due = 0;  // exact: next grid point; adaptive: last scan + effective period
+        bool adaptive = false;
+        int64_t lastMs = 0;
+        bool served = false;
+    };
+
+    int64_t budgetFloor() const;
+    int64_t dueAt(int consumer) const;
+
+    Request m_consumers[ConsumerCount];
+    int64_t m_minMs = 250;
+    int64_t m_maxMs = 30000;
+    double m_cpuBudget = 0.02;
+    double m_scanCostMs = 0;
+    double m_factor = 1;
+};
+
+#endif // SAMPLESCHEDULER_H
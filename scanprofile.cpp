@@ -0,0 +1,144 @@
+#include "scanprofile.h"
+#include "allocationcounter.h"
+
+#include <chrono>
+#include <cstdio>
+
+namespace {
+
+const char *const kPhaseNames[ScanProfile::PhaseCount] = {
+    "List /proc", "Read", "Parse", "Deep accounting", "Build delta", "Rank", "Scan (worker total)",
+    "Export metrics",
+    "Deliver", "Apply to model", "Display",
+};
+
+int highestBit(uint64_t value)
+{
+    return 63 - __builtin_clzll(value);
+}
+
+} // namespace
+
+// Values below 2^kSubBits get a bucket each; above, the top kSubBits bits
+// after the leading one pick the step within its power of two.
+int LatencyHistogram::bucketOf(uint64_t ns)
+{
+    if (ns < (1u << kSubBits)) return static_cast<int>(ns);
+    int exponent = highestBit(ns);
+    int step = static_cast<int>((ns >> (exponent - kSubBits)) & ((1u << kSubBits) - 1));
+    return ((exponent - kSubBits + 1) << kSubBits) + step;
+}
+
+uint64_t LatencyHistogram::bucketStart(int bucket)
+{
+    if (bucket < (1 << kSubBits)) return static_cast<uint64_t>(bucket);
+    int exponent = (bucket >> kSubBits) + kSubBits - 1;
+    uint64_t step = static_cast<uint64_t>(bucket & ((1 << kSubBits) - 1));
+    return (uint64_t(1) << exponent) | (step << (exponent - kSubBits));
+}
+
+void LatencyHistogram::record(uint64_t ns)
+{
+    ++m_buckets[bucketOf(ns)];
+    ++m_count;
+    m_sum += ns;
+    m_last = ns;
+    if (ns > m_max) m_max = ns;
+}
+
+void LatencyHistogram::reset()
+{
+    *this = LatencyHistogram();
+}
+
+uint64_t LatencyHistogram::percentile(double q) const
+{
+    if (m_count == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(m_count - 1)) + 1;
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < kBucketCount; ++bucket) {
+        seen += m_buckets[bucket];
+        if (seen < rank) continue;
+        // Middle of the bucket, but never beyond what was actually seen
+        uint64_t start = bucketStart(bucket);
+        uint64_t end = bucket + 1 < kBucketCount ? bucketStart(bucket + 1) : m_max;
+        uint64_t value = start + (end - start) / 2;
+        return value < m_max ? value : m_max;
+    }
+    return m_max;
+}
+
+ScanProfile::Tick::Tick()
+{
+    for (double &ms : phaseMs) ms = -1;
+}
+
+const char *ScanProfile::phaseName(Phase phase)
+{
+    return phase >= 0 && phase < PhaseCount ? kPhaseNames[phase] : "";
+}
+
+int64_t ScanProfile::nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void ScanProfile::record(const Tick &tick)
+{
+    for (int phase = 0; phase < PhaseCount; ++phase) {
+        if (tick.phaseMs[phase] >= 0) m_histograms[phase].record(static_cast<uint64_t>(tick.phaseMs[phase] * 1e6));
+    }
+    m_workerTotal.syscalls += tick.worker.syscalls;
+    m_workerTotal.allocations += tick.worker.allocations;
+    m_workerTotal.allocatedBytes += tick.worker.allocatedBytes;
+    m_receiverTotal.syscalls += tick.receiver.syscalls;
+    m_receiverTotal.allocations += tick.receiver.allocations;
+    m_receiverTotal.allocatedBytes += tick.receiver.allocatedBytes;
+    m_last = tick;
+    ++m_ticks;
+}
+
+void ScanProfile::reset()
+{
+    for (LatencyHistogram &histogram : m_histograms) histogram.reset();
+    m_last = Tick();
+    m_ticks = 0;
+    m_workerTotal = Counters();
+    m_receiverTotal = Counters();
+}
+
+std::string ScanProfile::report() const
+{
+    std::string out;
+    char line[256];
+    snprintf(line, sizeof(line), "%llu ticks, last with %d processes\n\n", static_cast<unsigned long long>(m_ticks),
+             m_last.processes);
+    out += line;
+    snprintf(line, sizeof(line), "%-22s %10s %10s %10s %10s %10s %8s\n", "Phase (ms)", "Last", "Mean", "p50", "p99",
+             "Max", "Count");
+    out += line;
+    for (int phase = 0; phase < PhaseCount; ++phase) {
+        const LatencyHistogram &h = m_histograms[phase];
+        snprintf(line, sizeof(line), "%-22s %10.3f %10.3f %10.3f %10.3f %10.3f %8llu\n",
+                 phaseName(static_cast<Phase>(phase)), h.last() / 1e6, h.mean() / 1e6, h.percentile(0.5) / 1e6,
+                 h.percentile(0.99) / 1e6, h.max() / 1e6, static_cast<unsigned long long>(h.count()));
+        out += line;
+    }
+    snprintf(line, sizeof(line),
+             "\nPer tick (last / mean):\n"
+             "  worker syscalls      %10llu / %.1f\n"
+             "  worker allocations   %10llu / %.1f (%llu bytes last)\n"
+             "  receiver allocations %10llu / %.1f (%llu bytes last)\n",
+             static_cast<unsigned long long>(m_last.worker.syscalls),
+             m_ticks ? static_cast<double>(m_workerTotal.syscalls) / m_ticks : 0.0,
+             static_cast<unsigned long long>(m_last.worker.allocations),
+             m_ticks ? static_cast<double>(m_workerTotal.allocations) / m_ticks : 0.0,
+             static_cast<unsigned long long>(m_last.worker.allocatedBytes),
+             static_cast<unsigned long long>(m_last.receiver.allocations),
+             m_ticks ? static_cast<double>(m_receiverTotal.allocations) / m_ticks : 0.0,
+             static_cast<unsigned long long>(m_last.receiver.allocatedBytes));
+    out += line;
+    if (!allocationsCounted()) out += "  (heap allocations are not counted in this build)\n";
+    return out;
+}
@@ -0,0 +1,101 @@
+#ifndef SCANPROFILE_H
+#define SCANPROFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Latency distribution in fixed memory with O(1) recording. Buckets are
+// powers of two split into eight linear steps, so a percentile is off by at
+// most 12.5%; values are nanoseconds.
+class LatencyHistogram
+{
+public:
+    void record(uint64_t ns);
+    void reset();
+
+    uint64_t count() const { return m_count; }
+    uint64_t last() const { return m_last; }
+    uint64_t max() const { return m_max; }
+    uint64_t mean() const { return m_count ? m_sum / m_count : 0; }
+    // Value at quantile q (0..1), within a bucket of the truth; 0 when empty
+    uint64_t percentile(double q) const;
+
+private:
+    static const int kSubBits = 3;
+    static const int kBucketCount = (64 - kSubBits + 1) << kSubBits;
+
+    static int bucketOf(uint64_t ns);
+    static uint64_t bucketStart(int bucket);
+
+    uint64_t m_buckets[kBucketCount] = {};
+    uint64_t m_count = 0;
+    uint64_t m_sum = 0;
+    uint64_t m_last = 0;
+    uint64_t m_max = 0;
+};
+
+// Where the time of each tick goes, from listing /proc in the worker to the
+// table update in the GUI. The worker measures its phases into a Tick that
+// travels with the scan; the receiver adds its own and records the whole
+// tick, so all histograms live on one thread.
+class ScanProfile
+{
+public:
+    enum Phase {
+        List,           // listing /proc, or applying process events
+        Read,           // open/pread/close of statm and stat, all scan threads
+        Parse,          // the rest of sampling, all scan threads
+        DeepAccounting, // smaps_rollup reads
+        Build,          // comparing with the last scan and filling the delta
+        Rank,           // top-N selections and the leak detector's ranking
+        Scan,           // the whole tick in the worker, including the above
+        Export,         // building the metrics exposition, after Scan; only while exporting
+        Deliver,        // from emitting the scan until the receiver runs
+        Apply,          // updating the process model
+        Display,        // handleResults: labels and tables
+        PhaseCount
+    };
+
+    struct Counters {
+        uint64_t syscalls = 0;
+        uint64_t allocations = 0;
+        uint64_t allocatedBytes = 0;
+    };
+
+    // One tick's measurements; phases below zero were not measured.
+    struct Tick {
+        double phaseMs[PhaseCount];
+        Counters worker;            // syscalls reading /proc; heap use of the worker thread
+        Counters receiver;          // heap use while applying and displaying
+        int64_t emittedNs = 0;      // nowNs() when the worker emitted the scan
+        int processes = 0;
+
+        Tick();
+    };
+
+    static const char *phaseName(Phase phase);
+    // Steady clock shared by all threads, for Deliver
+    static int64_t nowNs();
+
+    void record(const Tick &tick);
+    void reset();
+
+    const LatencyHistogram &histogram(Phase phase) const { return m_histograms[phase]; }
+    const Tick &lastTick() const { return m_last; }
+    uint64_t ticks() const { return m_ticks; }
+    const Counters &workerTotal() const { return m_workerTotal; }
+    const Counters &receiverTotal() const { return m_receiverTotal; }
+
+    // Plain-text table of every phase and the counters, for saving to a file
+    std::string report() const;
+
+private:
+    LatencyHistogram m_histograms[PhaseCount];
+    Tick m_last;
+    uint64_t m_ticks = 0;
+    Counters m_workerTotal;
+    Counters m_receiverTotal;
+};
+
+#endif // SCANPROFILE_H
@@ -0,0 +1,100 @@
+#ifndef SMAPSSAMPLER_H
+#define SMAPSSAMPLER_H
+
+#include <sys/types.h>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+#include "procscanner.h"
+
+// Memory of one process from /proc/<pid>/smaps_rollup, in kB; -1 while it
+// has not been read (or cannot be, e.g. another user's process).
+struct SmapsRollup {
+    long pssKb = -1;   // shared pages divided among the processes mapping them
+    long ussKb = -1;   // Private_Clean + Private_Dirty
+    long swapKb = -1;
+};
+
+// Deeper per-process accounting than statm's RSS, which counts shared
+// libraries and shared memory in full for every process mapping them.
+// smaps_rollup walks the whole address space under the mm lock, so it costs
+// far more than statm and is not read for every process on every scan.
+// Instead each scan spends at most budgetMs on it, in this order:
+//   1. the topCount largest processes by RSS,
+//   2. processes whose RSS moved significantly since their last rollup,
+//      and new processes, biggest change first,
+//   3. everyone else, least recently refreshed first (round-robin).
+// Each read is only started if its estimated cost (from the last read of
+// that process, or from its RSS) fits in what is left of the budget, so a
+// scan stays within budgetMs unless a read is far slower than estimated.
+// A process too big to ever fit is counted in overBudget.
+class SmapsSampler
+{
+public:
+    struct Stats {
+        double budgetMs = 0;
+        double usedMs = 0;        // spent in the last scan
+        int read = 0;             // rollups read in the last scan
+        int deferred = 0;         // wanted a refresh (tiers 1 and 2) but did not fit
+        int overBudget = 0;       // estimated to cost more than the whole budget
+        int covered = 0;          // processes with a rollup
+        int denied = 0;           // processes whose rollup cannot be read
+        double worstReadMs = 0;   // slowest single read in the last scan
+        int syscalls = 0;         // in the last scan
+        bool supported = false;   // the kernel has smaps_rollup (4.14+)
+    };
+
+    explicit SmapsSampler(const char *procRoot = "/proc");
+    ~SmapsSampler();
+    SmapsSampler(const SmapsSampler &) = delete;
+    SmapsSampler &operator=(const SmapsSampler &) = delete;
+
+    // Time per scan for reading rollups; 0 turns deep accounting off.
+    void setBudgetMs(double ms) { m_budgetMs = ms < 0 ? 0 : ms; }
+    void setTopCount(size_t count) { m_topCount = count; }
+
+    // Refreshes rollups for this scan's samples within the budget. The
+    // returned vector is parallel to samples and valid until the next call.
+    const std::vector<SmapsRollup> &update(const std::vector<ProcSample> &samples);
+
+    Stats stats() const { return m_stats; }
+
+    // Extracts Pss, Private_Clean + Private_Dirty and Swap from the
+    // contents of smaps_rollup.
+    static bool parseRollup(const char *buf, size_t len, SmapsRollup &out);
+
+private:
+    struct Entry {
+        unsigned long long startTime = 0;
+        unsigned long long seen = 0;
+        unsigned long long refreshed = 0;  // scan of the last read, 0 if never
+        long rssAtRead = -1;
+        double readMs = 0;
+        bool denied = false;
+        SmapsRollup rollup;
+    };
+
+    struct Candidate {
+        int tier;
+        long key;       // lower first within a tier
+        size_t sample;
+    };
+
+    bool readRollup(pid_t pid, SmapsRollup &out, bool &denied);
+    double estimateMs(const Entry &entry, long rssKb) const;
+
+    int m_rootFd = -1;
+    double m_budgetMs = 10;
+    size_t m_topCount = 10;
+    double m_msPerMb;
+    unsigned long long m_scan = 0;
+    std::unordered_map<pid_t, Entry> m_entries;
+    std::vector<Entry *> m_entryOfSample;
+    std::vector<Candidate> m_candidates;
+    std::vector<size_t> m_bySize;
+    std::vector<SmapsRollup> m_rollups;
+    Stats m_stats;
+    char m_buf[4096];
+};
+
+#endif // SMAPSSAMPLER_H
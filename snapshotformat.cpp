@@ -0,0 +1,205 @@
+#include "snapshotformat.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char kMagic[8] = {'M', 'A', 'S', 'N', 'A', 'P', 0, 0};
+
+template <typename T>
+void putColumn(std::string &out, const std::vector<T> &values)
+{
+    out.append(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+}
+
+} // namespace
+
+void SnapshotEncoder::pad(std::string &out)
+{
+    size_t padding = (8 - (m_offset & 7)) & 7;
+    out.append(padding, '\0');
+    m_offset += padding;
+}
+
+void SnapshotEncoder::begin(std::string &out)
+{
+    m_offset = 0;
+    m_frames.clear();
+    m_nameIds.clear();
+    m_nameOffsets.clear();
+    m_nameBytes.clear();
+
+    SnapshotHeader header = {};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kSnapshotVersion;
+    header.headerSize = sizeof(SnapshotHeader);
+    out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    m_offset += sizeof(header);
+}
+
+uint32_t SnapshotEncoder::internName(const char *name, size_t len)
+{
+    m_key.assign(name, len);
+    auto it = m_nameIds.find(m_key);
+    if (it != m_nameIds.end()) return it->second;
+    uint32_t id = static_cast<uint32_t>(m_nameOffsets.size());
+    m_nameOffsets.push_back(static_cast<uint32_t>(m_nameBytes.size()));
+    m_nameBytes.append(name, len);
+    m_nameIds.emplace(m_key, id);
+    return id;
+}
+
+void SnapshotEncoder::addFrame(std::string &out, const RecorderFrame &frame)
+{
+    size_t count = frame.samples.size();
+    std::vector<int64_t> rss(count), growth(count);
+    std::vector<int32_t> pids(count);
+    std::vector<uint32_t> nameIds(count);
+    for (size_t i = 0; i < count; ++i) {
+        const RecorderFrame::Sample &sample = frame.samples[i];
+        rss[i] = sample.memory;
+        growth[i] = sample.growth;
+        pids[i] = sample.pid;
+        nameIds[i] = internName(frame.names.data() + sample.nameOffset, sample.nameLen);
+    }
+
+    SnapshotFrame entry = {};
+    entry.timeMs = frame.timeMs;
+    entry.memTotal = frame.memTotal;
+    entry.memAvailable = frame.memAvailable;
+    entry.recordsOffset = m_offset;
+    entry.recordCount = static_cast<uint32_t>(count);
+    m_frames.push_back(entry);
+
+    putColumn(out, rss);
+    putColumn(out, growth);
+    putColumn(out, pids);
+    putColumn(out, nameIds);
+    m_offset += count * (2 * sizeof(int64_t) + sizeof(int32_t) + sizeof(uint32_t));
+    pad(out);
+}
+
+SnapshotHeader SnapshotEncoder::finish(std::string &out)
+{
+    SnapshotHeader header = {};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kSnapshotVersion;
+    header.headerSize = sizeof(SnapshotHeader);
+
+    header.nameCount = m_nameOffsets.size();
+    header.stringTableOffset = m_offset;
+    m_nameOffsets.push_back(static_cast<uint32_t>(m_nameBytes.size()));
+    putColumn(out, m_nameOffsets);
+    out += m_nameBytes;
+    header.stringTableSize = m_nameOffsets.size() * sizeof(uint32_t) + m_nameBytes.size();
+    m_offset += header.stringTableSize;
+    pad(out);
+
+    header.frameCount = m_frames.size();
+    header.frameIndexOffset = m_offset;
+    putColumn(out, m_frames);
+    m_offset += m_frames.size() * sizeof(SnapshotFrame);
+    header.complete = 1;
+    return header;
+}
+
+std::string SnapshotEncoder::encode(const std::vector<RecorderFrame> &frames)
+{
+    SnapshotEncoder encoder;
+    std::string out;
+    encoder.begin(out);
+    for (const RecorderFrame &frame : frames) encoder.addFrame(out, frame);
+    SnapshotHeader header = encoder.finish(out);
+    memcpy(&out[0], &header, sizeof(header));
+    return out;
+}
+
+SnapshotFile::~SnapshotFile()
+{
+    close();
+}
+
+void SnapshotFile::close()
+{
+    if (m_data) munmap(const_cast<char *>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+    m_frames = nullptr;
+    m_frameCount = 0;
+    m_nameOffsets = nullptr;
+    m_nameBytes = nullptr;
+    m_nameBytesSize = 0;
+    m_nameCount = 0;
+}
+
+bool SnapshotFile::open(const std::string &path, std::string *error)
+{
+    close();
+    auto failed = [&](const std::string &message) {
+        if (error) *error = message;
+        close();
+        return false;
+    };
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return failed("Could not open " + path + ": " + strerror(errno));
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(SnapshotHeader))) {
+        ::close(fd);
+        return failed(path + " is not a snapshot file");
+    }
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return failed("Could not map " + path + ": " + strerror(errno));
+    m_data = static_cast<const char *>(data);
+    m_size = st.st_size;
+
+    const SnapshotHeader &header = *reinterpret_cast<const SnapshotHeader *>(m_data);
+    if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) return failed(path + " is not a snapshot file");
+    if (header.version != kSnapshotVersion) {
+        return failed("Unsupported snapshot version " + std::to_string(header.version));
+    }
+    if (!header.complete) return failed(path + " was not finished (the recording was interrupted)");
+
+    auto fits = [this](uint64_t offset, uint64_t count, uint64_t size) {
+        return offset <= m_size && (offset & 7) == 0 && count <= (m_size - offset) / size;
+    };
+    if (header.headerSize < sizeof(SnapshotHeader)
+        || !fits(header.frameIndexOffset, header.frameCount, sizeof(SnapshotFrame))
+        // nameCount + 1 offsets, bounded before adding so it cannot wrap
+        || !fits(header.stringTableOffset, 0, sizeof(uint32_t))
+        || header.nameCount >= (m_size - header.stringTableOffset) / sizeof(uint32_t)
+        || header.stringTableSize > m_size - header.stringTableOffset
+        || header.stringTableSize < (header.nameCount + 1) * sizeof(uint32_t)) {
+        return failed(path + " is truncated or corrupt");
+    }
+
+    m_frames = reinterpret_cast<const SnapshotFrame *>(m_data + header.frameIndexOffset);
+    m_frameCount = header.frameCount;
+    m_nameCount = header.nameCount;
+    m_nameOffsets = reinterpret_cast<const uint32_t *>(m_data + header.stringTableOffset);
+    m_nameBytes = m_data + header.stringTableOffset + (m_nameCount + 1) * sizeof(uint32_t);
+    m_nameBytesSize = header.stringTableSize - (m_nameCount + 1) * sizeof(uint32_t);
+    for (size_t i = 0; i < m_frameCount; ++i) {
+        if (!fits(m_frames[i].recordsOffset, m_frames[i].recordCount, 24)) {
+            return failed(path + " is truncated or corrupt");
+        }
+    }
+    return true;
+}
+
+bool SnapshotFile::name(uint32_t id, const char **data, size_t *len) const
+{
+    if (id >= m_nameCount) return false;
+    uint32_t begin = m_nameOffsets[id];
+    uint32_t end = m_nameOffsets[id + 1];
+    if (begin > end || end > m_nameBytesSize) return false;
+    *data = m_nameBytes + begin;
+    *len = end - begin;
+    return true;
+}
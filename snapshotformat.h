@@ -0,0 +1,122 @@
+#ifndef SNAPSHOTFORMAT_H
+#define SNAPSHOTFORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "memoryrecorder.h"
+
+// Snapshot files (.masnap) hold one or more frames of process samples in a
+// layout that can be mmap()ed and read in place:
+//
+//   SnapshotHeader                       at offset 0, rewritten on finish
+//   per frame, its columns               int64 rss_kb[n], int64 growth[n],
+//                                        int32 pid[n], uint32 name_id[n]
+//   string table                         uint32 offsets[names + 1], UTF-8 bytes
+//   frame index                          SnapshotFrame[frames]
+//
+// Integers are little-endian and every section starts 8-byte aligned.
+// Names are interned per file, so a name is stored once however many
+// frames and processes use it. A file whose header still has
+// complete == 0 was not finished (e.g. the writer crashed).
+
+const uint32_t kSnapshotVersion = 1;
+
+struct SnapshotHeader {
+    char magic[8]; // "MASNAP\0\0"
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t frameCount;
+    uint64_t frameIndexOffset;
+    uint64_t nameCount;
+    uint64_t stringTableOffset;
+    uint64_t stringTableSize;
+    uint32_t complete;
+    uint32_t reserved;
+};
+
+struct SnapshotFrame {
+    int64_t timeMs;
+    int64_t memTotal;
+    int64_t memAvailable;
+    uint64_t recordsOffset;
+    uint32_t recordCount;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(SnapshotHeader) == 64, "SnapshotHeader is part of the file format");
+static_assert(sizeof(SnapshotFrame) == 40, "SnapshotFrame is part of the file format");
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "snapshot files are read in place as little-endian");
+
+// Produces a snapshot file as a stream of bytes. Everything written to the
+// file must go through begin(), addFrame() and finish(), in that order;
+// finish() returns the header to write over the placeholder at offset 0.
+class SnapshotEncoder
+{
+public:
+    void begin(std::string &out);
+    void addFrame(std::string &out, const RecorderFrame &frame);
+    SnapshotHeader finish(std::string &out);
+
+    // Encodes a whole file in memory, header included.
+    static std::string encode(const std::vector<RecorderFrame> &frames);
+
+private:
+    uint32_t internName(const char *name, size_t len);
+    void pad(std::string &out);
+
+    uint64_t m_offset = 0;
+    std::vector<SnapshotFrame> m_frames;
+    std::unordered_map<std::string, uint32_t> m_nameIds;
+    std::vector<uint32_t> m_nameOffsets;
+    std::string m_nameBytes;
+    std::string m_key;
+};
+
+// A snapshot file mapped read-only. open() checks that the header, the
+// frame index and every frame's columns lie within the file; after that,
+// accessors return pointers straight into the mapping.
+class SnapshotFile
+{
+public:
+    SnapshotFile() = default;
+    ~SnapshotFile();
+    SnapshotFile(const SnapshotFile &) = delete;
+    SnapshotFile &operator=(const SnapshotFile &) = delete;
+
+    bool open(const std::string &path, std::string *error = nullptr);
+    void close();
+    bool isOpen() const { return m_data != nullptr; }
+
+    size_t frameCount() const { return m_frameCount; }
+    const SnapshotFrame &frame(size_t index) const { return m_frames[index]; }
+    const int64_t *rss(size_t index) const { return column<int64_t>(index, 0); }
+    const int64_t *growth(size_t index) const { return column<int64_t>(index, 8); }
+    const int32_t *pids(size_t index) const { return column<int32_t>(index, 16); }
+    const uint32_t *nameIds(size_t index) const { return column<uint32_t>(index, 20); }
+
+    size_t nameCount() const { return m_nameCount; }
+    // False for an id outside the string table
+    bool name(uint32_t id, const char **data, size_t *len) const;
+
+private:
+    template <typename T>
+    const T *column(size_t index, size_t bytesPerRecordBefore) const
+    {
+        const SnapshotFrame &f = m_frames[index];
+        return reinterpret_cast<const T *>(m_data + f.recordsOffset + bytesPerRecordBefore * f.recordCount);
+    }
+
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+    const SnapshotFrame *m_frames = nullptr;
+    size_t m_frameCount = 0;
+    const uint32_t *m_nameOffsets = nullptr;
+    const char *m_nameBytes = nullptr;
+    size_t m_nameBytesSize = 0;
+    size_t m_nameCount = 0;
+};
+
+#endif // SNAPSHOTFORMAT_H
@@ -0,0 +1,133 @@
+#include "snapshotreplayer.h"
+#include <QFile>
+#include <QTimer>
+
+namespace {
+
+// Gaps longer than this (e.g. a suspended machine) are shortened on replay.
+const qint64 kMaxReplayGapMs = 10000;
+
+} // namespace
+
+SnapshotReplayer::SnapshotReplayer(QObject *parent) : QObject(parent)
+{
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    connect(m_timer, &QTimer::timeout, this, &SnapshotReplayer::emitNextFrame);
+}
+
+bool SnapshotReplayer::open(const QString &path, QString *error)
+{
+    stop();
+    std::string message;
+    if (!m_file.open(QFile::encodeName(path).toStdString(), &message)) {
+        if (error) *error = QString::fromStdString(message);
+        return false;
+    }
+    if (m_file.frameCount() == 0) {
+        m_file.close();
+        if (error) *error = "The recording contains no samples.";
+        return false;
+    }
+    m_names = QVector<QString>(static_cast<int>(m_file.nameCount()));
+    m_next = m_file.frameCount(); // idle until start()
+    return true;
+}
+
+void SnapshotReplayer::start(bool realTime)
+{
+    if (!m_file.isOpen()) return;
+    m_realTime = realTime;
+    m_next = 0;
+    m_generation = 0;
+    m_known.clear();
+    m_elapsed.start();
+    m_timer->start(0);
+}
+
+void SnapshotReplayer::stop()
+{
+    m_timer->stop();
+    m_next = m_file.frameCount();
+}
+
+bool SnapshotReplayer::isActive() const
+{
+    return m_file.isOpen() && m_next < m_file.frameCount();
+}
+
+const QString &SnapshotReplayer::nameAt(uint32_t id)
+{
+    static const QString unknown("?");
+    if (id >= static_cast<uint32_t>(m_names.size())) return unknown;
+    QString &name = m_names[id];
+    if (name.isNull()) {
+        const char *data;
+        size_t len;
+        name = m_file.name(id, &data, &len) ? QString::fromUtf8(data, static_cast<int>(len)) : unknown;
+    }
+    return name;
+}
+
+void SnapshotReplayer::emitNextFrame()
+{
+    if (!isActive()) return;
+    const SnapshotFrame &frame = m_file.frame(m_next);
+    const int64_t *rss = m_file.rss(m_next);
+    const int64_t *growth = m_file.growth(m_next);
+    const int32_t *pids = m_file.pids(m_next);
+    const uint32_t *nameIds = m_file.nameIds(m_next);
+
+    bool full = m_next == 0;
+    ScanDelta delta;
+    ++m_generation;
+    delta.generation = m_generation;
+    delta.baseGeneration = full ? 0 : m_generation - 1;
+    delta.timeMs = frame.timeMs;
+    delta.memTotal = frame.memTotal;
+    delta.memAvailable = frame.memAvailable;
+    if (full) delta.added.reserve(static_cast<int>(frame.recordCount));
+
+    for (uint32_t i = 0; i < frame.recordCount; ++i) {
+        auto it = m_known.find(pids[i]);
+        bool isNew = it == m_known.end();
+        if (isNew) it = m_known.insert(pids[i], KnownProcess());
+        KnownProcess &known = *it;
+        bool renamed = !isNew && known.nameId != nameIds[i];
+        bool valuesChanged = known.memory != rss[i] || known.growth != growth[i];
+        known.memory = rss[i];
+        known.growth = growth[i];
+        known.nameId = nameIds[i];
+        known.seen = m_generation;
+
+        if (full || isNew || renamed) {
+            ProcessInfo info;
+            info.pid = pids[i];
+            info.memory = rss[i];
+            info.growth = growth[i];
+            info.name = nameAt(nameIds[i]);
+            delta.added.append(info);
+        } else if (valuesChanged) {
+            delta.changed.append(ProcessUpdate{pids[i], static_cast<long>(rss[i]), static_cast<long>(growth[i])});
+        }
+    }
+    for (auto it = m_known.begin(); it != m_known.end();) {
+        if (it->seen != m_generation) {
+            if (!full) delta.removed.append(it.key());
+            it = m_known.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    m_currentTimeMs = frame.timeMs;
+    emit scanDelta(delta);
+
+    ++m_next;
+    if (m_next >= m_file.frameCount()) {
+        emit finished(static_cast<int>(m_file.frameCount()), m_elapsed.elapsed());
+        return;
+    }
+    qint64 gap = m_realTime ? m_file.frame(m_next).timeMs - frame.timeMs : 0;
+    m_timer->start(static_cast<int>(qBound<qint64>(0, gap, kMaxReplayGapMs)));
+}
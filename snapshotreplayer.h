@@ -0,0 +1,59 @@
+#ifndef SNAPSHOTREPLAYER_H
+#define SNAPSHOTREPLAYER_H
+
+#include <QObject>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QVector>
+#include "datatypes.h"
+#include "snapshotformat.h"
+
+class QTimer;
+
+// Plays a .masnap recording back as the same ScanDelta stream the worker
+// produces, either spaced as recorded or as fast as the event loop takes
+// them, which gives a repeatable load for the views.
+class SnapshotReplayer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SnapshotReplayer(QObject *parent = nullptr);
+
+    bool open(const QString &path, QString *error = nullptr);
+    void start(bool realTime);
+    void stop();
+    bool isActive() const;
+    int frameCount() const { return static_cast<int>(m_file.frameCount()); }
+    int position() const { return static_cast<int>(m_next); }
+    // Recording time of the frame emitted last
+    qint64 currentTimeMs() const { return m_currentTimeMs; }
+
+signals:
+    void scanDelta(const ScanDelta &delta);
+    void finished(int frames, qint64 elapsedMs);
+
+private slots:
+    void emitNextFrame();
+
+private:
+    const QString &nameAt(uint32_t id);
+
+    struct KnownProcess {
+        long memory = 0;
+        long growth = 0;
+        uint32_t nameId = 0;
+        quint64 seen = 0;
+    };
+
+    SnapshotFile m_file;
+    QTimer* m_timer;
+    size_t m_next = 0;
+    bool m_realTime = false;
+    quint64 m_generation = 0;
+    qint64 m_currentTimeMs = 0;
+    QHash<pid_t, KnownProcess> m_known;
+    QVector<QString> m_names; // decoded on first use
+    QElapsedTimer m_elapsed;
+};
+
+#endif // SNAPSHOTREPLAYER_H
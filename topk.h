@@ -0,0 +1,60 @@
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+// Keeps the k largest (key, id) pairs offered to push(), in a bounded
+// min-heap. Most candidates are rejected by a single comparison with the
+// current minimum, so ranking n items costs O(n + m log k) instead of the
+// O(n log n) of sorting everything, where m is the number of accepted items.
+template <typename Key, typename Id>
+class TopK
+{
+public:
+    struct Entry {
+        Key key;
+        Id id;
+        bool operator>(const Entry &other) const { return key > other.key; }
+    };
+
+    explicit TopK(size_t k = 0) { reset(k); }
+
+    void reset(size_t k)
+    {
+        m_k = k;
+        m_heap.clear();
+        m_heap.reserve(k);
+    }
+
+    void push(Key key, Id id)
+    {
+        if (m_k == 0) return;
+        if (m_heap.size() < m_k) {
+            m_heap.push_back({key, id});
+            std::push_heap(m_heap.begin(), m_heap.end(), std::greater<Entry>());
+        } else if (key > m_heap.front().key) {
+            std::pop_heap(m_heap.begin(), m_heap.end(), std::greater<Entry>());
+            m_heap.back() = {key, id};
+            std::push_heap(m_heap.begin(), m_heap.end(), std::greater<Entry>());
+        }
+    }
+
+    size_t capacity() const { return m_k; }
+    size_t size() const { return m_heap.size(); }
+
+    // Largest first. Consumes the heap; call reset() before pushing again.
+    const std::vector<Entry> &takeSorted()
+    {
+        std::sort_heap(m_heap.begin(), m_heap.end(), std::greater<Entry>());
+        return m_heap;
+    }
+
+private:
+    size_t m_k = 0;
+    std::vector<Entry> m_heap;
+};
+
+#endif // TOPK_H